@@ -0,0 +1,69 @@
+#include "BuiltinTools.h"
+#include "FileUtils.h"
+#include <windows.h>
+#include <cwchar>
+
+namespace {
+    constexpr size_t kMaxFileBytes = 64 * 1024;
+
+    bool CurrentTime(const std::wstring&, std::wstring& output, const std::atomic<bool>&)
+    {
+        SYSTEMTIME now;
+        GetLocalTime(&now);
+        wchar_t text[64];
+        swprintf(text, sizeof(text) / sizeof(text[0]), L"%04u-%02u-%02u %02u:%02u:%02u (local time)",
+                 now.wYear, now.wMonth, now.wDay, now.wHour, now.wMinute, now.wSecond);
+        output = text;
+        return true;
+    }
+
+    bool ReadTextFile(const std::wstring& arguments, std::wstring& output, const std::atomic<bool>&)
+    {
+        std::wstring path;
+        if (!ToolEngine::StringArgument(arguments, L"path", path) || path.empty()) {
+            output = L"Missing the \"path\" argument.";
+            return false;
+        }
+        if (!FileUtils::ValidateFileSize(path, kMaxFileBytes)) {
+            output = L"The file does not exist or is larger than 64 KB.";
+            return false;
+        }
+
+        std::vector<BYTE> buffer;
+        if (!FileUtils::ReadFileToBuffer(path, buffer)) {
+            output = L"The file could not be read.";
+            return false;
+        }
+        if (buffer.empty()) {
+            output.clear();
+            return true;
+        }
+        const char* data = reinterpret_cast<const char*>(buffer.data());
+        const int length = static_cast<int>(buffer.size());
+        const int wideLength = MultiByteToWideChar(CP_UTF8, 0, data, length, nullptr, 0);
+        output.assign(wideLength, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, data, length, &output[0], wideLength);
+        return true;
+    }
+}
+
+namespace BuiltinTools {
+    void Register(ToolEngine& engine, ToolPermissionStore& permissions)
+    {
+        engine.Register(ToolEngine::Tool{
+            L"get_current_time",
+            L"Returns the current local date and time of the user's computer.",
+            L"{\"type\":\"object\",\"properties\":{}}",
+            0,
+            CurrentTime });
+        permissions.SetPolicy(L"get_current_time", ToolPermissionPolicy::AlwaysAllow);
+
+        engine.Register(ToolEngine::Tool{
+            L"read_text_file",
+            L"Returns the contents of a UTF-8 text file of at most 64 KB on the user's computer.",
+            L"{\"type\":\"object\",\"properties\":{\"path\":{\"type\":\"string\","
+            L"\"description\":\"Absolute path of the file\"}},\"required\":[\"path\"]}",
+            0,
+            ReadTextFile });
+    }
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "ToolEngine.h"
+
+// Tools PilotLight offers the model when tools are enabled. The clock is
+// allowed from the start; reading a file asks first.
+namespace BuiltinTools {
+    void Register(ToolEngine& engine, ToolPermissionStore& permissions);
+}
@@ -1,13 +1,24 @@
 #include "ChatEngine.h"
 #include "OpenAIClient.h"
+#include "BuiltinTools.h"
+#include "Diagnostics.h"
+#include "SettingsStore.h"
+
+namespace {
+    constexpr int kMaxToolRounds = 4;  // Rounds of tool calls per reply before the model must answer
+}
 
 ChatEngine::ChatEngine()
+    : m_tools(m_toolPermissions)
 {
     InitializeSystemMessage();
+    BuiltinTools::Register(m_tools, m_toolPermissions);
+    Diagnostics::RegisterSection(L"Tools", [this] { return m_tools.Describe(); });
 }
 
 ChatEngine::~ChatEngine()
 {
+    Diagnostics::RegisterSection(L"Tools", [] { return std::wstring(L"stopped\r\n"); });
 }
 
 void ChatEngine::InitializeSystemMessage()
@@ -31,21 +42,105 @@ void ChatEngine::AddUserMessage(const std::wstring& content, const std::vector<F
 
 ChatMessage ChatEngine::GetAssistantResponse()
 {
+    return AddAssistantMessage(RequestAssistantResponse(m_history.GetMessages(), nullptr, nullptr,
+                                                        RateLimiter::Priority::Background));
+}
+
+std::wstring ChatEngine::RequestAssistantResponse(const std::vector<ChatMessage>& messages,
+                                                  const OpenAIClient::DeltaCallback& onDelta,
+                                                  const ToolEngine::ConfirmFn& confirm,
+                                                  RateLimiter::Priority priority,
+                                                  RequestCancellation* cancel)
+{
+    // Deltas pass through the plugins' streaming hooks before they are shown
+    PluginHost::ResponseStream stream(m_pluginHost);
+    OpenAIClient::DeltaCallback transformedDelta;
+    if (onDelta) {
+        transformedDelta = [&stream, &onDelta](const std::wstring& delta) {
+            const std::wstring& shown = stream.Append(delta);
+            if (!shown.empty()) {
+                onDelta(shown);
+            }
+        };
+    }
+
     OpenAIClient client;
-    std::wstring response = client.Complete(m_history.GetMessages());
-    response = m_pluginHost.ApplyAssistantResponseTransforms(response);
-    
-    ChatMessage assistantMsg(ChatMessage::Role::Assistant, response);
+    client.SetCancellation(cancel);
+    const auto& settings = SettingsStore::Get();
+    if (!settings.toolsEnabled || m_tools.Empty()) {
+        const std::wstring response = client.Complete(messages, priority, transformedDelta);
+        return stream.Finish(response);
+    }
+
+    // The text of each round is streamed as it comes; a blank line separates
+    // it from earlier text, as in the joined response
+    m_tools.Configure(static_cast<size_t>(settings.toolMaxParallel), settings.toolTimeoutMs, kMaxToolRounds);
+    bool streamedText = false;
+    bool separate = false;
+    OpenAIClient::DeltaCallback roundDelta;
+    if (transformedDelta) {
+        roundDelta = [&](const std::wstring& delta) {
+            if (separate) {
+                transformedDelta(L"\n\n");
+                separate = false;
+            }
+            streamedText = true;
+            transformedDelta(delta);
+        };
+    }
+    const std::wstring response = m_tools.Run(
+        [&](const ToolExchange& exchange, std::vector<ToolCall>& calls) {
+            separate = streamedText;
+            return client.Complete(messages, priority, roundDelta, &exchange, &calls);
+        },
+        confirm);
+    return stream.Finish(response);
+}
+
+ChatMessage ChatEngine::AddAssistantMessage(const std::wstring& content)
+{
+    ChatMessage assistantMsg(ChatMessage::Role::Assistant, content);
     m_history.AddMessage(assistantMsg);
     
     return assistantMsg;
 }
 
+size_t ChatEngine::ImportMessages(std::vector<ChatMessage>&& messages)
+{
+    std::vector<PluginHost::BatchMessage> batch;
+    for (const ChatMessage& msg : messages) {
+        if (msg.role == ChatMessage::Role::User) {
+            batch.push_back(PluginHost::BatchMessage{ PILOTLIGHT_ROLE_USER, msg.Content() });
+        } else if (msg.role == ChatMessage::Role::Assistant) {
+            batch.push_back(PluginHost::BatchMessage{ PILOTLIGHT_ROLE_ASSISTANT, msg.Content() });
+        }
+    }
+    m_pluginHost.ApplyTransformsBatch(batch);
+
+    size_t next = 0;
+    for (ChatMessage& msg : messages) {
+        if (msg.role == ChatMessage::Role::System) {
+            continue;
+        }
+        // A new message, so no digest of the old content carries over
+        ChatMessage imported(msg.role, batch[next++].text);
+        imported.attachments = std::move(msg.attachments);
+        imported.timestamp = msg.timestamp;
+        m_history.AddMessage(imported);
+    }
+    return next;
+}
+
 ChatHistory& ChatEngine::GetHistory()
 {
     return m_history;
 }
 
+PluginHost& ChatEngine::GetPluginHost()
+{
+    return m_pluginHost;
+}
+
 void ChatEngine::ClearHistory()
 {
     m_history.Clear();
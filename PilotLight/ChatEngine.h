@@ -3,6 +3,8 @@
 #include "ChatMessage.h"
 #include "ChatHistory.h"
 #include "PluginHost.h"
+#include "OpenAIClient.h"
+#include "ToolEngine.h"
 
 class ChatEngine {
 public:
@@ -10,12 +12,38 @@ public:
     ~ChatEngine();
 
     void AddUserMessage(const std::wstring& content, const std::vector<FileAttachment>& attachments);
+    // Blocking and unstreamed, for scripted use; nobody watches it arrive, so
+    // it is rate limited as background traffic
     ChatMessage GetAssistantResponse();
+
+    // Background-friendly split of GetAssistantResponse: RequestAssistantResponse
+    // touches only the given snapshot and may run on a worker thread (onDelta is
+    // called on a network thread with text that went through the plugins'
+    // streaming hooks; whole-response transforms run at the end); the reply is
+    // then recorded with AddAssistantMessage on the history's thread. With
+    // tools enabled the model may call them first; confirm is then called on
+    // the same thread for the calls that need the user's approval. Another
+    // thread can stop the request through cancel.
+    std::wstring RequestAssistantResponse(const std::vector<ChatMessage>& messages,
+                                          const OpenAIClient::DeltaCallback& onDelta,
+                                          const ToolEngine::ConfirmFn& confirm = nullptr,
+                                          RateLimiter::Priority priority = RateLimiter::Priority::Interactive,
+                                          RequestCancellation* cancel = nullptr);
+    ChatMessage AddAssistantMessage(const std::wstring& content);
+
+    // Appends the user and assistant messages of another conversation (an
+    // import) after passing them through the plugins in one batch, as if
+    // they had been typed and received here; system messages are dropped.
+    // Returns the number of messages added.
+    size_t ImportMessages(std::vector<ChatMessage>&& messages);
     ChatHistory& GetHistory();
+    PluginHost& GetPluginHost();
     void ClearHistory();
 
 private:
     ChatHistory m_history;
     PluginHost m_pluginHost;
+    ToolPermissionStore m_toolPermissions;
+    ToolEngine m_tools;
     void InitializeSystemMessage();
 };
@@ -1,9 +1,44 @@
 #include "ChatHistory.h"
+#include <algorithm>
 #include <fstream>
+#include <iterator>
 #include <sstream>
 #include <windows.h>
 #include <shlobj.h>
 
+namespace {
+    constexpr uint64_t kTailChunkBytes = 64 * 1024;
+
+    // SaveToFile writes through the C locale: one byte per character
+    std::wstring Widen(const std::string& bytes)
+    {
+        std::wstring text(bytes.length(), L'\0');
+        for (size_t i = 0; i < bytes.length(); ++i) {
+            text[i] = static_cast<wchar_t>(static_cast<unsigned char>(bytes[i]));
+        }
+        return text;
+    }
+
+    // SaveToFile writes one message per line ("  {...},"); newlines in the
+    // content are escaped, so a line never holds part of a message
+    bool ParseLine(const std::wstring& text, size_t begin, size_t end, ChatMessage& msg)
+    {
+        const size_t open = text.find(L'{', begin);
+        if (open >= end) {
+            return false;
+        }
+        size_t close = end;
+        while (close > open && text[close - 1] != L'}') {
+            --close;
+        }
+        if (close == open) {
+            return false;
+        }
+        msg = ChatMessage::FromJson(text.substr(open, close - open));
+        return true;
+    }
+}
+
 ChatHistory::ChatHistory()
 {
 }
@@ -27,6 +62,12 @@ void ChatHistory::Clear()
     m_messages.clear();
 }
 
+void ChatHistory::PrependMessages(std::vector<ChatMessage>&& older)
+{
+    older.insert(older.end(), std::make_move_iterator(m_messages.begin()), std::make_move_iterator(m_messages.end()));
+    m_messages = std::move(older);
+}
+
 bool ChatHistory::SaveToFile(const std::wstring& path)
 {
     std::wofstream file(path, std::ios::out | std::ios::trunc);
@@ -47,32 +88,95 @@ bool ChatHistory::SaveToFile(const std::wstring& path)
 
 bool ChatHistory::LoadFromFile(const std::wstring& path)
 {
-    std::wifstream file(path);
+    std::vector<ChatMessage> messages;
+    if (!ReadMessages(path, 0, UINT64_MAX, messages)) {
+        return false;
+    }
+    m_messages = std::move(messages);
+    return true;
+}
+
+bool ChatHistory::LoadTail(const std::wstring& path, size_t maxMessages, uint64_t& tailOffset)
+{
+    tailOffset = 0;
+    std::ifstream file(path, std::ios::in | std::ios::binary);
     if (!file.is_open()) {
         return false;
     }
+    file.seekg(0, std::ios::end);
+    const uint64_t fileSize = static_cast<uint64_t>(file.tellg());
 
-    m_messages.clear();
+    // Read growing chunks off the end until they hold enough complete lines
+    std::vector<ChatMessage> tail;
+    for (uint64_t chunk = kTailChunkBytes;; chunk *= 4) {
+        const uint64_t start = fileSize > chunk ? fileSize - chunk : 0;
+        std::string bytes(static_cast<size_t>(fileSize - start), '\0');
+        file.seekg(static_cast<std::streamoff>(start));
+        if (!bytes.empty() && !file.read(&bytes[0], bytes.size())) {
+            return false;
+        }
+        const std::wstring text = Widen(bytes);
 
-    std::wstring content;
-    std::wstring line;
-    while (std::getline(file, line)) {
-        content += line + L"\n";
+        // A chunk starting mid-file starts mid-line; that line waits for a bigger chunk
+        const size_t newline = text.find(L'\n');
+        const size_t firstLine = start == 0 ? 0 : (newline == std::wstring::npos ? text.length() : newline + 1);
+
+        tail.clear();
+        size_t lineEnd = text.length();
+        while (lineEnd > firstLine && tail.size() < maxMessages) {
+            const size_t previous = text.rfind(L'\n', lineEnd - 1);
+            const size_t lineStart =
+                previous == std::wstring::npos || previous < firstLine ? firstLine : previous + 1;
+            ChatMessage msg;
+            if (ParseLine(text, lineStart, lineEnd, msg)) {
+                tail.push_back(std::move(msg));
+                tailOffset = start + lineStart;
+            }
+            lineEnd = lineStart > firstLine ? lineStart - 1 : firstLine;
+        }
+
+        if (tail.size() >= maxMessages || start == 0) {
+            break;
+        }
     }
-    file.close();
 
-    // Basic parsing - extract JSON objects between { and }
-    size_t pos = 0;
-    while ((pos = content.find(L'{', pos)) != std::wstring::npos) {
-        size_t end = content.find(L'}', pos);
-        if (end == std::wstring::npos) break;
-        
-        std::wstring msgJson = content.substr(pos, end - pos + 1);
-        ChatMessage msg = ChatMessage::FromJson(msgJson);
-        m_messages.push_back(msg);
-        
-        pos = end + 1;
+    if (tail.size() < maxMessages) {
+        tailOffset = 0;  // The whole history fit
     }
+    std::reverse(tail.begin(), tail.end());
+    m_messages = std::move(tail);
+    return true;
+}
 
+bool ChatHistory::ReadMessages(const std::wstring& path, uint64_t begin, uint64_t end,
+                               std::vector<ChatMessage>& messages)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.seekg(0, std::ios::end);
+    end = (std::min)(end, static_cast<uint64_t>(file.tellg()));
+    begin = (std::min)(begin, end);
+
+    std::string bytes(static_cast<size_t>(end - begin), '\0');
+    file.seekg(static_cast<std::streamoff>(begin));
+    if (!bytes.empty() && !file.read(&bytes[0], bytes.size())) {
+        return false;
+    }
+    const std::wstring text = Widen(bytes);
+
+    size_t lineStart = 0;
+    while (lineStart < text.length()) {
+        size_t lineEnd = text.find(L'\n', lineStart);
+        if (lineEnd == std::wstring::npos) {
+            lineEnd = text.length();
+        }
+        ChatMessage msg;
+        if (ParseLine(text, lineStart, lineEnd, msg)) {
+            messages.push_back(std::move(msg));
+        }
+        lineStart = lineEnd + 1;
+    }
     return true;
-}
\ No newline at end of file
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "ChatMessage.h"
+#include <cstdint>
 #include <vector>
 #include <string>
 
@@ -12,10 +13,22 @@ public:
     void AddMessage(const ChatMessage& msg);
     const std::vector<ChatMessage>& GetMessages() const;
     void Clear();
+    // Puts messages loaded later in front of the current ones
+    void PrependMessages(std::vector<ChatMessage>&& older);
     
     bool SaveToFile(const std::wstring& path);
     bool LoadFromFile(const std::wstring& path);
 
+    // Loads at most maxMessages from the end of the file, reading only as much
+    // of it as they need. tailOffset receives the byte offset the loaded
+    // messages start at; the older ones lie before it (0 when there are none).
+    bool LoadTail(const std::wstring& path, size_t maxMessages, uint64_t& tailOffset);
+
+    // Parses the messages stored in bytes [begin, end) of a history file;
+    // touches no instance state, so it can run on a worker thread
+    static bool ReadMessages(const std::wstring& path, uint64_t begin, uint64_t end,
+                             std::vector<ChatMessage>& messages);
+
 private:
     std::vector<ChatMessage> m_messages;
 };
\ No newline at end of file
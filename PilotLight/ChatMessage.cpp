@@ -1,4 +1,5 @@
 #include "ChatMessage.h"
+#include <cwchar>
 #include <sstream>
 
 std::wstring ChatMessage::RoleToString() const
@@ -18,6 +19,25 @@ ChatMessage::Role ChatMessage::StringToRole(const std::wstring& str)
     return Role::User;
 }
 
+void ChatMessage::SetContent(const std::wstring& content)
+{
+    m_content = content;
+    m_digestValid = false;
+}
+
+const Hash::Digest& ChatMessage::ContentDigest() const
+{
+    if (!m_digestValid || m_digestedRole != role) {
+        Hash::Sha256 hasher;
+        hasher.Update(RoleToString());
+        hasher.Update(m_content);
+        m_contentDigest = hasher.Final();
+        m_digestValid = true;
+        m_digestedRole = role;
+    }
+    return m_contentDigest;
+}
+
 // Simple JSON escaping for strings
 static std::wstring EscapeJson(const std::wstring& str)
 {
@@ -38,12 +58,38 @@ static std::wstring EscapeJson(const std::wstring& str)
     return result;
 }
 
+// Reads a JSON string starting just past its opening quote, undoing EscapeJson
+static std::wstring ReadJsonString(const std::wstring& json, size_t pos)
+{
+    std::wstring result;
+    for (; pos < json.length() && json[pos] != L'"'; ++pos) {
+        if (json[pos] != L'\\' || pos + 1 >= json.length()) {
+            result += json[pos];
+            continue;
+        }
+        const wchar_t escaped = json[++pos];
+        switch (escaped) {
+            case L'n': result += L'\n'; break;
+            case L'r': result += L'\r'; break;
+            case L't': result += L'\t'; break;
+            case L'u':
+                if (pos + 4 < json.length()) {
+                    result += static_cast<wchar_t>(wcstoul(json.substr(pos + 1, 4).c_str(), nullptr, 16));
+                    pos += 4;
+                }
+                break;
+            default: result += escaped; break;  // \" \\ \/
+        }
+    }
+    return result;
+}
+
 std::wstring ChatMessage::ToJson() const
 {
     std::wostringstream oss;
     oss << L"{";
     oss << L"\"role\":\"" << RoleToString() << L"\",";
-    oss << L"\"content\":\"" << EscapeJson(content) << L"\"";
+    oss << L"\"content\":\"" << EscapeJson(m_content) << L"\"";
     
     // Add attachments if present
     if (!attachments.empty()) {
@@ -72,21 +118,13 @@ ChatMessage ChatMessage::FromJson(const std::wstring& json)
     // Extract role
     size_t rolePos = json.find(L"\"role\":\"");
     if (rolePos != std::wstring::npos) {
-        rolePos += 8;
-        size_t roleEnd = json.find(L"\"", rolePos);
-        if (roleEnd != std::wstring::npos) {
-            msg.role = StringToRole(json.substr(rolePos, roleEnd - rolePos));
-        }
+        msg.role = StringToRole(ReadJsonString(json, rolePos + 8));
     }
     
     // Extract content
     size_t contentPos = json.find(L"\"content\":\"");
     if (contentPos != std::wstring::npos) {
-        contentPos += 11;
-        size_t contentEnd = json.find(L"\"", contentPos);
-        if (contentEnd != std::wstring::npos) {
-            msg.content = json.substr(contentPos, contentEnd - contentPos);
-        }
+        msg.SetContent(ReadJsonString(json, contentPos + 11));
     }
     
     return msg;
@@ -2,6 +2,7 @@
 #include <string>
 #include <vector>
 #include <windows.h>
+#include "Hash.h"
 
 // File attachment with base64 encoding support
 struct FileAttachment {
@@ -18,7 +19,6 @@ struct ChatMessage {
     enum class Role { System, User, Assistant };
     
     Role role;
-    std::wstring content;
     std::vector<FileAttachment> attachments;
     SYSTEMTIME timestamp;
 
@@ -26,13 +26,26 @@ struct ChatMessage {
         GetSystemTime(&timestamp);
     }
 
-    ChatMessage(Role r, const std::wstring& c) : role(r), content(c) {
+    ChatMessage(Role r, const std::wstring& c) : role(r), m_content(c) {
         GetSystemTime(&timestamp);
     }
 
+    const std::wstring& Content() const { return m_content; }
+    void SetContent(const std::wstring& content);
+
     // Serialization helpers
     std::wstring RoleToString() const;
     static Role StringToRole(const std::wstring& str);
     std::wstring ToJson() const;
     static ChatMessage FromJson(const std::wstring& json);
+
+    // SHA-256 over role + content. Cached so request keys over long histories
+    // stay cheap; SetContent() and a role change invalidate it.
+    const Hash::Digest& ContentDigest() const;
+
+private:
+    std::wstring m_content;  // Private so every edit goes through SetContent()
+    mutable Hash::Digest m_contentDigest = {};
+    mutable bool m_digestValid = false;
+    mutable Role m_digestedRole = Role::User;
 };
\ No newline at end of file
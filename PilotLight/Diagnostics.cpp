@@ -0,0 +1,87 @@
+#include "Diagnostics.h"
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace {
+    constexpr size_t kMaxEvents = 128;
+
+    struct DiagnosticsState {
+        std::mutex lock;
+        std::deque<std::wstring> events;
+        std::vector<std::pair<std::wstring, std::function<std::wstring()>>> sections;
+    };
+
+    DiagnosticsState& State()
+    {
+        static DiagnosticsState state;
+        return state;
+    }
+}
+
+namespace Diagnostics {
+
+void Log(const std::wstring& message)
+{
+#ifdef _WIN32
+    std::wstring debugLine = L"[PilotLight] " + message + L"\n";
+    OutputDebugStringW(debugLine.c_str());
+#endif
+
+    auto& state = State();
+    std::lock_guard<std::mutex> guard(state.lock);
+    state.events.push_back(message);
+    while (state.events.size() > kMaxEvents) {
+        state.events.pop_front();
+    }
+}
+
+void RegisterSection(const std::wstring& title, std::function<std::wstring()> provider)
+{
+    auto& state = State();
+    std::lock_guard<std::mutex> guard(state.lock);
+    for (auto& section : state.sections) {
+        if (section.first == title) {
+            section.second = std::move(provider);
+            return;
+        }
+    }
+    state.sections.emplace_back(title, std::move(provider));
+}
+
+std::wstring BuildReport()
+{
+    // Copy under the lock, render outside it: providers take their own locks
+    std::vector<std::pair<std::wstring, std::function<std::wstring()>>> sections;
+    std::deque<std::wstring> events;
+    {
+        auto& state = State();
+        std::lock_guard<std::mutex> guard(state.lock);
+        sections = state.sections;
+        events = state.events;
+    }
+
+    std::wstring report;
+    for (const auto& section : sections) {
+        report += L"== " + section.first + L" ==\r\n";
+        report += section.second ? section.second() : std::wstring();
+        report += L"\r\n";
+    }
+
+    report += L"== Recent events ==\r\n";
+    if (events.empty()) {
+        report += L"(none)\r\n";
+    }
+    for (const auto& line : events) {
+        report += line + L"\r\n";
+    }
+
+    return report;
+}
+
+}  // namespace Diagnostics
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+// Lightweight in-process diagnostics: a bounded event log plus named report
+// sections that subsystems register to describe their current state.
+namespace Diagnostics {
+    // Record a single event line (also forwarded to the debugger output on Windows)
+    void Log(const std::wstring& message);
+
+    // Register a section rendered by BuildReport(); re-registering a title replaces it
+    void RegisterSection(const std::wstring& title, std::function<std::wstring()> provider);
+
+    // Compose all sections followed by the most recent events
+    std::wstring BuildReport();
+}
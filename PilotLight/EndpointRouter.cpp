@@ -0,0 +1,245 @@
+#include "EndpointRouter.h"
+#include "Diagnostics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+    constexpr double kEwmaAlpha = 0.2;
+    constexpr int kFailuresBeforeCoolDown = 3;
+    constexpr int kInitialCoolDownSeconds = 5;
+    constexpr int kMaxCoolDownSeconds = 60;
+    constexpr double kUnhealthyErrorRate = 0.5;
+    constexpr double kErrorHalfLifeSeconds = 30.0;  // A single failure stops counting as unhealthy after this
+    constexpr size_t kMaxDecisions = 16;
+
+    double Ewma(double current, double sample, bool hasHistory)
+    {
+        return hasHistory ? current + kEwmaAlpha * (sample - current) : sample;
+    }
+}
+
+EndpointRouter& EndpointRouter::Shared()
+{
+    static EndpointRouter router;
+    static const bool registered = [] {
+        Diagnostics::RegisterSection(L"Endpoint routing", [] { return router.Describe(); });
+        return true;
+    }();
+    (void)registered;
+    return router;
+}
+
+void EndpointRouter::Configure(const std::vector<std::wstring>& endpoints)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    std::vector<Endpoint> configured;
+    configured.reserve(endpoints.size());
+    for (const auto& url : endpoints) {
+        if (url.empty()) {
+            continue;
+        }
+        auto duplicate = std::find_if(configured.begin(), configured.end(),
+            [&](const Endpoint& e) { return e.stats.url == url; });
+        if (duplicate != configured.end()) {
+            continue;
+        }
+
+        Endpoint* existing = Find(url);
+        if (existing) {
+            configured.push_back(*existing);
+        } else {
+            Endpoint endpoint;
+            endpoint.stats.url = url;
+            configured.push_back(endpoint);
+        }
+    }
+
+    m_endpoints.swap(configured);
+}
+
+std::vector<std::wstring> EndpointRouter::Rank(Clock::time_point now)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    std::vector<Endpoint*> healthy;
+    std::vector<Endpoint*> coolingDown;
+    for (auto& endpoint : m_endpoints) {
+        endpoint.stats.healthy = IsHealthy(endpoint, now);
+        (endpoint.stats.healthy ? healthy : coolingDown).push_back(&endpoint);
+    }
+
+    // Stable sorts keep configuration order as the tie-breaker
+    std::stable_sort(healthy.begin(), healthy.end(),
+        [this, now](const Endpoint* a, const Endpoint* b) { return Score(*a, now) < Score(*b, now); });
+    std::stable_sort(coolingDown.begin(), coolingDown.end(),
+        [](const Endpoint* a, const Endpoint* b) { return a->coolDownUntil < b->coolDownUntil; });
+
+    // The endpoint whose cool-down ended first gets this request as its
+    // probe, and the next window starts now: the probe's outcome either
+    // clears the cool-down or doubles it
+    Endpoint* probe = nullptr;
+    if (!coolingDown.empty() && coolingDown.front()->coolDownSeconds > 0 && now >= coolingDown.front()->coolDownUntil) {
+        probe = coolingDown.front();
+        coolingDown.erase(coolingDown.begin());
+        probe->coolDownUntil = now + std::chrono::seconds(probe->coolDownSeconds);
+    }
+
+    std::vector<std::wstring> ranked;
+    ranked.reserve(m_endpoints.size());
+    if (probe) ranked.push_back(probe->stats.url);
+    for (const Endpoint* endpoint : healthy) ranked.push_back(endpoint->stats.url);
+    for (const Endpoint* endpoint : coolingDown) ranked.push_back(endpoint->stats.url);
+
+    if (m_endpoints.size() > 1 && !ranked.empty()) {
+        RecordDecision((probe ? L"probing " : L"selected ") + ranked.front() +
+                       (probe ? L" after cool-down" : healthy.empty() ? L" (no healthy endpoint, last resort)" : L""));
+    }
+
+    return ranked;
+}
+
+void EndpointRouter::RecordSuccess(const std::wstring& url, double ttftMs, Clock::time_point now)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    Endpoint* endpoint = Find(url);
+    if (!endpoint) {
+        return;
+    }
+
+    EndpointStats& stats = endpoint->stats;
+    stats.ewmaTtftMs = Ewma(stats.ewmaTtftMs, ttftMs, stats.sampled);
+    stats.ewmaErrorRate = Ewma(ErrorRate(*endpoint, now), 0.0, stats.requests > 0);
+    endpoint->lastSample = now;
+    stats.sampled = true;
+    stats.requests++;
+    stats.consecutiveFailures = 0;
+    if (endpoint->coolDownSeconds > 0) {
+        // A successful probe puts the endpoint back in rotation
+        stats.ewmaErrorRate = (std::min)(stats.ewmaErrorRate, kUnhealthyErrorRate / 2);
+        RecordDecision(L"probe of " + url + L" succeeded");
+    }
+    endpoint->coolDownSeconds = 0;
+    endpoint->coolDownUntil = Clock::time_point();
+}
+
+void EndpointRouter::RecordFailure(const std::wstring& url, const std::wstring& reason, Clock::time_point now)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    Endpoint* endpoint = Find(url);
+    if (!endpoint) {
+        return;
+    }
+
+    EndpointStats& stats = endpoint->stats;
+    stats.ewmaErrorRate = Ewma(ErrorRate(*endpoint, now), 1.0, stats.requests > 0);
+    endpoint->lastSample = now;
+    stats.requests++;
+    stats.failures++;
+    stats.consecutiveFailures++;
+
+    if (stats.consecutiveFailures >= kFailuresBeforeCoolDown) {
+        // Back off exponentially; once the window passes the endpoint gets a probe request
+        endpoint->coolDownSeconds = endpoint->coolDownSeconds == 0
+            ? kInitialCoolDownSeconds
+            : (std::min)(endpoint->coolDownSeconds * 2, kMaxCoolDownSeconds);
+        endpoint->coolDownUntil = now + std::chrono::seconds(endpoint->coolDownSeconds);
+        RecordDecision(L"cooling down " + url + L" for " +
+                       std::to_wstring(endpoint->coolDownSeconds) + L"s after " + reason);
+    }
+}
+
+void EndpointRouter::RecordFailover(const std::wstring& from, const std::wstring& to, const std::wstring& reason)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    RecordDecision(L"failover " + from + L" -> " + to + L" (" + reason + L")");
+}
+
+std::vector<EndpointRouter::EndpointStats> EndpointRouter::Snapshot(Clock::time_point now)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    std::vector<EndpointStats> snapshot;
+    snapshot.reserve(m_endpoints.size());
+    for (const auto& endpoint : m_endpoints) {
+        EndpointStats stats = endpoint.stats;
+        stats.ewmaErrorRate = ErrorRate(endpoint, now);
+        stats.healthy = IsHealthy(endpoint, now);
+        snapshot.push_back(stats);
+    }
+    return snapshot;
+}
+
+std::wstring EndpointRouter::Describe()
+{
+    std::wstring text;
+    for (const auto& stats : Snapshot()) {
+        wchar_t line[160];
+        swprintf(line, sizeof(line) / sizeof(line[0]),
+                 L"  ttft=%.0fms err=%.2f req=%llu fail=%llu %ls\r\n",
+                 stats.ewmaTtftMs, stats.ewmaErrorRate,
+                 static_cast<unsigned long long>(stats.requests),
+                 static_cast<unsigned long long>(stats.failures),
+                 stats.healthy ? L"healthy" : L"cooling down");
+        text += stats.url + L"\r\n" + line;
+    }
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (!m_decisions.empty()) {
+        text += L"Recent decisions:\r\n";
+        for (const auto& decision : m_decisions) {
+            text += L"  " + decision + L"\r\n";
+        }
+    }
+    return text.empty() ? L"(no endpoints configured)\r\n" : text;
+}
+
+EndpointRouter::Endpoint* EndpointRouter::Find(const std::wstring& url)
+{
+    for (auto& endpoint : m_endpoints) {
+        if (endpoint.stats.url == url) {
+            return &endpoint;
+        }
+    }
+    return nullptr;
+}
+
+// The stored rate halves every kErrorHalfLifeSeconds without a new sample
+double EndpointRouter::ErrorRate(const Endpoint& endpoint, Clock::time_point now) const
+{
+    if (endpoint.stats.requests == 0 || now <= endpoint.lastSample) {
+        return endpoint.stats.ewmaErrorRate;
+    }
+    const double idleSeconds = std::chrono::duration<double>(now - endpoint.lastSample).count();
+    return endpoint.stats.ewmaErrorRate * std::exp2(-idleSeconds / kErrorHalfLifeSeconds);
+}
+
+// An endpoint in cool-down stays unhealthy until a probe succeeds
+bool EndpointRouter::IsHealthy(const Endpoint& endpoint, Clock::time_point now) const
+{
+    return endpoint.coolDownSeconds == 0 && ErrorRate(endpoint, now) < kUnhealthyErrorRate;
+}
+
+double EndpointRouter::Score(const Endpoint& endpoint, Clock::time_point now) const
+{
+    // Unsampled endpoints score best so every gateway gets measured once
+    if (!endpoint.stats.sampled) {
+        return 0.0;
+    }
+    const double availability = (std::max)(0.05, 1.0 - ErrorRate(endpoint, now));
+    return endpoint.stats.ewmaTtftMs / availability;
+}
+
+void EndpointRouter::RecordDecision(const std::wstring& decision)
+{
+    // Only log transitions so steady traffic does not flood the event log
+    if (!m_decisions.empty() && m_decisions.back() == decision) {
+        return;
+    }
+    m_decisions.push_back(decision);
+    while (m_decisions.size() > kMaxDecisions) {
+        m_decisions.pop_front();
+    }
+    Diagnostics::Log(L"router: " + decision);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Routes completion requests across a set of OpenAI-compatible endpoints.
+// Each endpoint tracks an EWMA of time-to-first-byte and of its error rate;
+// requests go to the fastest healthy endpoint and fail over down the ranking.
+// The error rate decays with time, so an endpoint that failed is tried again
+// once its failures are old; one in cool-down gets a single probe request
+// each time its cool-down ends. Every call takes the current time, so tests
+// can drive the router with a simulated clock.
+class EndpointRouter {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct EndpointStats {
+        std::wstring url;
+        double ewmaTtftMs = 0.0;
+        double ewmaErrorRate = 0.0;
+        uint64_t requests = 0;
+        uint64_t failures = 0;
+        int consecutiveFailures = 0;
+        bool sampled = false;
+        bool healthy = true;
+    };
+
+    static EndpointRouter& Shared();
+
+    // Replace the endpoint set; stats are kept for URLs present in both sets
+    void Configure(const std::vector<std::wstring>& endpoints);
+
+    // Endpoints in preferred order: a due probe first, then healthy ones by
+    // score, then cooling-down ones as last resort
+    std::vector<std::wstring> Rank(Clock::time_point now = Clock::now());
+
+    void RecordSuccess(const std::wstring& url, double ttftMs, Clock::time_point now = Clock::now());
+    void RecordFailure(const std::wstring& url, const std::wstring& reason, Clock::time_point now = Clock::now());
+    void RecordFailover(const std::wstring& from, const std::wstring& to, const std::wstring& reason);
+
+    std::vector<EndpointStats> Snapshot(Clock::time_point now = Clock::now());
+    std::wstring Describe();
+
+private:
+    struct Endpoint {
+        EndpointStats stats;
+        Clock::time_point lastSample;     // When ewmaErrorRate was last updated
+        Clock::time_point coolDownUntil;  // Next probe; meaningful while coolDownSeconds > 0
+        int coolDownSeconds = 0;
+    };
+
+    Endpoint* Find(const std::wstring& url);
+    double ErrorRate(const Endpoint& endpoint, Clock::time_point now) const;
+    bool IsHealthy(const Endpoint& endpoint, Clock::time_point now) const;
+    double Score(const Endpoint& endpoint, Clock::time_point now) const;
+    void RecordDecision(const std::wstring& decision);
+
+    std::mutex m_lock;
+    std::vector<Endpoint> m_endpoints;
+    std::deque<std::wstring> m_decisions;
+};
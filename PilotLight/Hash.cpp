@@ -0,0 +1,207 @@
+#include "Hash.h"
+#include <cstring>
+
+namespace {
+    const uint32_t kRoundConstants[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    inline uint32_t RotateRight(uint32_t value, int bits)
+    {
+        return (value >> bits) | (value << (32 - bits));
+    }
+
+    int HexValue(wchar_t ch)
+    {
+        if (ch >= L'0' && ch <= L'9') return ch - L'0';
+        if (ch >= L'a' && ch <= L'f') return ch - L'a' + 10;
+        if (ch >= L'A' && ch <= L'F') return ch - L'A' + 10;
+        return -1;
+    }
+}
+
+namespace Hash {
+
+bool Digest::operator==(const Digest& other) const
+{
+    return std::memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+}
+
+std::wstring Digest::ToHex() const
+{
+    static const wchar_t kDigits[] = L"0123456789abcdef";
+    std::wstring hex;
+    hex.reserve(sizeof(bytes) * 2);
+    for (uint8_t byte : bytes) {
+        hex += kDigits[byte >> 4];
+        hex += kDigits[byte & 0x0f];
+    }
+    return hex;
+}
+
+bool Digest::FromHex(const std::wstring& hex, Digest& digest)
+{
+    if (hex.length() != sizeof(digest.bytes) * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(digest.bytes); ++i) {
+        const int high = HexValue(hex[i * 2]);
+        const int low = HexValue(hex[i * 2 + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        digest.bytes[i] = static_cast<uint8_t>((high << 4) | low);
+    }
+    return true;
+}
+
+uint64_t Digest::Prefix64() const
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+Sha256::Sha256()
+    : m_bufferLength(0)
+    , m_totalLength(0)
+{
+    const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    std::memcpy(m_state, initial, sizeof(m_state));
+}
+
+void Sha256::Update(const void* data, size_t length)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    m_totalLength += length;
+
+    if (m_bufferLength > 0) {
+        const size_t take = (length < 64 - m_bufferLength) ? length : 64 - m_bufferLength;
+        std::memcpy(m_buffer + m_bufferLength, bytes, take);
+        m_bufferLength += take;
+        bytes += take;
+        length -= take;
+        if (m_bufferLength < 64) {
+            return;
+        }
+        Transform(m_buffer);
+        m_bufferLength = 0;
+    }
+
+    while (length >= 64) {
+        Transform(bytes);
+        bytes += 64;
+        length -= 64;
+    }
+
+    std::memcpy(m_buffer, bytes, length);
+    m_bufferLength = length;
+}
+
+void Sha256::Update(const std::wstring& text)
+{
+    // Length prefix keeps concatenated fields unambiguous
+    const uint64_t length = text.length();
+    Update(&length, sizeof(length));
+    Update(text.data(), text.length() * sizeof(wchar_t));
+}
+
+void Sha256::Update(const Digest& digest)
+{
+    Update(digest.bytes, sizeof(digest.bytes));
+}
+
+Digest Sha256::Final()
+{
+    const uint64_t bitLength = m_totalLength * 8;
+    const uint8_t padStart = 0x80;
+    const uint8_t zero = 0;
+    Update(&padStart, 1);
+    while (m_bufferLength != 56) {
+        Update(&zero, 1);
+    }
+
+    uint8_t lengthBytes[8];
+    for (int i = 0; i < 8; ++i) {
+        lengthBytes[i] = static_cast<uint8_t>(bitLength >> (56 - 8 * i));
+    }
+    Update(lengthBytes, sizeof(lengthBytes));
+
+    Digest digest;
+    for (int i = 0; i < 8; ++i) {
+        digest.bytes[i * 4] = static_cast<uint8_t>(m_state[i] >> 24);
+        digest.bytes[i * 4 + 1] = static_cast<uint8_t>(m_state[i] >> 16);
+        digest.bytes[i * 4 + 2] = static_cast<uint8_t>(m_state[i] >> 8);
+        digest.bytes[i * 4 + 3] = static_cast<uint8_t>(m_state[i]);
+    }
+    return digest;
+}
+
+void Sha256::Transform(const uint8_t* block)
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16) |
+               (uint32_t(block[i * 4 + 2]) << 8) | uint32_t(block[i * 4 + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+        const uint32_t s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        const uint32_t s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+    uint32_t e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+
+    for (int i = 0; i < 64; ++i) {
+        const uint32_t s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+        const uint32_t choice = (e & f) ^ (~e & g);
+        const uint32_t temp1 = h + s1 + choice + kRoundConstants[i] + w[i];
+        const uint32_t s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+        const uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        const uint32_t temp2 = s0 + majority;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+
+    m_state[0] += a; m_state[1] += b; m_state[2] += c; m_state[3] += d;
+    m_state[4] += e; m_state[5] += f; m_state[6] += g; m_state[7] += h;
+}
+
+Digest Sha256Of(const std::wstring& text)
+{
+    Sha256 hasher;
+    hasher.Update(text);
+    return hasher.Final();
+}
+
+uint64_t Fnv1a64(const void* data, size_t length, uint64_t seed)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+}  // namespace Hash
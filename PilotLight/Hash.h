@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Portable hashing helpers: SHA-256 for cache keys that must not collide,
+// FNV-1a for cheap in-memory bucketing.
+namespace Hash {
+    struct Digest {
+        uint8_t bytes[32];
+
+        bool operator==(const Digest& other) const;
+        bool operator!=(const Digest& other) const { return !(*this == other); }
+        std::wstring ToHex() const;
+        static bool FromHex(const std::wstring& hex, Digest& digest);
+        uint64_t Prefix64() const;  // First 8 bytes, for hash tables
+    };
+
+    // Incremental SHA-256
+    class Sha256 {
+    public:
+        Sha256();
+
+        void Update(const void* data, size_t length);
+        void Update(const std::wstring& text);
+        void Update(const Digest& digest);
+        Digest Final();
+
+    private:
+        void Transform(const uint8_t* block);
+
+        uint32_t m_state[8];
+        uint8_t m_buffer[64];
+        size_t m_bufferLength;
+        uint64_t m_totalLength;
+    };
+
+    Digest Sha256Of(const std::wstring& text);
+
+    constexpr uint64_t kFnvOffset = 14695981039346656037ULL;
+    uint64_t Fnv1a64(const void* data, size_t length, uint64_t seed = kFnvOffset);
+}
@@ -0,0 +1,107 @@
+#include "HedgePolicy.h"
+#include "Diagnostics.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+    constexpr size_t kMaxSamples = 64;
+    constexpr size_t kMinSamples = 10;
+    constexpr double kMaxBudget = 2.0;  // Allows a short burst of hedges after a quiet period
+}
+
+HedgePolicy::HedgePolicy()
+    : m_nextSample(0)
+    , m_percentile(95.0)
+    , m_maxHedgeRate(0.1)
+    , m_budget(0.0)
+    , m_requests(0)
+    , m_hedges(0)
+    , m_hedgeWins(0)
+    , m_budgetDenials(0)
+{
+}
+
+HedgePolicy& HedgePolicy::Shared()
+{
+    static HedgePolicy policy;
+    static const bool registered = [] {
+        Diagnostics::RegisterSection(L"Request hedging", [] { return policy.Describe(); });
+        return true;
+    }();
+    (void)registered;
+    return policy;
+}
+
+void HedgePolicy::Configure(double percentile, double maxHedgeRate)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_percentile = (std::min)(100.0, (std::max)(1.0, percentile));
+    m_maxHedgeRate = (std::min)(1.0, (std::max)(0.0, maxHedgeRate));
+}
+
+void HedgePolicy::RecordRequest()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_requests++;
+    m_budget = (std::min)(kMaxBudget, m_budget + m_maxHedgeRate);
+}
+
+void HedgePolicy::RecordTtft(double ms)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_samples.size() < kMaxSamples) {
+        m_samples.push_back(ms);
+    } else {
+        m_samples[m_nextSample] = ms;
+    }
+    m_nextSample = (m_nextSample + 1) % kMaxSamples;
+}
+
+bool HedgePolicy::HedgeDelay(double& delayMs)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_samples.size() < kMinSamples) {
+        return false;
+    }
+
+    std::vector<double> sorted = m_samples;
+    const size_t rank = static_cast<size_t>(m_percentile / 100.0 * (sorted.size() - 1) + 0.5);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    delayMs = sorted[rank];
+    return true;
+}
+
+bool HedgePolicy::TryAcquireHedge()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_budget < 1.0) {
+        m_budgetDenials++;
+        return false;
+    }
+    m_budget -= 1.0;
+    m_hedges++;
+    return true;
+}
+
+void HedgePolicy::RecordHedgeOutcome(bool hedgeWon)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (hedgeWon) {
+        m_hedgeWins++;
+    }
+}
+
+std::wstring HedgePolicy::Describe()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    wchar_t text[256];
+    swprintf(text, sizeof(text) / sizeof(text[0]),
+             L"p%.0f trigger, cap %.0f%%, samples=%zu\r\n"
+             L"requests=%llu hedges=%llu hedge wins=%llu budget denials=%llu\r\n",
+             m_percentile, m_maxHedgeRate * 100.0, m_samples.size(),
+             static_cast<unsigned long long>(m_requests),
+             static_cast<unsigned long long>(m_hedges),
+             static_cast<unsigned long long>(m_hedgeWins),
+             static_cast<unsigned long long>(m_budgetDenials));
+    return text;
+}
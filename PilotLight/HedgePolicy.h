@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Decides when a completion request should be hedged: if no first byte has
+// arrived within a percentile of recent time-to-first-byte samples, a duplicate
+// request may be issued. A token budget caps hedges to a fraction of requests.
+class HedgePolicy {
+public:
+    HedgePolicy();
+
+    static HedgePolicy& Shared();
+
+    // percentile in (0, 100]; maxHedgeRate is the allowed hedges per request (0..1)
+    void Configure(double percentile, double maxHedgeRate);
+
+    void RecordRequest();
+    void RecordTtft(double ms);
+
+    // Delay after which to hedge; false until enough samples have been seen
+    bool HedgeDelay(double& delayMs);
+
+    // Consumes hedge budget; false when the rate cap has been reached
+    bool TryAcquireHedge();
+    void RecordHedgeOutcome(bool hedgeWon);
+
+    std::wstring Describe();
+
+private:
+    std::mutex m_lock;
+    std::vector<double> m_samples;  // Ring of recent TTFT samples
+    size_t m_nextSample;
+    double m_percentile;
+    double m_maxHedgeRate;
+    double m_budget;
+    uint64_t m_requests;
+    uint64_t m_hedges;
+    uint64_t m_hedgeWins;
+    uint64_t m_budgetDenials;
+};
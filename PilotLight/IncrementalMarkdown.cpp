@@ -0,0 +1,91 @@
+#include "IncrementalMarkdown.h"
+#include <algorithm>
+#include <cstdio>
+
+IncrementalMarkdownRenderer::IncrementalMarkdownRenderer()
+    : m_stableEnd(0)
+    , m_generation(0)
+    , m_deltas(0)
+    , m_charsTokenized(0)
+    , m_bytesRendered(0)
+    , m_maxBytesPerDelta(0)
+{
+}
+
+const std::string& IncrementalMarkdownRenderer::Begin(const std::wstring& label, const RtfMessageStyle& style)
+{
+    m_style = style;
+    m_style.markdown = true;
+    m_text.clear();
+    m_stableEnd = 0;
+    m_spans.clear();
+    m_deltas = 0;
+    m_charsTokenized = 0;
+    m_bytesRendered = 0;
+    m_maxBytesPerDelta = 0;
+    m_renderer.SetGrowingText(++m_generation);
+    return m_renderer.RenderSpans(label, m_text.c_str(), m_spans, 0, 0, m_style);
+}
+
+const IncrementalMarkdownRenderer::Update& IncrementalMarkdownRenderer::Append(const wchar_t* delta, size_t length)
+{
+    m_text.append(delta, length);
+
+    m_spans.clear();
+    m_tokenizer.Tokenize(m_text.c_str(), m_stableEnd, m_text.length(), m_spans);
+    m_charsTokenized += m_text.length() - m_stableEnd;
+
+    // Only complete lines are final: the unfinished last line can still change
+    // what it is ("#" -> "#hashtag" continues a paragraph instead of starting a heading).
+    const size_t newline = m_text.find_last_of(L'\n');
+    const size_t lastLineStart = newline == std::wstring::npos ? 0 : newline + 1;
+
+    size_t split = 0;
+    size_t stableEnd = m_stableEnd;
+    for (size_t i = 0; i + 1 < m_spans.size(); ++i) {
+        const MarkdownSpan& span = m_spans[i];
+        if (span.kind != MarkdownSpanKind::BlockEnd) {
+            continue;
+        }
+
+        // Paragraphs and list items end at the line after them, which must be complete;
+        // headings, rules and closed fences end with their own complete last line
+        bool stable = false;
+        if (span.block == MarkdownBlock::Paragraph || span.block == MarkdownBlock::ListItem) {
+            stable = span.start < lastLineStart;
+        } else if (span.block == MarkdownBlock::CodeFence) {
+            stable = span.start <= lastLineStart && !(m_spans[i - 1].flags & MarkdownSpan::Unterminated);
+        } else {
+            stable = span.start <= lastLineStart;
+        }
+        if (!stable) {
+            break;
+        }
+        split = i + 1;
+        stableEnd = span.start;
+    }
+
+    m_update.stableRtf.clear();
+    if (split > 0) {
+        m_update.stableRtf = m_renderer.RenderSpans(std::wstring(), m_text.c_str(), m_spans, 0, split, m_style);
+    }
+    m_update.tailRtf = m_renderer.RenderSpans(std::wstring(), m_text.c_str(), m_spans, split, m_spans.size(), m_style);
+    m_stableEnd = stableEnd;
+
+    const size_t bytes = m_update.stableRtf.size() + m_update.tailRtf.size();
+    m_deltas++;
+    m_bytesRendered += bytes;
+    m_maxBytesPerDelta = (std::max)(m_maxBytesPerDelta, bytes);
+    return m_update;
+}
+
+std::wstring IncrementalMarkdownRenderer::Describe() const
+{
+    wchar_t text[200];
+    swprintf(text, sizeof(text) / sizeof(text[0]),
+             L"deltas=%llu chars=%zu re-tokenized=%llu RTF bytes=%llu (avg %.0f, max %zu per delta)",
+             static_cast<unsigned long long>(m_deltas), m_text.length(),
+             static_cast<unsigned long long>(m_charsTokenized), static_cast<unsigned long long>(m_bytesRendered),
+             m_deltas ? static_cast<double>(m_bytesRendered) / m_deltas : 0.0, m_maxBytesPerDelta);
+    return text;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MarkdownRtf.h"
+#include "MarkdownTokenizer.h"
+
+// Renders a streaming assistant message without touching finished blocks.
+// Everything before the last stable block boundary has been emitted once and
+// is never re-tokenized; each delta re-tokenizes only the open tail (for
+// example an unterminated code fence) and reports the fragments that replace
+// the previously rendered tail in the chat control. Portable.
+class IncrementalMarkdownRenderer {
+public:
+    struct Update {
+        std::string stableRtf;  // Blocks finalized by this delta; empty if none
+        std::string tailRtf;    // Open tail, replacing the previously emitted tail
+    };
+
+    IncrementalMarkdownRenderer();
+
+    // Starts a message; returns the fragment for its label line
+    const std::string& Begin(const std::wstring& label, const RtfMessageStyle& style);
+    const Update& Append(const wchar_t* delta, size_t length);
+
+    const std::wstring& Text() const { return m_text; }
+    size_t StableLength() const { return m_stableEnd; }
+    const SyntaxHighlighter& Highlighter() const { return m_renderer.Highlighter(); }
+
+    // Re-render cost of the current message
+    std::wstring Describe() const;
+
+private:
+    RtfMessageStyle m_style;
+    std::wstring m_text;
+    size_t m_stableEnd;  // Source offset of the last stable block boundary
+    uint64_t m_generation;  // Messages begun; names the growing text for the renderer
+    MarkdownTokenizer m_tokenizer;
+    std::vector<MarkdownSpan> m_spans;
+    MarkdownRtfRenderer m_renderer;
+    Update m_update;
+
+    uint64_t m_deltas;
+    uint64_t m_charsTokenized;
+    uint64_t m_bytesRendered;
+    size_t m_maxBytesPerDelta;
+};
@@ -1,4 +1,5 @@
 #include "JsonBuilder.h"
+#include <cwchar>
 #include <sstream>
 #include <iomanip>
 
@@ -82,7 +83,7 @@ std::wstring JsonBuilder::EscapeString(const std::wstring& str) const
             default:
                 if (c < 32) {
                     wchar_t buf[8];
-                    swprintf_s(buf, L"\\u%04x", (int)c);
+                    swprintf(buf, sizeof(buf) / sizeof(buf[0]), L"\\u%04x", (int)c);
                     result += buf;
                 } else {
                     result += c;
@@ -125,7 +126,7 @@ void JsonBuilder::AddNumber(const wchar_t* key, double value)
     }
     
     wchar_t buf[64];
-    swprintf_s(buf, L"%g", value);
+    swprintf(buf, sizeof(buf) / sizeof(buf[0]), L"%g", value);
     m_buffer += buf;
     
     if (!m_needsComma.empty()) {
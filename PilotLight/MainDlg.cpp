@@ -5,13 +5,41 @@
 #include "SettingsStore.h"
 #include "FileUtils.h"
 #include "RichTextRenderer.h"
+#include "Diagnostics.h"
+#include "RenderCache.h"
+#include "StartupTrace.h"
+#include "ToolConfirmationDialog.h"
 #include <commctrl.h>
 #include <shellapi.h>
 #include <algorithm>
+#include <chrono>
+#include <climits>
 #include <cstring>
 
 #pragma comment(lib, "comctl32.lib")
 
+namespace {
+    constexpr size_t kStartupTailMessages = 24;  // More than a screenful; read from the end of the file
+    constexpr size_t kToolConfirmCalls = 8;        // Calls listed in the confirmation; the rest are counted
+    constexpr size_t kToolConfirmArgChars = 160;   // Per call, before the arguments are cut off
+
+    // Wall-clock time since the process was created, for the startup trace
+    double SecondsSinceProcessStart()
+    {
+        FILETIME created, exited, kernel, user, now;
+        if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) {
+            return 0.0;
+        }
+        GetSystemTimePreciseAsFileTime(&now);
+        ULARGE_INTEGER start, current;
+        start.LowPart = created.dwLowDateTime;
+        start.HighPart = created.dwHighDateTime;
+        current.LowPart = now.dwLowDateTime;
+        current.HighPart = now.dwHighDateTime;
+        return current.QuadPart > start.QuadPart ? (current.QuadPart - start.QuadPart) / 1e7 : 0.0;
+    }
+}
+
 // Constructor
 CMainDlg::CMainDlg(CWnd* pParent /*=nullptr*/)
     : CDialogEx(IDD_MAIN_DIALOG, pParent)
@@ -25,6 +53,20 @@ CMainDlg::CMainDlg(CWnd* pParent /*=nullptr*/)
     , m_btnSettingsState(Theme::ButtonState::Normal)
     , m_bTrackingMouse(FALSE)
     , m_settingsVisible(false)
+    , m_streamStart(0)
+    , m_streamTailStart(0)
+    , m_streamTailLength(0)
+    , m_toolConfirm(nullptr)
+    , m_toolConfirmSerial(0)
+    , m_toolConfirmBlocked(false)
+    , m_windowFirst(0)
+    , m_windowLast(0)
+    , m_lineHeight(20)
+    , m_charsPerLine(80)
+    , m_wrapWidth(0)
+    , m_historyTailCount(0)
+    , m_findVisible(false)
+    , m_findCurrent(0)
 {
     m_chatEngine = new ChatEngine();
     m_bgBrush.CreateSolidBrush(Theme::FrameBackground);
@@ -33,6 +75,19 @@ CMainDlg::CMainDlg(CWnd* pParent /*=nullptr*/)
 // Destructor
 CMainDlg::~CMainDlg()
 {
+    Diagnostics::RegisterSection(L"Streaming", [] { return std::wstring(L"stopped\r\n"); });
+    Diagnostics::RegisterSection(L"Syntax highlighting", [] { return std::wstring(L"stopped\r\n"); });
+    Diagnostics::RegisterSection(L"Transcript", [] { return std::wstring(L"stopped\r\n"); });
+    Diagnostics::RegisterSection(L"Find", [] { return std::wstring(L"stopped\r\n"); });
+    if (m_responseThread.joinable()) {
+        BlockToolConfirmation(true);
+        m_responseCancel.Cancel();
+        m_tokenQueue.Abort();
+        m_responseThread.join();
+    }
+    if (m_historyThread.joinable()) {
+        m_historyThread.join();
+    }
     if (m_chatEngine) {
         delete m_chatEngine;
         m_chatEngine = nullptr;
@@ -79,15 +134,23 @@ BEGIN_MESSAGE_MAP(CMainDlg, CDialogEx)
     ON_BN_CLICKED(IDC_SETTINGS_STUB_TOGGLE, &CMainDlg::OnStubToggle)
     ON_BN_CLICKED(IDC_BTN_CLEAR_HISTORY, &CMainDlg::OnClearHistory)
     ON_LBN_DBLCLK(IDC_ATTACHMENT_LIST, &CMainDlg::OnAttachmentDblClick)
+    ON_EN_CHANGE(IDC_FIND_EDIT, &CMainDlg::OnFindChanged)
     ON_WM_NCCALCSIZE()
     ON_WM_NCACTIVATE()
     ON_WM_DROPFILES()
+    ON_WM_TIMER()
+    ON_MESSAGE(WM_RESPONSE_COMPLETE, &CMainDlg::OnResponseComplete)
+    ON_MESSAGE(WM_THEMED_SCROLL, &CMainDlg::OnThemedScroll)
+    ON_MESSAGE(WM_HISTORY_LOADED, &CMainDlg::OnHistoryLoaded)
+    ON_MESSAGE(WM_STARTUP_IDLE, &CMainDlg::OnStartupIdle)
+    ON_MESSAGE(WM_TOOL_CONFIRM, &CMainDlg::OnToolConfirm)
 END_MESSAGE_MAP()
 
 // Initialize dialog
 BOOL CMainDlg::OnInitDialog()
 {
     CDialogEx::OnInitDialog();
+    StartupTrace::Shared().Mark(StartupTrace::DialogInit, SecondsSinceProcessStart());
 
     CBorderlessFrame::Apply(this);
     CBorderlessFrame::UpdateRegion(this, 16);
@@ -180,6 +243,14 @@ BOOL CMainDlg::OnInitDialog()
     m_settingsClose.Create(L"Close", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, CRect(0, 0, 0, 0), &m_settingsPanel, IDC_BTN_CLOSE_SETTINGS);
     m_settingsClose.ShowWindow(SW_HIDE);
 
+    // Find bar, shown in the titlebar by Ctrl+F
+    m_findStatus.Create(L"", WS_CHILD | SS_RIGHT | SS_CENTERIMAGE, CRect(0, 0, 0, 0), this, IDC_STATIC);
+    m_findStatus.SetFont(CFont::FromHandle(Theme::UIFont()));
+    m_findEdit.Create(WS_CHILD | WS_BORDER | ES_AUTOHSCROLL, CRect(0, 0, 0, 0), this, IDC_FIND_EDIT);
+    m_findEdit.SetFont(CFont::FromHandle(Theme::UIFont()));
+    m_findEdit.LimitText(256);
+    m_tooltip.AddTool(&m_findEdit, L"Find in transcript (Enter: next, Shift+Enter: previous, Esc: close)");
+
     // Set initial window size and position
     int screenWidth = GetSystemMetrics(SM_CXSCREEN);
     int screenHeight = GetSystemMetrics(SM_CYSCREEN);
@@ -195,17 +266,37 @@ BOOL CMainDlg::OnInitDialog()
     // Set window position and size
     SetWindowPos(nullptr, windowX, windowY, windowWidth, windowHeight, SWP_NOZORDER);
 
-    // Load chat history
-    LoadChatHistory();
-    UpdateChatDisplay();
+    // Streamed replies: batch sizes, dropped frames and queue depth
+    Diagnostics::RegisterSection(L"Streaming", [this] {
+        return m_framePacer.Describe() + m_tokenQueue.Describe();
+    });
+
+    // Code block lexing: history renders, then the streamed reply
+    Diagnostics::RegisterSection(L"Syntax highlighting", [this] {
+        return m_rtfRenderer.Highlighter().Describe() + m_streamRenderer.Highlighter().Describe();
+    });
+
+    Diagnostics::RegisterSection(L"Transcript", [this] {
+        wchar_t window[96];
+        swprintf(window, sizeof(window) / sizeof(window[0]), L"loaded messages [%zu, %zu)\r\n",
+                 m_windowFirst, m_windowLast);
+        return m_layout.Describe() + window;
+    });
+
+    Diagnostics::RegisterSection(L"Find", [this] { return m_search.Describe(); });
 
     // Initial layout - force after window is fully created
     LayoutControls();
+
+    // Load chat history: the last screenful now, the rest in the background
+    StartHistoryLoad();
     
     // Post a message to trigger layout after dialog is fully shown
     PostMessage(WM_SIZE, 0, MAKELPARAM(0, 0));
 
-    return TRUE;
+    // Focus the input so typing works from the first frame
+    m_input.SetFocus();
+    return FALSE;
 }
 
 namespace {
@@ -215,12 +306,58 @@ namespace {
     constexpr UINT ID_INPUT_PASTE = 0x5004;
     constexpr UINT ID_INPUT_DELETE = 0x5005;
     constexpr UINT ID_INPUT_SELECT_ALL = 0x5006;
+    constexpr UINT_PTR kStreamTimerId = 1;
+    constexpr UINT kStreamTimerMs = 16;  // One display frame; WM_TIMER coalesces while the UI is busy
+    constexpr size_t kVirtualizeThreshold = 200;  // Shorter transcripts are loaded whole
+    constexpr size_t kOverscanMessages = 12;      // Loaded beyond the viewport on each side
+    constexpr size_t kEdgeMessages = 4;           // Re-center when scrolling gets this close to an edge
+
+    double SteadySeconds()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
 
     bool HasHttpScheme(const CString& value)
     {
         return value.Left(7).CompareNoCase(L"http://") == 0 ||
                value.Left(8).CompareNoCase(L"https://") == 0;
     }
+
+    RtfMessageStyle MessageStyle(ChatMessage::Role role, std::wstring& label)
+    {
+        RtfMessageStyle style;
+        if (role == ChatMessage::Role::User) {
+            label = L"You: ";
+            style.labelColor = Theme::Text;
+            style.textColor = Theme::Text;
+            style.backgroundColor = Theme::Accent;
+            style.highlight = true;
+            style.indentTwips = 18 * 15;
+            style.hangingTwips = style.indentTwips / 2;
+            style.spaceBeforeTwips = 24;
+            style.spaceAfterTwips = 60;
+        } else if (role == ChatMessage::Role::Assistant) {
+            label = L"Assistant:";
+            style.labelColor = Theme::Foreground;
+            style.textColor = Theme::Text;
+            style.markdown = true;
+            style.labelOnOwnLine = true;
+            style.trailingBlankLine = true;
+            style.syntaxHighlight = true;
+            style.syntaxColors[static_cast<size_t>(SyntaxToken::Keyword)] = Theme::SyntaxKeyword;
+            style.syntaxColors[static_cast<size_t>(SyntaxToken::Type)] = Theme::SyntaxType;
+            style.syntaxColors[static_cast<size_t>(SyntaxToken::String)] = Theme::SyntaxString;
+            style.syntaxColors[static_cast<size_t>(SyntaxToken::Number)] = Theme::SyntaxNumber;
+            style.syntaxColors[static_cast<size_t>(SyntaxToken::Comment)] = Theme::SyntaxComment;
+            style.syntaxColors[static_cast<size_t>(SyntaxToken::Meta)] = Theme::SyntaxMeta;
+        } else {
+            label = L"System: ";
+            style.labelColor = Theme::Foreground;
+            style.textColor = Theme::Foreground;
+            style.trailingBlankLine = true;
+        }
+        return style;
+    }
 }
 
 // Pre-translate message for tooltips + clipboard shortcuts in chat input
@@ -230,6 +367,51 @@ BOOL CMainDlg::PreTranslateMessage(MSG* pMsg)
         m_tooltip.RelayEvent(pMsg);
     }
 
+    // Ctrl+Shift+D shows the diagnostics report from anywhere in the window
+    if (pMsg->message == WM_KEYDOWN && pMsg->wParam == 'D' &&
+        (GetKeyState(VK_CONTROL) & 0x8000) != 0 && (GetKeyState(VK_SHIFT) & 0x8000) != 0) {
+        ShowDiagnostics();
+        return TRUE;
+    }
+
+    // Ctrl+Shift+P re-enables plugins bypassed for running over the latency budget
+    if (pMsg->message == WM_KEYDOWN && pMsg->wParam == 'P' &&
+        (GetKeyState(VK_CONTROL) & 0x8000) != 0 && (GetKeyState(VK_SHIFT) & 0x8000) != 0) {
+        ReenablePlugins();
+        return TRUE;
+    }
+
+    // Ctrl+Shift+I appends a saved conversation, passed through the plugins
+    if (pMsg->message == WM_KEYDOWN && pMsg->wParam == 'I' &&
+        (GetKeyState(VK_CONTROL) & 0x8000) != 0 && (GetKeyState(VK_SHIFT) & 0x8000) != 0) {
+        ImportConversation();
+        return TRUE;
+    }
+
+    // Ctrl+F opens the find bar; F3 and Shift+F3 step through matches while it is open
+    if (pMsg->message == WM_KEYDOWN) {
+        const bool ctrlDown = (GetKeyState(VK_CONTROL) & 0x8000) != 0;
+        const bool shiftDown = (GetKeyState(VK_SHIFT) & 0x8000) != 0;
+        if (pMsg->wParam == 'F' && ctrlDown && !shiftDown) {
+            ShowFindBar(true);
+            return TRUE;
+        }
+        if (pMsg->wParam == VK_F3 && m_findVisible) {
+            StepFindMatch(shiftDown);
+            return TRUE;
+        }
+        if (m_findEdit.GetSafeHwnd() && ::GetFocus() == m_findEdit.GetSafeHwnd()) {
+            if (pMsg->wParam == VK_RETURN) {
+                StepFindMatch(shiftDown);
+                return TRUE;
+            }
+            if (pMsg->wParam == VK_ESCAPE) {
+                ShowFindBar(false);
+                return TRUE;
+            }
+        }
+    }
+
     CWnd* pFocus = GetFocus();
     const bool inputFocused =
         pFocus != nullptr &&
@@ -300,6 +482,11 @@ void CMainDlg::OnSize(UINT nType, int cx, int cy)
     CBorderlessFrame::UpdateRegion(this, 16);
     
     LayoutControls();
+
+    // Wrap width changed: only the loaded window is laid out again
+    if (m_chat.GetSafeHwnd() && UpdateLayoutMetrics()) {
+        RelayoutTranscript();
+    }
 }
 
 // Handle paint
@@ -336,6 +523,19 @@ void CMainDlg::OnPaint()
         dc.SelectObject(pOldBrush);
         dc.SelectObject(pOldPen);
     }
+
+    StartupTrace& trace = StartupTrace::Shared();
+    if (!trace.IsMarked(StartupTrace::FirstPaint)) {
+        trace.Mark(StartupTrace::FirstPaint, SecondsSinceProcessStart());
+        PostMessage(WM_STARTUP_IDLE);
+    }
+}
+
+// The first paint is done and the queue is being serviced: typing reaches the input now
+LRESULT CMainDlg::OnStartupIdle(WPARAM, LPARAM)
+{
+    StartupTrace::Shared().Mark(StartupTrace::InputReady, SecondsSinceProcessStart());
+    return 0;
 }
 
 
@@ -361,10 +561,24 @@ void CMainDlg::LayoutControls()
     CRect iconRect(margin, iconTop, margin + iconSize, iconTop + iconSize);
     m_appIcon.MoveWindow(&iconRect);
 
+    // Find bar - right end of the titlebar, next to the window buttons
+    int titleRight = clientRect.right - 3 * buttonWidth;
+    if (m_findVisible) {
+        const int findWidth = 220;
+        const int findHeight = 24;
+        const int statusWidth = 90;
+        int findTop = (titlebarHeight - findHeight) / 2;
+        CRect findRect(titleRight - margin - findWidth, findTop, titleRight - margin, findTop + findHeight);
+        m_findEdit.MoveWindow(&findRect);
+        CRect statusRect(findRect.left - margin / 2 - statusWidth, findTop, findRect.left - margin / 2, findTop + findHeight);
+        m_findStatus.MoveWindow(&statusRect);
+        titleRight = statusRect.left;
+    }
+
     // Titlebar text - start after the icon, aligned with icon vertically
     int titleLeft = margin + iconSize + iconMargin;
     int titleTop = iconTop;  // Align with icon top
-    CRect titlebarRect(titleLeft, titleTop, clientRect.right - 3 * buttonWidth, titlebarHeight);
+    CRect titlebarRect(titleLeft, titleTop, titleRight, titlebarHeight);
     m_titlebar.MoveWindow(&titlebarRect);
 
     // Titlebar buttons (right-aligned, flush with top-right, smaller height)
@@ -455,6 +669,7 @@ void CMainDlg::OnMaximize()
 // Close window
 void CMainDlg::OnClose()
 {
+    CancelPendingResponse();
     SaveChatHistory();
     CDialogEx::OnOK();  // Use OnOK to properly close modal dialog
 }
@@ -466,13 +681,18 @@ void CMainDlg::OnSendMessage()
     m_input.GetWindowText(inputText);
 
     if (inputText.IsEmpty()) return;
+    if (m_responseThread.joinable()) return;  // One reply at a time
+    CompleteHistoryLoad();  // The request carries the whole conversation
 
     // Create user message
     ChatMessage userMsg(ChatMessage::Role::User, (LPCTSTR)inputText);
     userMsg.attachments = m_pendingAttachments;
 
-    // Add to engine and display
-    m_chatEngine->AddUserMessage(userMsg.content, userMsg.attachments);
+    // Add to engine and display; new messages go at the end of the transcript
+    if (m_windowLast != m_layout.Count()) {
+        ShowTranscriptEnd();
+    }
+    m_chatEngine->AddUserMessage(userMsg.Content(), userMsg.attachments);
     AppendChatMessage(userMsg);
 
     // Clear input and attachments
@@ -481,12 +701,131 @@ void CMainDlg::OnSendMessage()
     m_attachmentList.ResetContent();
     UpdateAttachmentTooltip();
 
-    // Get assistant response
-    ChatMessage assistantMsg = m_chatEngine->GetAssistantResponse();
-    AppendChatMessage(assistantMsg);
+    // Request the reply on a worker thread so the window stays responsive;
+    // OnResponseComplete records it and saves history
+    BeginStreamingMessage();
+    const std::vector<ChatMessage> snapshot = m_chatEngine->GetHistory().GetMessages();
+    const HWND hwnd = GetSafeHwnd();
+    m_responseThread = std::thread([this, snapshot, hwnd] {
+        m_pendingResponse = m_chatEngine->RequestAssistantResponse(
+            snapshot,
+            [this](const std::wstring& delta) { m_tokenQueue.Write(delta.c_str(), delta.length()); },
+            [this, hwnd](const std::vector<ToolCall>& calls) { return ConfirmToolCalls(calls, hwnd); },
+            RateLimiter::Priority::Interactive, &m_responseCancel);
+        ::PostMessage(hwnd, WM_RESPONSE_COMPLETE, 0, 0);
+    });
+}
 
-    // Save history
-    SaveChatHistory();
+void CMainDlg::OnTimer(UINT_PTR nIDEvent)
+{
+    if (nIDEvent == kStreamTimerId) {
+        ApplyQueuedTokens();
+        return;
+    }
+    CDialogEx::OnTimer(nIDEvent);
+}
+
+LRESULT CMainDlg::OnResponseComplete(WPARAM /*wParam*/, LPARAM /*lParam*/)
+{
+    CompletePendingResponse();
+    return 0;
+}
+
+// Runs on the response worker; the dialog is shown by OnToolConfirm
+std::vector<ToolConfirmationDecision> CMainDlg::ConfirmToolCalls(const std::vector<ToolCall>& calls, HWND hwnd)
+{
+    ToolConfirmRequest request{ calls, std::vector<ToolConfirmationDecision>(), false };
+    std::unique_lock<std::mutex> guard(m_toolConfirmLock);
+    if (m_toolConfirmBlocked) {
+        return request.decisions;
+    }
+    m_toolConfirm = &request;
+    ++m_toolConfirmSerial;
+    ::PostMessage(hwnd, WM_TOOL_CONFIRM, 0, 0);
+    m_toolConfirmDone.wait(guard, [&request] { return request.answered; });
+    m_toolConfirm = nullptr;
+    return request.decisions;
+}
+
+// One dialog for all the calls of a round; the decision applies to each
+LRESULT CMainDlg::OnToolConfirm(WPARAM /*wParam*/, LPARAM /*lParam*/)
+{
+    std::vector<ToolCall> calls;
+    uint64_t serial = 0;
+    {
+        std::lock_guard<std::mutex> guard(m_toolConfirmLock);
+        if (!m_toolConfirm || m_toolConfirm->answered) {
+            return 0;
+        }
+        calls = m_toolConfirm->calls;
+        serial = m_toolConfirmSerial;
+    }
+
+    std::vector<std::wstring> names;
+    std::wstring summary;
+    for (size_t i = 0; i < calls.size(); ++i) {
+        if (std::find(names.begin(), names.end(), calls[i].name) == names.end()) {
+            names.push_back(calls[i].name);
+        }
+        if (i < kToolConfirmCalls) {
+            std::wstring arguments = calls[i].arguments;
+            if (arguments.length() > kToolConfirmArgChars) {
+                arguments = arguments.substr(0, kToolConfirmArgChars) + L"...";
+            }
+            summary += (i ? L"\r\n" : L"") + calls[i].name + L"(" + arguments + L")";
+        }
+    }
+    if (calls.size() > kToolConfirmCalls) {
+        summary += L"\r\n... and " + std::to_wstring(calls.size() - kToolConfirmCalls) + L" more";
+    }
+    std::wstring title;
+    for (const std::wstring& name : names) {
+        title += (title.empty() ? L"" : L", ") + name;
+    }
+
+    const ToolConfirmationDecision decision =
+        CToolConfirmationDialog::Prompt(title.c_str(), summary.c_str(), this);
+    {
+        std::lock_guard<std::mutex> guard(m_toolConfirmLock);
+        if (m_toolConfirm && !m_toolConfirm->answered && m_toolConfirmSerial == serial) {
+            m_toolConfirm->decisions.assign(calls.size(), decision);
+            m_toolConfirm->answered = true;
+        }
+    }
+    m_toolConfirmDone.notify_all();
+    return 0;
+}
+
+// While blocked, a waiting confirmation and any later one are cancelled, so
+// the worker can be joined
+void CMainDlg::BlockToolConfirmation(bool block)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_toolConfirmLock);
+        m_toolConfirmBlocked = block;
+        if (block && m_toolConfirm) {
+            m_toolConfirm->answered = true;
+        }
+    }
+    m_toolConfirmDone.notify_all();
+}
+
+LRESULT CMainDlg::OnThemedScroll(WPARAM wParam, LPARAM lParam)
+{
+    // A streaming reply writes at fixed character positions; the window stays put until it completes
+    if (!IsTranscriptVirtualized() || m_responseThread.joinable()) {
+        return 0;
+    }
+
+    if (wParam == ThemedScrollSeek) {
+        const int64_t top = static_cast<int64_t>(lParam);
+        const size_t anchor = m_layout.IndexAt(top);
+        const TranscriptLayout::Range range = m_layout.VisibleRange(top, ChatViewportHeight(), kOverscanMessages);
+        MaterializeWindow(range.first, range.last, anchor, static_cast<int>(m_layout.Offset(anchor) - top));
+    } else {
+        UpdateTranscriptWindow();
+    }
+    return 0;
 }
 
 // Attach file
@@ -637,8 +976,10 @@ void CMainDlg::RemoveAttachmentAtIndex(int index)
 void CMainDlg::OnClearHistory()
 {
     if (AfxMessageBox(L"Clear all chat history?", MB_YESNO | MB_ICONQUESTION) == IDYES) {
+        CancelPendingResponse();
+        CompleteHistoryLoad();
         m_chatEngine->ClearHistory();
-        m_chat.SetWindowText(L"");
+        UpdateChatDisplay();
         SaveChatHistory();
     }
 }
@@ -678,27 +1019,360 @@ void CMainDlg::AppendChatMessage(const ChatMessage& msg)
 {
     const bool wasNearBottom = IsChatNearBottom();
 
-    if (msg.role == ChatMessage::Role::User) {
-        RichTextRenderer::AppendBubble(m_chat, L"You: " + msg.content, Theme::Text, Theme::Accent);
-    } else if (msg.role == ChatMessage::Role::Assistant) {
-        RichTextRenderer::AppendFormattedText(m_chat, L"Assistant:\r\n", Theme::Foreground);
-        RichTextRenderer::AppendFormattedText(m_chat, msg.content + L"\r\n\r\n", Theme::Text);
+    // Past an unloaded tail the message only joins the layout; it loads when scrolled to
+    if (m_windowLast == m_layout.Count()) {
+        m_windowStarts.push_back(RichTextRenderer::TextLength(m_chat));
+        AppendMessageRtf(msg);
+        ++m_windowLast;
+        m_layout.Append(MeasureWindowMessage(m_windowLast - 1, msg), true);
     } else {
-        RichTextRenderer::AppendFormattedText(m_chat, L"System: " + msg.content + L"\r\n\r\n", Theme::Foreground);
+        m_layout.Append(EstimateMessageHeight(msg), false);
+    }
+    UpdateVirtualExtent();
+
+    ScrollChatToBottomIfPinned(wasNearBottom);
+}
+
+void CMainDlg::AppendMessageRtf(const ChatMessage& msg)
+{
+    RichTextRenderer::AppendRtf(m_chat, RenderMessage(msg));
+}
+
+// RTF for a message, from the render cache when it has been rendered before
+const std::string& CMainDlg::RenderMessage(const ChatMessage& msg)
+{
+    RenderCache& cache = RenderCache::Shared();
+    cache.Configure(static_cast<uint64_t>(SettingsStore::Get().renderCacheMaxMB) * 1024 * 1024);
+    if (const std::string* cached = cache.FindRtf(msg.ContentDigest(), Theme::Version)) {
+        return *cached;
+    }
+
+    std::wstring label;
+    const RtfMessageStyle style = MessageStyle(msg.role, label);
+    const std::string& rtf = m_rtfRenderer.Render(label, msg.Content(), style);
+    cache.StoreRtf(msg.ContentDigest(), Theme::Version, rtf);
+    return rtf;
+}
+
+// Insert the label of an assistant message whose body will stream in
+void CMainDlg::BeginStreamingMessage()
+{
+    const bool wasNearBottom = IsChatNearBottom();
+
+    std::wstring label;
+    const RtfMessageStyle style = MessageStyle(ChatMessage::Role::Assistant, label);
+    m_streamStart = RichTextRenderer::TextLength(m_chat);
+    RichTextRenderer::AppendRtf(m_chat, m_streamRenderer.Begin(label, style));
+    m_streamTailStart = RichTextRenderer::TextLength(m_chat);
+    m_streamTailLength = 0;
+
+    ScrollChatToBottomIfPinned(wasNearBottom);
+
+    m_framePacer.Start(SteadySeconds());
+    SetTimer(kStreamTimerId, kStreamTimerMs, nullptr);
+}
+
+// Finished blocks are inserted once; only the block still being written is replaced
+void CMainDlg::AppendStreamingDelta(const std::wstring& delta)
+{
+    const bool wasNearBottom = IsChatNearBottom();
+
+    const IncrementalMarkdownRenderer::Update& update = m_streamRenderer.Append(delta.c_str(), delta.length());
+    if (!update.stableRtf.empty()) {
+        m_streamTailStart += RichTextRenderer::ReplaceRtf(m_chat, m_streamTailStart,
+                                                          m_streamTailStart + m_streamTailLength, update.stableRtf);
+        m_streamTailLength = 0;
+    }
+    m_streamTailLength = RichTextRenderer::ReplaceRtf(m_chat, m_streamTailStart,
+                                                      m_streamTailStart + m_streamTailLength, update.tailRtf);
+
+    ScrollChatToBottomIfPinned(wasNearBottom);
+}
+
+// Timer tick: apply everything queued since the last frame as one batch
+void CMainDlg::ApplyQueuedTokens()
+{
+    const double now = SteadySeconds();
+    if (!m_framePacer.ShouldApply(now, m_tokenQueue.Depth())) {
+        return;
+    }
+
+    m_tokenBatch.clear();
+    const size_t chars = m_tokenQueue.Drain(m_tokenBatch);
+    AppendStreamingDelta(m_tokenBatch);
+    m_framePacer.RecordBatch(now, SteadySeconds(), chars);
+}
+
+// Join the worker and replace the streamed text with the recorded reply
+void CMainDlg::CompletePendingResponse()
+{
+    if (!m_responseThread.joinable()) {
+        return;
+    }
+    // Only this thread drains the queue, so a worker waiting for room there
+    // must give up rather than wait for the join to finish
+    BlockToolConfirmation(true);
+    m_tokenQueue.Abort();
+    m_responseThread.join();
+    BlockToolConfirmation(false);
+    KillTimer(kStreamTimerId);
+
+    // Text still queued is covered by the final render
+    m_tokenBatch.clear();
+    m_tokenQueue.Drain(m_tokenBatch);
+    m_tokenQueue.Reset();
+
+    // A cancelled reply keeps what had streamed before it stopped
+    std::wstring response = std::move(m_pendingResponse);
+    if (m_responseCancel.Cancelled()) {
+        const std::wstring streamed = m_streamRenderer.Text() + m_tokenBatch;
+        if (response.compare(0, 6, L"Error:") == 0 && !streamed.empty()) {
+            response = streamed;
+        }
+        m_responseCancel.Reset();
+    }
+
+    FinishStreamingMessage(m_chatEngine->AddAssistantMessage(response));
+    m_pendingResponse.clear();
+    SaveChatHistory();
+    UpdateTranscriptWindow();
+    ShowPluginNotices();
+}
+
+// Stop the reply in progress instead of waiting for the rest of it
+void CMainDlg::CancelPendingResponse()
+{
+    if (m_responseThread.joinable()) {
+        m_responseCancel.Cancel();
+    }
+    CompletePendingResponse();
+}
+
+// Swap the streamed rendering for the final message (plugins may have rewritten it)
+void CMainDlg::FinishStreamingMessage(const ChatMessage& msg)
+{
+    const bool wasNearBottom = IsChatNearBottom();
+
+    RichTextRenderer::ReplaceRtf(m_chat, m_streamStart, RichTextRenderer::TextLength(m_chat), RenderMessage(msg));
+    if (!m_streamRenderer.Text().empty()) {
+        Diagnostics::Log(L"stream render: " + m_streamRenderer.Describe());
     }
 
+    // The window is pinned to the tail while streaming
+    m_windowStarts.push_back(m_streamStart);
+    ++m_windowLast;
+    m_layout.Append(MeasureWindowMessage(m_windowLast - 1, msg), true);
+    UpdateVirtualExtent();
+
     ScrollChatToBottomIfPinned(wasNearBottom);
 }
 
-// Update entire chat display
+// Update entire chat display; long transcripts load only the messages around the viewport
 void CMainDlg::UpdateChatDisplay()
 {
-    m_chat.SetWindowText(L"");
+    m_search.Invalidate();
+    UpdateLayoutMetrics();
+    EstimateLayout();
+
+    const size_t count = m_layout.Count();
+    if (count <= kVirtualizeThreshold) {
+        MaterializeWindow(0, count, count, 0);
+    } else {
+        ShowTranscriptEnd();
+    }
+}
 
+bool CMainDlg::IsTranscriptVirtualized() const
+{
+    return m_layout.Count() > kVirtualizeThreshold;
+}
+
+// Line height and wrap width used for height estimates; true if either changed
+bool CMainDlg::UpdateLayoutMetrics()
+{
+    CClientDC dc(&m_chat);
+    CFont* pOldFont = dc.SelectObject(CFont::FromHandle(Theme::UIFont()));
+    TEXTMETRIC tm;
+    dc.GetTextMetrics(&tm);
+    dc.SelectObject(pOldFont);
+
+    CRect formatRect;
+    m_chat.GetRect(&formatRect);
+    const int lineHeight = max(1, static_cast<int>(tm.tmHeight + tm.tmExternalLeading));
+    const int charsPerLine = max(1, formatRect.Width() / max(1, static_cast<int>(tm.tmAveCharWidth)));
+
+    const bool changed = lineHeight != m_lineHeight || charsPerLine != m_charsPerLine ||
+                         formatRect.Width() != m_wrapWidth;
+    m_lineHeight = lineHeight;
+    m_charsPerLine = charsPerLine;
+    m_wrapWidth = formatRect.Width();
+    return changed;
+}
+
+int CMainDlg::EstimateMessageHeight(const ChatMessage& msg) const
+{
+    // Assistant messages carry a label line and a trailing blank line
+    const int chrome = msg.role == ChatMessage::Role::Assistant ? 2 * m_lineHeight : m_lineHeight / 2;
+    return TranscriptLayout::EstimateHeight(msg.Content(), m_charsPerLine, m_lineHeight, chrome);
+}
+
+void CMainDlg::EstimateLayout()
+{
     const auto& messages = m_chatEngine->GetHistory().GetMessages();
+    std::vector<int> heights;
+    heights.reserve(messages.size());
     for (const auto& msg : messages) {
-        AppendChatMessage(msg);
+        heights.push_back(EstimateMessageHeight(msg));
+    }
+    m_layout.Assign(heights);
+
+    // Heights measured earlier at this wrap width are exact
+    RenderCache& cache = RenderCache::Shared();
+    if (cache.Count() == 0) {
+        return;
+    }
+    for (size_t i = 0; i < messages.size(); ++i) {
+        const int height = cache.FindHeight(messages[i].ContentDigest(), Theme::Version, m_wrapWidth);
+        if (height >= 0) {
+            m_layout.SetHeight(i, height);
+        }
+    }
+}
+
+// Load history messages [first, last) into the control and place message anchor
+// anchorTop pixels below the top edge (an anchor outside the range scrolls to the end)
+void CMainDlg::MaterializeWindow(size_t first, size_t last, size_t anchor, int anchorTop)
+{
+    const auto& messages = m_chatEngine->GetHistory().GetMessages();
+
+    m_chat.SetRedraw(FALSE);
+    m_chat.SetWindowText(L"");
+    m_windowStarts.clear();
+    m_windowFirst = first;
+    m_windowLast = first;
+    for (size_t i = first; i < last; ++i) {
+        m_windowStarts.push_back(RichTextRenderer::TextLength(m_chat));
+        AppendMessageRtf(messages[i]);
+        ++m_windowLast;
+    }
+
+    // Loaded messages replace their estimates with measured heights
+    for (size_t i = first; i < last; ++i) {
+        m_layout.SetHeight(i, MeasureWindowMessage(i, messages[i]));
+    }
+    UpdateVirtualExtent();
+
+    if (anchor >= first && anchor < last) {
+        POINT scroll = { 0, max(0, DocumentY(m_windowStarts[anchor - first]) - anchorTop) };
+        m_chat.SendMessage(EM_SETSCROLLPOS, 0, reinterpret_cast<LPARAM>(&scroll));
+    } else {
+        RichTextRenderer::ScrollToBottom(m_chat);
+    }
+    m_chat.SetRedraw(TRUE);
+    m_chat.Invalidate();
+}
+
+void CMainDlg::ShowTranscriptEnd()
+{
+    const int viewport = ChatViewportHeight();
+    const int64_t top = (std::max)(static_cast<int64_t>(0), m_layout.TotalHeight() - viewport);
+    const TranscriptLayout::Range range = m_layout.VisibleRange(top, viewport, kOverscanMessages);
+    MaterializeWindow(range.first, m_layout.Count(), m_layout.Count(), 0);
+}
+
+// Re-center the loaded window when the view nears one of its edges or the window has grown large
+void CMainDlg::UpdateTranscriptWindow()
+{
+    if (!IsTranscriptVirtualized() || m_responseThread.joinable() || m_windowStarts.empty()) {
+        return;
+    }
+
+    const int64_t top = m_layout.Offset(m_windowFirst) + ChatScrollY();
+    const int viewport = ChatViewportHeight();
+    const TranscriptLayout::Range visible = m_layout.VisibleRange(top, viewport, 0);
+    const bool nearTop = m_windowFirst > 0 && visible.first < m_windowFirst + kEdgeMessages;
+    const bool nearBottom = m_windowLast < m_layout.Count() && visible.last + kEdgeMessages > m_windowLast;
+    const bool oversized = m_windowLast - m_windowFirst > visible.last - visible.first + 4 * kOverscanMessages;
+    if (!nearTop && !nearBottom && !oversized) {
+        return;
+    }
+
+    const TranscriptLayout::Range range = m_layout.VisibleRange(top, viewport, kOverscanMessages);
+    MaterializeWindow(range.first, range.last, visible.first, static_cast<int>(m_layout.Offset(visible.first) - top));
+}
+
+// New wrap width: estimates are redone and only the window around the current view is laid out
+void CMainDlg::RelayoutTranscript()
+{
+    if (m_layout.Count() == 0 || m_windowStarts.empty() || m_responseThread.joinable()) {
+        return;
+    }
+
+    const bool pinned = IsChatNearBottom();
+    const int64_t top = m_layout.Offset(m_windowFirst) + ChatScrollY();
+    const size_t anchor = m_layout.IndexAt(top);
+    const int anchorTop = static_cast<int>(m_layout.Offset(anchor) - top);
+
+    EstimateLayout();
+    if (!IsTranscriptVirtualized()) {
+        return;  // Everything is loaded; the control rewraps on its own
+    }
+    if (pinned) {
+        ShowTranscriptEnd();
+        return;
+    }
+
+    const TranscriptLayout::Range range = m_layout.VisibleRange(m_layout.Offset(anchor) - anchorTop,
+                                                                ChatViewportHeight(), kOverscanMessages);
+    MaterializeWindow(range.first, range.last, anchor, anchorTop);
+}
+
+void CMainDlg::UpdateVirtualExtent()
+{
+    const int64_t above = m_layout.Offset(m_windowFirst);
+    const int64_t below = m_layout.TotalHeight() - m_layout.Offset(m_windowLast);
+    m_chat.SetVirtualExtent(static_cast<int>((std::min)(above, static_cast<int64_t>(INT_MAX))),
+                            static_cast<int>((std::min)(below, static_cast<int64_t>(INT_MAX))));
+}
+
+// Height of a loaded message: distance to the next message's first character.
+// Remembered in the render cache for the current wrap width.
+int CMainDlg::MeasureWindowMessage(size_t index, const ChatMessage& msg)
+{
+    const size_t slot = index - m_windowFirst;
+    const int top = DocumentY(m_windowStarts[slot]);
+    int bottom = top;
+    if (slot + 1 < m_windowStarts.size()) {
+        bottom = DocumentY(m_windowStarts[slot + 1]);
+    } else {
+        const int length = RichTextRenderer::TextLength(m_chat);
+        if (length > m_windowStarts[slot]) {
+            bottom = DocumentY(length - 1) + m_lineHeight;
+        }
     }
+    const int height = max(0, bottom - top);
+    RenderCache::Shared().StoreHeight(msg.ContentDigest(), Theme::Version, m_wrapWidth, height);
+    return height;
+}
+
+// Position of a character in document pixels, independent of the scroll position
+int CMainDlg::DocumentY(int charPos)
+{
+    return m_chat.PosFromChar(charPos).y + ChatScrollY();
+}
+
+int CMainDlg::ChatScrollY()
+{
+    POINT scroll = { 0, 0 };
+    m_chat.SendMessage(EM_GETSCROLLPOS, 0, reinterpret_cast<LPARAM>(&scroll));
+    return scroll.y;
+}
+
+int CMainDlg::ChatViewportHeight()
+{
+    CRect clientRect;
+    m_chat.GetClientRect(&clientRect);
+    return clientRect.Height();
 }
 
 // Save chat history
@@ -709,6 +1383,9 @@ void CMainDlg::SaveChatHistory()
 
     FileUtils::EnsureDirectoryExists(appDataPath);
 
+    // Never write the startup tail over the full file
+    CompleteHistoryLoad();
+
     std::wstring historyPath = appDataPath + L"\\history.json";
     m_chatEngine->GetHistory().SaveToFile(historyPath);
 }
@@ -722,7 +1399,7 @@ std::wstring CMainDlg::FindLatestAssistantMessage() const
     const auto& messages = m_chatEngine->GetHistory().GetMessages();
     for (auto it = messages.rbegin(); it != messages.rend(); ++it) {
         if (it->role == ChatMessage::Role::Assistant) {
-            return it->content;
+            return it->Content();
         }
     }
 
@@ -739,6 +1416,242 @@ void CMainDlg::LoadChatHistory()
     m_chatEngine->GetHistory().LoadFromFile(historyPath);
 }
 
+// Startup: show the newest messages right away and read the older ones on a worker
+void CMainDlg::StartHistoryLoad()
+{
+    StartupTrace& trace = StartupTrace::Shared();
+    const std::wstring appDataPath = FileUtils::GetAppDataPath();
+    if (!SettingsStore::Get().fastStartup || appDataPath.empty()) {
+        LoadChatHistory();
+        UpdateChatDisplay();
+        const size_t count = m_chatEngine->GetHistory().GetMessages().size();
+        trace.SetHistory(count, count);
+        trace.Mark(StartupTrace::HistoryLoaded, SecondsSinceProcessStart());
+        return;
+    }
+
+    const std::wstring historyPath = appDataPath + L"\\history.json";
+    uint64_t tailOffset = 0;
+    m_chatEngine->GetHistory().LoadTail(historyPath, kStartupTailMessages, tailOffset);
+    m_historyTailCount = m_chatEngine->GetHistory().GetMessages().size();
+    UpdateChatDisplay();
+    if (tailOffset == 0) {
+        trace.SetHistory(m_historyTailCount, m_historyTailCount);
+        trace.Mark(StartupTrace::HistoryLoaded, SecondsSinceProcessStart());
+        return;
+    }
+
+    const HWND hwnd = GetSafeHwnd();
+    m_historyThread = std::thread([this, historyPath, tailOffset, hwnd] {
+        ChatHistory::ReadMessages(historyPath, 0, tailOffset, m_olderHistory);
+        ::PostMessage(hwnd, WM_HISTORY_LOADED, 0, 0);
+    });
+}
+
+LRESULT CMainDlg::OnHistoryLoaded(WPARAM, LPARAM)
+{
+    CompleteHistoryLoad();
+    return 0;
+}
+
+// Join the history loader and put the older messages in front of the tail.
+// Called before anything that needs the whole history (send, save, clear).
+void CMainDlg::CompleteHistoryLoad()
+{
+    if (!m_historyThread.joinable()) {
+        return;
+    }
+    m_historyThread.join();
+
+    ChatHistory& history = m_chatEngine->GetHistory();
+    history.PrependMessages(std::move(m_olderHistory));
+    m_olderHistory.clear();
+    UpdateChatDisplay();
+
+    StartupTrace& trace = StartupTrace::Shared();
+    trace.SetHistory(m_historyTailCount, history.GetMessages().size());
+    trace.Mark(StartupTrace::HistoryLoaded, SecondsSinceProcessStart());
+}
+
+void CMainDlg::ShowDiagnostics()
+{
+    const std::wstring report = Diagnostics::BuildReport();
+    MessageBox(report.c_str(), L"PilotLight Diagnostics", MB_OK | MB_ICONINFORMATION);
+}
+
+void CMainDlg::ShowPluginNotices()
+{
+    const std::vector<std::wstring> notices = m_chatEngine->GetPluginHost().TakeNotices();
+    if (notices.empty()) {
+        return;
+    }
+
+    std::wstring text;
+    for (const auto& notice : notices) {
+        text += notice + L"\n";
+    }
+    text += L"\nBypassed plugins are skipped until you press Ctrl+Shift+P. "
+            L"Per-plugin latencies are in the diagnostics report (Ctrl+Shift+D).";
+    MessageBox(text.c_str(), L"PilotLight Plugins", MB_OK | MB_ICONWARNING);
+}
+
+void CMainDlg::ReenablePlugins()
+{
+    const size_t count = m_chatEngine->GetPluginHost().ReenablePlugins();
+    if (count == 0) {
+        MessageBox(L"No plugins are bypassed.", L"PilotLight Plugins", MB_OK | MB_ICONINFORMATION);
+        return;
+    }
+
+    wchar_t text[96];
+    swprintf(text, sizeof(text) / sizeof(text[0]), L"Re-enabled %zu bypassed plugin(s).", count);
+    Diagnostics::Log(text);
+    MessageBox(text, L"PilotLight Plugins", MB_OK | MB_ICONINFORMATION);
+}
+
+// Import: a history.json saved by PilotLight, appended after the current messages
+void CMainDlg::ImportConversation()
+{
+    const std::vector<std::wstring> files =
+        FileUtils::SelectFiles(GetSafeHwnd(), L"PilotLight history (*.json)\0*.json\0All files (*.*)\0*.*\0", false);
+    if (files.empty()) {
+        return;
+    }
+
+    std::vector<ChatMessage> messages;
+    if (!ChatHistory::ReadMessages(files[0], 0, UINT64_MAX, messages) || messages.empty()) {
+        MessageBox(L"No messages found in that file.", L"PilotLight Import", MB_OK | MB_ICONWARNING);
+        return;
+    }
+
+    CancelPendingResponse();
+    CompleteHistoryLoad();
+    const auto started = std::chrono::steady_clock::now();
+    const size_t count = m_chatEngine->ImportMessages(std::move(messages));
+    wchar_t text[128];
+    swprintf(text, sizeof(text) / sizeof(text[0]), L"import: %zu messages through the plugins in %.1f ms", count,
+             std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count());
+    Diagnostics::Log(text);
+
+    UpdateChatDisplay();
+    SaveChatHistory();
+    ShowPluginNotices();
+}
+
+void CMainDlg::ShowFindBar(bool show)
+{
+    m_findVisible = show;
+    m_findEdit.ShowWindow(show ? SW_SHOW : SW_HIDE);
+    m_findStatus.ShowWindow(show ? SW_SHOW : SW_HIDE);
+    m_chat.HideSelection(show ? FALSE : TRUE, FALSE);  // Keep the current match visible while typing
+    LayoutControls();
+    m_titlebar.Invalidate();
+
+    if (show) {
+        m_findEdit.SetFocus();
+        m_findEdit.SetSel(0, -1);
+    } else {
+        m_input.SetFocus();
+    }
+}
+
+// Typing in the find bar: go to the first match at or below the top of the view
+void CMainDlg::OnFindChanged()
+{
+    std::wstring query;
+    const std::vector<TranscriptSearch::Match>& matches = FindMatches(query);
+    m_findCurrent = 0;
+    if (!matches.empty() && !m_windowStarts.empty()) {
+        const size_t top = m_layout.IndexAt(m_layout.Offset(m_windowFirst) + ChatScrollY());
+        const auto first = std::lower_bound(matches.begin(), matches.end(), top,
+                                            [](const TranscriptSearch::Match& match, size_t message) {
+                                                return match.message < message;
+                                            });
+        m_findCurrent = first == matches.end() ? 0 : static_cast<size_t>(first - matches.begin());
+        ShowFindMatch(matches, query);
+    }
+    UpdateFindStatus(matches.size());
+}
+
+// Matches of the find bar text; extending the query only narrows the previous result
+const std::vector<TranscriptSearch::Match>& CMainDlg::FindMatches(std::wstring& query)
+{
+    CString text;
+    m_findEdit.GetWindowText(text);
+    query = static_cast<LPCTSTR>(text);
+
+    const auto& messages = m_chatEngine->GetHistory().GetMessages();
+    return m_search.Find(query, messages.size(), [&messages](size_t index) -> const std::wstring& {
+        return messages[index].Content();
+    });
+}
+
+void CMainDlg::StepFindMatch(bool backward)
+{
+    std::wstring query;
+    const std::vector<TranscriptSearch::Match>& matches = FindMatches(query);
+    if (matches.empty()) {
+        UpdateFindStatus(0);
+        return;
+    }
+
+    const size_t count = matches.size();
+    if (m_findCurrent >= count) {
+        m_findCurrent = 0;
+    } else {
+        m_findCurrent = backward ? (m_findCurrent + count - 1) % count : (m_findCurrent + 1) % count;
+    }
+    ShowFindMatch(matches, query);
+    UpdateFindStatus(count);
+}
+
+// Select the current match in m_chat, loading the part of a virtualized transcript around it first
+void CMainDlg::ShowFindMatch(const std::vector<TranscriptSearch::Match>& matches, const std::wstring& query)
+{
+    // A streaming reply writes at fixed character positions; the control stays put until it completes
+    if (m_responseThread.joinable() || m_findCurrent >= matches.size()) {
+        return;
+    }
+
+    const size_t message = matches[m_findCurrent].message;
+    if (message < m_windowFirst || message >= m_windowLast) {
+        const int viewport = ChatViewportHeight();
+        const int anchorTop = viewport / 3;
+        const int64_t top = (std::max)(static_cast<int64_t>(0), m_layout.Offset(message) - anchorTop);
+        TranscriptLayout::Range range = m_layout.VisibleRange(top, viewport, kOverscanMessages);
+        range.first = min(range.first, message);
+        range.last = max(range.last, message + 1);
+        MaterializeWindow(range.first, range.last, message, anchorTop);
+    }
+
+    // The hit is an offset into the raw text; the renderer says where that text is
+    // shown (markdown markers are not, and a link target stands for its link text)
+    const ChatMessage& msg = m_chatEngine->GetHistory().GetMessages()[message];
+    std::wstring label;
+    const RtfMessageStyle style = MessageStyle(msg.role, label);
+    const std::vector<RtfTextRun>& runs = m_rtfRenderer.MapText(label, msg.Content(), style);
+    size_t renderedStart = 0;
+    size_t renderedLength = 0;
+    MarkdownRtfRenderer::MapRange(runs, matches[m_findCurrent].offset, query.length(), renderedStart, renderedLength);
+
+    const int start = m_windowStarts[message - m_windowFirst];
+    const int selStart = start + static_cast<int>(renderedStart);
+    const int selEnd = selStart + static_cast<int>(renderedLength);
+    m_chat.SetSel(selStart, selEnd);
+    m_chat.SendMessage(EM_SCROLLCARET);
+}
+
+void CMainDlg::UpdateFindStatus(size_t total)
+{
+    CString status;
+    if (total > 0) {
+        status.Format(L"%zu of %zu%s", m_findCurrent + 1, total, m_search.Truncated() ? L"+" : L"");
+    } else if (m_findEdit.GetWindowTextLength() > 0) {
+        status = L"No matches";
+    }
+    m_findStatus.SetWindowText(status);
+}
+
 // Set minimum window size
 void CMainDlg::OnGetMinMaxInfo(MINMAXINFO* lpMMI)
 {
@@ -1155,6 +2068,9 @@ void CMainDlg::OnSettingsClose()
 
 void CMainDlg::OnStubToggle()
 {
+    CancelPendingResponse();
+    CompleteHistoryLoad();
+
     bool enabled = (m_settingsStubToggle.GetCheck() == BST_CHECKED);
     SettingsStore::SetStubModeEnabled(enabled);
     SettingsStore::Save();
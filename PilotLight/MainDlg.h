@@ -12,8 +12,28 @@
 #include "Theme.h"
 #include "SettingsStore.h"
 #include "ThemedRichEdit.h"
+#include "MarkdownRtf.h"
+#include "IncrementalMarkdown.h"
+#include "OpenAIClient.h"
+#include "TokenQueue.h"
+#include "TranscriptLayout.h"
+#include "TranscriptSearch.h"
+#include "ToolEngine.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+// Posted by the response worker when the assistant reply is complete
+#define WM_RESPONSE_COMPLETE (WM_APP + 1)
+// Posted by the history loader once messages older than the startup tail are read
+#define WM_HISTORY_LOADED (WM_APP + 3)
+// Posted after the first paint; handled once the message loop is servicing input
+#define WM_STARTUP_IDLE (WM_APP + 4)
+// Posted by the response worker when tool calls wait for the user's approval
+#define WM_TOOL_CONFIRM (WM_APP + 5)
+
 // Forward declarations
 class ChatEngine;
 
@@ -46,6 +66,7 @@ protected:
     afx_msg void OnStubToggle();
     afx_msg void OnClearHistory();
     afx_msg void OnAttachmentDblClick();
+    afx_msg void OnFindChanged();
     afx_msg void OnDrawItem(int nIDCtl, LPDRAWITEMSTRUCT lpDrawItemStruct);
     afx_msg void OnMouseMove(UINT nFlags, CPoint point);
     afx_msg void OnMouseLeave();
@@ -56,6 +77,12 @@ protected:
     afx_msg BOOL OnSetCursor(CWnd* pWnd, UINT nHitTest, UINT message);
     afx_msg void OnContextMenu(CWnd* pWnd, CPoint point);
     afx_msg void OnDropFiles(HDROP hDropInfo);
+    afx_msg void OnTimer(UINT_PTR nIDEvent);
+    afx_msg LRESULT OnResponseComplete(WPARAM wParam, LPARAM lParam);
+    afx_msg LRESULT OnThemedScroll(WPARAM wParam, LPARAM lParam);
+    afx_msg LRESULT OnHistoryLoaded(WPARAM wParam, LPARAM lParam);
+    afx_msg LRESULT OnStartupIdle(WPARAM wParam, LPARAM lParam);
+    afx_msg LRESULT OnToolConfirm(WPARAM wParam, LPARAM lParam);
 
     DECLARE_MESSAGE_MAP()
 
@@ -90,6 +117,56 @@ private:
 
     // Chat engine
     ChatEngine* m_chatEngine;
+    MarkdownRtfRenderer m_rtfRenderer;
+
+    // Assistant message currently streaming into m_chat (character positions)
+    IncrementalMarkdownRenderer m_streamRenderer;
+    int m_streamStart;
+    int m_streamTailStart;
+    int m_streamTailLength;
+
+    // Reply requested on a worker thread; deltas pass through a lock-free queue
+    // and are applied at most once per frame
+    std::thread m_responseThread;
+    std::wstring m_pendingResponse;
+    SpscTextQueue m_tokenQueue;
+    RequestCancellation m_responseCancel;
+    FramePacer m_framePacer;
+    std::wstring m_tokenBatch;
+
+    // Tool calls of the reply waiting for the user: the worker blocks until
+    // the UI thread answers, or until the reply is completed early
+    struct ToolConfirmRequest {
+        std::vector<ToolCall> calls;
+        std::vector<ToolConfirmationDecision> decisions;  // Empty: all cancelled
+        bool answered;
+    };
+    std::mutex m_toolConfirmLock;
+    std::condition_variable m_toolConfirmDone;
+    ToolConfirmRequest* m_toolConfirm;  // Owned by the waiting worker
+    uint64_t m_toolConfirmSerial;       // Tells a late answer from the current request
+    bool m_toolConfirmBlocked;          // Set while the worker is joined
+
+    // Virtualized transcript: m_chat holds only history messages [m_windowFirst, m_windowLast)
+    TranscriptLayout m_layout;
+    size_t m_windowFirst;
+    size_t m_windowLast;
+    std::vector<int> m_windowStarts;  // Character position of each loaded message
+    int m_lineHeight;
+    int m_charsPerLine;
+    int m_wrapWidth;  // Formatting rectangle width in pixels
+
+    // Startup shows the history tail first; older messages are read on a worker
+    std::thread m_historyThread;
+    std::vector<ChatMessage> m_olderHistory;
+    size_t m_historyTailCount;
+
+    // Find bar (Ctrl+F): matches come from the history text, then the hit is loaded and selected
+    CEdit m_findEdit;
+    CStatic m_findStatus;
+    bool m_findVisible;
+    TranscriptSearch m_search;
+    size_t m_findCurrent;  // Index into the matches of the current query
 
     // Pending attachments
     std::vector<FileAttachment> m_pendingAttachments;
@@ -108,11 +185,36 @@ private:
     // Layout and rendering
     void LayoutControls();
     void AppendChatMessage(const ChatMessage& msg);
+    void AppendMessageRtf(const ChatMessage& msg);
+    const std::string& RenderMessage(const ChatMessage& msg);
+    void BeginStreamingMessage();
+    void AppendStreamingDelta(const std::wstring& delta);
+    void FinishStreamingMessage(const ChatMessage& msg);
+    void ApplyQueuedTokens();
+    void CompletePendingResponse();
+    void CancelPendingResponse();
+    std::vector<ToolConfirmationDecision> ConfirmToolCalls(const std::vector<ToolCall>& calls, HWND hwnd);
+    void BlockToolConfirmation(bool block);
     void UpdateChatDisplay();
+    bool IsTranscriptVirtualized() const;
+    bool UpdateLayoutMetrics();
+    int EstimateMessageHeight(const ChatMessage& msg) const;
+    void EstimateLayout();
+    void MaterializeWindow(size_t first, size_t last, size_t anchor, int anchorTop);
+    void ShowTranscriptEnd();
+    void UpdateTranscriptWindow();
+    void RelayoutTranscript();
+    void UpdateVirtualExtent();
+    int MeasureWindowMessage(size_t index, const ChatMessage& msg);
+    int DocumentY(int charPos);
+    int ChatScrollY();
+    int ChatViewportHeight();
     bool IsChatNearBottom();
     void ScrollChatToBottomIfPinned(bool wasNearBottom);
     void SaveChatHistory();
     void LoadChatHistory();
+    void StartHistoryLoad();
+    void CompleteHistoryLoad();
     void LayoutSettingsOverlay();
     void ShowSettingsOverlay(bool show);
     void ApplySettingsState();
@@ -122,6 +224,15 @@ private:
     void UpdateAttachmentTooltip();
     void RemoveAttachmentAtIndex(int index);
     std::wstring FindLatestAssistantMessage() const;
+    void ShowDiagnostics();
+    void ShowPluginNotices();
+    void ReenablePlugins();
+    void ImportConversation();
+    void ShowFindBar(bool show);
+    const std::vector<TranscriptSearch::Match>& FindMatches(std::wstring& query);
+    void StepFindMatch(bool backward);
+    void ShowFindMatch(const std::vector<TranscriptSearch::Match>& matches, const std::wstring& query);
+    void UpdateFindStatus(size_t total);
     
     // Button helper methods
     CRect GetButtonRect(int buttonID);
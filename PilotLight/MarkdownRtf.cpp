@@ -0,0 +1,396 @@
+#include "MarkdownRtf.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+namespace {
+    constexpr int kBodyFontSize = 27;  // Half-points; matches the 18px UI font at 96 DPI
+    constexpr int kCodeFontSize = 24;
+    constexpr int kListIndentTwips = 360;
+    constexpr int kListHangingTwips = 240;
+    constexpr int kCodeIndentTwips = 240;
+    constexpr int kBlockSpacingTwips = 80;
+    constexpr int kListSpacingTwips = 20;
+    constexpr int kSyntaxColorBase = 3;  // \cf index of SyntaxToken n is base + n; Plain is never written
+
+    int HeadingFontSize(int level)
+    {
+        return level == 1 ? 34 : (level == 2 ? 31 : kBodyFontSize);
+    }
+
+    void AppendColor(std::string& out, uint32_t color)
+    {
+        char buffer[48];
+        snprintf(buffer, sizeof(buffer), "\\red%u\\green%u\\blue%u;",
+                 color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff);
+        out += buffer;
+    }
+
+    void AppendUnicode(std::string& out, unsigned int unit)
+    {
+        // RTF takes a signed 16-bit value; '?' is the fallback skipped by \uc1 readers
+        int value = static_cast<int16_t>(unit);
+        out += "\\u";
+        if (value < 0) {
+            out += '-';
+            value = -value;
+        }
+        char digits[8];
+        int count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (count > 0) {
+            out += digits[--count];
+        }
+        out += '?';
+    }
+}
+
+const std::string& MarkdownRtfRenderer::Render(const std::wstring& label, const std::wstring& body,
+                                               const RtfMessageStyle& style)
+{
+    m_output.clear();
+    m_output.reserve(body.length() + body.length() / 4 + 256);
+    AppendHeader(style);
+    AppendLabelLine(label, style);
+
+    const std::wstring& inlineLabel = style.labelOnOwnLine ? std::wstring() : label;
+    bool wroteParagraph = false;
+    if (style.markdown) {
+        m_tokenizer.Tokenize(body, m_spans);
+        wroteParagraph = AppendSpans(inlineLabel, body.c_str(), m_spans, 0, m_spans.size(), style);
+    }
+
+    // Plain bodies, and empty markdown ones so the label still shows
+    if (!wroteParagraph) {
+        AppendParagraph(style, 0, style.hangingTwips, style.spaceBeforeTwips, style.spaceAfterTwips);
+        if (!inlineLabel.empty()) {
+            AppendLabel(inlineLabel);
+        }
+        AppendBody(body.c_str(), 0, body.length(), true);
+        m_output += "\\par\n";
+        ++m_shown;
+    }
+
+    if (style.trailingBlankLine) {
+        m_output += "\\pard\\plain\\f0\\fs";
+        AppendInt(kBodyFontSize);
+        m_output += "\\par\n";
+        ++m_shown;
+    }
+
+    m_output += "}";
+    return m_output;
+}
+
+const std::string& MarkdownRtfRenderer::RenderSpans(const std::wstring& label, const wchar_t* text,
+                                                    const std::vector<MarkdownSpan>& spans, size_t first, size_t last,
+                                                    const RtfMessageStyle& style)
+{
+    m_output.clear();
+    AppendHeader(style);
+    AppendLabelLine(label, style);
+    AppendSpans(style.labelOnOwnLine ? std::wstring() : label, text, spans, first, last, style);
+    m_output += "}";
+    return m_output;
+}
+
+const std::vector<RtfTextRun>& MarkdownRtfRenderer::MapText(const std::wstring& label, const std::wstring& body,
+                                                           const RtfMessageStyle& style)
+{
+    m_mapping = true;
+    m_shown = 0;
+    m_runs.clear();
+    Render(label, body, style);
+    m_mapping = false;
+    return m_runs;
+}
+
+bool MarkdownRtfRenderer::MapRange(const std::vector<RtfTextRun>& runs, size_t start, size_t length,
+                                   size_t& renderedStart, size_t& renderedLength)
+{
+    const size_t end = start + (std::max)(length, static_cast<size_t>(1));
+    size_t first = SIZE_MAX;
+    size_t last = 0;
+    for (const RtfTextRun& run : runs) {
+        const size_t runEnd = run.source + run.length;
+        if (run.source >= end || runEnd <= start) {
+            continue;
+        }
+        if (run.hidden) {
+            // Part of a link target: the link text stands for it
+            first = (std::min)(first, static_cast<size_t>(run.rendered));
+            last = (std::max)(last, static_cast<size_t>(run.rendered + run.shown));
+        } else {
+            const size_t from = (std::max)(start, static_cast<size_t>(run.source));
+            first = (std::min)(first, run.rendered + (from - run.source));
+            last = (std::max)(last, run.rendered + ((std::min)(end, runEnd) - run.source));
+        }
+    }
+    if (first == SIZE_MAX) {
+        return false;
+    }
+    renderedStart = first;
+    renderedLength = last - first;
+    return true;
+}
+
+void MarkdownRtfRenderer::AppendEscaped(std::string& out, const wchar_t* text, size_t length, bool lineBreaks)
+{
+    for (size_t i = 0; i < length; ++i) {
+        const unsigned int ch = static_cast<unsigned int>(text[i]);
+        if (ch == L'\\' || ch == L'{' || ch == L'}') {
+            out += '\\';
+            out += static_cast<char>(ch);
+        } else if (ch == L'\n') {
+            if (lineBreaks) {
+                out += "\\line ";
+            }
+        } else if (ch == L'\t') {
+            out += "\\tab ";
+        } else if (ch < 0x20) {
+            continue;  // \r and other control characters
+        } else if (ch < 0x80) {
+            out += static_cast<char>(ch);
+        } else if (ch > 0xffff) {
+            // 32-bit wchar_t platforms: RTF expects UTF-16 surrogate pairs
+            const unsigned int value = ch - 0x10000;
+            AppendUnicode(out, 0xd800 + (value >> 10));
+            AppendUnicode(out, 0xdc00 + (value & 0x3ff));
+        } else {
+            AppendUnicode(out, ch);
+        }
+    }
+}
+
+void MarkdownRtfRenderer::AppendHeader(const RtfMessageStyle& style)
+{
+    m_output += "{\\rtf1\\ansi\\deff0\\uc1"
+                "{\\fonttbl{\\f0\\fswiss Segoe UI Variable;}{\\f1\\fmodern Consolas;}}"
+                "{\\colortbl ;";
+    AppendColor(m_output, style.labelColor);
+    AppendColor(m_output, style.textColor);
+    AppendColor(m_output, style.backgroundColor);
+    if (style.syntaxHighlight) {
+        for (size_t token = 1; token < kSyntaxTokenCount; ++token) {
+            AppendColor(m_output, style.syntaxColors[token]);
+        }
+    }
+    m_output += "}\n";
+}
+
+void MarkdownRtfRenderer::AppendParagraph(const RtfMessageStyle& style, int extraIndent, int hanging,
+                                          int spaceBefore, int spaceAfter)
+{
+    m_output += "\\pard\\li";
+    AppendInt(style.indentTwips + extraIndent + hanging);
+    m_output += "\\fi";
+    AppendInt(-hanging);
+    m_output += "\\sb";
+    AppendInt(spaceBefore);
+    m_output += "\\sa";
+    AppendInt(spaceAfter);
+    m_output += "\\plain\\f0\\fs";
+    AppendInt(kBodyFontSize);
+    m_output += style.highlight ? "\\cf2\\highlight3 " : "\\cf2 ";
+}
+
+void MarkdownRtfRenderer::AppendLabelLine(const std::wstring& label, const RtfMessageStyle& style)
+{
+    if (!style.labelOnOwnLine || label.empty()) {
+        return;
+    }
+    AppendParagraph(style, 0, 0, style.spaceBeforeTwips, 0);
+    AppendLabel(label);
+    m_output += "\\par\n";
+    ++m_shown;
+}
+
+bool MarkdownRtfRenderer::AppendSpans(const std::wstring& label, const wchar_t* text,
+                                      const std::vector<MarkdownSpan>& spans, size_t firstSpan, size_t lastSpan,
+                                      const RtfMessageStyle& style)
+{
+    bool first = true;
+    const MarkdownSpan* link = nullptr;
+    size_t linkShown = 0;
+    auto beginParagraph = [&](int extraIndent, int hanging, int spaceAfter) {
+        AppendParagraph(style, extraIndent, hanging, first ? style.spaceBeforeTwips : 0, spaceAfter);
+        if (first && !label.empty()) {
+            AppendLabel(label);
+        }
+        first = false;
+    };
+
+    for (size_t index = firstSpan; index < lastSpan; ++index) {
+        const MarkdownSpan& span = spans[index];
+        switch (span.kind) {
+        case MarkdownSpanKind::BlockStart:
+            switch (span.block) {
+            case MarkdownBlock::Paragraph:
+                beginParagraph(0, style.hangingTwips, kBlockSpacingTwips);
+                break;
+            case MarkdownBlock::Heading:
+                beginParagraph(0, style.hangingTwips, kBlockSpacingTwips);
+                m_output += "{\\b\\fs";
+                AppendInt(HeadingFontSize(span.level));
+                m_output += " ";
+                break;
+            case MarkdownBlock::ListItem:
+                beginParagraph(kListIndentTwips * (span.level + 1) - kListHangingTwips, kListHangingTwips,
+                               kListSpacingTwips);
+                m_output += "{";
+                if (span.flags & MarkdownSpan::Ordered) {
+                    AppendBody(text, span.auxStart, span.auxLength, false);
+                } else {
+                    AppendUnicode(m_output, 0x2022);  // Bullet
+                    ++m_shown;
+                }
+                m_output += "\\tab ";
+                ++m_shown;
+                break;
+            case MarkdownBlock::CodeFence:
+                beginParagraph(kCodeIndentTwips, 0, kBlockSpacingTwips);
+                m_output += "{\\f1\\fs";
+                AppendInt(kCodeFontSize);
+                m_output += " ";
+                break;
+            case MarkdownBlock::Rule:
+                beginParagraph(0, 0, kBlockSpacingTwips);
+                for (int i = 0; i < 3; ++i) {
+                    AppendUnicode(m_output, 0x2014);  // Em dash
+                }
+                m_shown += 3;
+                break;
+            }
+            break;
+
+        case MarkdownSpanKind::BlockEnd:
+            if (span.block != MarkdownBlock::Paragraph && span.block != MarkdownBlock::Rule) {
+                m_output += "}";
+            }
+            m_output += "\\par\n";
+            ++m_shown;
+            break;
+
+        case MarkdownSpanKind::Text:
+            if (span.style) {
+                m_output += (span.style & MarkdownSpan::Bold) ? "{\\b" : "{";
+                m_output += (span.style & MarkdownSpan::Italic) ? "\\i " : " ";
+                AppendBody(text, span.start, span.length, false);
+                m_output += "}";
+            } else {
+                AppendBody(text, span.start, span.length, false);
+            }
+            break;
+
+        case MarkdownSpanKind::LineBreak:
+            m_output += "\\line ";
+            ++m_shown;
+            break;
+
+        case MarkdownSpanKind::Code:
+            m_output += "{\\f1 ";
+            AppendBody(text, span.start, span.length, false);
+            m_output += "}";
+            break;
+
+        case MarkdownSpanKind::CodeBlock:
+            AppendCode(text, span, style);
+            break;
+
+        case MarkdownSpanKind::LinkStart:
+            m_output += "{\\ul ";
+            link = &span;
+            linkShown = m_shown;
+            break;
+
+        case MarkdownSpanKind::LinkEnd:
+            m_output += "}";
+            if (m_mapping && link && link->auxLength > 0) {
+                m_runs.push_back(RtfTextRun{ link->auxStart, static_cast<uint32_t>(linkShown), link->auxLength, true,
+                                             static_cast<uint32_t>(m_shown - linkShown) });
+            }
+            link = nullptr;
+            break;
+        }
+    }
+
+    return !first;
+}
+
+void MarkdownRtfRenderer::AppendCode(const wchar_t* text, const MarkdownSpan& block, const RtfMessageStyle& style)
+{
+    const wchar_t* code = text + block.start;
+    const size_t length = block.length;
+    const SyntaxLanguage language = style.syntaxHighlight
+        ? SyntaxLexer::LanguageFromInfo(text + block.auxStart, block.auxLength)
+        : SyntaxLanguage::None;
+    if (language == SyntaxLanguage::None) {
+        AppendBody(text, block.start, length, true);
+        return;
+    }
+
+    // In a growing text a block is identified by where its content starts
+    const uint64_t growingId = m_growingText ? (m_growingText << 32) ^ (block.start + 1ULL) : 0;
+    size_t pos = 0;
+    for (const SyntaxSpan& span : m_highlighter.Highlight(language, code, length, growingId)) {
+        AppendBody(text, block.start + pos, span.start - pos, true);
+        m_output += "{\\cf";
+        AppendInt(kSyntaxColorBase + static_cast<int>(span.token));
+        m_output += " ";
+        AppendBody(text, block.start + span.start, span.length, true);
+        m_output += "}";
+        pos = span.start + span.length;
+    }
+    AppendBody(text, block.start + pos, length - pos, true);
+}
+
+// Body text; while mapping, also records where each character is shown
+void MarkdownRtfRenderer::AppendBody(const wchar_t* text, size_t start, size_t length, bool lineBreaks)
+{
+    AppendEscaped(m_output, text + start, length, lineBreaks);
+    if (!m_mapping) {
+        return;
+    }
+
+    // Counted as AppendEscaped writes them: dropped control characters end a run
+    for (size_t i = start; i < start + length; ++i) {
+        const unsigned int ch = static_cast<unsigned int>(text[i]);
+        size_t units = ch > 0xffff ? 2 : 1;
+        if (ch == L'\n') {
+            units = lineBreaks ? 1 : 0;
+        } else if (ch < 0x20 && ch != L'\t') {
+            units = 0;
+        }
+        if (units == 1) {
+            RtfTextRun* run = m_runs.empty() ? nullptr : &m_runs.back();
+            if (run && !run->hidden && run->source + run->length == i && run->rendered + run->length == m_shown) {
+                ++run->length;
+            } else {
+                m_runs.push_back(RtfTextRun{ static_cast<uint32_t>(i), static_cast<uint32_t>(m_shown), 1, false, 0 });
+            }
+        }
+        m_shown += units;
+    }
+}
+
+void MarkdownRtfRenderer::AppendLabel(const std::wstring& label)
+{
+    m_output += "{\\cf1 ";
+    AppendEscaped(m_output, label.c_str(), label.length(), false);
+    m_output += "}";
+    if (m_mapping) {
+        for (wchar_t ch : label) {
+            m_shown += static_cast<unsigned int>(ch) < 0x20 ? 0 : (static_cast<unsigned int>(ch) > 0xffff ? 2 : 1);
+        }
+    }
+}
+
+void MarkdownRtfRenderer::AppendInt(int value)
+{
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%d", value);
+    m_output += buffer;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MarkdownTokenizer.h"
+#include "SyntaxHighlighter.h"
+
+// How one chat message is laid out. Colors use the COLORREF layout (0x00BBGGRR).
+struct RtfMessageStyle {
+    uint32_t labelColor = 0;
+    uint32_t textColor = 0;
+    uint32_t backgroundColor = 0;
+    bool highlight = false;          // Paint backgroundColor behind the text (chat bubble)
+    bool markdown = false;           // Render the body as markdown rather than plain text
+    bool labelOnOwnLine = false;     // "Assistant:" above the body instead of inline
+    bool trailingBlankLine = false;  // Empty paragraph after the message
+    bool syntaxHighlight = false;    // Color fenced code blocks in a known language
+    int indentTwips = 0;
+    int hangingTwips = 0;            // Extra indent of wrapped lines
+    int spaceBeforeTwips = 0;
+    int spaceAfterTwips = 0;
+    uint32_t syntaxColors[kSyntaxTokenCount] = {};  // Indexed by SyntaxToken; Plain uses textColor
+};
+
+// Body text shown character for character: body[source, source + length) is
+// at [rendered, rendered + length) of the control's text, counted from the
+// start of the message. Hidden text (a link target) has shown set to the
+// length of what stands in for it (the link text) instead.
+struct RtfTextRun {
+    uint32_t source;
+    uint32_t rendered;
+    uint32_t length;
+    bool hidden;
+    uint32_t shown;  // Hidden runs only
+};
+
+// Turns a chat message into one self-contained RTF fragment suitable for a
+// single EM_STREAMIN (SF_RTF | SFF_SELECTION). Output is 7-bit ASCII; every
+// non-ASCII character is written as a \uN escape. Portable (no Windows headers),
+// so output and throughput can be checked anywhere. Buffers are reused between
+// calls.
+class MarkdownRtfRenderer {
+public:
+    const std::string& Render(const std::wstring& label, const std::wstring& body, const RtfMessageStyle& style);
+
+    // Fragment for spans[first, last) of an already tokenized markdown text
+    const std::string& RenderSpans(const std::wstring& label, const wchar_t* text,
+                                   const std::vector<MarkdownSpan>& spans, size_t first, size_t last,
+                                   const RtfMessageStyle& style);
+
+    // Where the body of a message rendered by Render with the same arguments
+    // ends up in the control's text, in rendering order. Markdown markers,
+    // fences and link targets are not shown, so raw offsets have to go
+    // through this before they select anything.
+    const std::vector<RtfTextRun>& MapText(const std::wstring& label, const std::wstring& body,
+                                           const RtfMessageStyle& style);
+
+    // Rendered range covering body[start, start + length); false if none of it is shown
+    static bool MapRange(const std::vector<RtfTextRun>& runs, size_t start, size_t length,
+                         size_t& renderedStart, size_t& renderedLength);
+
+    // Escapes text for RTF: \\ \{ \} control words, \uN for non-ASCII
+    static void AppendEscaped(std::string& out, const wchar_t* text, size_t length, bool lineBreaks);
+
+    // Text rendered from now on only grows until the next call with another
+    // generation, so its code blocks resume highlighting; 0 for unrelated texts
+    void SetGrowingText(uint64_t generation) { m_growingText = generation; }
+    const SyntaxHighlighter& Highlighter() const { return m_highlighter; }
+
+private:
+    void AppendHeader(const RtfMessageStyle& style);
+    void AppendParagraph(const RtfMessageStyle& style, int extraIndent, int hanging, int spaceBefore, int spaceAfter);
+    void AppendLabelLine(const std::wstring& label, const RtfMessageStyle& style);
+    bool AppendSpans(const std::wstring& label, const wchar_t* text, const std::vector<MarkdownSpan>& spans,
+                     size_t firstSpan, size_t lastSpan, const RtfMessageStyle& style);
+    void AppendCode(const wchar_t* text, const MarkdownSpan& span, const RtfMessageStyle& style);
+    void AppendBody(const wchar_t* text, size_t start, size_t length, bool lineBreaks);
+    void AppendLabel(const std::wstring& label);
+    void AppendInt(int value);
+
+    MarkdownTokenizer m_tokenizer;
+    SyntaxHighlighter m_highlighter;
+    uint64_t m_growingText = 0;
+    std::vector<MarkdownSpan> m_spans;
+    std::string m_output;
+
+    // While mapping: characters shown so far and the runs of body text among them
+    bool m_mapping = false;
+    size_t m_shown = 0;
+    std::vector<RtfTextRun> m_runs;
+};
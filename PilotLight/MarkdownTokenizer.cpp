@@ -0,0 +1,582 @@
+#include "MarkdownTokenizer.h"
+#include <algorithm>
+
+namespace {
+    constexpr size_t kMaxCodeTicks = 16;  // Longer backtick runs are left as text
+    constexpr int kMaxListDepth = 8;
+
+    inline bool IsSpace(wchar_t ch)
+    {
+        return ch == L' ' || ch == L'\t' || ch == L'\n' || ch == L'\r';
+    }
+
+    inline bool IsPunct(wchar_t ch)
+    {
+        return (ch >= L'!' && ch <= L'/') || (ch >= L':' && ch <= L'@') ||
+               (ch >= L'[' && ch <= L'`') || (ch >= L'{' && ch <= L'~');
+    }
+
+    inline bool IsAlnum(wchar_t ch)
+    {
+        return (ch >= L'0' && ch <= L'9') || (ch >= L'a' && ch <= L'z') || (ch >= L'A' && ch <= L'Z') || ch > 0x7f;
+    }
+}
+
+void MarkdownTokenizer::Tokenize(const std::wstring& text, std::vector<MarkdownSpan>& spans)
+{
+    spans.clear();
+    Tokenize(text.c_str(), 0, text.length(), spans);
+}
+
+void MarkdownTokenizer::Tokenize(const wchar_t* text, size_t begin, size_t end, std::vector<MarkdownSpan>& spans)
+{
+    m_text = text;
+    size_t pos = begin;
+
+    while (pos < end) {
+        const Line line = ReadLine(pos, end);
+        if (IsBlank(line)) {
+            pos = line.next;
+            continue;
+        }
+
+        wchar_t fenceChar = 0;
+        size_t fenceLength = 0;
+        if (IsFence(line, fenceChar, fenceLength)) {
+            size_t infoStart = line.first + fenceLength;
+            size_t infoEnd = line.end;
+            while (infoStart < infoEnd && IsSpace(m_text[infoStart])) ++infoStart;
+            while (infoEnd > infoStart && IsSpace(m_text[infoEnd - 1])) --infoEnd;
+
+            // Content runs to the closing fence; an unterminated fence swallows the rest
+            const size_t contentStart = line.next;
+            size_t contentEnd = end;
+            size_t blockEnd = end;
+            bool closed = false;
+            for (size_t scan = contentStart; scan < end;) {
+                const Line inner = ReadLine(scan, end);
+                if (IsClosingFence(inner, fenceChar, fenceLength)) {
+                    contentEnd = inner.start;
+                    blockEnd = inner.next;
+                    closed = true;
+                    break;
+                }
+                scan = inner.next;
+            }
+            if (closed && contentEnd > contentStart && m_text[contentEnd - 1] == L'\n') --contentEnd;
+            if (closed && contentEnd > contentStart && m_text[contentEnd - 1] == L'\r') --contentEnd;
+
+            PushBlock(MarkdownSpanKind::BlockStart, MarkdownBlock::CodeFence, line.start, spans);
+            MarkdownSpan code = {};
+            code.kind = MarkdownSpanKind::CodeBlock;
+            code.block = MarkdownBlock::CodeFence;
+            code.flags = closed ? 0 : MarkdownSpan::Unterminated;
+            code.start = static_cast<uint32_t>(contentStart);
+            code.length = static_cast<uint32_t>(contentEnd - contentStart);
+            code.auxStart = static_cast<uint32_t>(infoStart);
+            code.auxLength = static_cast<uint32_t>(infoEnd - infoStart);
+            spans.push_back(code);
+            PushBlock(MarkdownSpanKind::BlockEnd, MarkdownBlock::CodeFence, blockEnd, spans);
+            pos = blockEnd;
+            continue;
+        }
+
+        const int headingLevel = HeadingLevel(line);
+        if (headingLevel > 0) {
+            size_t contentStart = line.first + headingLevel;
+            size_t contentEnd = line.end;
+            while (contentStart < contentEnd && IsSpace(m_text[contentStart])) ++contentStart;
+            while (contentEnd > contentStart && IsSpace(m_text[contentEnd - 1])) --contentEnd;
+
+            // Optional closing sequence: "## Title ##"
+            size_t hashes = contentEnd;
+            while (hashes > contentStart && m_text[hashes - 1] == L'#') --hashes;
+            if (hashes < contentEnd && (hashes == contentStart || IsSpace(m_text[hashes - 1]))) {
+                contentEnd = hashes;
+                while (contentEnd > contentStart && IsSpace(m_text[contentEnd - 1])) --contentEnd;
+            }
+
+            PushBlock(MarkdownSpanKind::BlockStart, MarkdownBlock::Heading, line.start, spans);
+            spans.back().level = static_cast<uint8_t>(headingLevel);
+            TokenizeInline(contentStart, contentEnd, spans);
+            PushBlock(MarkdownSpanKind::BlockEnd, MarkdownBlock::Heading, line.next, spans);
+            spans.back().level = static_cast<uint8_t>(headingLevel);
+            pos = line.next;
+            continue;
+        }
+
+        if (IsRule(line)) {
+            PushBlock(MarkdownSpanKind::BlockStart, MarkdownBlock::Rule, line.start, spans);
+            PushBlock(MarkdownSpanKind::BlockEnd, MarkdownBlock::Rule, line.next, spans);
+            pos = line.next;
+            continue;
+        }
+
+        size_t markerEnd = 0;
+        bool ordered = false;
+        if (IsListItem(line, markerEnd, ordered)) {
+            size_t contentStart = markerEnd;
+            while (contentStart < line.end && IsSpace(m_text[contentStart])) ++contentStart;
+
+            // Indented continuation lines belong to the item
+            size_t contentEnd = line.end;
+            size_t blockEnd = line.next;
+            while (blockEnd < end) {
+                const Line next = ReadLine(blockEnd, end);
+                if (IsBlank(next) || next.indent == 0 || StartsBlock(next)) {
+                    break;
+                }
+                contentEnd = next.end;
+                blockEnd = next.next;
+            }
+
+            const uint8_t depth = static_cast<uint8_t>((std::min)(line.indent / 2, kMaxListDepth));
+            PushBlock(MarkdownSpanKind::BlockStart, MarkdownBlock::ListItem, line.start, spans);
+            MarkdownSpan& item = spans.back();
+            item.level = depth;
+            item.flags = ordered ? MarkdownSpan::Ordered : 0;
+            item.auxStart = static_cast<uint32_t>(line.first);
+            item.auxLength = static_cast<uint32_t>(markerEnd - line.first);
+            TokenizeInline(contentStart, contentEnd, spans);
+            PushBlock(MarkdownSpanKind::BlockEnd, MarkdownBlock::ListItem, blockEnd, spans);
+            spans.back().level = depth;
+            pos = blockEnd;
+            continue;
+        }
+
+        // Paragraph: consecutive lines up to a blank line or another block
+        size_t contentEnd = line.end;
+        size_t blockEnd = line.next;
+        while (blockEnd < end) {
+            const Line next = ReadLine(blockEnd, end);
+            if (IsBlank(next) || StartsBlock(next)) {
+                break;
+            }
+            contentEnd = next.end;
+            blockEnd = next.next;
+        }
+
+        PushBlock(MarkdownSpanKind::BlockStart, MarkdownBlock::Paragraph, line.start, spans);
+        TokenizeInline(line.first, contentEnd, spans);
+        PushBlock(MarkdownSpanKind::BlockEnd, MarkdownBlock::Paragraph, blockEnd, spans);
+        pos = blockEnd;
+    }
+}
+
+MarkdownTokenizer::Line MarkdownTokenizer::ReadLine(size_t pos, size_t end) const
+{
+    Line line;
+    line.start = pos;
+    line.indent = 0;
+
+    size_t i = pos;
+    while (i < end && (m_text[i] == L' ' || m_text[i] == L'\t')) {
+        line.indent += m_text[i] == L'\t' ? 4 : 1;
+        ++i;
+    }
+    line.first = i;
+
+    while (i < end && m_text[i] != L'\n') ++i;
+    line.next = i < end ? i + 1 : end;
+    line.end = (i > line.first && m_text[i - 1] == L'\r') ? i - 1 : i;
+    return line;
+}
+
+bool MarkdownTokenizer::IsBlank(const Line& line) const
+{
+    return line.first >= line.end;
+}
+
+bool MarkdownTokenizer::IsFence(const Line& line, wchar_t& fenceChar, size_t& fenceLength) const
+{
+    if (line.indent > 3 || line.first >= line.end) {
+        return false;
+    }
+    const wchar_t ch = m_text[line.first];
+    if (ch != L'`' && ch != L'~') {
+        return false;
+    }
+
+    size_t i = line.first;
+    while (i < line.end && m_text[i] == ch) ++i;
+    if (i - line.first < 3) {
+        return false;
+    }
+    // A backtick in the info string means this is inline code, not a fence
+    if (ch == L'`' && std::find(m_text + i, m_text + line.end, L'`') != m_text + line.end) {
+        return false;
+    }
+
+    fenceChar = ch;
+    fenceLength = i - line.first;
+    return true;
+}
+
+bool MarkdownTokenizer::IsClosingFence(const Line& line, wchar_t fenceChar, size_t fenceLength) const
+{
+    if (line.indent > 3) {
+        return false;
+    }
+    size_t i = line.first;
+    while (i < line.end && m_text[i] == fenceChar) ++i;
+    if (i - line.first < fenceLength) {
+        return false;
+    }
+    while (i < line.end && IsSpace(m_text[i])) ++i;
+    return i == line.end;
+}
+
+int MarkdownTokenizer::HeadingLevel(const Line& line) const
+{
+    if (line.indent > 3) {
+        return 0;
+    }
+    size_t i = line.first;
+    while (i < line.end && m_text[i] == L'#') ++i;
+    const int level = static_cast<int>(i - line.first);
+    if (level < 1 || level > 6 || (i < line.end && !IsSpace(m_text[i]))) {
+        return 0;
+    }
+    return level;
+}
+
+bool MarkdownTokenizer::IsRule(const Line& line) const
+{
+    if (line.indent > 3) {
+        return false;
+    }
+    const wchar_t ch = m_text[line.first];
+    if (ch != L'-' && ch != L'*' && ch != L'_') {
+        return false;
+    }
+    int count = 0;
+    for (size_t i = line.first; i < line.end; ++i) {
+        if (m_text[i] == ch) {
+            ++count;
+        } else if (!IsSpace(m_text[i])) {
+            return false;
+        }
+    }
+    return count >= 3;
+}
+
+bool MarkdownTokenizer::IsListItem(const Line& line, size_t& markerEnd, bool& ordered) const
+{
+    size_t i = line.first;
+    const wchar_t ch = m_text[i];
+    if (ch == L'-' || ch == L'*' || ch == L'+') {
+        ordered = false;
+        ++i;
+    } else {
+        while (i < line.end && i - line.first < 9 && m_text[i] >= L'0' && m_text[i] <= L'9') ++i;
+        if (i == line.first || i >= line.end || (m_text[i] != L'.' && m_text[i] != L')')) {
+            return false;
+        }
+        ordered = true;
+        ++i;
+    }
+
+    if (i < line.end && m_text[i] != L' ' && m_text[i] != L'\t') {
+        return false;
+    }
+    markerEnd = i;
+    return true;
+}
+
+bool MarkdownTokenizer::StartsBlock(const Line& line) const
+{
+    wchar_t fenceChar = 0;
+    size_t fenceLength = 0;
+    size_t markerEnd = 0;
+    bool ordered = false;
+    return IsFence(line, fenceChar, fenceLength) || HeadingLevel(line) > 0 || IsRule(line) ||
+           IsListItem(line, markerEnd, ordered);
+}
+
+void MarkdownTokenizer::PushBlock(MarkdownSpanKind kind, MarkdownBlock block, size_t offset,
+                                  std::vector<MarkdownSpan>& spans)
+{
+    MarkdownSpan span = {};
+    span.kind = kind;
+    span.block = block;
+    span.start = static_cast<uint32_t>(offset);
+    spans.push_back(span);
+}
+
+void MarkdownTokenizer::TokenizeInline(size_t begin, size_t end, std::vector<MarkdownSpan>& spans)
+{
+    m_pieces.clear();
+    m_brackets.clear();
+
+    // Failed forward scans are remembered so unmatched openers never rescan:
+    // a code span of n ticks that found no closer will not find one later,
+    // and a link target scan that stopped at stopAt fails for any start before it.
+    bool noCloser[kMaxCodeTicks + 1] = {};
+    size_t targetFailFrom = end;
+    size_t targetFailStop = end;
+
+    size_t textStart = begin;
+    size_t i = begin;
+    auto flush = [&](size_t upto) {
+        if (upto > textStart) {
+            PushPiece(PieceKind::Text, textStart, upto - textStart);
+        }
+    };
+
+    while (i < end) {
+        const wchar_t ch = m_text[i];
+
+        if (ch == L'\\' && i + 1 < end && IsPunct(m_text[i + 1])) {
+            flush(i);
+            textStart = i + 1;  // The escaped character starts a new literal run
+            i += 2;
+            continue;
+        }
+
+        if (ch == L'\n') {
+            flush(i > textStart && m_text[i - 1] == L'\r' ? i - 1 : i);
+            PushPiece(PieceKind::LineBreak, i, 1);
+            ++i;
+            while (i < end && (m_text[i] == L' ' || m_text[i] == L'\t')) ++i;
+            textStart = i;
+            continue;
+        }
+
+        if (ch == L'`') {
+            size_t ticks = 0;
+            while (i + ticks < end && m_text[i + ticks] == L'`') ++ticks;
+            if (ticks <= kMaxCodeTicks && !noCloser[ticks]) {
+                size_t scan = i + ticks;
+                size_t closer = end;
+                while (scan < end) {
+                    if (m_text[scan] != L'`') {
+                        ++scan;
+                        continue;
+                    }
+                    size_t run = 0;
+                    while (scan + run < end && m_text[scan + run] == L'`') ++run;
+                    if (run == ticks) {
+                        closer = scan;
+                        break;
+                    }
+                    scan += run;
+                }
+
+                if (closer != end) {
+                    size_t contentStart = i + ticks;
+                    size_t contentEnd = closer;
+                    if (contentEnd - contentStart >= 2 && m_text[contentStart] == L' ' && m_text[contentEnd - 1] == L' ') {
+                        ++contentStart;
+                        --contentEnd;
+                    }
+                    flush(i);
+                    PushPiece(PieceKind::Code, contentStart, contentEnd - contentStart);
+                    i = closer + ticks;
+                    textStart = i;
+                    continue;
+                }
+                noCloser[ticks] = true;
+            }
+            i += ticks;
+            continue;
+        }
+
+        if (ch == L'*' || ch == L'_') {
+            size_t run = 0;
+            while (i + run < end && m_text[i + run] == ch) ++run;
+
+            const wchar_t before = i > begin ? m_text[i - 1] : L' ';
+            const wchar_t after = i + run < end ? m_text[i + run] : L' ';
+            const bool leftFlanking = !IsSpace(after) && (!IsPunct(after) || IsSpace(before) || IsPunct(before));
+            const bool rightFlanking = !IsSpace(before) && (!IsPunct(before) || IsSpace(after) || IsPunct(after));
+            bool canOpen = leftFlanking;
+            bool canClose = rightFlanking;
+            if (ch == L'_') {
+                // No intraword emphasis with underscores (snake_case stays literal)
+                canOpen = leftFlanking && (!rightFlanking || IsPunct(before)) && !IsAlnum(before);
+                canClose = rightFlanking && (!leftFlanking || IsPunct(after)) && !IsAlnum(after);
+            }
+
+            if (canOpen || canClose) {
+                flush(i);
+                PushPiece(PieceKind::Delimiter, i, run);
+                Piece& piece = m_pieces.back();
+                piece.delimiter = ch;
+                piece.canOpen = canOpen;
+                piece.canClose = canClose;
+                piece.remaining = static_cast<uint32_t>(run);
+                textStart = i + run;
+            }
+            i += run;
+            continue;
+        }
+
+        if (ch == L'[') {
+            flush(i);
+            m_brackets.push_back(static_cast<uint32_t>(m_pieces.size()));
+            PushPiece(PieceKind::Bracket, i, 1);
+            textStart = ++i;
+            continue;
+        }
+
+        if (ch == L']' && !m_brackets.empty() && i + 1 < end && m_text[i + 1] == L'(') {
+            const size_t targetStart = i + 2;
+            size_t scan = targetStart;
+            if (targetStart >= targetFailFrom && targetStart < targetFailStop) {
+                scan = targetFailStop;
+            } else {
+                while (scan < end && m_text[scan] != L')' && !IsSpace(m_text[scan])) ++scan;
+            }
+
+            if (scan < end && m_text[scan] == L')') {
+                Piece& open = m_pieces[m_brackets.back()];
+                m_brackets.pop_back();
+                open.kind = PieceKind::LinkOpen;
+                open.auxStart = static_cast<uint32_t>(targetStart);
+                open.auxLength = static_cast<uint32_t>(scan - targetStart);
+                flush(i);
+                PushPiece(PieceKind::LinkClose, i, scan + 1 - i);
+                i = scan + 1;
+                textStart = i;
+                continue;
+            }
+            targetFailFrom = targetStart;
+            targetFailStop = scan;
+        }
+
+        ++i;
+    }
+    flush(end);
+
+    ResolveEmphasis();
+    EmitPieces(spans);
+}
+
+void MarkdownTokenizer::PushPiece(PieceKind kind, size_t start, size_t length)
+{
+    Piece piece = {};
+    piece.kind = kind;
+    piece.start = static_cast<uint32_t>(start);
+    piece.length = static_cast<uint32_t>(length);
+    m_pieces.push_back(piece);
+}
+
+void MarkdownTokenizer::ResolveEmphasis()
+{
+    // Each closer pairs with the nearest unmatched opener of the same character;
+    // every opener is pushed and popped at most once, so this stays linear.
+    m_openers[0].clear();
+    m_openers[1].clear();
+
+    for (uint32_t index = 0; index < m_pieces.size(); ++index) {
+        Piece& piece = m_pieces[index];
+        if (piece.kind != PieceKind::Delimiter) {
+            continue;
+        }
+        std::vector<uint32_t>& openers = m_openers[piece.delimiter == L'*' ? 0 : 1];
+
+        if (piece.canClose) {
+            while (piece.remaining > 0 && !openers.empty()) {
+                Piece& opener = m_pieces[openers.back()];
+                const uint32_t used = (opener.remaining >= 2 && piece.remaining >= 2) ? 2 : 1;
+                if (used == 2) {
+                    opener.openBold++;
+                    piece.closeBold++;
+                } else {
+                    opener.openItalic++;
+                    piece.closeItalic++;
+                }
+                opener.remaining -= used;
+                piece.remaining -= used;
+                if (opener.remaining == 0) {
+                    openers.pop_back();
+                }
+            }
+        }
+
+        if (piece.canOpen && piece.remaining > 0) {
+            openers.push_back(index);
+        }
+    }
+}
+
+void MarkdownTokenizer::EmitPieces(std::vector<MarkdownSpan>& spans)
+{
+    uint32_t bold = 0;
+    uint32_t italic = 0;
+    auto style = [&]() -> uint8_t {
+        return static_cast<uint8_t>((bold ? MarkdownSpan::Bold : 0) | (italic ? MarkdownSpan::Italic : 0));
+    };
+
+    for (const Piece& piece : m_pieces) {
+        MarkdownSpan span = {};
+        span.start = piece.start;
+        span.length = piece.length;
+
+        switch (piece.kind) {
+        case PieceKind::Text:
+        case PieceKind::Bracket:
+            EmitText(piece.start, piece.length, style(), spans);
+            break;
+
+        case PieceKind::Delimiter: {
+            bold -= piece.closeBold;
+            italic -= piece.closeItalic;
+            // Closers consume their leading characters, openers their trailing ones
+            const bool closed = piece.closeBold || piece.closeItalic;
+            const uint32_t literalStart = closed ? piece.start + piece.length - piece.remaining : piece.start;
+            EmitText(literalStart, piece.remaining, style(), spans);
+            bold += piece.openBold;
+            italic += piece.openItalic;
+            break;
+        }
+
+        case PieceKind::Code:
+            span.kind = MarkdownSpanKind::Code;
+            span.style = style();
+            spans.push_back(span);
+            break;
+
+        case PieceKind::LineBreak:
+            span.kind = MarkdownSpanKind::LineBreak;
+            spans.push_back(span);
+            break;
+
+        case PieceKind::LinkOpen:
+            span.kind = MarkdownSpanKind::LinkStart;
+            span.style = style();
+            span.auxStart = piece.auxStart;
+            span.auxLength = piece.auxLength;
+            spans.push_back(span);
+            break;
+
+        case PieceKind::LinkClose:
+            span.kind = MarkdownSpanKind::LinkEnd;
+            spans.push_back(span);
+            break;
+        }
+    }
+}
+
+void MarkdownTokenizer::EmitText(size_t start, size_t length, uint8_t style, std::vector<MarkdownSpan>& spans)
+{
+    if (length == 0) {
+        return;
+    }
+
+    // Merge with the previous run when it is adjacent and styled the same
+    if (!spans.empty()) {
+        MarkdownSpan& last = spans.back();
+        if (last.kind == MarkdownSpanKind::Text && last.style == style && last.start + last.length == start) {
+            last.length += static_cast<uint32_t>(length);
+            return;
+        }
+    }
+
+    MarkdownSpan span = {};
+    span.kind = MarkdownSpanKind::Text;
+    span.style = style;
+    span.start = static_cast<uint32_t>(start);
+    span.length = static_cast<uint32_t>(length);
+    spans.push_back(span);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Block kinds carried by BlockStart/BlockEnd spans
+enum class MarkdownBlock : uint8_t { Paragraph, Heading, ListItem, CodeFence, Rule };
+
+enum class MarkdownSpanKind : uint8_t {
+    BlockStart,  // start = first source offset of the block
+    BlockEnd,    // start = offset just past the block, including its line break
+    Text,
+    LineBreak,   // Line break inside a paragraph or list item
+    Code,        // Inline code; range is the code content
+    CodeBlock,   // Fenced block content; aux is the info string (language)
+    LinkStart,   // aux is the link target
+    LinkEnd,
+};
+
+// One entry of the flat token stream. Ranges are offsets into the source text,
+// so spans never own or copy characters.
+struct MarkdownSpan {
+    enum : uint8_t { Bold = 1, Italic = 2 };           // style bits
+    enum : uint8_t { Ordered = 1, Unterminated = 2 };  // flags
+
+    MarkdownSpanKind kind;
+    MarkdownBlock block;
+    uint8_t style;
+    uint8_t flags;
+    uint8_t level;  // Heading level or list nesting depth
+    uint32_t start;
+    uint32_t length;
+    uint32_t auxStart;
+    uint32_t auxLength;
+};
+
+// Single-pass markdown tokenizer: headings, emphasis, inline code, fenced
+// blocks, lists and links. Runs in linear time; delimiter runs are matched
+// with a stack instead of searching ahead, and the few forward scans (code
+// spans, link targets) remember failures so they never rescan. Scratch
+// buffers are reused across calls. Portable (no Windows headers).
+class MarkdownTokenizer {
+public:
+    // Clears spans and tokenizes the whole text
+    void Tokenize(const std::wstring& text, std::vector<MarkdownSpan>& spans);
+
+    // Appends spans for text[begin, end); begin must be at a block boundary
+    void Tokenize(const wchar_t* text, size_t begin, size_t end, std::vector<MarkdownSpan>& spans);
+
+private:
+    struct Line {
+        size_t start;
+        size_t first;  // First non-indent character
+        size_t end;    // End of content, excluding \r\n
+        size_t next;   // Start of the following line
+        int indent;    // Columns, tabs count as four
+    };
+
+    enum class PieceKind : uint8_t { Text, Delimiter, Code, LineBreak, Bracket, LinkOpen, LinkClose };
+
+    struct Piece {
+        PieceKind kind;
+        wchar_t delimiter;
+        bool canOpen;
+        bool canClose;
+        uint32_t start;
+        uint32_t length;
+        uint32_t auxStart;
+        uint32_t auxLength;
+        uint32_t remaining;  // Delimiter characters not consumed by emphasis
+        uint32_t openBold;
+        uint32_t openItalic;
+        uint32_t closeBold;
+        uint32_t closeItalic;
+    };
+
+    Line ReadLine(size_t pos, size_t end) const;
+    bool IsBlank(const Line& line) const;
+    bool IsFence(const Line& line, wchar_t& fenceChar, size_t& fenceLength) const;
+    bool IsClosingFence(const Line& line, wchar_t fenceChar, size_t fenceLength) const;
+    int HeadingLevel(const Line& line) const;
+    bool IsRule(const Line& line) const;
+    bool IsListItem(const Line& line, size_t& markerEnd, bool& ordered) const;
+    bool StartsBlock(const Line& line) const;
+
+    void PushBlock(MarkdownSpanKind kind, MarkdownBlock block, size_t offset, std::vector<MarkdownSpan>& spans);
+    void TokenizeInline(size_t begin, size_t end, std::vector<MarkdownSpan>& spans);
+    void PushPiece(PieceKind kind, size_t start, size_t length);
+    void ResolveEmphasis();
+    void EmitPieces(std::vector<MarkdownSpan>& spans);
+    void EmitText(size_t start, size_t length, uint8_t style, std::vector<MarkdownSpan>& spans);
+
+    const wchar_t* m_text = nullptr;
+    std::vector<Piece> m_pieces;
+    std::vector<uint32_t> m_openers[2];  // Unmatched '*' and '_' runs
+    std::vector<uint32_t> m_brackets;
+};
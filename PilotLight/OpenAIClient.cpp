@@ -1,26 +1,389 @@
 #include "OpenAIClient.h"
 #include "JsonBuilder.h"
 #include "SettingsStore.h"
+#include "EndpointRouter.h"
+#include "HedgePolicy.h"
+#include "Diagnostics.h"
+#include "ResponseCache.h"
+#include "SemanticCache.h"
 #include <windows.h>
 #include <winhttp.h>
 #include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <cwctype>
+#include <mutex>
+#include <thread>
 
 #pragma comment(lib, "winhttp.lib")
 
-std::wstring OpenAIClient::Endpoint()
+namespace {
+    const wchar_t* const kModel = L"gpt-4o-mini";
+    constexpr double kRateLimitQueueSeconds = 120.0;
+    constexpr int kMaxThrottleRetries = 2;
+
+    // Rough prompt size: about four UTF-8 bytes per token for English text
+    uint64_t EstimateTokens(size_t utf8Bytes)
+    {
+        return static_cast<uint64_t>(utf8Bytes / 4 + 1);
+    }
+
+    // Reads an unsigned integer field such as "total_tokens": 123; 0 if absent
+    uint64_t FindJsonCount(const std::wstring& json, const wchar_t* key)
+    {
+        const std::wstring quoted = L"\"" + std::wstring(key) + L"\"";
+        size_t pos = json.find(quoted);
+        if (pos == std::wstring::npos) {
+            return 0;
+        }
+        pos = json.find(L':', pos + quoted.length());
+        if (pos == std::wstring::npos) {
+            return 0;
+        }
+        ++pos;
+        while (pos < json.length() && iswspace(json[pos])) {
+            ++pos;
+        }
+        uint64_t value = 0;
+        while (pos < json.length() && iswdigit(json[pos])) {
+            value = value * 10 + (json[pos++] - L'0');
+        }
+        return value;
+    }
+
+    double QueryHeaderNumber(HINTERNET hRequest, const wchar_t* name, bool duration)
+    {
+        wchar_t value[64] = {0};
+        DWORD size = sizeof(value);
+        if (!WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_CUSTOM, name, value, &size, WINHTTP_NO_HEADER_INDEX)) {
+            return -1.0;
+        }
+        if (duration) {
+            return RateLimitHint::ParseDuration(value);
+        }
+        wchar_t* end = nullptr;
+        const double number = wcstod(value, &end);
+        return end != value ? number : -1.0;
+    }
+
+    void ReadRateLimitHeaders(HINTERNET hRequest, RateLimitHint& hint)
+    {
+        hint.limitRequests = QueryHeaderNumber(hRequest, L"x-ratelimit-limit-requests", false);
+        hint.limitTokens = QueryHeaderNumber(hRequest, L"x-ratelimit-limit-tokens", false);
+        hint.remainingRequests = QueryHeaderNumber(hRequest, L"x-ratelimit-remaining-requests", false);
+        hint.remainingTokens = QueryHeaderNumber(hRequest, L"x-ratelimit-remaining-tokens", false);
+        hint.resetRequestsSeconds = QueryHeaderNumber(hRequest, L"x-ratelimit-reset-requests", true);
+        hint.resetTokensSeconds = QueryHeaderNumber(hRequest, L"x-ratelimit-reset-tokens", true);
+        hint.retryAfterSeconds = QueryHeaderNumber(hRequest, L"retry-after", true);
+    }
+
+    std::wstring Utf8ToWide(const char* data, size_t length)
+    {
+        if (length == 0) {
+            return std::wstring();
+        }
+        const int wideLength = MultiByteToWideChar(CP_UTF8, 0, data, static_cast<int>(length), nullptr, 0);
+        std::wstring wide(wideLength, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, data, static_cast<int>(length), &wide[0], wideLength);
+        return wide;
+    }
+
+    // Decodes the JSON string literal that starts at json[pos] (the opening quote)
+    bool ReadJsonString(const std::wstring& json, size_t pos, std::wstring& value)
+    {
+        value.clear();
+        if (pos >= json.length() || json[pos] != L'"') {
+            return false;
+        }
+        for (size_t i = pos + 1; i < json.length(); ++i) {
+            const wchar_t ch = json[i];
+            if (ch == L'"') {
+                return true;
+            }
+            if (ch != L'\\') {
+                value += ch;
+                continue;
+            }
+            if (++i == json.length()) {
+                break;
+            }
+            switch (json[i]) {
+            case L'n': value += L'\n'; break;
+            case L'r': value += L'\r'; break;
+            case L't': value += L'\t'; break;
+            case L'b': value += L'\b'; break;
+            case L'f': value += L'\f'; break;
+            case L'u':
+                // Surrogate pairs arrive as two escapes and pass through unit by unit
+                if (i + 4 < json.length()) {
+                    value += static_cast<wchar_t>(wcstoul(json.substr(i + 1, 4).c_str(), nullptr, 16));
+                    i += 4;
+                }
+                break;
+            default: value += json[i]; break;  // \" \\ \/
+            }
+        }
+        return false;
+    }
+
+    // Finds "key": "value" at or after from; false if absent or not a string (e.g. null)
+    bool FindJsonString(const std::wstring& json, const wchar_t* key, size_t from, std::wstring& value)
+    {
+        const std::wstring quoted = L"\"" + std::wstring(key) + L"\"";
+        size_t pos = json.find(quoted, from);
+        if (pos == std::wstring::npos) {
+            return false;
+        }
+        pos = json.find(L':', pos + quoted.length());
+        if (pos == std::wstring::npos) {
+            return false;
+        }
+        ++pos;
+        while (pos < json.length() && iswspace(json[pos])) {
+            ++pos;
+        }
+        return ReadJsonString(json, pos, value);
+    }
+
+    // Elements of the array whose '[' is at pos, as JSON text
+    std::vector<std::wstring> ReadJsonArray(const std::wstring& json, size_t pos)
+    {
+        std::vector<std::wstring> elements;
+        int depth = 0;
+        bool inString = false;
+        size_t start = std::wstring::npos;
+        for (size_t i = pos; i < json.length(); ++i) {
+            const wchar_t ch = json[i];
+            if (inString) {
+                if (ch == L'\\') {
+                    ++i;
+                } else if (ch == L'"') {
+                    inString = false;
+                }
+                continue;
+            }
+            if (ch == L'"') {
+                inString = true;
+            } else if (ch == L'[' || ch == L'{') {
+                if (++depth == 2 && start == std::wstring::npos) {
+                    start = i;
+                }
+            } else if (ch == L']' || ch == L'}') {
+                if (--depth == 1 && start != std::wstring::npos) {
+                    elements.push_back(json.substr(start, i + 1 - start));
+                    start = std::wstring::npos;
+                } else if (depth == 0) {
+                    break;
+                }
+            }
+        }
+        return elements;
+    }
+
+    // Elements of the first "tool_calls" array at or after from
+    std::vector<std::wstring> FindToolCalls(const std::wstring& json, size_t from = 0)
+    {
+        size_t pos = json.find(L"\"tool_calls\"", from);
+        if (pos == std::wstring::npos) {
+            return std::vector<std::wstring>();
+        }
+        pos = json.find_first_not_of(L" \t\r\n:", pos + 12);
+        if (pos == std::wstring::npos || json[pos] != L'[') {
+            return std::vector<std::wstring>();  // null
+        }
+        return ReadJsonArray(json, pos);
+    }
+
+    // Adds one tool call fragment of a chat.completion.chunk; the id and the
+    // name come in the first fragment of a call, the arguments in pieces
+    void MergeToolCallDelta(const std::wstring& element, std::vector<ToolCall>& calls)
+    {
+        const size_t index = static_cast<size_t>(FindJsonCount(element, L"index"));
+        if (index >= calls.size()) {
+            calls.resize(index + 1);
+        }
+        ToolCall& call = calls[index];
+        std::wstring value;
+        if (FindJsonString(element, L"id", 0, value)) {
+            call.id = value;
+        }
+        if (FindJsonString(element, L"name", 0, value)) {
+            call.name += value;
+        }
+        if (FindJsonString(element, L"arguments", 0, value)) {
+            call.arguments += value;
+        }
+    }
+
+    // Content fragment of one chat.completion.chunk payload
+    bool ReadStreamDelta(const std::wstring& payload, std::wstring& delta)
+    {
+        const size_t pos = payload.find(L"\"delta\"");
+        return pos != std::wstring::npos && FindJsonString(payload, L"content", pos, delta);
+    }
+
+    // Splits a text/event-stream body into "data:" payloads as bytes arrive
+    // and forwards each content fragment. Lines may straddle reads.
+    class EventStreamDecoder {
+    public:
+        explicit EventStreamDecoder(const OpenAIClient::DeltaCallback& onDelta) : m_onDelta(onDelta) {}
+
+        void Feed(const char* data, size_t length)
+        {
+            m_pending.append(data, length);
+            size_t lineStart = 0;
+            for (size_t newline; (newline = m_pending.find('\n', lineStart)) != std::string::npos;
+                 lineStart = newline + 1) {
+                HandleLine(m_pending.data() + lineStart, newline - lineStart);
+            }
+            m_pending.erase(0, lineStart);
+        }
+
+    private:
+        void HandleLine(const char* line, size_t length)
+        {
+            if (length > 0 && line[length - 1] == '\r') {
+                --length;
+            }
+            if (length < 5 || memcmp(line, "data:", 5) != 0) {
+                return;
+            }
+            const std::wstring payload = Utf8ToWide(line + 5, length - 5);
+            if (ReadStreamDelta(payload, m_delta) && !m_delta.empty()) {
+                m_onDelta(m_delta);
+            }
+        }
+
+        const OpenAIClient::DeltaCallback& m_onDelta;
+        std::string m_pending;
+        std::wstring m_delta;
+    };
+}
+
+void RequestCancellation::Cancel()
 {
-    const auto& settings = SettingsStore::Get();
-    if (!settings.endpoint.empty()) {
-        return settings.endpoint;
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_cancelled = true;
+    for (void* request : m_requests) {
+        WinHttpCloseHandle(static_cast<HINTERNET>(request));
     }
+    m_requests.clear();
+}
 
-    wchar_t buffer[512] = {0};
-    GetEnvironmentVariableW(L"PILOTLIGHT_OPENAI_ENDPOINT", buffer, 512);
-    if (buffer[0] != L'\0') {
-        return buffer;
+bool RequestCancellation::Cancelled() const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return m_cancelled;
+}
+
+void RequestCancellation::Reset()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_cancelled = false;
+    m_requests.clear();
+}
+
+bool RequestCancellation::Register(void* request)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_cancelled) {
+        return false;
+    }
+    m_requests.push_back(request);
+    return true;
+}
+
+bool RequestCancellation::Release(void* request)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto it = std::find(m_requests.begin(), m_requests.end(), request);
+    if (it == m_requests.end()) {
+        return false;
+    }
+    m_requests.erase(it);
+    return true;
+}
+
+// Coordinates a primary attempt and its hedge: the first to receive response
+// headers wins and the coordinator closes the loser's request handle, which
+// aborts its blocking WinHTTP call. A handle is closed by whoever first takes
+// it back from the cancellation, if the request has one.
+struct OpenAIClient::HedgeRace {
+    std::mutex lock;
+    std::condition_variable changed;
+    int winner = -1;
+    bool finished[2] = { false, false };
+    HINTERNET requests[2] = { nullptr, nullptr };
+    RequestCancellation* cancel = nullptr;
+
+    // False if the race was already decided in favour of the other attempt
+    bool Register(int slot, HINTERNET hRequest)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (winner != -1 && winner != slot) {
+            return false;
+        }
+        requests[slot] = hRequest;
+        return true;
+    }
+
+    bool Claim(int slot)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (winner == -1) {
+            winner = slot;
+            changed.notify_all();
+        }
+        return winner == slot;
+    }
+
+    // True if the attempt still owns its handle (it was not closed by CancelLosers)
+    bool Release(int slot)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        const bool owned = requests[slot] != nullptr;
+        requests[slot] = nullptr;
+        return owned;
+    }
+
+    void Finish(int slot)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        finished[slot] = true;
+        changed.notify_all();
+    }
+
+    // Caller holds the lock
+    void CancelLosers()
+    {
+        for (int slot = 0; slot < 2; ++slot) {
+            if (slot != winner && requests[slot]) {
+                if (!cancel || cancel->Release(requests[slot])) {
+                    WinHttpCloseHandle(requests[slot]);
+                }
+                requests[slot] = nullptr;
+            }
+        }
+    }
+};
+
+std::vector<std::wstring> OpenAIClient::Endpoints()
+{
+    std::vector<std::wstring> endpoints;
+    const auto& settings = SettingsStore::Get();
+    if (!settings.endpoint.empty()) {
+        endpoints.push_back(settings.endpoint);
+    } else {
+        wchar_t buffer[512] = {0};
+        GetEnvironmentVariableW(L"PILOTLIGHT_OPENAI_ENDPOINT", buffer, 512);
+        endpoints.push_back(buffer[0] != L'\0' ? buffer : L"https://api.openai.com/v1/chat/completions");
     }
 
-    return L"https://api.openai.com/v1/chat/completions";
+    // Extra gateways join the routing pool after the primary endpoint
+    endpoints.insert(endpoints.end(), settings.endpoints.begin(), settings.endpoints.end());
+    return endpoints;
 }
 
 std::wstring OpenAIClient::ApiKey()
@@ -39,29 +402,251 @@ std::wstring OpenAIClient::SerializeMessages(const std::vector<ChatMessage>& mes
 {
     JsonBuilder json;
     json.BeginObject();
-    json.AddString(L"model", L"gpt-4o-mini");
+    json.AddString(L"model", kModel);
     json.BeginArray(L"messages");
 
     for (const auto& msg : messages) {
         json.BeginObject();
         json.AddString(L"role", msg.RoleToString().c_str());
-        json.AddString(L"content", msg.content.c_str());
+        json.AddString(L"content", msg.Content().c_str());
         json.EndObject();
     }
+    if (m_tools) {
+        // Earlier tool rounds of this turn: the calls and their results
+        for (const auto& raw : m_tools->messages) {
+            json.AddRawValue(raw);
+        }
+    }
 
     json.EndArray();
+    if (m_tools && !m_tools->tools.empty()) {
+        json.AddRawValue(L"\"tools\":" + m_tools->tools);
+    }
+    if (m_onDelta) {
+        json.AddBool(L"stream", true);
+        json.AddRawValue(L"\"stream_options\":{\"include_usage\":true}");  // Final chunk carries usage
+    }
     json.EndObject();
 
     return json.ToString();
 }
 
-std::wstring OpenAIClient::SendHttpRequest(const std::wstring& jsonBody)
+// Digest of the normalized request: model, parameters, then the cached
+// per-message digests, so the key costs O(messages) rather than O(bytes).
+Hash::Digest OpenAIClient::RequestKey(const std::vector<ChatMessage>& messages)
+{
+    Hash::Sha256 hasher;
+    hasher.Update(std::wstring(kModel));
+
+    const uint64_t count = messages.size();
+    hasher.Update(&count, sizeof(count));
+    for (const auto& msg : messages) {
+        hasher.Update(msg.ContentDigest());
+    }
+
+    return hasher.Final();
+}
+
+Hash::Digest OpenAIClient::ContextKey(const std::vector<ChatMessage>& messages)
+{
+    // Everything before the question, so paraphrases only match in the same conversation state
+    Hash::Sha256 hasher;
+    hasher.Update(std::wstring(kModel));
+
+    const uint64_t count = messages.empty() ? 0 : messages.size() - 1;
+    hasher.Update(&count, sizeof(count));
+    for (size_t i = 0; i < count; ++i) {
+        hasher.Update(messages[i].ContentDigest());
+    }
+
+    return hasher.Final();
+}
+
+std::wstring OpenAIClient::SendHttpRequest(const std::wstring& jsonBody, RateLimiter::Priority priority)
 {
     std::wstring apiKey = ApiKey();
     if (apiKey.empty()) {
         return L"Error: OpenAI API key missing. Set it in Settings or via PILOTLIGHT_OPENAI_API_KEY.";
     }
 
+    // Convert JSON to UTF-8
+    int utf8Length = WideCharToMultiByte(CP_UTF8, 0, jsonBody.c_str(), -1, nullptr, 0, nullptr, nullptr);
+    std::string utf8Body(utf8Length, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, jsonBody.c_str(), -1, &utf8Body[0], utf8Length, nullptr, nullptr);
+    utf8Body.resize(utf8Length > 0 ? utf8Length - 1 : 0);  // Drop the terminator
+
+    const auto& settings = SettingsStore::Get();
+    RateLimiter& limiter = RateLimiter::Shared();
+    limiter.Configure(settings.rateLimitRequestsPerMinute, settings.rateLimitTokensPerMinute);
+    const uint64_t estimate = EstimateTokens(utf8Body.size()) + limiter.EstimateCompletionTokens();
+
+    RequestCancellation* cancel = m_cancel;
+    const auto cancelled = [cancel] { return cancel && cancel->Cancelled(); };
+    HttpAttempt attempt;
+    for (int throttled = 0; ; ++throttled) {
+        // A request the server throttled requeues as background work, behind
+        // fresh interactive requests and outside their reserved share
+        const RateLimiter::Priority lane = throttled ? RateLimiter::Priority::Background : priority;
+        if (!limiter.Acquire(lane, estimate, kRateLimitQueueSeconds,
+                             cancel ? std::function<bool()>(cancelled) : nullptr)) {
+            if (cancelled()) {
+                return L"Error: Request cancelled.";
+            }
+            return L"Error: Rate limit queue timed out; too many requests are waiting for quota.";
+        }
+
+        attempt = HttpAttempt();
+        SendRouted(apiKey, utf8Body, attempt);
+
+        if (attempt.statusCode == 429 && attempt.rateLimit.retryAfterSeconds < 0.0) {
+            // Throttled without retry-after: back off until the exhausted quota resets, at least a second
+            attempt.rateLimit.retryAfterSeconds = (std::max)(1.0, (std::max)(attempt.rateLimit.resetRequestsSeconds,
+                                                                             attempt.rateLimit.resetTokensSeconds));
+        }
+        limiter.ApplyHint(attempt.rateLimit);
+
+        if (attempt.statusCode != 429 || throttled == kMaxThrottleRetries || cancelled()) {
+            break;
+        }
+        // A rejected request consumed no tokens
+        limiter.Complete(estimate, 0, 0);
+        Diagnostics::Log(L"rate limit: HTTP 429 from " + attempt.endpoint + L", requeueing");
+    }
+
+    if (cancelled()) {
+        limiter.Complete(estimate, 0, 0);
+        return L"Error: Request cancelled.";
+    }
+    if (!attempt.error.empty()) {
+        limiter.Complete(estimate, 0, 0);
+        return L"Error: " + attempt.error;
+    }
+
+    const uint64_t totalTokens = FindJsonCount(attempt.body, L"total_tokens");
+    const uint64_t completionTokens = FindJsonCount(attempt.body, L"completion_tokens");
+    limiter.Complete(estimate, totalTokens ? totalTokens : estimate, completionTokens);
+    return attempt.body;
+}
+
+void OpenAIClient::SendRouted(const std::wstring& apiKey, const std::string& utf8Body, HttpAttempt& attempt)
+{
+    EndpointRouter& router = EndpointRouter::Shared();
+    router.Configure(Endpoints());
+    const std::vector<std::wstring> ranked = router.Rank();
+
+    const auto& settings = SettingsStore::Get();
+    HedgePolicy& hedging = HedgePolicy::Shared();
+    if (settings.hedgeEnabled) {
+        hedging.Configure(settings.hedgePercentile, settings.hedgeMaxRatePercent / 100.0);
+        hedging.RecordRequest();
+    }
+
+    for (size_t i = 0; i < ranked.size(); ++i) {
+        attempt = HttpAttempt();
+        if (i == 0 && settings.hedgeEnabled) {
+            SendHedged(ranked, apiKey, utf8Body, attempt);
+        } else {
+            SendHttpRequestTo(ranked[i], apiKey, utf8Body, attempt);
+        }
+        RecordOutcome(attempt);
+
+        if (settings.hedgeEnabled && attempt.error.empty()) {
+            hedging.RecordTtft(attempt.ttftMs);
+        }
+
+        // Only connect errors fail over: the request never reached that server
+        if (!attempt.connectFailed || attempt.cancelled || i + 1 == ranked.size()) {
+            break;
+        }
+        router.RecordFailover(attempt.endpoint, ranked[i + 1], attempt.error);
+    }
+}
+
+void OpenAIClient::SendHedged(const std::vector<std::wstring>& ranked, const std::wstring& apiKey,
+                              const std::string& utf8Body, HttpAttempt& attempt)
+{
+    HedgePolicy& hedging = HedgePolicy::Shared();
+    double delayMs = 0.0;
+    if (!hedging.HedgeDelay(delayMs)) {
+        SendHttpRequestTo(ranked[0], apiKey, utf8Body, attempt);
+        return;
+    }
+
+    // Prefer an alternate endpoint for the hedge; a single endpoint hedges against itself
+    const std::wstring targets[2] = { ranked[0], ranked.size() > 1 ? ranked[1] : ranked[0] };
+    HedgeRace race;
+    race.cancel = m_cancel;
+    HttpAttempt attempts[2];
+    std::thread workers[2];
+
+    workers[0] = std::thread([&] {
+        SendHttpRequestTo(targets[0], apiKey, utf8Body, attempts[0], &race, 0);
+        race.Finish(0);
+    });
+
+    bool hedged = false;
+    {
+        std::unique_lock<std::mutex> lock(race.lock);
+        const bool settled = race.changed.wait_for(lock, std::chrono::duration<double, std::milli>(delayMs),
+            [&] { return race.winner != -1 || race.finished[0]; });
+        lock.unlock();
+        hedged = !settled && hedging.TryAcquireHedge();
+    }
+
+    if (hedged) {
+        Diagnostics::Log(L"hedge: no first byte after " + std::to_wstring(static_cast<int>(delayMs)) +
+                         L"ms, duplicating to " + targets[1]);
+        workers[1] = std::thread([&] {
+            SendHttpRequestTo(targets[1], apiKey, utf8Body, attempts[1], &race, 1);
+            race.Finish(1);
+        });
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(race.lock);
+        race.changed.wait(lock, [&] {
+            return race.winner != -1 || (race.finished[0] && (!hedged || race.finished[1]));
+        });
+        race.CancelLosers();
+    }
+
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    // Without a winner both attempts failed; report the primary so failover continues normally
+    const int chosen = race.winner != -1 ? race.winner : 0;
+    if (hedged) {
+        hedging.RecordHedgeOutcome(race.winner == 1);
+        RecordOutcome(attempts[1 - chosen]);
+    }
+    attempt = attempts[chosen];
+}
+
+void OpenAIClient::RecordOutcome(const HttpAttempt& attempt)
+{
+    EndpointRouter& router = EndpointRouter::Shared();
+    if (attempt.cancelled || attempt.endpoint.empty()) {
+        return;
+    }
+
+    if (!attempt.error.empty()) {
+        router.RecordFailure(attempt.endpoint, attempt.error);
+    } else if (attempt.statusCode >= 500 || attempt.statusCode == 429) {
+        router.RecordFailure(attempt.endpoint, L"HTTP " + std::to_wstring(attempt.statusCode));
+    } else {
+        router.RecordSuccess(attempt.endpoint, attempt.ttftMs);
+    }
+}
+
+void OpenAIClient::SendHttpRequestTo(const std::wstring& endpoint, const std::wstring& apiKey,
+                                     const std::string& utf8Body, HttpAttempt& attempt,
+                                     HedgeRace* race, int slot)
+{
+    attempt.endpoint = endpoint;
+
     // Parse URL
     URL_COMPONENTS urlComp = {0};
     urlComp.dwStructSize = sizeof(urlComp);
@@ -72,9 +657,10 @@ std::wstring OpenAIClient::SendHttpRequest(const std::wstring& jsonBody)
     urlComp.lpszUrlPath = urlPath;
     urlComp.dwUrlPathLength = 256;
 
-    std::wstring endpoint = Endpoint();
     if (!WinHttpCrackUrl(endpoint.c_str(), 0, 0, &urlComp)) {
-        return L"Error: Invalid endpoint URL.";
+        attempt.connectFailed = true;
+        attempt.error = L"Invalid endpoint URL.";
+        return;
     }
 
     // Open session
@@ -83,25 +669,56 @@ std::wstring OpenAIClient::SendHttpRequest(const std::wstring& jsonBody)
                                       WINHTTP_NO_PROXY_NAME,
                                       WINHTTP_NO_PROXY_BYPASS, 0);
     if (!hSession) {
-        return L"Error: Failed to open HTTP session.";
+        attempt.error = L"Failed to open HTTP session.";
+        return;
     }
 
     // Connect
     HINTERNET hConnect = WinHttpConnect(hSession, hostName, urlComp.nPort, 0);
     if (!hConnect) {
         WinHttpCloseHandle(hSession);
-        return L"Error: Failed to connect to server.";
+        attempt.connectFailed = true;
+        attempt.error = L"Failed to connect to server.";
+        return;
     }
 
     // Open request
+    const DWORD requestFlags = urlComp.nScheme == INTERNET_SCHEME_HTTPS ? WINHTTP_FLAG_SECURE : 0;
     HINTERNET hRequest = WinHttpOpenRequest(hConnect, L"POST", urlPath,
                                              nullptr, WINHTTP_NO_REFERER,
                                              WINHTTP_DEFAULT_ACCEPT_TYPES,
-                                             WINHTTP_FLAG_SECURE);
+                                             requestFlags);
     if (!hRequest) {
         WinHttpCloseHandle(hConnect);
         WinHttpCloseHandle(hSession);
-        return L"Error: Failed to open HTTP request.";
+        attempt.error = L"Failed to open HTTP request.";
+        return;
+    }
+
+    // A losing hedge attempt has its request handle closed by the coordinator,
+    // a cancelled request by the cancelling thread
+    const bool registered = m_cancel && m_cancel->Register(hRequest);
+    auto closeHandles = [&]() {
+        const bool raceOwned = !race || race->Release(slot);
+        const bool cancelOwned = !registered || m_cancel->Release(hRequest);
+        if (raceOwned && cancelOwned) {
+            WinHttpCloseHandle(hRequest);
+        } else {
+            attempt.cancelled = true;
+        }
+        WinHttpCloseHandle(hConnect);
+        WinHttpCloseHandle(hSession);
+    };
+
+    if ((m_cancel && !registered) || (race && !race->Register(slot, hRequest))) {
+        if (!registered || m_cancel->Release(hRequest)) {
+            WinHttpCloseHandle(hRequest);
+        }
+        WinHttpCloseHandle(hConnect);
+        WinHttpCloseHandle(hSession);
+        attempt.cancelled = true;
+        attempt.error = L"Request cancelled.";
+        return;
     }
 
     // Set headers
@@ -111,26 +728,51 @@ std::wstring OpenAIClient::SendHttpRequest(const std::wstring& jsonBody)
     WinHttpAddRequestHeaders(hRequest, authHeader.c_str(), -1, WINHTTP_ADDREQ_FLAG_ADD);
     WinHttpAddRequestHeaders(hRequest, contentType.c_str(), -1, WINHTTP_ADDREQ_FLAG_ADD);
 
-    // Convert JSON to UTF-8
-    int utf8Length = WideCharToMultiByte(CP_UTF8, 0, jsonBody.c_str(), -1, nullptr, 0, nullptr, nullptr);
-    std::string utf8Body(utf8Length, '\0');
-    WideCharToMultiByte(CP_UTF8, 0, jsonBody.c_str(), -1, &utf8Body[0], utf8Length, nullptr, nullptr);
-
     // Send request
+    const auto sendStart = std::chrono::steady_clock::now();
     BOOL bResult = WinHttpSendRequest(hRequest,
                                        WINHTTP_NO_ADDITIONAL_HEADERS, 0,
-                                       (LPVOID)utf8Body.c_str(), utf8Body.length() - 1,
-                                       utf8Body.length() - 1, 0);
+                                       (LPVOID)utf8Body.data(), (DWORD)utf8Body.length(),
+                                       (DWORD)utf8Body.length(), 0);
+    if (!bResult) {
+        // The connection is established inside WinHttpSendRequest
+        const DWORD lastError = GetLastError();
+        attempt.connectFailed = lastError == ERROR_WINHTTP_CANNOT_CONNECT ||
+                                lastError == ERROR_WINHTTP_NAME_NOT_RESOLVED ||
+                                lastError == ERROR_WINHTTP_TIMEOUT ||
+                                lastError == ERROR_WINHTTP_CONNECTION_ERROR ||
+                                lastError == ERROR_WINHTTP_SECURE_FAILURE;
+        closeHandles();
+        attempt.error = L"Failed to send request or receive response.";
+        return;
+    }
 
-    if (!bResult || !WinHttpReceiveResponse(hRequest, nullptr)) {
-        WinHttpCloseHandle(hRequest);
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
-        return L"Error: Failed to send request or receive response.";
+    if (!WinHttpReceiveResponse(hRequest, nullptr)) {
+        closeHandles();
+        attempt.error = L"Failed to send request or receive response.";
+        return;
     }
+    attempt.ttftMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - sendStart).count();
+
+    if (race && !race->Claim(slot)) {
+        closeHandles();
+        attempt.cancelled = true;
+        attempt.error = L"Request cancelled.";
+        return;
+    }
+
+    DWORD statusCode = 0;
+    DWORD statusSize = sizeof(statusCode);
+    WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                        WINHTTP_HEADER_NAME_BY_INDEX, &statusCode, &statusSize, WINHTTP_NO_HEADER_INDEX);
+    attempt.statusCode = statusCode;
+    ReadRateLimitHeaders(hRequest, attempt.rateLimit);
 
-    // Read response
+    // Read response; successful streamed responses are decoded as they arrive
     std::string response;
+    EventStreamDecoder decoder(m_onDelta);
+    const bool streaming = m_onDelta && statusCode == 200;
     DWORD dwSize = 0;
     DWORD dwDownloaded = 0;
     
@@ -143,62 +785,87 @@ std::wstring OpenAIClient::SendHttpRequest(const std::wstring& jsonBody)
         if (!WinHttpReadData(hRequest, buffer.data(), dwSize, &dwDownloaded)) break;
         
         response.append(buffer.data(), dwDownloaded);
+        if (streaming) {
+            decoder.Feed(buffer.data(), dwDownloaded);
+        }
     } while (dwSize > 0);
 
-    WinHttpCloseHandle(hRequest);
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
-
-    // Convert response to wide string
-    int wideLength = MultiByteToWideChar(CP_UTF8, 0, response.c_str(), -1, nullptr, 0);
-    std::wstring wideResponse(wideLength, L'\0');
-    MultiByteToWideChar(CP_UTF8, 0, response.c_str(), -1, &wideResponse[0], wideLength);
+    // A handle closed under the read ends it early; the partial body is not a reply
+    closeHandles();
+    if (attempt.cancelled) {
+        attempt.error = L"Request cancelled.";
+        return;
+    }
 
-    return wideResponse;
+    attempt.body = Utf8ToWide(response.data(), response.size());
 }
 
-std::wstring OpenAIClient::ParseResponse(const std::wstring& jsonResponse)
+std::wstring OpenAIClient::ParseResponse(const std::wstring& jsonResponse, std::vector<ToolCall>* calls)
 {
-    // Basic JSON parsing - extract content from response
-    size_t contentPos = jsonResponse.find(L"\"content\":\"");
-    if (contentPos == std::wstring::npos) {
-        return L"Error: Could not parse response.";
+    if (calls) {
+        for (const auto& element : FindToolCalls(jsonResponse)) {
+            ToolCall call;
+            FindJsonString(element, L"id", 0, call.id);
+            FindJsonString(element, L"name", 0, call.name);
+            FindJsonString(element, L"arguments", 0, call.arguments);
+            calls->push_back(call);
+        }
     }
 
-    contentPos += 11;  // Length of "content":""
-    size_t contentEnd = jsonResponse.find(L"\"", contentPos);
-    if (contentEnd == std::wstring::npos) {
-        return L"Error: Could not parse response.";
+    // First "content" is choices[0].message.content
+    std::wstring content;
+    if (FindJsonString(jsonResponse, L"content", 0, content)) {
+        return content;
+    }
+    if (calls && !calls->empty()) {
+        return std::wstring();  // Content is null beside tool calls
     }
 
-    std::wstring content = jsonResponse.substr(contentPos, contentEnd - contentPos);
+    const size_t errorPos = jsonResponse.find(L"\"error\"");
+    if (errorPos != std::wstring::npos && FindJsonString(jsonResponse, L"message", errorPos, content)) {
+        return L"Error: " + content;
+    }
+    return L"Error: Could not parse response.";
+}
 
-    // Unescape JSON strings
-    std::wstring result;
-    for (size_t i = 0; i < content.length(); ++i) {
-        if (content[i] == L'\\' && i + 1 < content.length()) {
-            wchar_t next = content[i + 1];
-            if (next == L'n') { result += L'\n'; i++; }
-            else if (next == L'r') { result += L'\r'; i++; }
-            else if (next == L't') { result += L'\t'; i++; }
-            else if (next == L'\\') { result += L'\\'; i++; }
-            else if (next == L'"') { result += L'"'; i++; }
-            else { result += content[i]; }
-        } else {
-            result += content[i];
+std::wstring OpenAIClient::ParseStreamResponse(const std::wstring& eventStream, std::vector<ToolCall>* calls)
+{
+    std::wstring content;
+    std::wstring delta;
+    bool sawEvent = false;
+    for (size_t lineStart = 0; lineStart < eventStream.length(); ) {
+        size_t lineEnd = eventStream.find(L'\n', lineStart);
+        if (lineEnd == std::wstring::npos) {
+            lineEnd = eventStream.length();
+        }
+        if (eventStream.compare(lineStart, 5, L"data:") == 0) {
+            sawEvent = true;
+            const std::wstring payload = eventStream.substr(lineStart + 5, lineEnd - lineStart - 5);
+            if (ReadStreamDelta(payload, delta)) {
+                content += delta;
+            }
+            if (calls) {
+                for (const auto& element : FindToolCalls(payload)) {
+                    MergeToolCallDelta(element, *calls);
+                }
+            }
         }
+        lineStart = lineEnd + 1;
     }
 
-    return result;
+    // Errors come back as a plain JSON body even when streaming was requested
+    return sawEvent ? content : ParseResponse(eventStream, calls);
 }
 
-std::wstring OpenAIClient::Complete(const std::vector<ChatMessage>& messages)
+std::wstring OpenAIClient::Complete(const std::vector<ChatMessage>& messages, RateLimiter::Priority priority,
+                                    const DeltaCallback& onDelta, const ToolExchange* tools,
+                                    std::vector<ToolCall>* calls)
 {
     if (SettingsStore::IsStubModeEnabled()) {
         std::wstring stubResponse = L"(Stub) Running in sample mode, so no OpenAI request was issued. ";
         if (!messages.empty()) {
             stubResponse += L"You asked: \"";
-            stubResponse += messages.back().content;
+            stubResponse += messages.back().Content();
             stubResponse += L"\". ";
         }
         stubResponse += L"Configure PILOTLIGHT_OPENAI_API_KEY in Settings to talk to the API.\n";
@@ -206,12 +873,59 @@ std::wstring OpenAIClient::Complete(const std::vector<ChatMessage>& messages)
         return stubResponse;
     }
 
+    const auto& settings = SettingsStore::Get();
+    // A reply that may call tools depends on more than the messages
+    ResponseCache* cache = settings.responseCacheEnabled && !tools ? &ResponseCache::Shared() : nullptr;
+    Hash::Digest cacheKey = {};
+    if (cache) {
+        cache->Configure(static_cast<int64_t>(settings.responseCacheTtlMinutes) * 60,
+                         static_cast<uint64_t>(settings.responseCacheMaxMB) * 1024 * 1024, 4096);
+        cacheKey = RequestKey(messages);
+
+        std::wstring cached;
+        if (cache->Lookup(cacheKey, cached)) {
+            return cached;
+        }
+    }
+
+    // Paraphrased repeats: only plain-text questions, attachments are not part of the signature
+    const bool semanticEligible = settings.semanticCacheEnabled && !tools && !messages.empty() &&
+        messages.back().role == ChatMessage::Role::User && messages.back().attachments.empty();
+    SemanticCache* semantic = semanticEligible ? &SemanticCache::Shared() : nullptr;
+    Hash::Digest contextKey = {};
+    if (semantic) {
+        semantic->Configure(settings.semanticCacheThresholdPercent / 100.0,
+                            static_cast<size_t>(settings.semanticCacheMaxEntries));
+        contextKey = ContextKey(messages);
+
+        std::wstring cached;
+        double similarity = 0.0;
+        if (semantic->Lookup(contextKey, messages.back().Content(), cached, similarity)) {
+            wchar_t note[96];
+            swprintf(note, sizeof(note) / sizeof(note[0]), L"Semantic cache hit (similarity %.2f)", similarity);
+            Diagnostics::Log(note);
+            return cached;
+        }
+    }
+
+    m_onDelta = settings.streamResponses ? onDelta : nullptr;
+    m_tools = tools;
     std::wstring jsonBody = SerializeMessages(messages);
-    std::wstring jsonResponse = SendHttpRequest(jsonBody);
+    m_tools = nullptr;
+    std::wstring jsonResponse = SendHttpRequest(jsonBody, priority);
+    const bool streamed = static_cast<bool>(m_onDelta);
+    m_onDelta = nullptr;
     
     if (jsonResponse.find(L"Error:") == 0) {
         return jsonResponse;
     }
     
-    return ParseResponse(jsonResponse);
+    std::wstring response = streamed ? ParseStreamResponse(jsonResponse, calls) : ParseResponse(jsonResponse, calls);
+    if (cache && response.find(L"Error:") != 0) {
+        cache->Store(cacheKey, response);
+    }
+    if (semantic && response.find(L"Error:") != 0) {
+        semantic->Store(contextKey, messages.back().Content(), response);
+    }
+    return response;
 }
@@ -1,16 +1,89 @@
 #pragma once
+#include <functional>
+#include <mutex>
 #include <string>
 #include <vector>
 #include "ChatMessage.h"
+#include "RateLimiter.h"
+#include "ToolEngine.h"
+
+// Lets another thread abandon a request in flight. Cancel() closes the open
+// request handles, which makes their blocking WinHTTP calls return at once;
+// the request then fails with "Request cancelled." and later requests made
+// with the same object fail at once until Reset().
+class RequestCancellation {
+public:
+    void Cancel();
+    bool Cancelled() const;
+    // Once no request uses it
+    void Reset();
+
+private:
+    friend class OpenAIClient;
+
+    // False if already cancelled; the caller keeps the handle then
+    bool Register(void* request);
+    // True if the caller still owns the handle and must close it
+    bool Release(void* request);
+
+    mutable std::mutex m_lock;
+    bool m_cancelled = false;
+    std::vector<void*> m_requests;  // HINTERNET; two while a request is hedged
+};
 
 class OpenAIClient {
 public:
-    std::wstring Complete(const std::vector<ChatMessage>& messages);
+    // Receives each content fragment of a streamed response. Called on the
+    // thread reading the response (a hedge worker when the request is raced),
+    // never on two threads at once.
+    typedef std::function<void(const std::wstring& delta)> DeltaCallback;
+
+    // With onDelta set and streaming enabled the response is requested as
+    // server-sent events; the full text is still returned at the end. With
+    // tools the request offers them and carries the earlier rounds of the
+    // turn, calls receives the tool calls of the reply (the text may then be
+    // empty), and the response caches are bypassed.
+    std::wstring Complete(const std::vector<ChatMessage>& messages,
+                          RateLimiter::Priority priority = RateLimiter::Priority::Interactive,
+                          const DeltaCallback& onDelta = nullptr,
+                          const ToolExchange* tools = nullptr,
+                          std::vector<ToolCall>* calls = nullptr);
+
+    // Requests made from now on can be abandoned through cancel
+    void SetCancellation(RequestCancellation* cancel) { m_cancel = cancel; }
 
 private:
-    std::wstring Endpoint();
+    struct HedgeRace;  // Shared by racing attempts when a request is hedged
+
+    // Outcome of a single POST against one endpoint
+    struct HttpAttempt {
+        std::wstring endpoint;
+        bool connectFailed = false;  // Nothing reached the server; safe to retry elsewhere
+        bool cancelled = false;      // Lost a hedge race, or the request was cancelled
+        DWORD statusCode = 0;
+        double ttftMs = 0.0;         // Send to first response byte
+        std::wstring body;
+        std::wstring error;
+        RateLimitHint rateLimit;     // x-ratelimit-* and retry-after headers
+    };
+
+    std::vector<std::wstring> Endpoints();
     std::wstring ApiKey();
     std::wstring SerializeMessages(const std::vector<ChatMessage>& messages);
-    std::wstring SendHttpRequest(const std::wstring& jsonBody);
-    std::wstring ParseResponse(const std::wstring& jsonResponse);
+    Hash::Digest RequestKey(const std::vector<ChatMessage>& messages);
+    Hash::Digest ContextKey(const std::vector<ChatMessage>& messages);
+    std::wstring SendHttpRequest(const std::wstring& jsonBody, RateLimiter::Priority priority);
+    void SendRouted(const std::wstring& apiKey, const std::string& utf8Body, HttpAttempt& attempt);
+    void SendHedged(const std::vector<std::wstring>& ranked, const std::wstring& apiKey,
+                    const std::string& utf8Body, HttpAttempt& attempt);
+    void SendHttpRequestTo(const std::wstring& endpoint, const std::wstring& apiKey,
+                           const std::string& utf8Body, HttpAttempt& attempt,
+                           HedgeRace* race = nullptr, int slot = 0);
+    void RecordOutcome(const HttpAttempt& attempt);
+    std::wstring ParseResponse(const std::wstring& jsonResponse, std::vector<ToolCall>* calls = nullptr);
+    std::wstring ParseStreamResponse(const std::wstring& eventStream, std::vector<ToolCall>* calls = nullptr);
+
+    DeltaCallback m_onDelta;                // Set while a streamed request is in flight
+    const ToolExchange* m_tools = nullptr;  // Set while a request with tools is in flight
+    RequestCancellation* m_cancel = nullptr;
 };
@@ -2,7 +2,10 @@
 #include <winsock2.h>
 #include <afxwin.h>
 #include <afxdlgs.h>
+#include <shellapi.h>
+#include <cwchar>
 #include "MainDlg.h"
+#include "PluginProcess.h"
 
 // PilotLight application object
 class CPilotLightApp : public CWinApp
@@ -16,6 +19,18 @@ CPilotLightApp theApp;
 
 BOOL CPilotLightApp::InitInstance()
 {
+    // Started as the plugin helper: serve plugin calls for the parent, no UI
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (argv && argc == 4 && wcscmp(argv[1], L"--plugin-host") == 0) {
+        const std::wstring channelName = argv[2];
+        const DWORD parentProcessId = wcstoul(argv[3], nullptr, 10);
+        LocalFree(argv);
+        PluginProcess::RunHelper(channelName, parentProcessId);
+        return FALSE;
+    }
+    LocalFree(argv);
+
     // Enable per-monitor DPI awareness (Windows 10+)
     SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
 
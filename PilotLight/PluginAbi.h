@@ -0,0 +1,148 @@
+#pragma once
+
+// Interface between PilotLight and plugin DLLs. Plugins include this header;
+// it only depends on <windows.h> and is valid C as well as C++.
+//
+// Version 2 hooks receive text as pointer + length (not null-terminated) and
+// write output of any length through a buffer obtained from the host, so
+// nothing is truncated and no hop rescans the text for its terminator. The
+// version 1 exports (fixed output buffer) keep working; a plugin exporting
+// both versions of a hook is called through version 2.
+//
+// Version 3 adds the pipeline description and the analyzer hooks below;
+// plugins without them run in discovery order, as before.
+
+#include <windows.h>
+
+#define PILOTLIGHT_PLUGIN_ABI_VERSION 3
+
+// UTF-16 text owned by the host; valid until the hook returns
+typedef struct PilotLightText {
+    const wchar_t* data;
+    size_t length;
+} PilotLightText;
+
+// Returns a host buffer for length characters (plus a terminator the host
+// writes), or NULL if it cannot be allocated. Calling it again replaces the
+// earlier buffer. The buffer belongs to the host; it is read when the hook
+// returns TRUE.
+typedef wchar_t*(WINAPI* PilotLightAllocateFn)(void* context, size_t length);
+
+typedef struct PilotLightOutput {
+    PilotLightAllocateFn allocate;
+    void* context;  // Pass back to allocate unchanged
+} PilotLightOutput;
+
+// Return TRUE after filling a buffer from output->allocate to replace the
+// text; FALSE (or TRUE without allocating, or an empty buffer) leaves it
+// unchanged.
+typedef BOOL(WINAPI* PilotLightTransformFn)(const PilotLightText* input, const PilotLightOutput* output);
+
+// Version 1: output is a null-terminated string of at most outputChars - 1
+// characters. The host sizes outputChars from the input (at least 8192).
+typedef BOOL(WINAPI* PilotLightTransformV1Fn)(LPCWSTR input, LPWSTR output, DWORD outputChars);
+
+// Export names
+#define PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT "PilotLight_TransformUserPrompt"
+#define PILOTLIGHT_EXPORT_TRANSFORM_ASSISTANT_RESPONSE "PilotLight_TransformAssistantResponse"
+#define PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2 "PilotLight_TransformUserPromptV2"
+#define PILOTLIGHT_EXPORT_TRANSFORM_ASSISTANT_RESPONSE_V2 "PilotLight_TransformAssistantResponseV2"
+
+// Streaming response hooks (optional; a plugin exports all three or none).
+// They see the assistant reply delta by delta as it arrives, so the reply can
+// be shown before it is complete. A plugin with these hooks is not called
+// through its whole-response transform.
+//
+// BeginResponse returns the plugin's state for one reply (may be NULL); the
+// same pointer is passed to OnDelta and EndResponse, and EndResponse must
+// release it. Calls for one reply come from one thread, in order.
+typedef void*(WINAPI* PilotLightBeginResponseFn)(void);
+
+// Return FALSE to pass the delta on unchanged. Return TRUE to replace it with
+// the buffer filled from output->allocate; TRUE without allocating drops the
+// delta, which lets a plugin hold text back until it has seen enough.
+typedef BOOL(WINAPI* PilotLightOnDeltaFn)(void* state, const PilotLightText* delta, const PilotLightOutput* output);
+
+// End of the reply: return TRUE with a filled buffer to append text (such as
+// text held back earlier), FALSE to append nothing
+typedef BOOL(WINAPI* PilotLightEndResponseFn)(void* state, const PilotLightOutput* output);
+
+#define PILOTLIGHT_EXPORT_BEGIN_RESPONSE "PilotLight_BeginResponse"
+#define PILOTLIGHT_EXPORT_ON_DELTA "PilotLight_OnDelta"
+#define PILOTLIGHT_EXPORT_END_RESPONSE "PilotLight_EndResponse"
+
+// Pipeline description (optional). Names are plugin DLL file names such as
+// L"redact.dll", separated by ';'. Either list may be NULL. The strings are
+// read once when the DLL is scanned and must stay valid until then. Fields
+// past the given size are taken as zero, so older plugins keep working.
+typedef struct PilotLightPluginInfo {
+    DWORD size;                // sizeof(PilotLightPluginInfo)
+    const wchar_t* runsAfter;  // Plugins whose hooks must run before this one's
+    const wchar_t* runsBefore; // Plugins whose hooks must run after this one's
+    DWORD flags;               // PILOTLIGHT_PLUGIN_* bits
+} PilotLightPluginInfo;
+
+// The whole-text transforms return the same result for the same input (and
+// annotations) every time, so the host may reuse an earlier result instead
+// of calling. Streaming hooks and analyzers are always called.
+#define PILOTLIGHT_PLUGIN_DETERMINISTIC 0x1
+
+typedef const PilotLightPluginInfo*(WINAPI* PilotLightGetPluginInfoFn)(void);
+
+// A span of the analyzed text, reported by an analyzer. Copied by the host.
+typedef struct PilotLightAnnotation {
+    size_t start;          // Offset in characters
+    size_t length;
+    PilotLightText tag;    // What the span is, e.g. L"pii.email"
+    PilotLightText value;  // Detail for the tag; may be empty
+} PilotLightAnnotation;
+
+// Returns FALSE if the span is outside the text or the host is out of memory
+typedef BOOL(WINAPI* PilotLightAnnotateFn)(void* context, const PilotLightAnnotation* annotation);
+
+typedef struct PilotLightAnnotations {
+    PilotLightAnnotateFn add;
+    void* context;  // Pass back to add unchanged
+} PilotLightAnnotations;
+
+// Analyzer hook: reads the text without changing it and reports spans
+// through annotations->add. Analyzers that do not depend on each other run at
+// the same time on different threads. Return FALSE to discard what this call
+// reported.
+typedef BOOL(WINAPI* PilotLightAnalyzeFn)(const PilotLightText* input, const PilotLightAnnotations* annotations);
+
+// Transform that also receives the annotations reported on exactly this
+// input, sorted by start and then length; valid until the hook returns.
+// Output works as in PilotLightTransformFn.
+typedef BOOL(WINAPI* PilotLightTransformAnnotatedFn)(const PilotLightText* input,
+                                                     const PilotLightAnnotation* annotations, size_t count,
+                                                     const PilotLightOutput* output);
+
+#define PILOTLIGHT_EXPORT_GET_PLUGIN_INFO "PilotLight_GetPluginInfo"
+#define PILOTLIGHT_EXPORT_ANALYZE_USER_PROMPT "PilotLight_AnalyzeUserPrompt"
+#define PILOTLIGHT_EXPORT_ANALYZE_ASSISTANT_RESPONSE "PilotLight_AnalyzeAssistantResponse"
+#define PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_ANNOTATED "PilotLight_TransformUserPromptAnnotated"
+#define PILOTLIGHT_EXPORT_TRANSFORM_ASSISTANT_RESPONSE_ANNOTATED "PilotLight_TransformAssistantResponseAnnotated"
+
+// Batch transform (optional). Bulk operations such as importing a
+// conversation pass many messages in one call instead of one hook call per
+// message, so the plugin can set up once for all of them. Each message must
+// come out as its role's transform hook would make it: a user message as
+// the prompt transform, an assistant message as the whole-response
+// transform (or the streaming hooks over the whole reply). The plugin must
+// still export those hooks; they are used for single messages and for
+// annotated input. outputs[i] replaces messages[i] as in
+// PilotLightTransformFn; a message left without output is unchanged.
+// Return FALSE to leave every message unchanged.
+#define PILOTLIGHT_ROLE_USER 1
+#define PILOTLIGHT_ROLE_ASSISTANT 2
+
+typedef struct PilotLightMessage {
+    DWORD role;  // PILOTLIGHT_ROLE_*
+    PilotLightText text;
+} PilotLightMessage;
+
+typedef BOOL(WINAPI* PilotLightTransformBatchFn)(const PilotLightMessage* messages, size_t count,
+                                                 const PilotLightOutput* outputs);
+
+#define PILOTLIGHT_EXPORT_TRANSFORM_BATCH "PilotLight_TransformBatch"
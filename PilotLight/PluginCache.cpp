@@ -0,0 +1,112 @@
+#include "PluginCache.h"
+#include "Diagnostics.h"
+#include <cwchar>
+
+namespace {
+    constexpr uint64_t kEntryOverheadBytes = 128;  // List node, map slot, key and output digest
+}
+
+PluginCache::PluginCache()
+    : m_totalBytes(0)
+    , m_maxBytes(4ULL * 1024 * 1024)
+    , m_hits(0)
+    , m_misses(0)
+    , m_evictions(0)
+{
+}
+
+PluginCache& PluginCache::Shared()
+{
+    static PluginCache cache;
+    static const bool registered = [] {
+        Diagnostics::RegisterSection(L"Plugin cache", [] { return cache.Describe(); });
+        return true;
+    }();
+    (void)registered;
+    return cache;
+}
+
+void PluginCache::Configure(uint64_t maxBytes)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_maxBytes = maxBytes;
+    EvictToLimit();
+}
+
+bool PluginCache::Enabled() const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return m_maxBytes > 0;
+}
+
+bool PluginCache::Lookup(const Hash::Digest& key, Result& result)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    const auto found = m_entries.find(key);
+    if (found == m_entries.end()) {
+        ++m_misses;
+        return false;
+    }
+    m_lru.splice(m_lru.begin(), m_lru, found->second);
+    result = found->second->result;
+    ++m_hits;
+    return true;
+}
+
+void PluginCache::Store(const Hash::Digest& key, const Result& result)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    const uint64_t bytes = result.output.size() * sizeof(wchar_t) + kEntryOverheadBytes;
+    if (m_maxBytes == 0 || bytes > m_maxBytes) {
+        return;
+    }
+
+    const auto found = m_entries.find(key);
+    if (found != m_entries.end()) {
+        m_totalBytes -= EntryBytes(*found->second);
+        m_lru.erase(found->second);
+        m_entries.erase(found);
+    }
+    m_lru.push_front(Entry{ key, result });
+    m_entries[key] = m_lru.begin();
+    m_totalBytes += bytes;
+    EvictToLimit();
+}
+
+void PluginCache::Clear()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_lru.clear();
+    m_entries.clear();
+    m_totalBytes = 0;
+}
+
+std::wstring PluginCache::Describe() const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    const uint64_t lookups = m_hits + m_misses;
+    wchar_t text[256];
+    swprintf(text, sizeof(text) / sizeof(text[0]),
+             L"entries=%zu bytes=%llu/%llu evictions=%llu hits=%llu misses=%llu (%.1f%%)\r\n",
+             m_entries.size(), static_cast<unsigned long long>(m_totalBytes),
+             static_cast<unsigned long long>(m_maxBytes), static_cast<unsigned long long>(m_evictions),
+             static_cast<unsigned long long>(m_hits), static_cast<unsigned long long>(m_misses),
+             lookups ? 100.0 * m_hits / lookups : 0.0);
+    return text;
+}
+
+uint64_t PluginCache::EntryBytes(const Entry& entry)
+{
+    return entry.result.output.size() * sizeof(wchar_t) + kEntryOverheadBytes;
+}
+
+void PluginCache::EvictToLimit()
+{
+    while (m_totalBytes > m_maxBytes && !m_lru.empty()) {
+        const Entry& oldest = m_lru.back();
+        m_totalBytes -= EntryBytes(oldest);
+        m_entries.erase(oldest.key);
+        m_lru.pop_back();
+        ++m_evictions;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Hash.h"
+
+// In-memory LRU of deterministic plugin transforms, bounded by bytes. The
+// key is a digest of the plugin name, its file version, the hook and the
+// input (see PluginHost), so a new DLL version never sees old results. An
+// entry also remembers when the plugin left the text unchanged, and keeps
+// the output digest so the next plugin's key needs no rehash. Shared by
+// every PluginHost in a process; thread-safe. Portable.
+class PluginCache {
+public:
+    struct Result {
+        bool replaced;
+        std::wstring output;        // Empty unless replaced
+        Hash::Digest outputDigest;  // Of the text after the call
+    };
+
+    PluginCache();
+
+    static PluginCache& Shared();
+
+    // maxBytes 0 turns the cache off
+    void Configure(uint64_t maxBytes);
+    bool Enabled() const;
+
+    bool Lookup(const Hash::Digest& key, Result& result);
+    void Store(const Hash::Digest& key, const Result& result);
+    void Clear();
+
+    std::wstring Describe() const;
+
+private:
+    struct KeyHash {
+        size_t operator()(const Hash::Digest& key) const { return static_cast<size_t>(key.Prefix64()); }
+    };
+
+    struct Entry {
+        Hash::Digest key;
+        Result result;
+    };
+
+    typedef std::list<Entry>::iterator EntryIterator;
+
+    static uint64_t EntryBytes(const Entry& entry);
+    void EvictToLimit();
+
+    mutable std::mutex m_lock;
+    std::list<Entry> m_lru;  // Most recently used first
+    std::unordered_map<Hash::Digest, EntryIterator, KeyHash> m_entries;
+    uint64_t m_totalBytes;
+    uint64_t m_maxBytes;
+
+    uint64_t m_hits;
+    uint64_t m_misses;
+    uint64_t m_evictions;
+};
@@ -1,117 +1,1265 @@
 #include "PluginHost.h"
+#include "Diagnostics.h"
+#include "FileUtils.h"
+#include "PluginCache.h"
+#include "PluginMetrics.h"
+#include "PluginProcess.h"
+#include "SettingsStore.h"
+#include "StartupTrace.h"
+#include "WorkerPool.h"
 #include <Shlwapi.h>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cwchar>
+#include <functional>
+#include <iterator>
 
 #pragma comment(lib, "Shlwapi.lib")
 
 namespace {
-    constexpr DWORD kMaxPluginOutputChars = 8192;
+    constexpr size_t kMinV1OutputChars = 8192;
+    constexpr size_t kMaxPoolThreads = 3;  // Plus the calling thread
+    constexpr DWORD kReloadSettleMs = 500;  // Copying a DLL changes it several times
+    constexpr size_t kBatchChunkMessages = 16;  // Per round trip to the isolation helper
+
+    double ElapsedMs(std::chrono::steady_clock::time_point started)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    }
+
+    // Metrics are written by the process that runs the plugins, after each reply
+    void SaveMetrics()
+    {
+        const std::wstring appData = FileUtils::GetAppDataPath();
+        if (!appData.empty()) {
+            PluginMetrics::Shared().Save(appData + L"\\plugin-metrics.tsv");
+        }
+    }
+
+    // Host side of PilotLightOutput: the buffer is the next text of the chain
+    wchar_t* WINAPI AllocateOutput(void* context, size_t length)
+    {
+        std::wstring* output = static_cast<std::wstring*>(context);
+        try {
+            output->resize(length);
+        } catch (...) {
+            output->clear();
+            return nullptr;
+        }
+        return &(*output)[0];
+    }
+
+    bool CallTransform(PilotLightTransformFn transform, const std::wstring& input, std::wstring& output)
+    {
+        output.clear();
+        const PilotLightText text = { input.data(), input.length() };
+        const PilotLightOutput sink = { &AllocateOutput, &output };
+        return transform(&text, &sink) && !output.empty();
+    }
+
+    // Version 1 plugins write into a fixed buffer; it is sized from the input
+    // so rewrites of long prompts fit, and reused across the chain
+    bool CallTransformV1(PilotLightTransformV1Fn transform, const std::wstring& input, std::wstring& output,
+                         std::vector<wchar_t>& buffer)
+    {
+        const size_t capacity = input.length() * 2 + kMinV1OutputChars;
+        if (capacity > MAXDWORD) {
+            return false;
+        }
+        if (buffer.size() < capacity) {
+            buffer.resize(capacity);
+        }
+        buffer[0] = L'\0';
+        if (!transform(input.c_str(), buffer.data(), static_cast<DWORD>(capacity))) {
+            return false;
+        }
+
+        // Empty output leaves the text unchanged; output without a terminator is ignored
+        const size_t length = wcsnlen(buffer.data(), capacity);
+        if (length == 0 || length == capacity) {
+            return false;
+        }
+        output.assign(buffer.data(), length);
+        return true;
+    }
+
+    // True if the plugin replaced the delta; the replacement may be empty
+    bool CallOnDelta(PilotLightOnDeltaFn onDelta, void* state, const std::wstring& input, std::wstring& output)
+    {
+        output.clear();
+        const PilotLightText text = { input.data(), input.length() };
+        const PilotLightOutput sink = { &AllocateOutput, &output };
+        return onDelta(state, &text, &sink) != FALSE;
+    }
+
+    bool CallEndResponse(PilotLightEndResponseFn endResponse, void* state, std::wstring& output)
+    {
+        output.clear();
+        const PilotLightOutput sink = { &AllocateOutput, &output };
+        return endResponse(state, &sink) && !output.empty();
+    }
+
+    // Context of PilotLightAnnotations for one analyzer call
+    struct AnnotationSink {
+        void* found;  // std::vector<PluginHost::Annotation>
+        size_t textLength;
+    };
+
+    // Names from GetPluginInfo go into the tab-separated manifest
+    std::wstring ManifestNames(const wchar_t* names)
+    {
+        std::wstring text = names ? names : L"";
+        std::replace_if(text.begin(), text.end(), [](wchar_t c) { return c < L' '; }, L';');
+        return text;
+    }
+
+    // Shadow copies are named after the version they hold, so two copies
+    // of PilotLight can share one and a reload never overwrites a loaded one
+    std::wstring ShadowName(const std::wstring& name, uint64_t size, uint64_t writeTime)
+    {
+        const size_t dot = name.find_last_of(L'.');
+        wchar_t version[48];
+        swprintf(version, sizeof(version) / sizeof(version[0]), L".%llx.%llx", static_cast<unsigned long long>(size),
+                 static_cast<unsigned long long>(writeTime));
+        return name.substr(0, dot) + version + (dot == std::wstring::npos ? L".dll" : name.substr(dot));
+    }
+
+    // Copies left by an earlier run; those another PilotLight has loaded cannot be deleted and stay
+    void DeleteShadowCopies(const std::wstring& directory)
+    {
+        WIN32_FIND_DATAW findData = {};
+        HANDLE findHandle = FindFirstFileW((directory + L"*.dll").c_str(), &findData);
+        if (findHandle == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        do {
+            if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+                DeleteFileW((directory + findData.cFileName).c_str());
+            }
+        } while (FindNextFileW(findHandle, &findData));
+        FindClose(findHandle);
+    }
+
+    // Most analyzers in one step of a pipeline
+    size_t WidestStep(const std::vector<PluginSchedule::Step>& steps)
+    {
+        size_t widest = 0;
+        for (const auto& step : steps) {
+            if (step.analyzers) {
+                widest = (std::max)(widest, step.nodes.size());
+            }
+        }
+        return widest;
+    }
 }
 
-PluginHost::PluginHost()
+PluginHost::PluginHost(bool allowIsolation)
+    : m_stopEvent(nullptr)
+    , m_retireEvent(nullptr)
 {
-    LoadPlugins();
+    const SettingsStore::Settings& settings = SettingsStore::Get();
+    if (allowIsolation && settings.pluginIsolation) {
+        m_process.reset(new PluginProcess(settings.pluginTimeoutMs));
+        Diagnostics::RegisterSection(L"Plugins", [this] { return DescribePlugins(); });
+        return;
+    }
+    PluginMetrics::Shared().Configure(settings.pluginBudgetMs, settings.pluginBudgetStrikes);
+    PluginCache::Shared().Configure(static_cast<uint64_t>(settings.pluginCacheMaxKB) * 1024);
+
+    const std::wstring appData = FileUtils::GetAppDataPath();
+    const std::wstring shadowDirectory = appData + L"\\plugin-shadow";
+    if (settings.pluginHotReload && !appData.empty() && FileUtils::EnsureDirectoryExists(shadowDirectory)) {
+        m_shadowDirectory = shadowDirectory + L"\\";
+        DeleteShadowCopies(m_shadowDirectory);
+    }
+    m_set = ScanPlugins(nullptr);
+
+    if (settings.pluginHotReload) {
+        m_stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        m_retireEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+        if (m_stopEvent && m_retireEvent) {
+            m_watcher = std::thread(&PluginHost::WatchPlugins, this);
+        }
+    }
 }
 
 PluginHost::~PluginHost()
 {
-    UnloadPlugins();
+    if (m_process) {
+        Diagnostics::RegisterSection(L"Plugins", [] { return std::wstring(L"stopped\r\n"); });
+    }
+    if (m_watcher.joinable()) {
+        SetEvent(m_stopEvent);
+        m_watcher.join();
+    }
+    if (m_set && !m_set->plugins.empty()) {
+        SaveMetrics();
+    }
+    m_set.reset();
+    UnloadRetired();
+    if (m_stopEvent) {
+        CloseHandle(m_stopEvent);
+    }
+    if (m_retireEvent) {
+        CloseHandle(m_retireEvent);
+    }
 }
 
 size_t PluginHost::LoadedPluginCount() const
 {
-    return m_plugins.size();
+    return m_process ? m_process->PluginCount() : Snapshot()->plugins.size();
 }
 
+std::shared_ptr<const PluginHost::PluginSet> PluginHost::Snapshot() const
+{
+    std::lock_guard<std::mutex> guard(m_setLock);
+    return m_set;
+}
+
+std::wstring PluginHost::DescribePlugins() const
+{
+    if (m_process) {
+        std::wstring text;
+        uint64_t generation = 0;
+        return m_process->Call(PluginProcess::Op::DescribePlugins, 0, std::wstring(), text, generation)
+            ? text : std::wstring(L"helper not running\r\n");
+    }
+    return PluginMetrics::Shared().Describe() + L"cache: " + PluginCache::Shared().Describe();
+}
+
+std::vector<std::wstring> PluginHost::TakeNotices()
+{
+    if (!m_process) {
+        return PluginMetrics::Shared().TakeNotices();
+    }
+
+    // The helper sends its notices one per line; its log is not visible here
+    std::vector<std::wstring> notices;
+    std::wstring text;
+    uint64_t generation = 0;
+    if (m_process->Call(PluginProcess::Op::TakeNotices, 0, std::wstring(), text, generation)) {
+        size_t start = 0;
+        while (start < text.length()) {
+            size_t end = text.find(L'\n', start);
+            if (end == std::wstring::npos) {
+                end = text.length();
+            }
+            notices.push_back(text.substr(start, end - start));
+            Diagnostics::Log(notices.back());
+            start = end + 1;
+        }
+    }
+    return notices;
+}
+
+size_t PluginHost::ReenablePlugins()
+{
+    if (!m_process) {
+        return PluginMetrics::Shared().Reenable();
+    }
+
+    std::wstring count;
+    uint64_t generation = 0;
+    return m_process->Call(PluginProcess::Op::ReenablePlugins, 0, std::wstring(), count, generation)
+        ? wcstoul(count.c_str(), nullptr, 10) : 0;
+}
+
+// Runs the prompt hooks of the plugins; each replacement becomes the next mutator's input
 std::wstring PluginHost::ApplyUserMessageTransforms(const std::wstring& message) const
 {
+    if (m_process) {
+        // A helper that fails or times out leaves the prompt as typed
+        std::wstring transformed;
+        uint64_t generation = 0;
+        return m_process->Call(PluginProcess::Op::TransformPrompt, 0, message, transformed, generation)
+            ? transformed : message;
+    }
+
+    const std::shared_ptr<const PluginSet> set = Snapshot();
     std::wstring current = message;
+    RunPipeline(*set, PromptMembers(*set), PluginMetrics::PromptHook, current);
+    return current;
+}
 
-    for (const auto& plugin : m_plugins) {
-        if (!plugin.transformUserPrompt) {
-            continue;
+std::wstring PluginHost::ApplyAssistantResponseTransforms(const std::wstring& response) const
+{
+    if (m_process) {
+        std::wstring transformed;
+        uint64_t generation = 0;
+        return m_process->Call(PluginProcess::Op::TransformResponse, 0, response, transformed, generation)
+            ? transformed : response;
+    }
+
+    ResponseStream stream(*this);
+    return stream.Finish(response);
+}
+
+// User messages go through the prompt pipeline together. Assistant messages
+// first go through the leading streaming plugins, in order, as if each had
+// arrived in one delta, and then through the response pipeline together.
+void PluginHost::ApplyTransformsBatch(std::vector<BatchMessage>& messages) const
+{
+    if (m_process) {
+        // Chunks keep each round trip well within the call timeout; a chunk
+        // the helper fails is left unchanged
+        std::vector<BatchMessage> transformed;
+        for (size_t first = 0; first < messages.size(); first += kBatchChunkMessages) {
+            const size_t count = (std::min)(kBatchChunkMessages, messages.size() - first);
+            std::wstring reply;
+            uint64_t generation = 0;
+            transformed.clear();
+            if (m_process->Call(PluginProcess::Op::TransformBatch, 0, EncodeBatch(messages, first, count), reply,
+                                generation) &&
+                DecodeBatch(reply, transformed) && transformed.size() == count) {
+                std::move(transformed.begin(), transformed.end(), messages.begin() + first);
+            }
         }
+        return;
+    }
 
-        wchar_t buffer[kMaxPluginOutputChars] = { 0 };
-        const BOOL handled = plugin.transformUserPrompt(current.c_str(), buffer, kMaxPluginOutputChars);
-        if (handled && buffer[0] != L'\0') {
-            current = buffer;
+    std::vector<PipelineItem> prompts;
+    std::vector<PipelineItem> responses;
+    for (BatchMessage& message : messages) {
+        if (message.role == PILOTLIGHT_ROLE_USER) {
+            prompts.push_back(PipelineItem(&message.text));
+        } else if (message.role == PILOTLIGHT_ROLE_ASSISTANT) {
+            responses.push_back(PipelineItem(&message.text));
         }
     }
 
-    return current;
+    const std::shared_ptr<const PluginSet> set = Snapshot();
+    RunPipeline(*set, PromptMembers(*set), PluginMetrics::PromptHook, prompts);
+    if (!responses.empty()) {
+        const size_t streamingCount = StreamingCount(*set);
+        std::vector<wchar_t> v1Buffer;
+        for (size_t i = 0; i < streamingCount; ++i) {
+            if (set->plugins[i]->Streams()) {
+                RunMutator(*set->plugins[i], PluginMetrics::ResponseHook, responses, v1Buffer);
+            }
+        }
+        RunPipeline(*set, ResponseMembers(*set, streamingCount), PluginMetrics::ResponseHook, responses);
+    }
+    if (!set->plugins.empty()) {
+        SaveMetrics();
+    }
 }
 
+// Per message: the role and the length in decimal, separated by a space,
+// then ':' and the text
+std::wstring PluginHost::EncodeBatch(const std::vector<BatchMessage>& messages, size_t first, size_t count)
+{
+    std::wstring text;
+    for (size_t i = first; i < first + count && i < messages.size(); ++i) {
+        text += std::to_wstring(messages[i].role) + L' ' + std::to_wstring(messages[i].text.length()) + L':';
+        text += messages[i].text;
+    }
+    return text;
+}
 
-std::wstring PluginHost::ApplyAssistantResponseTransforms(const std::wstring& response) const
+bool PluginHost::DecodeBatch(const std::wstring& text, std::vector<BatchMessage>& messages)
 {
-    std::wstring current = response;
+    size_t position = 0;
+    while (position < text.length()) {
+        wchar_t* end = nullptr;
+        const unsigned long role = wcstoul(text.c_str() + position, &end, 10);
+        if (*end != L' ') {
+            return false;
+        }
+        const unsigned long long length = wcstoull(end + 1, &end, 10);
+        if (*end != L':') {
+            return false;
+        }
+        position = static_cast<size_t>(end - text.c_str()) + 1;
+        if (length > text.length() - position) {
+            return false;
+        }
+        messages.push_back(
+            BatchMessage{ static_cast<DWORD>(role), text.substr(position, static_cast<size_t>(length)) });
+        position += static_cast<size_t>(length);
+    }
+    return true;
+}
 
-    for (const auto& plugin : m_plugins) {
-        if (!plugin.transformAssistantResponse) {
-            continue;
+std::vector<PluginHost::Plugin*> PluginHost::PromptMembers(const PluginSet& set)
+{
+    std::vector<Plugin*> members;
+    for (const auto& plugin : set.plugins) {
+        if (plugin->TransformsPrompts() || plugin->AnalyzesPrompts()) {
+            members.push_back(plugin.get());
         }
+    }
+    return members;
+}
 
-        wchar_t buffer[kMaxPluginOutputChars] = { 0 };
-        const BOOL handled = plugin.transformAssistantResponse(current.c_str(), buffer, kMaxPluginOutputChars);
-        if (handled && buffer[0] != L'\0') {
-            current = buffer;
+// Plugins from the first one without streaming hooks on see the whole
+// reply, and so do the analyzers wherever they were found
+std::vector<PluginHost::Plugin*> PluginHost::ResponseMembers(const PluginSet& set, size_t streamingCount)
+{
+    std::vector<Plugin*> members;
+    for (size_t i = 0; i < set.plugins.size(); ++i) {
+        const Plugin& plugin = *set.plugins[i];
+        if ((i >= streamingCount && plugin.TransformsResponses()) || plugin.AnalyzesResponses()) {
+            members.push_back(set.plugins[i].get());
         }
     }
+    return members;
+}
 
-    return current;
+// Streaming stops at the first plugin that needs the whole reply; a bypassed
+// plugin needs nothing
+size_t PluginHost::StreamingCount(const PluginSet& set)
+{
+    const PluginMetrics& metrics = PluginMetrics::Shared();
+    size_t count = 0;
+    while (count < set.plugins.size() &&
+           (set.plugins[count]->Streams() || !set.plugins[count]->TransformsResponses() ||
+            metrics.IsBypassed(set.plugins[count]->metricsId))) {
+        ++count;
+    }
+    return count;
 }
 
-void PluginHost::LoadPlugins()
+void PluginHost::RunPipeline(const PluginSet& set, const std::vector<Plugin*>& members, PluginMetrics::Hook hook,
+                             std::wstring& text) const
 {
-    const std::wstring pluginPattern = GetExecutableDirectory() + L"\\plugins\\*.dll";
+    if (members.empty()) {
+        return;
+    }
+    std::vector<PipelineItem> items(1, PipelineItem(&text));
+    RunPipeline(set, members, hook, items);
+}
 
-    WIN32_FIND_DATAW findData = {};
-    HANDLE findHandle = FindFirstFileW(pluginPattern.c_str(), &findData);
-    if (findHandle == INVALID_HANDLE_VALUE) {
+// Analyzers in one step see the same text, so they run together on the pool.
+// Annotations are merged in node order and then sorted by span, so the
+// result does not depend on which thread finished first. Every item goes
+// through a step before the next step starts, so a mutator sees all of them
+// at once.
+void PluginHost::RunPipeline(const PluginSet& set, const std::vector<Plugin*>& members, PluginMetrics::Hook hook,
+                             std::vector<PipelineItem>& items) const
+{
+    if (members.empty() || items.empty()) {
         return;
     }
 
-    do {
-        if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+    const auto pipelineStarted = std::chrono::steady_clock::now();
+    std::vector<wchar_t> v1Buffer;
+    for (const auto& step : PluginSchedule::Build(ScheduleNodes(members, hook))) {
+        if (step.analyzers) {
+            for (PipelineItem& item : items) {
+                RunAnalyzers(set, members, step.nodes, hook, *item.text, item.annotations);
+            }
+        } else {
+            RunMutator(*members[step.nodes[0]], hook, items, v1Buffer);
+        }
+    }
+
+    const double ms = ElapsedMs(pipelineStarted) / items.size();
+    for (size_t i = 0; i < items.size(); ++i) {
+        PluginMetrics::Shared().RecordPipeline(hook, ms);
+    }
+}
+
+// One mutator over every item. The digest of each text is kept while
+// deterministic plugins follow each other, so a chain of cache hits hashes
+// the input once. The items left after the cache go to the batch export in
+// one call when there are several of them and the plugin needs no
+// annotations; otherwise each is a call of its own. A batch call counts as
+// one call per item, each taking an equal share of the time.
+void PluginHost::RunMutator(Plugin& plugin, PluginMetrics::Hook hook, std::vector<PipelineItem>& items,
+                            std::vector<wchar_t>& v1Buffer) const
+{
+    PluginMetrics& metrics = PluginMetrics::Shared();
+    if (metrics.IsBypassed(plugin.metricsId)) {
+        return;
+    }
+
+    PluginCache& cache = PluginCache::Shared();
+    const bool cacheable = plugin.Cacheable() && cache.Enabled();
+    size_t pending = 0;
+    for (PipelineItem& item : items) {
+        item.pending = true;
+        item.replaced = false;
+        if (!cacheable) {
+            pending++;
             continue;
         }
+        if (!item.haveDigest) {
+            item.digest = Hash::Sha256Of(*item.text);
+            item.haveDigest = true;
+        }
+        item.key = CacheKey(plugin, hook, item.digest, item.annotations);
+        PluginCache::Result cached;
+        const bool hit = cache.Lookup(item.key, cached);
+        metrics.RecordCache(plugin.metricsId, hit);
+        if (hit) {
+            if (cached.replaced) {
+                item.text->swap(cached.output);
+                item.annotations.clear();
+            }
+            item.digest = cached.outputDigest;
+            item.pending = false;
+        } else {
+            pending++;
+        }
+    }
+    if (pending == 0 || !EnsureLoaded(plugin)) {
+        return;
+    }
+
+    if (pending > 1 && plugin.transformBatch && !plugin.TakesAnnotations(hook)) {
+        const auto started = std::chrono::steady_clock::now();
+        CallTransformBatch(plugin.transformBatch, hook, items);
+        const double ms = ElapsedMs(started) / pending;
+        for (size_t i = 0; i < pending; ++i) {
+            metrics.Record(plugin.metricsId, hook, ms);
+        }
+    } else {
+        for (PipelineItem& item : items) {
+            if (!item.pending) {
+                continue;
+            }
+            const auto started = std::chrono::steady_clock::now();
+            item.replaced = hook == PluginMetrics::PromptHook
+                ? TransformPrompt(plugin, *item.text, item.annotations, item.next, v1Buffer)
+                : TransformResponse(plugin, *item.text, item.annotations, item.next, v1Buffer);
+            metrics.Record(plugin.metricsId, hook, ElapsedMs(started));
+        }
+    }
 
-        const std::wstring dllPath = GetExecutableDirectory() + L"\\plugins\\" + findData.cFileName;
-        HMODULE module = LoadLibraryW(dllPath.c_str());
-        if (!module) {
+    for (PipelineItem& item : items) {
+        if (!item.pending) {
             continue;
         }
+        if (cacheable) {
+            PluginCache::Result result = { item.replaced, item.replaced ? item.next : std::wstring(), item.digest };
+            if (item.replaced) {
+                result.outputDigest = Hash::Sha256Of(item.next);
+            }
+            cache.Store(item.key, result);
+            item.digest = result.outputDigest;
+        } else if (item.replaced) {
+            item.haveDigest = false;
+        }
+        if (item.replaced) {
+            item.text->swap(item.next);
+            item.annotations.clear();  // Spans refer to the old text
+        }
+    }
+}
 
-        auto transformPromptFn = reinterpret_cast<TransformUserPromptFn>(
-            GetProcAddress(module, "PilotLight_TransformUserPrompt"));
-        auto transformAssistantFn = reinterpret_cast<TransformAssistantResponseFn>(
-            GetProcAddress(module, "PilotLight_TransformAssistantResponse"));
+// The pending items in one call; each output becomes its item's next text
+bool PluginHost::CallTransformBatch(PilotLightTransformBatchFn transform, PluginMetrics::Hook hook,
+                                    std::vector<PipelineItem>& items)
+{
+    const DWORD role = hook == PluginMetrics::PromptHook ? PILOTLIGHT_ROLE_USER : PILOTLIGHT_ROLE_ASSISTANT;
+    std::vector<PilotLightMessage> messages;
+    std::vector<PilotLightOutput> outputs;
+    std::vector<PipelineItem*> called;
+    for (PipelineItem& item : items) {
+        if (item.pending) {
+            item.next.clear();
+            messages.push_back({ role, { item.text->data(), item.text->length() } });
+            outputs.push_back({ &AllocateOutput, &item.next });
+            called.push_back(&item);
+        }
+    }
 
-        if (!transformPromptFn && !transformAssistantFn) {
-            FreeLibrary(module);
+    if (!transform(messages.data(), messages.size(), outputs.data())) {
+        return false;
+    }
+    for (PipelineItem* item : called) {
+        item->replaced = !item->next.empty();
+    }
+    return true;
+}
+
+void PluginHost::RunAnalyzers(const PluginSet& set, const std::vector<Plugin*>& members,
+                              const std::vector<size_t>& step, PluginMetrics::Hook hook, const std::wstring& text,
+                              std::vector<Annotation>& annotations) const
+{
+    PluginMetrics& metrics = PluginMetrics::Shared();
+    std::vector<std::vector<Annotation>> found(step.size());
+    std::vector<std::function<void()>> tasks;
+    for (size_t i = 0; i < step.size(); ++i) {
+        Plugin* plugin = members[step[i]];
+        if (metrics.IsBypassed(plugin->metricsId)) {
             continue;
         }
+        std::vector<Annotation>* output = &found[i];
+        tasks.push_back([this, plugin, hook, &text, output] {
+            if (!EnsureLoaded(*plugin)) {
+                return;
+            }
+            const PilotLightAnalyzeFn analyze =
+                hook == PluginMetrics::PromptHook ? plugin->analyzeUserPrompt : plugin->analyzeAssistantResponse;
+            if (!analyze) {
+                return;
+            }
+            const auto started = std::chrono::steady_clock::now();
+            CallAnalyze(analyze, text, *output);
+            PluginMetrics::Shared().Record(plugin->metricsId, hook, ElapsedMs(started));
+        });
+    }
+
+    if (set.pool) {
+        set.pool->Run(tasks);
+    } else {
+        for (const auto& task : tasks) {
+            task();
+        }
+    }
+
+    for (auto& list : found) {
+        std::move(list.begin(), list.end(), std::back_inserter(annotations));
+    }
+    std::stable_sort(annotations.begin(), annotations.end(), [](const Annotation& a, const Annotation& b) {
+        return a.start != b.start ? a.start < b.start : a.length < b.length;
+    });
+}
+
+std::vector<PluginSchedule::Node> PluginHost::ScheduleNodes(const std::vector<Plugin*>& members,
+                                                            PluginMetrics::Hook hook)
+{
+    std::vector<PluginSchedule::Node> nodes(members.size());
+    for (size_t i = 0; i < members.size(); ++i) {
+        const Plugin& plugin = *members[i];
+        nodes[i].name = plugin.name;
+        nodes[i].analyzer = hook == PluginMetrics::PromptHook ? plugin.AnalyzesPrompts() : plugin.AnalyzesResponses();
+        nodes[i].runsAfter = plugin.runsAfter;
+        nodes[i].runsBefore = plugin.runsBefore;
+    }
+    return nodes;
+}
+
+// Everything a deterministic transform's result depends on: the plugin file
+// (name, size and write time, so a new version misses), the hook, the input
+// and, for an annotated transform, the annotations it would be given
+Hash::Digest PluginHost::CacheKey(const Plugin& plugin, PluginMetrics::Hook hook, const Hash::Digest& input,
+                                  const std::vector<Annotation>& annotations)
+{
+    const auto addNumber = [](Hash::Sha256& sha, uint64_t value) { sha.Update(&value, sizeof(value)); };
+    const auto addText = [&addNumber](Hash::Sha256& sha, const std::wstring& value) {
+        addNumber(sha, value.length());
+        sha.Update(value);
+    };
+
+    Hash::Sha256 sha;
+    addText(sha, plugin.name);
+    addNumber(sha, plugin.size);
+    addNumber(sha, plugin.writeTime);
+    addNumber(sha, static_cast<uint64_t>(hook));
+    sha.Update(input);
+    if (plugin.TakesAnnotations(hook)) {
+        addNumber(sha, annotations.size());
+        for (const Annotation& annotation : annotations) {
+            addNumber(sha, annotation.start);
+            addNumber(sha, annotation.length);
+            addText(sha, annotation.tag);
+            addText(sha, annotation.value);
+        }
+    }
+    return sha.Final();
+}
+
+// A call that returns FALSE keeps none of its annotations
+bool PluginHost::CallAnalyze(PilotLightAnalyzeFn analyze, const std::wstring& text, std::vector<Annotation>& found)
+{
+    AnnotationSink context = { &found, text.length() };
+    const PilotLightText input = { text.data(), text.length() };
+    const PilotLightAnnotations sink = { &PluginHost::AddAnnotation, &context };
+    if (!analyze(&input, &sink)) {
+        found.clear();
+        return false;
+    }
+    return true;
+}
+
+BOOL WINAPI PluginHost::AddAnnotation(void* context, const PilotLightAnnotation* annotation)
+{
+    const AnnotationSink* sink = static_cast<const AnnotationSink*>(context);
+    if (!annotation || annotation->start > sink->textLength || annotation->length > sink->textLength - annotation->start ||
+        (annotation->tag.length && !annotation->tag.data) || (annotation->value.length && !annotation->value.data)) {
+        return FALSE;
+    }
+    try {
+        static_cast<std::vector<Annotation>*>(sink->found)->push_back(Annotation{
+            annotation->start, annotation->length,
+            std::wstring(annotation->tag.data, annotation->tag.length),
+            std::wstring(annotation->value.data, annotation->value.length) });
+    } catch (...) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+bool PluginHost::CallTransformAnnotated(PilotLightTransformAnnotatedFn transform, const std::wstring& input,
+                                        const std::vector<Annotation>& annotations, std::wstring& output)
+{
+    std::vector<PilotLightAnnotation> views(annotations.size());
+    for (size_t i = 0; i < annotations.size(); ++i) {
+        const Annotation& annotation = annotations[i];
+        views[i] = { annotation.start, annotation.length,
+                     { annotation.tag.data(), annotation.tag.length() },
+                     { annotation.value.data(), annotation.value.length() } };
+    }
+
+    output.clear();
+    const PilotLightText text = { input.data(), input.length() };
+    const PilotLightOutput sink = { &AllocateOutput, &output };
+    return transform(&text, views.data(), views.size(), &sink) && !output.empty();
+}
+
+bool PluginHost::TransformPrompt(const Plugin& plugin, const std::wstring& prompt,
+                                 const std::vector<Annotation>& annotations, std::wstring& output,
+                                 std::vector<wchar_t>& v1Buffer)
+{
+    if (plugin.transformUserPromptAnnotated) {
+        return CallTransformAnnotated(plugin.transformUserPromptAnnotated, prompt, annotations, output);
+    }
+    if (plugin.transformUserPromptV2) {
+        return CallTransform(plugin.transformUserPromptV2, prompt, output);
+    }
+    if (plugin.transformUserPrompt) {
+        return CallTransformV1(plugin.transformUserPrompt, prompt, output, v1Buffer);
+    }
+    return false;
+}
+
+// The whole reply through one plugin's response hooks; true if it was replaced
+bool PluginHost::TransformResponse(const Plugin& plugin, const std::wstring& response,
+                                   const std::vector<Annotation>& annotations, std::wstring& output,
+                                   std::vector<wchar_t>& v1Buffer)
+{
+    if (plugin.beginResponse && plugin.onDelta && plugin.endResponse) {
+        void* state = plugin.beginResponse();
+        std::wstring tail;
+        const bool replaced = CallOnDelta(plugin.onDelta, state, response, output);
+        const bool appended = CallEndResponse(plugin.endResponse, state, tail);
+        if (!replaced && !appended) {
+            return false;
+        }
+        if (!replaced) {
+            output = response;
+        }
+        output += tail;
+        return true;
+    }
+    if (plugin.transformAssistantResponseAnnotated) {
+        return CallTransformAnnotated(plugin.transformAssistantResponseAnnotated, response, annotations, output);
+    }
+    if (plugin.transformAssistantResponseV2) {
+        return CallTransform(plugin.transformAssistantResponseV2, response, output);
+    }
+    if (plugin.transformAssistantResponse) {
+        return CallTransformV1(plugin.transformAssistantResponse, response, output, v1Buffer);
+    }
+    return false;
+}
+
+PluginHost::ResponseStream::ResponseStream(const PluginHost& host)
+    : m_host(host)
+    , m_streamingCount(0)
+    , m_remoteStream(0)
+    , m_remoteGeneration(0)
+    , m_remoteOpen(false)
+{
+    if (host.m_process) {
+        std::wstring unused;
+        m_remoteStream = host.m_process->NewStreamId();
+        m_remoteOpen = host.m_process->Call(PluginProcess::Op::BeginResponse, m_remoteStream, std::wstring(),
+                                            unused, m_remoteGeneration);
+        return;
+    }
+
+    m_set = host.Snapshot();
+    m_streamingCount = StreamingCount(*m_set);
+    Begin();
+}
+
+PluginHost::ResponseStream::~ResponseStream()
+{
+    // Plugins release their state even when the reply is dropped
+    EndRemote();
+    End();
+}
+
+const std::wstring& PluginHost::ResponseStream::Append(const std::wstring& delta)
+{
+    if (m_host.m_process) {
+        // Once the helper fails the rest of the reply is shown as received;
+        // Finish then transforms the whole reply again
+        if (!m_remoteOpen || !m_host.m_process->Call(PluginProcess::Op::AppendDelta, m_remoteStream, delta,
+                                                     m_shown, m_remoteGeneration)) {
+            m_remoteOpen = false;
+            m_shown = delta;
+        }
+        return m_shown;
+    }
+
+    m_received += delta;
+    m_shown = delta;
+    Push(m_shown, 0);
+    m_streamed += m_shown;
+    return m_shown;
+}
+
+std::wstring PluginHost::ResponseStream::Finish(const std::wstring& response)
+{
+    if (m_host.m_process) {
+        std::wstring text;
+        const bool finished = m_remoteOpen &&
+            m_host.m_process->Call(PluginProcess::Op::FinishResponse, m_remoteStream, response, text,
+                                   m_remoteGeneration);
+        m_remoteOpen = false;
+        if (finished) {
+            return text;
+        }
+        uint64_t generation = 0;
+        return m_host.m_process->Call(PluginProcess::Op::TransformResponse, 0, response, text, generation)
+            ? text : response;
+    }
+
+    if (response.compare(0, m_received.length(), m_received) == 0) {
+        // Normally everything was streamed; a reply that arrived whole is one delta
+        if (response.length() > m_received.length()) {
+            Append(response.substr(m_received.length()));
+        }
+    } else {
+        End();
+        m_received.clear();
+        m_streamed.clear();
+        Begin();
+        Append(response);
+    }
+
+    std::wstring text;
+    text.swap(m_streamed);
+    text += End();
+
+    m_host.RunPipeline(*m_set, ResponseMembers(*m_set, m_streamingCount), PluginMetrics::ResponseHook, text);
+
+    if (!m_set->plugins.empty()) {
+        SaveMetrics();
+    }
+    return text;
+}
+
+void PluginHost::ResponseStream::Begin()
+{
+    m_stages.clear();
+    PluginMetrics& metrics = PluginMetrics::Shared();
+    for (size_t i = 0; i < m_streamingCount; ++i) {
+        Plugin& plugin = *m_set->plugins[i];
+        if (plugin.Streams() && !metrics.IsBypassed(plugin.metricsId) && m_host.EnsureLoaded(plugin) &&
+            plugin.beginResponse && plugin.onDelta && plugin.endResponse) {
+            const auto started = std::chrono::steady_clock::now();
+            void* state = plugin.beginResponse();
+            metrics.Record(plugin.metricsId, PluginMetrics::StreamHook, ElapsedMs(started));
+            m_stages.push_back(Stage{ &plugin, state });
+        }
+    }
+}
+
+// Runs text through the open stages from firstStage on; each replacement feeds the next
+void PluginHost::ResponseStream::Push(std::wstring& text, size_t firstStage)
+{
+    PluginMetrics& metrics = PluginMetrics::Shared();
+    for (size_t i = firstStage; i < m_stages.size() && !text.empty(); ++i) {
+        const Stage& stage = m_stages[i];
+        const auto started = std::chrono::steady_clock::now();
+        const bool replaced = CallOnDelta(stage.plugin->onDelta, stage.state, text, m_next);
+        metrics.Record(stage.plugin->metricsId, PluginMetrics::StreamHook, ElapsedMs(started));
+        if (replaced) {
+            text.swap(m_next);
+        }
+    }
+}
+
+void PluginHost::ResponseStream::EndRemote()
+{
+    if (m_remoteOpen) {
+        std::wstring unused;
+        m_host.m_process->Call(PluginProcess::Op::EndResponse, m_remoteStream, std::wstring(), unused,
+                               m_remoteGeneration);
+        m_remoteOpen = false;
+    }
+}
+
+// Ends the open stages in order; text a plugin releases at the end passes
+// through the plugins after it before they end
+std::wstring PluginHost::ResponseStream::End()
+{
+    std::wstring flushed;
+    std::wstring tail;
+    PluginMetrics& metrics = PluginMetrics::Shared();
+    for (size_t i = 0; i < m_stages.size(); ++i) {
+        const Stage& stage = m_stages[i];
+        const auto started = std::chrono::steady_clock::now();
+        if (!flushed.empty() && CallOnDelta(stage.plugin->onDelta, stage.state, flushed, m_next)) {
+            flushed.swap(m_next);
+        }
+        const bool appended = CallEndResponse(stage.plugin->endResponse, stage.state, tail);
+        metrics.Record(stage.plugin->metricsId, PluginMetrics::StreamHook, ElapsedMs(started));
+        if (appended) {
+            flushed += tail;
+        }
+    }
+    m_stages.clear();
+    return flushed;
+}
+
+// Loads the plugin's DLL the first time one of its hooks is needed; false if it cannot be loaded
+bool PluginHost::EnsureLoaded(Plugin& plugin) const
+{
+    std::lock_guard<std::mutex> guard(m_loadLock);
+    if (!plugin.loaded) {
+        const auto started = std::chrono::steady_clock::now();
+        const bool loaded = LoadPlugin(plugin);
+        wchar_t message[MAX_PATH + 64];
+        swprintf(message, sizeof(message) / sizeof(message[0]), L"plugin: %ls %ls on first use in %.1f ms",
+                 plugin.name.c_str(), loaded ? L"loaded" : L"failed to load", ElapsedMs(started));
+        Diagnostics::Log(message);
+    }
+    return plugin.module != nullptr;
+}
+
+// Loads the shadow copy when there is one, so the file in the plugins folder
+// stays free to be replaced; a copy that cannot be made means loading in place
+bool PluginHost::LoadPlugin(Plugin& plugin)
+{
+    plugin.loaded = true;
+    if (!plugin.shadowPath.empty() && !CopyFileW(plugin.path.c_str(), plugin.shadowPath.c_str(), FALSE) &&
+        GetFileAttributesW(plugin.shadowPath.c_str()) == INVALID_FILE_ATTRIBUTES) {
+        plugin.shadowPath.clear();
+    }
+    HMODULE module = LoadLibraryW((plugin.shadowPath.empty() ? plugin.path : plugin.shadowPath).c_str());
+    if (!module) {
+        return false;
+    }
+
+    plugin.module = module;
+    plugin.transformUserPrompt = reinterpret_cast<PilotLightTransformV1Fn>(
+        GetProcAddress(module, PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT));
+    plugin.transformAssistantResponse = reinterpret_cast<PilotLightTransformV1Fn>(
+        GetProcAddress(module, PILOTLIGHT_EXPORT_TRANSFORM_ASSISTANT_RESPONSE));
+    plugin.transformUserPromptV2 = reinterpret_cast<PilotLightTransformFn>(
+        GetProcAddress(module, PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2));
+    plugin.transformAssistantResponseV2 = reinterpret_cast<PilotLightTransformFn>(
+        GetProcAddress(module, PILOTLIGHT_EXPORT_TRANSFORM_ASSISTANT_RESPONSE_V2));
+    plugin.beginResponse = reinterpret_cast<PilotLightBeginResponseFn>(
+        GetProcAddress(module, PILOTLIGHT_EXPORT_BEGIN_RESPONSE));
+    plugin.onDelta = reinterpret_cast<PilotLightOnDeltaFn>(GetProcAddress(module, PILOTLIGHT_EXPORT_ON_DELTA));
+    plugin.endResponse = reinterpret_cast<PilotLightEndResponseFn>(
+        GetProcAddress(module, PILOTLIGHT_EXPORT_END_RESPONSE));
+    plugin.analyzeUserPrompt = reinterpret_cast<PilotLightAnalyzeFn>(
+        GetProcAddress(module, PILOTLIGHT_EXPORT_ANALYZE_USER_PROMPT));
+    plugin.analyzeAssistantResponse = reinterpret_cast<PilotLightAnalyzeFn>(
+        GetProcAddress(module, PILOTLIGHT_EXPORT_ANALYZE_ASSISTANT_RESPONSE));
+    plugin.transformUserPromptAnnotated = reinterpret_cast<PilotLightTransformAnnotatedFn>(
+        GetProcAddress(module, PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_ANNOTATED));
+    plugin.transformAssistantResponseAnnotated = reinterpret_cast<PilotLightTransformAnnotatedFn>(
+        GetProcAddress(module, PILOTLIGHT_EXPORT_TRANSFORM_ASSISTANT_RESPONSE_ANNOTATED));
+    plugin.transformBatch = reinterpret_cast<PilotLightTransformBatchFn>(
+        GetProcAddress(module, PILOTLIGHT_EXPORT_TRANSFORM_BATCH));
+    return true;
+}
+
+// Lists the plugins without loading them where the manifest already knows
+// their hooks; new or changed DLLs are loaded to find out, and stay loaded.
+// Plugins of previous whose file is unchanged carry over as they are.
+std::shared_ptr<PluginHost::PluginSet> PluginHost::ScanPlugins(const PluginSet* previous)
+{
+    const auto started = std::chrono::steady_clock::now();
+    const std::wstring pluginDirectory = GetExecutableDirectory() + L"\\plugins\\";
+    const std::wstring appData = FileUtils::GetAppDataPath();
+    const std::wstring manifestPath = appData.empty() ? std::wstring() : appData + L"\\plugin-manifest.tsv";
+    PluginManifest manifest;
+    if (!manifestPath.empty()) {
+        manifest.Load(manifestPath);
+    }
+    manifest.BeginScan();
+
+    std::shared_ptr<PluginSet> set = std::make_shared<PluginSet>();
+    size_t kept = 0;
+    size_t deferred = 0;
+    size_t loadedNow = 0;
+    double deferredLoadMs = 0.0;
+
+    WIN32_FIND_DATAW findData = {};
+    HANDLE findHandle = FindFirstFileW((pluginDirectory + L"*.dll").c_str(), &findData);
+    if (findHandle != INVALID_HANDLE_VALUE) {
+        do {
+            if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                continue;
+            }
 
-        Plugin plugin = {};
-        plugin.module = module;
-        plugin.name = findData.cFileName;
-        plugin.transformUserPrompt = transformPromptFn;
-        plugin.transformAssistantResponse = transformAssistantFn;
-        m_plugins.push_back(plugin);
+            Plugin plugin = {};
+            plugin.name = findData.cFileName;
+            plugin.path = pluginDirectory + plugin.name;
+            plugin.size = (static_cast<uint64_t>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+            plugin.writeTime = (static_cast<uint64_t>(findData.ftLastWriteTime.dwHighDateTime) << 32) |
+                               findData.ftLastWriteTime.dwLowDateTime;
 
-    } while (FindNextFileW(findHandle, &findData));
+            const std::shared_ptr<Plugin>* current = nullptr;
+            if (previous) {
+                for (const auto& candidate : previous->plugins) {
+                    if (candidate->path == plugin.path && candidate->size == plugin.size &&
+                        candidate->writeTime == plugin.writeTime) {
+                        current = &candidate;
+                        break;
+                    }
+                }
+            }
+            if (current) {
+                manifest.MarkSeen(plugin.path);
+                set->plugins.push_back(*current);
+                kept++;
+                continue;
+            }
 
-    FindClose(findHandle);
+            if (!m_shadowDirectory.empty()) {
+                plugin.shadowPath = m_shadowDirectory + ShadowName(plugin.name, plugin.size, plugin.writeTime);
+            }
+
+            PluginManifest::Entry file;
+            file.size = plugin.size;
+            file.writeTime = plugin.writeTime;
+
+            if (const PluginManifest::Entry* cached = manifest.Find(plugin.path, file.size, file.writeTime)) {
+                manifest.MarkSeen(plugin.path);
+                plugin.exports = cached->exports;
+                file.runsAfter = cached->runsAfter;
+                file.runsBefore = cached->runsBefore;
+                file.flags = cached->flags;
+                if (plugin.TransformsPrompts() || plugin.TransformsResponses() || plugin.AnalyzesPrompts() ||
+                    plugin.AnalyzesResponses()) {
+                    deferred++;
+                    deferredLoadMs += cached->loadMs;
+                }
+            } else {
+                const auto loadStarted = std::chrono::steady_clock::now();
+                if (!LoadPlugin(plugin)) {
+                    UnloadPlugin(plugin);
+                    continue;  // Not recorded, so it is tried again next time
+                }
+                file.loadMs = ElapsedMs(loadStarted);
+                const auto bit = [](bool exported, uint32_t flag) -> uint32_t { return exported ? flag : 0; };
+                file.exports = bit(plugin.transformUserPrompt != nullptr, PluginManifest::TransformUserPromptV1) |
+                    bit(plugin.transformAssistantResponse != nullptr, PluginManifest::TransformAssistantResponseV1) |
+                    bit(plugin.transformUserPromptV2 != nullptr, PluginManifest::TransformUserPromptV2) |
+                    bit(plugin.transformAssistantResponseV2 != nullptr, PluginManifest::TransformAssistantResponseV2) |
+                    bit(plugin.beginResponse != nullptr, PluginManifest::BeginResponse) |
+                    bit(plugin.onDelta != nullptr, PluginManifest::OnDelta) |
+                    bit(plugin.endResponse != nullptr, PluginManifest::EndResponse) |
+                    bit(plugin.analyzeUserPrompt != nullptr, PluginManifest::AnalyzeUserPrompt) |
+                    bit(plugin.analyzeAssistantResponse != nullptr, PluginManifest::AnalyzeAssistantResponse) |
+                    bit(plugin.transformUserPromptAnnotated != nullptr, PluginManifest::TransformUserPromptAnnotated) |
+                    bit(plugin.transformAssistantResponseAnnotated != nullptr,
+                        PluginManifest::TransformAssistantResponseAnnotated) |
+                    bit(plugin.transformBatch != nullptr, PluginManifest::TransformBatch);
+                const auto getInfo = reinterpret_cast<PilotLightGetPluginInfoFn>(
+                    GetProcAddress(plugin.module, PILOTLIGHT_EXPORT_GET_PLUGIN_INFO));
+                const PilotLightPluginInfo* info = getInfo ? getInfo() : nullptr;
+                if (info && info->size >= offsetof(PilotLightPluginInfo, flags)) {
+                    file.runsAfter = ManifestNames(info->runsAfter);
+                    file.runsBefore = ManifestNames(info->runsBefore);
+                }
+                if (info && info->size >= offsetof(PilotLightPluginInfo, flags) + sizeof(info->flags)) {
+                    file.flags = info->flags;
+                }
+                plugin.exports = file.exports;
+                manifest.Store(plugin.path, file);
+                loadedNow++;
+            }
+
+            if (!plugin.TransformsPrompts() && !plugin.TransformsResponses() && !plugin.AnalyzesPrompts() &&
+                !plugin.AnalyzesResponses()) {
+                UnloadPlugin(plugin);
+                continue;
+            }
+
+            plugin.flags = file.flags;
+            plugin.runsAfter = PluginSchedule::SplitNames(file.runsAfter);
+            plugin.runsBefore = PluginSchedule::SplitNames(file.runsBefore);
+            plugin.metricsId = PluginMetrics::Shared().Register(plugin.name);
+            set->plugins.push_back(AdoptPlugin(plugin));
+
+        } while (FindNextFileW(findHandle, &findData));
+
+        FindClose(findHandle);
+    }
+
+    manifest.EndScan();
+    if (manifest.IsDirty() && !manifestPath.empty()) {
+        manifest.Save(manifestPath);
+    }
+
+    PlanPipelines(*set, previous);
+
+    const double scanMs = ElapsedMs(started);
+    wchar_t message[192];
+    if (previous) {
+        if (kept != set->plugins.size() || kept != previous->plugins.size()) {
+            swprintf(message, sizeof(message) / sizeof(message[0]),
+                     L"plugins: rescanned in %.1f ms; %zu kept, %zu new or changed, %zu gone", scanMs, kept,
+                     set->plugins.size() - kept, previous->plugins.size() - kept);
+            Diagnostics::Log(message);
+        }
+        return set;
+    }
+
+    StartupTrace::Shared().SetPlugins(set->plugins.size(), deferred, scanMs, deferredLoadMs);
+    if (!set->plugins.empty() || loadedNow > 0) {
+        swprintf(message, sizeof(message) / sizeof(message[0]),
+                 L"plugins: scanned in %.1f ms; %zu deferred (%.1f ms of loading when last measured), %zu loaded",
+                 scanMs, deferred, deferredLoadMs, loadedNow);
+        Diagnostics::Log(message);
+    }
+    return set;
 }
 
-void PluginHost::UnloadPlugins()
+// Checks the declared order once per scan: logs cycles and gives the set a
+// pool if analyzers can run side by side. Streaming plugins are counted as
+// response mutators here; the order is built again for every call.
+void PluginHost::PlanPipelines(PluginSet& set, const PluginSet* previous)
 {
-    for (const auto& plugin : m_plugins) {
-        if (plugin.module) {
-            FreeLibrary(plugin.module);
+    std::vector<Plugin*> prompt;
+    std::vector<Plugin*> response;
+    for (const auto& plugin : set.plugins) {
+        if (plugin->TransformsPrompts() || plugin->AnalyzesPrompts()) {
+            prompt.push_back(plugin.get());
         }
+        if (plugin->TransformsResponses() || plugin->AnalyzesResponses()) {
+            response.push_back(plugin.get());
+        }
+    }
+
+    size_t promptCycles = 0;
+    size_t responseCycles = 0;
+    const size_t widest = (std::max)(
+        WidestStep(PluginSchedule::Build(ScheduleNodes(prompt, PluginMetrics::PromptHook), &promptCycles)),
+        WidestStep(PluginSchedule::Build(ScheduleNodes(response, PluginMetrics::ResponseHook), &responseCycles)));
+    if (promptCycles + responseCycles > 0) {
+        wchar_t message[160];
+        swprintf(message, sizeof(message) / sizeof(message[0]),
+                 L"plugins: ordering cycle broken in discovery order (%zu prompt, %zu response)", promptCycles,
+                 responseCycles);
+        Diagnostics::Log(message);
+    }
+    if (widest < 2) {
+        return;
+    }
+
+    const size_t threads = (std::min)(widest - 1, kMaxPoolThreads);
+    if (previous && previous->pool && previous->pool->ThreadCount() == threads) {
+        set.pool = previous->pool;
+        return;
+    }
+    set.pool = std::make_shared<WorkerPool>(threads);
+    wchar_t message[96];
+    swprintf(message, sizeof(message) / sizeof(message[0]),
+             L"plugins: up to %zu analyzers per step, %zu worker threads", widest, threads);
+    Diagnostics::Log(message);
+}
+
+// The plugin is unloaded when the last set holding it is released
+std::shared_ptr<PluginHost::Plugin> PluginHost::AdoptPlugin(const Plugin& plugin)
+{
+    return std::shared_ptr<Plugin>(new Plugin(plugin), [this](Plugin* retired) { RetirePlugin(retired); });
+}
+
+// May run on any thread that drops a set; the watcher does the unloading
+void PluginHost::RetirePlugin(Plugin* plugin)
+{
+    std::lock_guard<std::mutex> guard(m_retireLock);
+    m_retired.push_back(plugin);
+    if (m_retireEvent) {
+        SetEvent(m_retireEvent);
+    }
+}
+
+void PluginHost::UnloadPlugin(Plugin& plugin)
+{
+    if (plugin.module) {
+        FreeLibrary(plugin.module);
+        plugin.module = nullptr;
+    }
+    if (!plugin.shadowPath.empty()) {
+        DeleteFileW(plugin.shadowPath.c_str());
+    }
+}
+
+void PluginHost::UnloadRetired()
+{
+    std::vector<Plugin*> retired;
+    {
+        std::lock_guard<std::mutex> guard(m_retireLock);
+        retired.swap(m_retired);
+    }
+    for (Plugin* plugin : retired) {
+        if (plugin->module) {
+            wchar_t message[MAX_PATH + 64];
+            swprintf(message, sizeof(message) / sizeof(message[0]), L"plugin: %ls unloaded after its calls finished",
+                     plugin->name.c_str());
+            Diagnostics::Log(message);
+        }
+        UnloadPlugin(*plugin);
+        delete plugin;
+    }
+}
+
+// Watcher thread: a change to the plugins folder starts a rescan once no
+// further change has come for kReloadSettleMs. Without a plugins folder only
+// retired plugins are handled.
+void PluginHost::WatchPlugins()
+{
+    const std::wstring pluginDirectory = GetExecutableDirectory() + L"\\plugins";
+    HANDLE change = FindFirstChangeNotificationW(pluginDirectory.c_str(), FALSE,
+                                                 FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE |
+                                                 FILE_NOTIFY_CHANGE_LAST_WRITE);
+    const HANDLE handles[] = { m_stopEvent, m_retireEvent, change };
+    const DWORD handleCount = change != INVALID_HANDLE_VALUE ? 3 : 2;
+
+    ULONGLONG settleAt = 0;  // 0 while no change is pending
+    for (;;) {
+        DWORD timeout = INFINITE;
+        if (settleAt != 0) {
+            const ULONGLONG now = GetTickCount64();
+            timeout = settleAt > now ? static_cast<DWORD>(settleAt - now) : 0;
+        }
+
+        const DWORD result = WaitForMultipleObjects(handleCount, handles, FALSE, timeout);
+        if (result == WAIT_OBJECT_0 + 1) {
+            UnloadRetired();
+        } else if (result == WAIT_OBJECT_0 + 2) {
+            FindNextChangeNotification(change);
+            settleAt = GetTickCount64() + kReloadSettleMs;
+        } else if (result == WAIT_TIMEOUT && settleAt != 0) {
+            settleAt = 0;
+            ReloadPlugins();
+        } else {
+            break;  // Stopping, or the wait failed
+        }
+    }
+
+    if (change != INVALID_HANDLE_VALUE) {
+        FindCloseChangeNotification(change);
+    }
+}
+
+// The scan runs without holding any lock a call needs; only the pointer swap
+// takes m_setLock. The old set is released here, and its plugins that are not
+// in the new set are unloaded as soon as the calls still using them return.
+void PluginHost::ReloadPlugins()
+{
+    const std::shared_ptr<const PluginSet> previous = Snapshot();
+    std::shared_ptr<const PluginSet> next = ScanPlugins(previous.get());
+    if (next->plugins == previous->plugins) {
+        return;
     }
-    m_plugins.clear();
+    std::lock_guard<std::mutex> guard(m_setLock);
+    m_set.swap(next);
 }
 
 std::wstring PluginHost::GetExecutableDirectory() const
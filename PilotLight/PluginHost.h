@@ -1,32 +1,273 @@
 #pragma once
 
 #include <windows.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
+#include "Hash.h"
+#include "PluginAbi.h"
+#include "PluginManifest.h"
+#include "PluginMetrics.h"
+#include "PluginSchedule.h"
+
+class PluginProcess;
+class WorkerPool;
 
 class PluginHost {
 public:
-    PluginHost();
+    class ResponseStream;
+
+    // With allowIsolation and the pluginIsolation setting the plugins run in a
+    // helper process instead of being loaded here. With pluginHotReload the
+    // plugins folder is watched and changed DLLs replace the loaded ones.
+    explicit PluginHost(bool allowIsolation = true);
     ~PluginHost();
 
+    // One message of a bulk operation
+    struct BatchMessage {
+        DWORD role;  // PILOTLIGHT_ROLE_*; other messages are left as they are
+        std::wstring text;
+    };
+
     std::wstring ApplyUserMessageTransforms(const std::wstring& message) const;
     std::wstring ApplyAssistantResponseTransforms(const std::wstring& response) const;
+
+    // Each message as ApplyUserMessageTransforms or
+    // ApplyAssistantResponseTransforms would make it, with one call per
+    // plugin for all of them where the plugin exports PilotLight_TransformBatch
+    void ApplyTransformsBatch(std::vector<BatchMessage>& messages) const;
+
+    // Wire form of messages [first, first + count) for the isolation helper
+    static std::wstring EncodeBatch(const std::vector<BatchMessage>& messages, size_t first, size_t count);
+    static bool DecodeBatch(const std::wstring& text, std::vector<BatchMessage>& messages);
+
     size_t LoadedPluginCount() const;
 
-private:
-    typedef BOOL(WINAPI* TransformUserPromptFn)(LPCWSTR input, LPWSTR output, DWORD outputChars);
-    typedef BOOL(WINAPI* TransformAssistantResponseFn)(LPCWSTR input, LPWSTR output, DWORD outputChars);
+    // Per-plugin call counts and latency percentiles, also written to
+    // plugin-metrics.tsv in the app data folder after each reply
+    std::wstring DescribePlugins() const;
+
+    // Notices for plugins bypassed since the last call for running over the
+    // latency budget; they stay bypassed until ReenablePlugins
+    std::vector<std::wstring> TakeNotices();
+    size_t ReenablePlugins();
 
+private:
+    // One version of a plugin DLL. A hook may be exported in either ABI
+    // version; version 2 is preferred. The DLL is loaded from its shadow copy
+    // the first time one of its hooks is needed; until then only its export
+    // bits and ordering (from the manifest) are known. A plugin with a
+    // transform for some text is a mutator there even if it also exports the
+    // analyzer hook. A deterministic plugin's whole-text transforms go
+    // through PluginCache.
     struct Plugin {
         HMODULE module;
         std::wstring name;
-        TransformUserPromptFn transformUserPrompt;
-        TransformAssistantResponseFn transformAssistantResponse;
+        std::wstring path;
+        std::wstring shadowPath;  // Copy that is loaded, so path can be replaced; empty to load path
+        uint64_t size;
+        uint64_t writeTime;
+        uint32_t exports;  // PluginManifest::Export bits, fixed at scan time
+        uint32_t flags;    // PILOTLIGHT_PLUGIN_* bits, fixed at scan time
+        bool loaded;       // Load attempted; the hook pointers are final
+        PilotLightTransformV1Fn transformUserPrompt;
+        PilotLightTransformV1Fn transformAssistantResponse;
+        PilotLightTransformFn transformUserPromptV2;
+        PilotLightTransformFn transformAssistantResponseV2;
+        PilotLightBeginResponseFn beginResponse;
+        PilotLightOnDeltaFn onDelta;
+        PilotLightEndResponseFn endResponse;
+        PilotLightAnalyzeFn analyzeUserPrompt;
+        PilotLightAnalyzeFn analyzeAssistantResponse;
+        PilotLightTransformAnnotatedFn transformUserPromptAnnotated;
+        PilotLightTransformAnnotatedFn transformAssistantResponseAnnotated;
+        PilotLightTransformBatchFn transformBatch;
+        std::vector<std::wstring> runsAfter;
+        std::vector<std::wstring> runsBefore;
+        size_t metricsId;  // PluginMetrics id; also used to check the bypass
+
+        bool Streams() const
+        {
+            const uint32_t hooks =
+                PluginManifest::BeginResponse | PluginManifest::OnDelta | PluginManifest::EndResponse;
+            return (exports & hooks) == hooks;
+        }
+        bool TransformsPrompts() const
+        {
+            return (exports & (PluginManifest::TransformUserPromptV1 | PluginManifest::TransformUserPromptV2 |
+                               PluginManifest::TransformUserPromptAnnotated)) != 0;
+        }
+        bool TransformsResponses() const
+        {
+            return Streams() || (exports & (PluginManifest::TransformAssistantResponseV1 |
+                                            PluginManifest::TransformAssistantResponseV2 |
+                                            PluginManifest::TransformAssistantResponseAnnotated)) != 0;
+        }
+        bool AnalyzesPrompts() const
+        {
+            return (exports & PluginManifest::AnalyzeUserPrompt) != 0 && !TransformsPrompts();
+        }
+        bool AnalyzesResponses() const
+        {
+            return (exports & PluginManifest::AnalyzeAssistantResponse) != 0 && !TransformsResponses();
+        }
+        bool Cacheable() const
+        {
+            return (flags & PILOTLIGHT_PLUGIN_DETERMINISTIC) != 0 && !Streams();
+        }
+        bool TakesAnnotations(PluginMetrics::Hook hook) const
+        {
+            return (exports & (hook == PluginMetrics::PromptHook ? PluginManifest::TransformUserPromptAnnotated
+                                                                 : PluginManifest::TransformAssistantResponseAnnotated))
+                != 0;
+        }
+    };
+
+    // An analyzer's report, valid for the text it analyzed
+    struct Annotation {
+        size_t start;
+        size_t length;
+        std::wstring tag;
+        std::wstring value;
+    };
+
+    // One text on its way through a pipeline, with what is known about it
+    struct PipelineItem {
+        std::wstring* text;
+        std::wstring next;                    // Output of the current call; reused along the chain
+        std::vector<Annotation> annotations;  // Reported on *text
+        Hash::Digest digest;                  // Of *text, when haveDigest
+        Hash::Digest key;                     // PluginCache key of the current call
+        bool haveDigest;
+        bool pending;                         // Needs the current call (no cache hit)
+        bool replaced;                        // The current call replaced the text
+
+        explicit PipelineItem(std::wstring* item)
+            : text(item), digest(), key(), haveDigest(false), pending(false), replaced(false)
+        {
+        }
+    };
+
+    // The plugins as of one scan. Calls take a reference to the current set
+    // and keep it until they return (a ResponseStream for the whole reply),
+    // so a reload swaps in a new set without waiting for them. A plugin
+    // whose file did not change is shared with the next set; the others are
+    // unloaded when the last set holding them goes away.
+    struct PluginSet {
+        std::vector<std::shared_ptr<Plugin>> plugins;
+        std::shared_ptr<WorkerPool> pool;  // Set when some step has more than one analyzer
     };
 
-    std::vector<Plugin> m_plugins;
+    std::shared_ptr<const PluginSet> Snapshot() const;
 
-    void LoadPlugins();
-    void UnloadPlugins();
+    std::shared_ptr<const PluginSet> m_set;  // Replaced whole, under m_setLock
+    mutable std::mutex m_setLock;
+    mutable std::mutex m_loadLock;             // Plugins fill in their hooks on first use under it
+    std::unique_ptr<PluginProcess> m_process;  // Set in isolation mode; there are no plugins here then
+
+    // Reloading: the watcher thread rescans once the folder settles and
+    // unloads retired plugins, so FreeLibrary never runs on a calling thread
+    std::wstring m_shadowDirectory;  // Empty without hot reload: the DLLs are loaded in place
+    std::thread m_watcher;
+    HANDLE m_stopEvent;
+    HANDLE m_retireEvent;
+    std::mutex m_retireLock;
+    std::vector<Plugin*> m_retired;
+
+    // Runs text through members (plugins of set in discovery order) in
+    // dependency order; hook selects the prompt or response hooks
+    void RunPipeline(const PluginSet& set, const std::vector<Plugin*>& members, PluginMetrics::Hook hook,
+                     std::wstring& text) const;
+    void RunPipeline(const PluginSet& set, const std::vector<Plugin*>& members, PluginMetrics::Hook hook,
+                     std::vector<PipelineItem>& items) const;
+    void RunMutator(Plugin& plugin, PluginMetrics::Hook hook, std::vector<PipelineItem>& items,
+                    std::vector<wchar_t>& v1Buffer) const;
+    static bool CallTransformBatch(PilotLightTransformBatchFn transform, PluginMetrics::Hook hook,
+                                   std::vector<PipelineItem>& items);
+    static std::vector<Plugin*> PromptMembers(const PluginSet& set);
+    static std::vector<Plugin*> ResponseMembers(const PluginSet& set, size_t streamingCount);
+    static size_t StreamingCount(const PluginSet& set);
+    void RunAnalyzers(const PluginSet& set, const std::vector<Plugin*>& members, const std::vector<size_t>& step,
+                      PluginMetrics::Hook hook, const std::wstring& text,
+                      std::vector<Annotation>& annotations) const;
+    static std::vector<PluginSchedule::Node> ScheduleNodes(const std::vector<Plugin*>& members,
+                                                           PluginMetrics::Hook hook);
+    static Hash::Digest CacheKey(const Plugin& plugin, PluginMetrics::Hook hook, const Hash::Digest& input,
+                                 const std::vector<Annotation>& annotations);
+    static bool CallAnalyze(PilotLightAnalyzeFn analyze, const std::wstring& text, std::vector<Annotation>& found);
+    static BOOL WINAPI AddAnnotation(void* context, const PilotLightAnnotation* annotation);
+    static bool CallTransformAnnotated(PilotLightTransformAnnotatedFn transform, const std::wstring& input,
+                                       const std::vector<Annotation>& annotations, std::wstring& output);
+
+    static bool TransformPrompt(const Plugin& plugin, const std::wstring& prompt,
+                                const std::vector<Annotation>& annotations, std::wstring& output,
+                                std::vector<wchar_t>& v1Buffer);
+    static bool TransformResponse(const Plugin& plugin, const std::wstring& response,
+                                  const std::vector<Annotation>& annotations, std::wstring& output,
+                                  std::vector<wchar_t>& v1Buffer);
+
+    bool EnsureLoaded(Plugin& plugin) const;
+    static bool LoadPlugin(Plugin& plugin);
+
+    // New set from the plugins folder; plugins unchanged since previous are reused
+    std::shared_ptr<PluginSet> ScanPlugins(const PluginSet* previous);
+    static void PlanPipelines(PluginSet& set, const PluginSet* previous);
+    std::shared_ptr<Plugin> AdoptPlugin(const Plugin& plugin);
+    void RetirePlugin(Plugin* plugin);
+    static void UnloadPlugin(Plugin& plugin);
+    void UnloadRetired();
+
+    void WatchPlugins();
+    void ReloadPlugins();
     std::wstring GetExecutableDirectory() const;
 };
+
+// One assistant reply on its way through the plugins' response hooks.
+// Leading plugins with streaming hooks transform each delta as it arrives;
+// from the first plugin that only has a whole-response transform on, the
+// text is buffered and transformed when the reply is complete, together with
+// the response analyzers wherever they were found. A reply stays with the
+// plugins it began with, even if they are reloaded meanwhile. Used on one
+// thread at a time. In isolation mode the same happens in the helper process
+// and each call is a round trip to it.
+class PluginHost::ResponseStream {
+public:
+    explicit ResponseStream(const PluginHost& host);
+    ~ResponseStream();
+
+    // Text to show for a received delta; empty while plugins hold text back
+    const std::wstring& Append(const std::wstring& delta);
+
+    // Final text for the complete reply. If the reply is not what was
+    // streamed (an error, or a cached answer) it is passed through the
+    // plugins again from the start.
+    std::wstring Finish(const std::wstring& response);
+
+private:
+    struct Stage {
+        Plugin* plugin;
+        void* state;
+    };
+
+    void Begin();
+    void Push(std::wstring& text, size_t firstStage);
+    std::wstring End();
+    void EndRemote();
+
+    const PluginHost& m_host;
+    std::shared_ptr<const PluginSet> m_set;  // The plugins this reply started with
+    size_t m_streamingCount;  // Plugins [0, m_streamingCount) see deltas
+    std::vector<Stage> m_stages;  // Open replies of the streaming plugins
+    std::wstring m_received;
+    std::wstring m_streamed;  // Output of the streaming plugins so far
+    std::wstring m_shown;
+    std::wstring m_next;
+
+    // Isolation mode: the stream in the helper, and the helper generation that opened it
+    uint32_t m_remoteStream;
+    uint64_t m_remoteGeneration;
+    bool m_remoteOpen;
+};
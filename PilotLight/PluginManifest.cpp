@@ -0,0 +1,142 @@
+#include "PluginManifest.h"
+#include <fstream>
+#include <locale>
+#include <sstream>
+#include <vector>
+
+namespace {
+    constexpr const wchar_t* kHeader = L"# PilotLight plugin manifest v3";
+
+#ifdef _WIN32
+    const std::wstring& NativePath(const std::wstring& path)
+    {
+        return path;
+    }
+#else
+    std::string NativePath(const std::wstring& path)
+    {
+        return std::string(path.begin(), path.end());
+    }
+#endif
+}
+
+PluginManifest::PluginManifest()
+    : m_dirty(false)
+{
+}
+
+bool PluginManifest::Load(const std::wstring& path)
+{
+    m_records.clear();
+    m_dirty = false;
+
+    std::wifstream file(NativePath(path));
+    if (!file.is_open()) {
+        return false;
+    }
+    file.imbue(std::locale::classic());
+
+    std::wstring line;
+    if (!std::getline(file, line) || line != kHeader) {
+        return false;  // Unknown format; the next scan rebuilds it
+    }
+
+    // path, size, write time, exports, load ms, runs after, runs before,
+    // flags; the name lists may be empty
+    std::vector<std::wstring> fields;
+    while (std::getline(file, line)) {
+        fields.clear();
+        size_t start = 0;
+        for (size_t tab = line.find(L'\t'); tab != std::wstring::npos; tab = line.find(L'\t', start)) {
+            fields.push_back(line.substr(start, tab - start));
+            start = tab + 1;
+        }
+        fields.push_back(line.substr(start));
+        if (fields.size() != 8 || fields[0].empty()) {
+            continue;
+        }
+
+        std::wistringstream numbers(fields[1] + L' ' + fields[2] + L' ' + fields[3] + L' ' + fields[4] + L' ' +
+                                    fields[7]);
+        numbers.imbue(std::locale::classic());
+        Record record = {};
+        if (numbers >> record.entry.size >> record.entry.writeTime >> record.entry.exports >> record.entry.loadMs >>
+            record.entry.flags) {
+            record.entry.runsAfter = fields[5];
+            record.entry.runsBefore = fields[6];
+            m_records[fields[0]] = record;
+        }
+    }
+    return true;
+}
+
+bool PluginManifest::Save(const std::wstring& path)
+{
+    std::wofstream file(NativePath(path), std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.imbue(std::locale::classic());
+
+    file << kHeader << L"\n";
+    for (const auto& item : m_records) {
+        const Entry& entry = item.second.entry;
+        file << item.first << L'\t' << entry.size << L'\t' << entry.writeTime << L'\t' << entry.exports << L'\t'
+             << entry.loadMs << L'\t' << entry.runsAfter << L'\t' << entry.runsBefore << L'\t'
+             << entry.flags << L"\n";
+    }
+    if (!file.good()) {
+        return false;
+    }
+    m_dirty = false;
+    return true;
+}
+
+const PluginManifest::Entry* PluginManifest::Find(const std::wstring& path, uint64_t size, uint64_t writeTime) const
+{
+    const auto found = m_records.find(path);
+    if (found == m_records.end() || found->second.entry.size != size || found->second.entry.writeTime != writeTime) {
+        return nullptr;
+    }
+    return &found->second.entry;
+}
+
+void PluginManifest::Store(const std::wstring& path, const Entry& entry)
+{
+    Record& record = m_records[path];
+    if (record.entry.size != entry.size || record.entry.writeTime != entry.writeTime ||
+        record.entry.exports != entry.exports || record.entry.loadMs != entry.loadMs ||
+        record.entry.runsAfter != entry.runsAfter || record.entry.runsBefore != entry.runsBefore ||
+        record.entry.flags != entry.flags) {
+        record.entry = entry;
+        m_dirty = true;
+    }
+    record.seen = true;
+}
+
+void PluginManifest::BeginScan()
+{
+    for (auto& item : m_records) {
+        item.second.seen = false;
+    }
+}
+
+void PluginManifest::MarkSeen(const std::wstring& path)
+{
+    const auto found = m_records.find(path);
+    if (found != m_records.end()) {
+        found->second.seen = true;
+    }
+}
+
+void PluginManifest::EndScan()
+{
+    for (auto it = m_records.begin(); it != m_records.end();) {
+        if (!it->second.seen) {
+            it = m_records.erase(it);
+            m_dirty = true;
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// What each plugin DLL exports, cached between runs so startup can list the
+// plugins without loading them. An entry is trusted only while the file's
+// size and last-write time match; a stale entry means the DLL is loaded to
+// look again. The file is tab-separated text, one DLL per line. Portable.
+class PluginManifest {
+public:
+    // Export bits; the hooks a plugin has
+    enum Export : uint32_t {
+        TransformUserPromptV1 = 1 << 0,
+        TransformAssistantResponseV1 = 1 << 1,
+        TransformUserPromptV2 = 1 << 2,
+        TransformAssistantResponseV2 = 1 << 3,
+        BeginResponse = 1 << 4,
+        OnDelta = 1 << 5,
+        EndResponse = 1 << 6,
+        AnalyzeUserPrompt = 1 << 7,
+        AnalyzeAssistantResponse = 1 << 8,
+        TransformUserPromptAnnotated = 1 << 9,
+        TransformAssistantResponseAnnotated = 1 << 10,
+        TransformBatch = 1 << 11,
+    };
+
+    struct Entry {
+        uint64_t size = 0;
+        uint64_t writeTime = 0;
+        uint32_t exports = 0;
+        double loadMs = 0.0;  // Last measured LoadLibrary time, for the startup report
+        std::wstring runsAfter;   // From PilotLight_GetPluginInfo, ';'-separated
+        std::wstring runsBefore;
+        uint32_t flags = 0;       // PILOTLIGHT_PLUGIN_* bits from PilotLight_GetPluginInfo
+    };
+
+    PluginManifest();
+
+    bool Load(const std::wstring& path);
+    bool Save(const std::wstring& path);
+    bool IsDirty() const { return m_dirty; }
+
+    // Entry for path if its size and write time still match, else nullptr
+    const Entry* Find(const std::wstring& path, uint64_t size, uint64_t writeTime) const;
+    void Store(const std::wstring& path, const Entry& entry);
+
+    // Drops entries for DLLs that were not seen by the last scan
+    void BeginScan();
+    void MarkSeen(const std::wstring& path);
+    void EndScan();
+
+private:
+    struct Record {
+        Entry entry;
+        bool seen;
+    };
+
+    std::unordered_map<std::wstring, Record> m_records;
+    bool m_dirty;
+};
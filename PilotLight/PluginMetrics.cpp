@@ -0,0 +1,261 @@
+#include "PluginMetrics.h"
+#include "Diagnostics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+    const wchar_t* const kHookNames[PluginMetrics::HookCount] = { L"prompt", L"response", L"stream" };
+}
+
+PluginMetrics::PluginMetrics()
+    : m_pipelines()
+    , m_budgetMs(0.0)
+    , m_strikes(3)
+{
+}
+
+PluginMetrics& PluginMetrics::Shared()
+{
+    static PluginMetrics metrics;
+    static const bool registered = [] {
+        Diagnostics::RegisterSection(L"Plugins", [] { return metrics.Describe(); });
+        return true;
+    }();
+    (void)registered;
+    return metrics;
+}
+
+void PluginMetrics::Configure(double budgetMs, int strikes)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_budgetMs = budgetMs > 0.0 ? budgetMs : 0.0;
+    m_strikes = (std::max)(1, strikes);
+}
+
+size_t PluginMetrics::Register(const std::wstring& name)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    for (size_t i = 0; i < m_plugins.size(); ++i) {
+        if (m_plugins[i].name == name) {
+            return i;
+        }
+    }
+
+    m_plugins.emplace_back();  // Zeroed counters
+    m_plugins.back().name = name;
+    return m_plugins.size() - 1;
+}
+
+bool PluginMetrics::IsBypassed(size_t plugin) const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return plugin < m_plugins.size() && m_plugins[plugin].bypassed;
+}
+
+void PluginMetrics::Record(size_t plugin, Hook hook, double ms)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (plugin >= m_plugins.size()) {
+        return;
+    }
+
+    Plugin& entry = m_plugins[plugin];
+    Histogram& histogram = entry.hooks[hook];
+    Add(histogram, ms);
+
+    if (m_budgetMs <= 0.0 || ms <= m_budgetMs) {
+        entry.strikes = 0;
+        return;
+    }
+    histogram.overBudget++;
+    if (++entry.strikes < m_strikes || entry.bypassed) {
+        return;
+    }
+
+    entry.bypassed = true;
+    wchar_t notice[256];
+    swprintf(notice, sizeof(notice) / sizeof(notice[0]),
+             L"Plugin %ls bypassed: %d calls in a row over the %.0f ms budget (last %.0f ms)",
+             entry.name.c_str(), entry.strikes, m_budgetMs, ms);
+    m_notices.push_back(notice);
+    Diagnostics::Log(notice);
+}
+
+void PluginMetrics::RecordCache(size_t plugin, bool hit)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (plugin < m_plugins.size()) {
+        (hit ? m_plugins[plugin].cacheHits : m_plugins[plugin].cacheMisses)++;
+    }
+}
+
+void PluginMetrics::RecordPipeline(Hook hook, double ms)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    Add(m_pipelines[hook], ms);
+}
+
+std::vector<std::wstring> PluginMetrics::TakeNotices()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    std::vector<std::wstring> notices;
+    notices.swap(m_notices);
+    return notices;
+}
+
+size_t PluginMetrics::Reenable()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    size_t count = 0;
+    for (Plugin& plugin : m_plugins) {
+        if (plugin.bypassed) {
+            count++;
+        }
+        plugin.bypassed = false;
+        plugin.strikes = 0;
+    }
+    return count;
+}
+
+std::wstring PluginMetrics::Describe() const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    wchar_t line[320];
+    std::wstring text;
+    if (m_budgetMs > 0.0) {
+        swprintf(line, sizeof(line) / sizeof(line[0]), L"budget=%.0f ms, bypass after %d in a row\r\n",
+                 m_budgetMs, m_strikes);
+    } else {
+        swprintf(line, sizeof(line) / sizeof(line[0]), L"budget off\r\n");
+    }
+    text += line;
+
+    for (int hook = 0; hook < HookCount; ++hook) {
+        const Histogram& histogram = m_pipelines[hook];
+        if (histogram.calls == 0) {
+            continue;
+        }
+        swprintf(line, sizeof(line) / sizeof(line[0]),
+                 L"%ls pipeline: runs=%llu p50=%.3f p95=%.3f p99=%.3f max=%.3f ms\r\n",
+                 kHookNames[hook], static_cast<unsigned long long>(histogram.calls),
+                 histogram.PercentileMs(50.0), histogram.PercentileMs(95.0), histogram.PercentileMs(99.0),
+                 histogram.maxMs);
+        text += line;
+    }
+
+    for (const Plugin& plugin : m_plugins) {
+        text += plugin.name + (plugin.bypassed ? L" (bypassed)\r\n" : L"\r\n");
+        for (int hook = 0; hook < HookCount; ++hook) {
+            const Histogram& histogram = plugin.hooks[hook];
+            if (histogram.calls == 0) {
+                continue;
+            }
+            swprintf(line, sizeof(line) / sizeof(line[0]),
+                     L"  %ls: calls=%llu p50=%.3f p95=%.3f p99=%.3f max=%.3f ms over budget=%llu\r\n",
+                     kHookNames[hook], static_cast<unsigned long long>(histogram.calls),
+                     histogram.PercentileMs(50.0), histogram.PercentileMs(95.0), histogram.PercentileMs(99.0),
+                     histogram.maxMs, static_cast<unsigned long long>(histogram.overBudget));
+            text += line;
+        }
+        const uint64_t lookups = plugin.cacheHits + plugin.cacheMisses;
+        if (lookups > 0) {
+            swprintf(line, sizeof(line) / sizeof(line[0]), L"  cache: hits=%llu misses=%llu (%.1f%%)\r\n",
+                     static_cast<unsigned long long>(plugin.cacheHits),
+                     static_cast<unsigned long long>(plugin.cacheMisses), 100.0 * plugin.cacheHits / lookups);
+            text += line;
+        }
+    }
+    return text;
+}
+
+bool PluginMetrics::Save(const std::wstring& path) const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+#ifdef _WIN32
+    std::wofstream file(path, std::ios::out | std::ios::trunc);
+#else
+    std::wofstream file(std::string(path.begin(), path.end()), std::ios::out | std::ios::trunc);
+#endif
+    if (!file.is_open()) {
+        return false;
+    }
+
+    file << L"plugin\thook\tcalls\tp50_ms\tp95_ms\tp99_ms\tmax_ms\tmean_ms\tover_budget\tbypassed\tcache_hits\t"
+         << L"cache_misses\n";
+    for (const Plugin& plugin : m_plugins) {
+        for (int hook = 0; hook < HookCount; ++hook) {
+            const Histogram& histogram = plugin.hooks[hook];
+            if (histogram.calls == 0) {
+                continue;
+            }
+            file << plugin.name << L"\t" << kHookNames[hook] << L"\t" << histogram.calls << L"\t"
+                 << histogram.PercentileMs(50.0) << L"\t" << histogram.PercentileMs(95.0) << L"\t"
+                 << histogram.PercentileMs(99.0) << L"\t" << histogram.maxMs << L"\t"
+                 << histogram.totalMs / histogram.calls << L"\t" << histogram.overBudget << L"\t"
+                 << (plugin.bypassed ? 1 : 0) << L"\t" << plugin.cacheHits << L"\t" << plugin.cacheMisses << L"\n";
+        }
+    }
+    for (int hook = 0; hook < HookCount; ++hook) {
+        const Histogram& histogram = m_pipelines[hook];
+        if (histogram.calls == 0) {
+            continue;
+        }
+        file << L"(pipeline)\t" << kHookNames[hook] << L"\t" << histogram.calls << L"\t"
+             << histogram.PercentileMs(50.0) << L"\t" << histogram.PercentileMs(95.0) << L"\t"
+             << histogram.PercentileMs(99.0) << L"\t" << histogram.maxMs << L"\t"
+             << histogram.totalMs / histogram.calls << L"\t0\t0\t0\t0\n";
+    }
+    return file.good();
+}
+
+void PluginMetrics::Add(Histogram& histogram, double ms)
+{
+    histogram.calls++;
+    histogram.totalMs += ms;
+    histogram.maxMs = (std::max)(histogram.maxMs, ms);
+    histogram.buckets[BucketIndex(ms)]++;
+}
+
+// Upper edge of the bucket holding the percentile, capped at the largest sample
+double PluginMetrics::Histogram::PercentileMs(double percentile) const
+{
+    if (calls == 0) {
+        return 0.0;
+    }
+
+    const uint64_t rank = static_cast<uint64_t>(std::ceil(percentile / 100.0 * calls));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += buckets[i];
+        if (seen >= rank && buckets[i] != 0) {
+            return (std::min)(maxMs, BucketUpperMs(i));
+        }
+    }
+    return maxMs;
+}
+
+int PluginMetrics::BucketIndex(double ms)
+{
+    const double us = ms * 1000.0;
+    if (!(us >= 1.0)) {
+        return 0;
+    }
+
+    // us = mantissa * 2^exponent with mantissa in [0.5, 1)
+    int exponent = 0;
+    const double mantissa = std::frexp(us, &exponent);
+    const int index = exponent * kSubBuckets + static_cast<int>((mantissa - 0.5) * 2.0 * kSubBuckets) -
+                      (kSubBuckets - 1);
+    return (std::min)(kBuckets - 1, (std::max)(0, index));
+}
+
+double PluginMetrics::BucketUpperMs(int index)
+{
+    // Inverse of BucketIndex: the top of the bucket
+    const int shifted = index + kSubBuckets - 1;
+    const int exponent = shifted / kSubBuckets;
+    const int sub = shifted % kSubBuckets;
+    return std::ldexp(0.5 + (sub + 1) / (2.0 * kSubBuckets), exponent) / 1000.0;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Call counts and latency histograms per plugin and hook, and the latency
+// budget: a plugin whose calls run over budget several times in a row is
+// bypassed until Reenable. Histogram buckets are log-spaced, four per power
+// of two from 1 us, so a percentile is within 25% of the exact value. Shared
+// by every PluginHost in a process; thread-safe. Portable.
+class PluginMetrics {
+public:
+    enum Hook { PromptHook, ResponseHook, StreamHook, HookCount };
+
+    PluginMetrics();
+
+    static PluginMetrics& Shared();
+
+    // budgetMs <= 0 turns the budget off
+    void Configure(double budgetMs, int strikes);
+
+    // Id for a plugin; registering a name again returns its earlier id
+    size_t Register(const std::wstring& name);
+
+    bool IsBypassed(size_t plugin) const;
+    void Record(size_t plugin, Hook hook, double ms);
+
+    // A deterministic plugin's result was (hit) or was not found in the cache
+    void RecordCache(size_t plugin, bool hit);
+
+    // End-to-end time of one pass through the prompt or response pipeline,
+    // all plugins included; not subject to the budget
+    void RecordPipeline(Hook hook, double ms);
+
+    // Bypass notices not yet shown, oldest first
+    std::vector<std::wstring> TakeNotices();
+
+    // Calls bypassed plugins again; returns how many were bypassed
+    size_t Reenable();
+
+    std::wstring Describe() const;
+
+    // Tab-separated table, one row per plugin and hook that was called
+    bool Save(const std::wstring& path) const;
+
+private:
+    static constexpr int kSubBuckets = 4;
+    static constexpr int kBuckets = 34 * kSubBuckets;  // Up to 2^34 us, over four hours
+
+    struct Histogram {
+        uint64_t calls;
+        uint64_t overBudget;
+        double totalMs;
+        double maxMs;
+        uint32_t buckets[kBuckets];
+
+        double PercentileMs(double percentile) const;
+    };
+
+    struct Plugin {
+        std::wstring name;
+        Histogram hooks[HookCount];
+        uint64_t cacheHits;
+        uint64_t cacheMisses;
+        int strikes;  // Over-budget calls in a row
+        bool bypassed;
+    };
+
+    static int BucketIndex(double ms);
+    static void Add(Histogram& histogram, double ms);
+    static double BucketUpperMs(int index);
+
+    mutable std::mutex m_lock;
+    std::vector<Plugin> m_plugins;
+    Histogram m_pipelines[HookCount];
+    std::vector<std::wstring> m_notices;
+    double m_budgetMs;
+    int m_strikes;
+};
@@ -0,0 +1,389 @@
+#include "PluginProcess.h"
+#include "Diagnostics.h"
+#include "PluginHost.h"
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+
+namespace {
+    constexpr int kStartupTimeoutMs = 10000;  // Loading plugin DLLs can be slow on a cold start
+    constexpr int kShutdownWaitMs = 500;
+    constexpr unsigned long long kRestartWindowMs = 60 * 1000;
+    constexpr uint64_t kMaxFrameChars = (256u << 20) / sizeof(wchar_t);
+
+    struct FrameHeader {
+        uint32_t op;
+        uint32_t stream;
+        uint64_t chars;
+    };
+
+    const wchar_t* OpName(PluginProcess::Op op)
+    {
+        switch (op) {
+        case PluginProcess::Op::Ready: return L"start";
+        case PluginProcess::Op::TransformPrompt: return L"prompt transform";
+        case PluginProcess::Op::TransformResponse: return L"response transform";
+        case PluginProcess::Op::TransformBatch: return L"batch transform";
+        case PluginProcess::Op::BeginResponse: return L"begin response";
+        case PluginProcess::Op::AppendDelta: return L"response delta";
+        case PluginProcess::Op::FinishResponse: return L"finish response";
+        case PluginProcess::Op::EndResponse: return L"end response";
+        case PluginProcess::Op::DescribePlugins: return L"plugin report";
+        case PluginProcess::Op::TakeNotices: return L"plugin notices";
+        case PluginProcess::Op::ReenablePlugins: return L"re-enable";
+        default: return L"request";
+        }
+    }
+
+    double ElapsedMs(std::chrono::steady_clock::time_point started)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    }
+
+    // What is left of timeoutMs since started; a negative timeout stays infinite
+    int Remaining(int timeoutMs, std::chrono::steady_clock::time_point started)
+    {
+        if (timeoutMs < 0) {
+            return -1;
+        }
+        const double left = timeoutMs - ElapsedMs(started);
+        return left > 0 ? static_cast<int>(left) : 0;
+    }
+
+    bool WriteFrame(SharedChannel& channel, PluginProcess::Op op, uint32_t stream, const std::wstring& text,
+                    int timeoutMs)
+    {
+        const auto started = std::chrono::steady_clock::now();
+        const FrameHeader header = { static_cast<uint32_t>(op), stream, text.length() };
+        return channel.Write(&header, sizeof(header), timeoutMs) &&
+               channel.Write(text.data(), text.length() * sizeof(wchar_t), Remaining(timeoutMs, started));
+    }
+
+    bool ReadFrame(SharedChannel& channel, FrameHeader& header, std::wstring& text, int timeoutMs)
+    {
+        const auto started = std::chrono::steady_clock::now();
+        if (!channel.Read(&header, sizeof(header), timeoutMs) || header.chars > kMaxFrameChars) {
+            return false;
+        }
+        text.resize(static_cast<size_t>(header.chars));
+        return text.empty() || channel.Read(&text[0], text.length() * sizeof(wchar_t), Remaining(timeoutMs, started));
+    }
+}
+
+PluginProcess::PluginProcess(int timeoutMs)
+    : m_timeoutMs(timeoutMs)
+    , m_process(nullptr)
+    , m_ready(false)
+    , m_disabled(false)
+    , m_pluginCount(0)
+    , m_generation(0)
+    , m_nextStream(0)
+    , m_recentLaunches{}
+    , m_calls(0)
+    , m_answered(0)
+    , m_failures(0)
+    , m_timeouts(0)
+    , m_restarts(0)
+    , m_totalCallMs(0.0)
+{
+    Diagnostics::RegisterSection(L"Plugin host", [this] { return Describe(); });
+
+    // Start loading the plugins now; the first call waits for the helper to be ready
+    std::lock_guard<std::mutex> guard(m_lock);
+    Launch();
+}
+
+PluginProcess::~PluginProcess()
+{
+    Diagnostics::RegisterSection(L"Plugin host", [] { return std::wstring(L"stopped\r\n"); });
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    Stop(true);
+}
+
+bool PluginProcess::IsAvailable() const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return !m_disabled;
+}
+
+size_t PluginProcess::PluginCount() const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return m_pluginCount;
+}
+
+uint32_t PluginProcess::NewStreamId()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return ++m_nextStream;
+}
+
+bool PluginProcess::Call(Op op, uint32_t stream, const std::wstring& text, std::wstring& reply,
+                         uint64_t& generation)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (generation != 0 && (!m_ready || generation != m_generation)) {
+        return false;  // The helper that held this stream is gone
+    }
+    if (!EnsureRunning()) {
+        return false;
+    }
+
+    m_calls++;
+    const auto started = std::chrono::steady_clock::now();
+    FrameHeader header = {};
+    if (!WriteFrame(m_channel, op, stream, text, m_timeoutMs) ||
+        !ReadFrame(m_channel, header, m_readBuffer, Remaining(m_timeoutMs, started))) {
+        Fail(L"did not answer", op);
+        return false;
+    }
+    m_answered++;
+    m_totalCallMs += ElapsedMs(started);
+
+    if (header.op != static_cast<uint32_t>(op) || header.stream != stream) {
+        return false;  // Refused (an unknown stream); the helper itself is fine
+    }
+    reply.swap(m_readBuffer);
+    generation = m_generation;
+    return true;
+}
+
+bool PluginProcess::EnsureRunning()
+{
+    if (m_disabled) {
+        return false;
+    }
+    if (!m_process && !Launch()) {
+        return false;
+    }
+    if (m_ready) {
+        return true;
+    }
+
+    FrameHeader header = {};
+    if (!ReadFrame(m_channel, header, m_readBuffer, kStartupTimeoutMs) ||
+        header.op != static_cast<uint32_t>(Op::Ready)) {
+        Fail(L"did not start", Op::Ready);
+        return false;
+    }
+
+    m_ready = true;
+    m_pluginCount = header.stream;
+    wchar_t message[128];
+    swprintf(message, sizeof(message) / sizeof(message[0]), L"plugin host: helper %lu ready with %zu plugin(s)",
+             GetProcessId(m_process), m_pluginCount);
+    Diagnostics::Log(message);
+    return true;
+}
+
+bool PluginProcess::Launch()
+{
+    // A helper that keeps dying is given up on rather than restarted forever
+    const unsigned long long now = GetTickCount64();
+    const size_t slots = sizeof(m_recentLaunches) / sizeof(m_recentLaunches[0]);
+    if (m_recentLaunches[0] != 0 && now - m_recentLaunches[0] < kRestartWindowMs) {
+        m_disabled = true;
+        Diagnostics::Log(L"plugin host: helper failed repeatedly; plugins are bypassed until restart");
+        return false;
+    }
+    for (size_t i = 1; i < slots; ++i) {
+        m_recentLaunches[i - 1] = m_recentLaunches[i];
+    }
+    m_recentLaunches[slots - 1] = now;
+
+    if (++m_generation > 1) {
+        m_restarts++;
+    }
+
+    char channelName[64];
+    snprintf(channelName, sizeof(channelName), "PilotLight-plugins-%lu-%llu", GetCurrentProcessId(),
+             static_cast<unsigned long long>(m_generation));
+    if (!m_channel.Create(channelName)) {
+        Diagnostics::Log(L"plugin host: could not create the shared channel");
+        return false;
+    }
+
+    wchar_t exePath[MAX_PATH] = { 0 };
+    GetModuleFileNameW(nullptr, exePath, MAX_PATH);
+    wchar_t arguments[128];
+    swprintf(arguments, sizeof(arguments) / sizeof(arguments[0]), L" --plugin-host %hs %lu", channelName,
+             GetCurrentProcessId());
+    std::wstring commandLine = L"\"" + std::wstring(exePath) + L"\"" + arguments;
+
+    STARTUPINFOW startup = {};
+    startup.cb = sizeof(startup);
+    PROCESS_INFORMATION info = {};
+    if (!CreateProcessW(nullptr, &commandLine[0], nullptr, nullptr, FALSE, CREATE_NO_WINDOW, nullptr, nullptr,
+                        &startup, &info)) {
+        Diagnostics::Log(L"plugin host: could not start the helper process");
+        m_channel.Close();
+        return false;
+    }
+    CloseHandle(info.hThread);
+
+    m_process = info.hProcess;
+    m_ready = false;
+    const HANDLE process = m_process;
+    m_channel.SetPeerCheck([process] { return WaitForSingleObject(process, 0) == WAIT_TIMEOUT; });
+    return true;
+}
+
+void PluginProcess::Stop(bool graceful)
+{
+    if (!m_process) {
+        return;
+    }
+
+    if (graceful && m_ready) {
+        WriteFrame(m_channel, Op::Shutdown, 0, std::wstring(), kShutdownWaitMs);
+        WaitForSingleObject(m_process, kShutdownWaitMs);
+    }
+    if (WaitForSingleObject(m_process, 0) == WAIT_TIMEOUT) {
+        TerminateProcess(m_process, 1);
+        WaitForSingleObject(m_process, kShutdownWaitMs);
+    }
+
+    CloseHandle(m_process);
+    m_process = nullptr;
+    m_ready = false;
+    m_pluginCount = 0;
+    m_channel.SetPeerCheck(nullptr);
+    m_channel.Close();
+}
+
+// The channel is out of step after a failed transfer, so the helper is
+// replaced; the next call starts a new one
+void PluginProcess::Fail(const wchar_t* what, Op op)
+{
+    m_failures++;
+    DWORD exitCode = STILL_ACTIVE;
+    GetExitCodeProcess(m_process, &exitCode);
+
+    wchar_t message[160];
+    if (exitCode == STILL_ACTIVE) {
+        m_timeouts++;
+        swprintf(message, sizeof(message) / sizeof(message[0]), L"plugin host: %ls %ls within %d ms; restarting",
+                 OpName(op), what, op == Op::Ready ? kStartupTimeoutMs : m_timeoutMs);
+    } else {
+        swprintf(message, sizeof(message) / sizeof(message[0]),
+                 L"plugin host: helper exited with 0x%08lX during %ls; restarting", exitCode, OpName(op));
+    }
+    Diagnostics::Log(message);
+    Stop(false);
+}
+
+int PluginProcess::RunHelper(const std::wstring& channelName, DWORD parentProcessId)
+{
+    HANDLE parent = OpenProcess(SYNCHRONIZE, FALSE, parentProcessId);
+    if (!parent) {
+        return 1;
+    }
+
+    SharedChannel channel;
+    if (!channel.Open(std::string(channelName.begin(), channelName.end()))) {
+        CloseHandle(parent);
+        return 1;
+    }
+    // Requests can be minutes apart; the only reason to stop waiting is a dead parent
+    channel.SetPeerCheck([parent] { return WaitForSingleObject(parent, 0) == WAIT_TIMEOUT; });
+
+    PluginHost host(false);
+    std::map<uint32_t, std::unique_ptr<PluginHost::ResponseStream>> streams;
+    FrameHeader request = {};
+    std::wstring text;
+    std::wstring reply;
+    bool running = WriteFrame(channel, Op::Ready, static_cast<uint32_t>(host.LoadedPluginCount()), reply, -1);
+
+    while (running && ReadFrame(channel, request, text, -1)) {
+        const Op op = static_cast<Op>(request.op);
+        Op status = op;
+        reply.clear();
+
+        switch (op) {
+        case Op::TransformPrompt:
+            reply = host.ApplyUserMessageTransforms(text);
+            break;
+        case Op::TransformResponse:
+            reply = host.ApplyAssistantResponseTransforms(text);
+            break;
+        case Op::TransformBatch: {
+            std::vector<PluginHost::BatchMessage> messages;
+            if (!PluginHost::DecodeBatch(text, messages)) {
+                status = Op::Failed;
+                break;
+            }
+            host.ApplyTransformsBatch(messages);
+            reply = PluginHost::EncodeBatch(messages, 0, messages.size());
+            break;
+        }
+        case Op::BeginResponse:
+            streams[request.stream].reset(new PluginHost::ResponseStream(host));
+            break;
+        case Op::AppendDelta:
+        case Op::FinishResponse: {
+            const auto found = streams.find(request.stream);
+            if (found == streams.end()) {
+                status = Op::Failed;
+            } else if (op == Op::AppendDelta) {
+                reply = found->second->Append(text);
+            } else {
+                reply = found->second->Finish(text);
+                streams.erase(found);
+            }
+            break;
+        }
+        case Op::EndResponse:
+            streams.erase(request.stream);
+            break;
+        case Op::DescribePlugins:
+            reply = host.DescribePlugins();
+            break;
+        case Op::TakeNotices:
+            for (const std::wstring& notice : host.TakeNotices()) {
+                reply += (reply.empty() ? L"" : L"\n") + notice;
+            }
+            break;
+        case Op::ReenablePlugins:
+            reply = std::to_wstring(host.ReenablePlugins());
+            break;
+        case Op::Shutdown:
+            running = false;
+            continue;
+        default:
+            status = Op::Failed;
+            break;
+        }
+
+        running = WriteFrame(channel, status, request.stream, reply, -1);
+    }
+
+    streams.clear();
+    CloseHandle(parent);
+    return 0;
+}
+
+std::wstring PluginProcess::Describe() const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    wchar_t text[384];
+    const wchar_t* state = m_disabled ? L"disabled after repeated failures"
+                         : m_ready    ? L"running"
+                         : m_process  ? L"starting"
+                                      : L"stopped";
+    const double average = m_answered > 0 ? m_totalCallMs * 1000.0 / m_answered : 0.0;
+    swprintf(text, sizeof(text) / sizeof(text[0]),
+             L"%ls, pid=%lu plugins=%zu timeout=%d ms\r\n"
+             L"calls=%llu failures=%llu timeouts=%llu restarts=%llu avg round trip=%.1f us\r\n"
+             L"channel sleeps=%llu doorbells=%llu\r\n",
+             state, m_process ? GetProcessId(m_process) : 0ul, m_pluginCount, m_timeoutMs,
+             static_cast<unsigned long long>(m_calls),
+             static_cast<unsigned long long>(m_failures),
+             static_cast<unsigned long long>(m_timeouts),
+             static_cast<unsigned long long>(m_restarts),
+             average,
+             static_cast<unsigned long long>(m_channel.Sleeps()),
+             static_cast<unsigned long long>(m_channel.Rings()));
+    return text;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <windows.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "SharedChannel.h"
+
+// Runs the plugins in a helper process (this executable started with
+// --plugin-host) so a plugin that crashes or hangs cannot take PilotLight down
+// or stall a send. Requests and replies cross a SharedChannel. A call that
+// fails or outlives its timeout kills the helper and reports failure, and the
+// caller passes the text through unchanged; the next call starts a new
+// helper. Calls from different threads are serialized.
+class PluginProcess {
+public:
+    enum class Op : uint32_t {
+        Failed = 0,         // Reply: the helper could not serve the request
+        Ready,              // Helper -> host once the plugins are loaded; stream = plugin count
+        TransformPrompt,    // Text -> transformed prompt
+        TransformResponse,  // Whole reply -> transformed reply
+        TransformBatch,     // PluginHost::EncodeBatch messages -> the same, transformed
+        BeginResponse,      // Opens stream
+        AppendDelta,        // Delta -> text to show
+        FinishResponse,     // Whole reply -> final text; closes stream
+        EndResponse,        // Drops stream
+        DescribePlugins,    // -> plugin latency report
+        TakeNotices,        // -> bypass notices, one per line
+        ReenablePlugins,    // -> number of plugins that were bypassed
+        Shutdown            // No reply
+    };
+
+    explicit PluginProcess(int timeoutMs);
+    ~PluginProcess();
+    PluginProcess(const PluginProcess&) = delete;
+    PluginProcess& operator=(const PluginProcess&) = delete;
+
+    // False once the helper failed to start too often; callers then pass text through
+    bool IsAvailable() const;
+    size_t PluginCount() const;
+
+    // One request/reply. generation ties a response stream to the helper that
+    // opened it: pass 0 to accept any helper (it is set to the one that
+    // answered); a call for a helper that has since been restarted fails.
+    bool Call(Op op, uint32_t stream, const std::wstring& text, std::wstring& reply, uint64_t& generation);
+    uint32_t NewStreamId();
+
+    // Entry point of the helper process; returns its exit code
+    static int RunHelper(const std::wstring& channelName, DWORD parentProcessId);
+
+    std::wstring Describe() const;
+
+private:
+    bool EnsureRunning();
+    bool Launch();
+    void Stop(bool graceful);
+    void Fail(const wchar_t* what, Op op);
+
+    mutable std::mutex m_lock;
+    const int m_timeoutMs;
+    SharedChannel m_channel;
+    HANDLE m_process;
+    bool m_ready;
+    bool m_disabled;
+    size_t m_pluginCount;
+    uint64_t m_generation;
+    uint32_t m_nextStream;
+    std::wstring m_readBuffer;
+    unsigned long long m_recentLaunches[4];  // Tick counts of the latest launches, for the restart limit
+
+    uint64_t m_calls;
+    uint64_t m_answered;
+    uint64_t m_failures;
+    uint64_t m_timeouts;
+    uint64_t m_restarts;
+    double m_totalCallMs;
+};
@@ -0,0 +1,146 @@
+#include "PluginSchedule.h"
+#include <algorithm>
+#include <cwctype>
+
+namespace {
+    bool SameName(const std::wstring& a, const std::wstring& b)
+    {
+        return a.length() == b.length() &&
+            std::equal(a.begin(), a.end(), b.begin(), [](wchar_t x, wchar_t y) { return towlower(x) == towlower(y); });
+    }
+
+    size_t FindNode(const std::vector<PluginSchedule::Node>& nodes, const std::wstring& name)
+    {
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (SameName(nodes[i].name, name)) {
+                return i;
+            }
+        }
+        return nodes.size();
+    }
+
+    // True if start leads back to itself through nodes not yet done
+    bool OnCycle(const std::vector<std::vector<size_t>>& successors, const std::vector<bool>& done, size_t start)
+    {
+        std::vector<bool> seen(successors.size(), false);
+        std::vector<size_t> stack(1, start);
+        while (!stack.empty()) {
+            const size_t node = stack.back();
+            stack.pop_back();
+            for (size_t next : successors[node]) {
+                if (next == start) {
+                    return true;
+                }
+                if (!done[next] && !seen[next]) {
+                    seen[next] = true;
+                    stack.push_back(next);
+                }
+            }
+        }
+        return false;
+    }
+}
+
+// Topological order that prefers the lowest discovery index among the ready
+// nodes, so declarations only move the plugins they name
+std::vector<PluginSchedule::Step> PluginSchedule::Build(const std::vector<Node>& nodes, size_t* brokenCycles)
+{
+    const size_t count = nodes.size();
+    std::vector<std::vector<size_t>> successors(count);
+    std::vector<size_t> waitingFor(count, 0);
+    const auto addEdge = [&](size_t from, size_t to) {
+        if (from == count || to == count || from == to ||
+            std::find(successors[from].begin(), successors[from].end(), to) != successors[from].end()) {
+            return;
+        }
+        successors[from].push_back(to);
+        waitingFor[to]++;
+    };
+    for (size_t i = 0; i < count; ++i) {
+        for (const std::wstring& name : nodes[i].runsAfter) {
+            addEdge(FindNode(nodes, name), i);
+        }
+        for (const std::wstring& name : nodes[i].runsBefore) {
+            addEdge(i, FindNode(nodes, name));
+        }
+    }
+
+    std::vector<Step> steps;
+    std::vector<bool> done(count, false);
+    std::vector<size_t> ready;
+    size_t remaining = count;
+    size_t broken = 0;
+    while (remaining > 0) {
+        ready.clear();
+        for (size_t i = 0; i < count; ++i) {
+            if (!done[i] && waitingFor[i] == 0) {
+                ready.push_back(i);
+            }
+        }
+        if (ready.empty()) {
+            // Nodes that only wait on a cycle keep their order after it
+            size_t first = 0;
+            while (done[first] || !OnCycle(successors, done, first)) {
+                ++first;
+            }
+            waitingFor[first] = 0;
+            ready.push_back(first);
+            broken++;
+        }
+
+        // An analyzer joins the step unless a ready mutator was found before it
+        Step step;
+        step.analyzers = nodes[ready[0]].analyzer;
+        if (step.analyzers) {
+            for (size_t i : ready) {
+                if (!nodes[i].analyzer) {
+                    break;
+                }
+                step.nodes.push_back(i);
+            }
+        } else {
+            step.nodes.push_back(ready[0]);
+        }
+
+        for (size_t i : step.nodes) {
+            done[i] = true;
+            remaining--;
+            for (size_t next : successors[i]) {
+                if (waitingFor[next] > 0) {
+                    waitingFor[next]--;
+                }
+            }
+        }
+        steps.push_back(std::move(step));
+    }
+
+    if (brokenCycles) {
+        *brokenCycles = broken;
+    }
+    return steps;
+}
+
+std::vector<std::wstring> PluginSchedule::SplitNames(const std::wstring& list)
+{
+    std::vector<std::wstring> names;
+    size_t start = 0;
+    while (start <= list.length()) {
+        size_t end = list.find(L';', start);
+        if (end == std::wstring::npos) {
+            end = list.length();
+        }
+        size_t first = start;
+        size_t last = end;
+        while (first < last && iswspace(list[first])) {
+            ++first;
+        }
+        while (last > first && iswspace(list[last - 1])) {
+            --last;
+        }
+        if (last > first) {
+            names.push_back(list.substr(first, last - first));
+        }
+        start = end + 1;
+    }
+    return names;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Order of one plugin pipeline (prompt or whole response). A node runs after
+// the nodes named in its runsAfter list and before those in runsBefore;
+// nodes not ordered that way keep discovery order. Analyzers only read the
+// text, so analyzers that are ready together form one step and can run in
+// parallel; a mutator is a step of its own. Names match case-insensitively
+// and unknown names are ignored. A cycle is broken at its first node in
+// discovery order. Portable.
+class PluginSchedule {
+public:
+    struct Node {
+        std::wstring name;
+        bool analyzer;
+        std::vector<std::wstring> runsAfter;
+        std::vector<std::wstring> runsBefore;
+    };
+
+    struct Step {
+        std::vector<size_t> nodes;  // Node indexes, ascending
+        bool analyzers;
+    };
+
+    // Steps covering every node once; brokenCycles (if given) counts the
+    // nodes run before a dependency because of a cycle
+    static std::vector<Step> Build(const std::vector<Node>& nodes, size_t* brokenCycles = nullptr);
+
+    // Names from a ';'-separated list, with surrounding spaces removed
+    static std::vector<std::wstring> SplitNames(const std::wstring& list);
+};
@@ -0,0 +1,383 @@
+#include "RateLimiter.h"
+#include "Diagnostics.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cwctype>
+
+namespace {
+    constexpr double kSecondsPerMinute = 60.0;
+    constexpr double kBackgroundReserve = 0.1;  // Share of each bucket background work must leave free
+    constexpr double kInitialCompletionTokens = 256.0;
+    constexpr double kCompletionAlpha = 0.2;
+    constexpr double kCancelPollSeconds = 0.05;
+}
+
+bool RateLimitHint::Empty() const
+{
+    return limitRequests < 0 && limitTokens < 0 && remainingRequests < 0 && remainingTokens < 0 &&
+           resetRequestsSeconds < 0 && resetTokensSeconds < 0 && retryAfterSeconds < 0;
+}
+
+double RateLimitHint::ParseDuration(const std::wstring& text)
+{
+    double total = 0.0;
+    bool parsed = false;
+    size_t i = 0;
+    while (i < text.length()) {
+        if (std::iswspace(text[i])) {
+            ++i;
+            continue;
+        }
+
+        size_t used = 0;
+        double value = 0.0;
+        try {
+            value = std::stod(text.substr(i), &used);
+        } catch (...) {
+            return -1.0;
+        }
+        i += used;
+
+        std::wstring unit;
+        while (i < text.length() && std::iswalpha(text[i])) {
+            unit += text[i++];
+        }
+
+        if (unit == L"ms") {
+            total += value / 1000.0;
+        } else if (unit == L"s" || unit.empty()) {
+            total += value;  // Bare numbers are seconds, as in retry-after
+        } else if (unit == L"m") {
+            total += value * 60.0;
+        } else if (unit == L"h") {
+            total += value * 3600.0;
+        } else {
+            return -1.0;
+        }
+        parsed = true;
+    }
+    return parsed ? total : -1.0;
+}
+
+void RateScheduler::Bucket::SetCapacity(double perMinute, double now)
+{
+    Refill(now);
+    if (perMinute > 0.0 && capacity <= 0.0) {
+        level = perMinute;  // Newly limited buckets start full
+    } else {
+        level = (std::min)(level, perMinute);
+    }
+    capacity = (std::max)(0.0, perMinute);
+}
+
+void RateScheduler::Bucket::Refill(double now)
+{
+    if (capacity > 0.0 && now > updated) {
+        level = (std::min)(capacity, level + (now - updated) * capacity / kSecondsPerMinute);
+    }
+    updated = (std::max)(updated, now);
+}
+
+double RateScheduler::Bucket::SecondsUntil(double amount, double now)
+{
+    Refill(now);
+    if (capacity <= 0.0 || level >= amount) {
+        return 0.0;
+    }
+    return (amount - level) * kSecondsPerMinute / capacity;
+}
+
+RateScheduler::RateScheduler()
+    : m_blockedUntil(0.0)
+    , m_nextTicket(1)
+    , m_completionEstimate(kInitialCompletionTokens)
+    , m_granted{ 0, 0 }
+    , m_hintsApplied(0)
+    , m_throttled(0)
+    , m_tokensRefunded(0)
+    , m_tokensCharged(0)
+{
+}
+
+void RateScheduler::Configure(double requestsPerMinute, double tokensPerMinute, double now)
+{
+    if (m_requests.configured != requestsPerMinute) {
+        m_requests.configured = requestsPerMinute;
+        m_requests.SetCapacity(requestsPerMinute, now);
+    }
+    if (m_tokens.configured != tokensPerMinute) {
+        m_tokens.configured = tokensPerMinute;
+        m_tokens.SetCapacity(tokensPerMinute, now);
+    }
+}
+
+RateScheduler::Ticket RateScheduler::Submit(Priority priority, uint64_t estimatedTokens)
+{
+    const Ticket ticket = m_nextTicket++;
+    m_queues[static_cast<int>(priority)].push_back(Waiter{ ticket, static_cast<double>(estimatedTokens) });
+    return ticket;
+}
+
+bool RateScheduler::IsNext(Ticket ticket) const
+{
+    Priority priority;
+    const Waiter* head = Head(priority);
+    return head && head->ticket == ticket;
+}
+
+bool RateScheduler::TryGrant(Ticket ticket, double now)
+{
+    Priority priority;
+    const Waiter* head = Head(priority);
+    if (!head || head->ticket != ticket || WaitHint(now) > 0.0) {
+        return false;
+    }
+
+    if (m_requests.capacity > 0.0) {
+        m_requests.level -= 1.0;
+    }
+    if (m_tokens.capacity > 0.0) {
+        m_tokens.level -= (std::min)(head->cost, m_tokens.capacity);
+    }
+    m_granted[static_cast<int>(priority)]++;
+    m_queues[static_cast<int>(priority)].pop_front();
+    return true;
+}
+
+void RateScheduler::Cancel(Ticket ticket)
+{
+    for (auto& queue : m_queues) {
+        auto it = std::find_if(queue.begin(), queue.end(), [ticket](const Waiter& waiter) {
+            return waiter.ticket == ticket;
+        });
+        if (it != queue.end()) {
+            queue.erase(it);
+            return;
+        }
+    }
+}
+
+double RateScheduler::WaitHint(double now)
+{
+    Priority priority;
+    const Waiter* head = Head(priority);
+    if (!head) {
+        return 0.0;
+    }
+
+    double wait = (std::max)(0.0, m_blockedUntil - now);
+
+    const double requestNeed = (std::min)(1.0 + ReserveFor(priority, m_requests), m_requests.capacity);
+    wait = (std::max)(wait, m_requests.SecondsUntil(requestNeed, now));
+
+    // A request larger than the whole bucket waits for a full bucket rather than forever
+    const double tokenNeed = (std::min)(head->cost + ReserveFor(priority, m_tokens), m_tokens.capacity);
+    wait = (std::max)(wait, m_tokens.SecondsUntil(tokenNeed, now));
+    return wait;
+}
+
+void RateScheduler::Complete(uint64_t estimatedTokens, uint64_t actualTokens, uint64_t completionTokens)
+{
+    if (actualTokens < estimatedTokens) {
+        m_tokensRefunded += estimatedTokens - actualTokens;
+    } else {
+        m_tokensCharged += actualTokens - estimatedTokens;
+    }
+
+    if (m_tokens.capacity > 0.0) {
+        const double delta = static_cast<double>(estimatedTokens) - static_cast<double>(actualTokens);
+        m_tokens.level = (std::min)(m_tokens.capacity, m_tokens.level + delta);
+    }
+
+    if (completionTokens > 0) {
+        m_completionEstimate += kCompletionAlpha * (static_cast<double>(completionTokens) - m_completionEstimate);
+    }
+}
+
+void RateScheduler::ApplyHint(const RateLimitHint& hint, double now)
+{
+    if (hint.Empty()) {
+        return;
+    }
+    m_hintsApplied++;
+
+    // Server limits only replace the local ones when settings leave them unset
+    if (m_requests.configured <= 0.0 && hint.limitRequests > 0.0 && hint.limitRequests != m_requests.capacity) {
+        m_requests.SetCapacity(hint.limitRequests, now);
+    }
+    if (m_tokens.configured <= 0.0 && hint.limitTokens > 0.0 && hint.limitTokens != m_tokens.capacity) {
+        m_tokens.SetCapacity(hint.limitTokens, now);
+    }
+
+    // Other clients share the quota, so the server's remaining count is authoritative
+    if (hint.remainingRequests >= 0.0 && m_requests.capacity > 0.0) {
+        m_requests.Refill(now);
+        m_requests.level = (std::min)(m_requests.level, hint.remainingRequests);
+    }
+    if (hint.remainingTokens >= 0.0 && m_tokens.capacity > 0.0) {
+        m_tokens.Refill(now);
+        m_tokens.level = (std::min)(m_tokens.level, hint.remainingTokens);
+    }
+
+    if (hint.remainingRequests == 0.0 && hint.resetRequestsSeconds > 0.0) {
+        m_blockedUntil = (std::max)(m_blockedUntil, now + hint.resetRequestsSeconds);
+    }
+    if (hint.remainingTokens == 0.0 && hint.resetTokensSeconds > 0.0) {
+        m_blockedUntil = (std::max)(m_blockedUntil, now + hint.resetTokensSeconds);
+    }
+    if (hint.retryAfterSeconds >= 0.0) {
+        m_throttled++;
+        m_blockedUntil = (std::max)(m_blockedUntil, now + hint.retryAfterSeconds);
+    }
+}
+
+uint64_t RateScheduler::EstimateCompletionTokens() const
+{
+    return static_cast<uint64_t>(m_completionEstimate + 0.5);
+}
+
+size_t RateScheduler::QueueDepth(Priority priority) const
+{
+    return m_queues[static_cast<int>(priority)].size();
+}
+
+std::wstring RateScheduler::Describe() const
+{
+    wchar_t text[512];
+    swprintf(text, sizeof(text) / sizeof(text[0]),
+             L"requests/min=%.0f (level %.1f) tokens/min=%.0f (level %.0f)\r\n"
+             L"granted interactive=%llu background=%llu queued interactive=%zu background=%zu\r\n"
+             L"server hints=%llu throttled=%llu refunded tokens=%llu extra tokens=%llu completion estimate=%.0f\r\n",
+             m_requests.capacity, m_requests.level, m_tokens.capacity, m_tokens.level,
+             static_cast<unsigned long long>(m_granted[0]), static_cast<unsigned long long>(m_granted[1]),
+             m_queues[0].size(), m_queues[1].size(),
+             static_cast<unsigned long long>(m_hintsApplied), static_cast<unsigned long long>(m_throttled),
+             static_cast<unsigned long long>(m_tokensRefunded), static_cast<unsigned long long>(m_tokensCharged),
+             m_completionEstimate);
+    return text;
+}
+
+const RateScheduler::Waiter* RateScheduler::Head(Priority& priority) const
+{
+    if (!m_queues[0].empty()) {
+        priority = Priority::Interactive;
+        return &m_queues[0].front();
+    }
+    if (!m_queues[1].empty()) {
+        priority = Priority::Background;
+        return &m_queues[1].front();
+    }
+    return nullptr;
+}
+
+double RateScheduler::ReserveFor(Priority priority, const Bucket& bucket) const
+{
+    return priority == Priority::Background ? kBackgroundReserve * bucket.capacity : 0.0;
+}
+
+RateLimiter::RateLimiter()
+    : m_waits(0)
+    , m_timeouts(0)
+    , m_totalWaitSeconds(0.0)
+    , m_maxWaitSeconds(0.0)
+{
+}
+
+RateLimiter& RateLimiter::Shared()
+{
+    static RateLimiter limiter;
+    static const bool registered = [] {
+        Diagnostics::RegisterSection(L"Rate limiter", [] { return limiter.Describe(); });
+        return true;
+    }();
+    (void)registered;
+    return limiter;
+}
+
+void RateLimiter::Configure(double requestsPerMinute, double tokensPerMinute)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_scheduler.Configure(requestsPerMinute, tokensPerMinute, Now());
+    m_changed.notify_all();
+}
+
+bool RateLimiter::Acquire(Priority priority, uint64_t estimatedTokens, double timeoutSeconds,
+                          const std::function<bool()>& cancelled)
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    const double start = Now();
+    const RateScheduler::Ticket ticket = m_scheduler.Submit(priority, estimatedTokens);
+
+    for (;;) {
+        const double now = Now();
+        if (m_scheduler.TryGrant(ticket, now)) {
+            const double waited = now - start;
+            if (waited > 0.0) {
+                m_waits++;
+                m_totalWaitSeconds += waited;
+                m_maxWaitSeconds = (std::max)(m_maxWaitSeconds, waited);
+            }
+            if (waited >= 1.0) {
+                Diagnostics::Log(L"rate limit: request waited " + std::to_wstring(static_cast<int>(waited * 1000)) + L"ms");
+            }
+            m_changed.notify_all();
+            return true;
+        }
+
+        const double remaining = timeoutSeconds - (now - start);
+        if (remaining <= 0.0 || (cancelled && cancelled())) {
+            m_scheduler.Cancel(ticket);
+            m_timeouts += remaining <= 0.0 ? 1 : 0;
+            m_changed.notify_all();
+            return false;
+        }
+
+        // Only the head sleeps on the bucket; everyone else waits to move up the queue
+        double sleep = remaining;
+        if (m_scheduler.IsNext(ticket)) {
+            sleep = (std::min)(remaining, m_scheduler.WaitHint(now));
+        }
+        if (cancelled) {
+            sleep = (std::min)(sleep, kCancelPollSeconds);
+        }
+        m_changed.wait_for(lock, std::chrono::duration<double>(sleep));
+    }
+}
+
+void RateLimiter::Complete(uint64_t estimatedTokens, uint64_t actualTokens, uint64_t completionTokens)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_scheduler.Complete(estimatedTokens, actualTokens, completionTokens);
+    m_changed.notify_all();
+}
+
+void RateLimiter::ApplyHint(const RateLimitHint& hint)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_scheduler.ApplyHint(hint, Now());
+    m_changed.notify_all();
+}
+
+uint64_t RateLimiter::EstimateCompletionTokens()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return m_scheduler.EstimateCompletionTokens();
+}
+
+std::wstring RateLimiter::Describe()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    wchar_t text[160];
+    swprintf(text, sizeof(text) / sizeof(text[0]),
+             L"waits=%llu avg wait=%.2fs max wait=%.2fs timeouts=%llu\r\n",
+             static_cast<unsigned long long>(m_waits),
+             m_waits ? m_totalWaitSeconds / m_waits : 0.0, m_maxWaitSeconds,
+             static_cast<unsigned long long>(m_timeouts));
+    return m_scheduler.Describe() + text;
+}
+
+double RateLimiter::Now() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+// Limits reported by the server in x-ratelimit-* / retry-after headers.
+// Negative values mean the header was absent.
+struct RateLimitHint {
+    double limitRequests = -1.0;
+    double limitTokens = -1.0;
+    double remainingRequests = -1.0;
+    double remainingTokens = -1.0;
+    double resetRequestsSeconds = -1.0;
+    double resetTokensSeconds = -1.0;
+    double retryAfterSeconds = -1.0;
+
+    bool Empty() const;
+
+    // Accepts OpenAI-style durations such as "20ms", "1s", "6m0s" or "1h2m3.5s"
+    static double ParseDuration(const std::wstring& text);
+};
+
+// Token-bucket admission for requests-per-minute and tokens-per-minute quotas
+// with two FIFO priority classes. Every call takes the current time explicitly
+// (seconds on any monotonic clock), so the scheduler itself is deterministic
+// and can be driven by a simulated clock. Not thread safe; see RateLimiter.
+class RateScheduler {
+public:
+    enum class Priority { Interactive, Background };
+    typedef uint64_t Ticket;
+
+    RateScheduler();
+
+    // Zero leaves the limit to be learned from server hints
+    void Configure(double requestsPerMinute, double tokensPerMinute, double now);
+
+    Ticket Submit(Priority priority, uint64_t estimatedTokens);
+    bool IsNext(Ticket ticket) const;
+    // Admits and charges the ticket if it is next in line and both buckets allow it
+    bool TryGrant(Ticket ticket, double now);
+    void Cancel(Ticket ticket);
+    // Seconds until the head of the queue could be admitted; 0 if it can go now
+    double WaitHint(double now);
+
+    // Refunds or charges the difference between the estimate and real usage
+    void Complete(uint64_t estimatedTokens, uint64_t actualTokens, uint64_t completionTokens);
+    void ApplyHint(const RateLimitHint& hint, double now);
+
+    uint64_t EstimateCompletionTokens() const;
+    size_t QueueDepth(Priority priority) const;
+
+    std::wstring Describe() const;
+
+private:
+    struct Bucket {
+        double configured = 0.0;  // Per-minute limit from settings, 0 = unset
+        double capacity = 0.0;    // Effective per-minute limit, 0 = unlimited
+        double level = 0.0;
+        double updated = 0.0;
+
+        void SetCapacity(double perMinute, double now);
+        void Refill(double now);
+        double SecondsUntil(double amount, double now);
+    };
+
+    struct Waiter {
+        Ticket ticket;
+        double cost;
+    };
+
+    const Waiter* Head(Priority& priority) const;
+    double ReserveFor(Priority priority, const Bucket& bucket) const;
+
+    Bucket m_requests;
+    Bucket m_tokens;
+    double m_blockedUntil;
+    std::deque<Waiter> m_queues[2];
+    Ticket m_nextTicket;
+    double m_completionEstimate;
+
+    uint64_t m_granted[2];
+    uint64_t m_hintsApplied;
+    uint64_t m_throttled;
+    uint64_t m_tokensRefunded;
+    uint64_t m_tokensCharged;
+};
+
+// Process-wide blocking front end for RateScheduler on the steady clock
+class RateLimiter {
+public:
+    typedef RateScheduler::Priority Priority;
+
+    RateLimiter();
+
+    static RateLimiter& Shared();
+
+    void Configure(double requestsPerMinute, double tokensPerMinute);
+
+    // Blocks until admitted; false if the wait would exceed timeoutSeconds or
+    // cancelled (polled while waiting) returns true
+    bool Acquire(Priority priority, uint64_t estimatedTokens, double timeoutSeconds,
+                 const std::function<bool()>& cancelled = nullptr);
+    void Complete(uint64_t estimatedTokens, uint64_t actualTokens, uint64_t completionTokens);
+    void ApplyHint(const RateLimitHint& hint);
+
+    uint64_t EstimateCompletionTokens();
+
+    std::wstring Describe();
+
+private:
+    double Now() const;
+
+    mutable std::mutex m_lock;
+    std::condition_variable m_changed;
+    RateScheduler m_scheduler;
+    uint64_t m_waits;
+    uint64_t m_timeouts;
+    double m_totalWaitSeconds;
+    double m_maxWaitSeconds;
+};
@@ -0,0 +1,144 @@
+#include "RenderCache.h"
+#include "Diagnostics.h"
+#include <cwchar>
+
+namespace {
+    constexpr uint64_t kEntryOverheadBytes = 96;  // List node, map slot and key
+}
+
+RenderCache::RenderCache()
+    : m_totalBytes(0)
+    , m_maxBytes(16ULL * 1024 * 1024)
+    , m_rtfHits(0)
+    , m_rtfMisses(0)
+    , m_heightHits(0)
+    , m_heightMisses(0)
+    , m_evictions(0)
+{
+}
+
+RenderCache& RenderCache::Shared()
+{
+    static RenderCache cache;
+    static const bool registered = [] {
+        Diagnostics::RegisterSection(L"Render cache", [] { return cache.Describe(); });
+        return true;
+    }();
+    (void)registered;
+    return cache;
+}
+
+void RenderCache::Configure(uint64_t maxBytes)
+{
+    m_maxBytes = maxBytes;
+    EvictToLimit();
+}
+
+const std::string* RenderCache::FindRtf(const Hash::Digest& content, uint32_t themeVersion)
+{
+    const EntryIterator it = Find(Key{ content, themeVersion });
+    if (it == m_lru.end() || it->rtf.empty()) {
+        ++m_rtfMisses;
+        return nullptr;
+    }
+    ++m_rtfHits;
+    return &it->rtf;
+}
+
+void RenderCache::StoreRtf(const Hash::Digest& content, uint32_t themeVersion, const std::string& rtf)
+{
+    if (m_maxBytes == 0 || rtf.size() + kEntryOverheadBytes > m_maxBytes) {
+        return;
+    }
+    const EntryIterator it = FindOrAdd(Key{ content, themeVersion });
+    m_totalBytes -= EntryBytes(*it);
+    it->rtf = rtf;
+    m_totalBytes += EntryBytes(*it);
+    EvictToLimit();
+}
+
+int RenderCache::FindHeight(const Hash::Digest& content, uint32_t themeVersion, int wrapWidth)
+{
+    const EntryIterator it = Find(Key{ content, themeVersion });
+    if (it == m_lru.end() || it->height < 0 || it->wrapWidth != wrapWidth) {
+        ++m_heightMisses;
+        return -1;
+    }
+    ++m_heightHits;
+    return it->height;
+}
+
+void RenderCache::StoreHeight(const Hash::Digest& content, uint32_t themeVersion, int wrapWidth, int height)
+{
+    if (m_maxBytes == 0) {
+        return;
+    }
+    // Only the latest width is kept; resizing back and forth re-measures the loaded window anyway
+    const EntryIterator it = FindOrAdd(Key{ content, themeVersion });
+    it->wrapWidth = wrapWidth;
+    it->height = height;
+    EvictToLimit();
+}
+
+void RenderCache::Clear()
+{
+    m_lru.clear();
+    m_entries.clear();
+    m_totalBytes = 0;
+}
+
+std::wstring RenderCache::Describe() const
+{
+    const uint64_t rtfLookups = m_rtfHits + m_rtfMisses;
+    const uint64_t heightLookups = m_heightHits + m_heightMisses;
+    wchar_t text[384];
+    swprintf(text, sizeof(text) / sizeof(text[0]),
+             L"entries=%zu bytes=%llu/%llu evictions=%llu\r\n"
+             L"rtf hits=%llu misses=%llu (%.1f%%) height hits=%llu misses=%llu (%.1f%%)\r\n",
+             m_entries.size(), static_cast<unsigned long long>(m_totalBytes),
+             static_cast<unsigned long long>(m_maxBytes), static_cast<unsigned long long>(m_evictions),
+             static_cast<unsigned long long>(m_rtfHits), static_cast<unsigned long long>(m_rtfMisses),
+             rtfLookups ? 100.0 * m_rtfHits / rtfLookups : 0.0,
+             static_cast<unsigned long long>(m_heightHits), static_cast<unsigned long long>(m_heightMisses),
+             heightLookups ? 100.0 * m_heightHits / heightLookups : 0.0);
+    return text;
+}
+
+RenderCache::EntryIterator RenderCache::Find(const Key& key)
+{
+    const auto found = m_entries.find(key);
+    if (found == m_entries.end()) {
+        return m_lru.end();
+    }
+    m_lru.splice(m_lru.begin(), m_lru, found->second);
+    return found->second;
+}
+
+RenderCache::EntryIterator RenderCache::FindOrAdd(const Key& key)
+{
+    EntryIterator it = Find(key);
+    if (it != m_lru.end()) {
+        return it;
+    }
+    m_lru.push_front(Entry{ key, std::string(), 0, -1 });
+    m_entries[key] = m_lru.begin();
+    m_totalBytes += EntryBytes(m_lru.front());
+    return m_lru.begin();
+}
+
+uint64_t RenderCache::EntryBytes(const Entry& entry)
+{
+    return entry.rtf.size() + kEntryOverheadBytes;
+}
+
+void RenderCache::EvictToLimit()
+{
+    // The front entry is the one just used; never evict it
+    while (m_totalBytes > m_maxBytes && m_lru.size() > 1) {
+        const Entry& oldest = m_lru.back();
+        m_totalBytes -= EntryBytes(oldest);
+        m_entries.erase(oldest.key);
+        m_lru.pop_back();
+        ++m_evictions;
+    }
+}
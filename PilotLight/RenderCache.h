@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include "Hash.h"
+
+// In-memory LRU of rendered chat messages, bounded by bytes. An entry is keyed
+// by the message digest (role + content) and the theme version and holds the
+// RTF fragment plus the height measured at one wrap width, so a redraw after
+// clear/reload/resize skips markdown rendering for messages seen before and
+// can reuse exact heights when the width matches. Used from the UI thread
+// only. Portable.
+class RenderCache {
+public:
+    RenderCache();
+
+    static RenderCache& Shared();
+
+    void Configure(uint64_t maxBytes);
+
+    // Cached fragment, or nullptr. Valid until the next Store* call.
+    const std::string* FindRtf(const Hash::Digest& content, uint32_t themeVersion);
+    void StoreRtf(const Hash::Digest& content, uint32_t themeVersion, const std::string& rtf);
+
+    // Height measured at wrapWidth, or -1
+    int FindHeight(const Hash::Digest& content, uint32_t themeVersion, int wrapWidth);
+    void StoreHeight(const Hash::Digest& content, uint32_t themeVersion, int wrapWidth, int height);
+
+    size_t Count() const { return m_entries.size(); }
+    void Clear();
+
+    std::wstring Describe() const;
+
+private:
+    struct Key {
+        Hash::Digest content;
+        uint32_t themeVersion;
+
+        bool operator==(const Key& other) const
+        {
+            return themeVersion == other.themeVersion && content == other.content;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const
+        {
+            return static_cast<size_t>(key.content.Prefix64() ^ (key.themeVersion * 0x9e3779b97f4a7c15ULL));
+        }
+    };
+
+    struct Entry {
+        Key key;
+        std::string rtf;
+        int wrapWidth;
+        int height;
+    };
+
+    typedef std::list<Entry>::iterator EntryIterator;
+
+    EntryIterator Find(const Key& key);
+    EntryIterator FindOrAdd(const Key& key);
+    static uint64_t EntryBytes(const Entry& entry);
+    void EvictToLimit();
+
+    std::list<Entry> m_lru;  // Most recently used first
+    std::unordered_map<Key, EntryIterator, KeyHash> m_entries;
+    uint64_t m_totalBytes;
+    uint64_t m_maxBytes;
+
+    uint64_t m_rtfHits;
+    uint64_t m_rtfMisses;
+    uint64_t m_heightHits;
+    uint64_t m_heightMisses;
+    uint64_t m_evictions;
+};
@@ -0,0 +1,252 @@
+#include "ResponseCache.h"
+#include "Diagnostics.h"
+#include "FileUtils.h"
+#include <ctime>
+#include <cwchar>
+#include <fstream>
+#include <iterator>
+#include <locale>
+#include <sstream>
+#include <vector>
+
+namespace {
+    // A hit only moves an entry's access time; the index is rewritten for it
+    // at most this often, or with the next store
+    const int64_t kIndexFlushSeconds = 60;
+
+    int64_t Now()
+    {
+        return static_cast<int64_t>(std::time(nullptr));
+    }
+}
+
+ResponseCache::ResponseCache()
+    : m_loaded(false)
+    , m_totalBytes(0)
+    , m_indexDirty(false)
+    , m_indexSavedAt(0)
+    , m_ttlSeconds(24 * 60 * 60)
+    , m_maxBytes(32ULL * 1024 * 1024)
+    , m_maxEntries(4096)
+    , m_hits(0)
+    , m_misses(0)
+    , m_expired(0)
+    , m_evictions(0)
+{
+}
+
+ResponseCache::~ResponseCache()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_indexDirty) {
+        SaveIndex();
+    }
+}
+
+ResponseCache& ResponseCache::Shared()
+{
+    static ResponseCache cache;
+    static const bool registered = [] {
+        Diagnostics::RegisterSection(L"Response cache", [] { return cache.Describe(); });
+        return true;
+    }();
+    (void)registered;
+    return cache;
+}
+
+void ResponseCache::Configure(int64_t ttlSeconds, uint64_t maxBytes, size_t maxEntries)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_ttlSeconds = ttlSeconds;
+    m_maxBytes = maxBytes;
+    m_maxEntries = maxEntries;
+}
+
+bool ResponseCache::Lookup(const Hash::Digest& key, std::wstring& response)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    EnsureLoaded();
+
+    auto found = m_entries.find(key.ToHex());
+    if (found == m_entries.end()) {
+        m_misses++;
+        return false;
+    }
+
+    auto it = found->second;
+    const int64_t now = Now();
+    if (m_ttlSeconds > 0 && now - it->created > m_ttlSeconds) {
+        Remove(it);
+        SaveIndex();
+        m_expired++;
+        m_misses++;
+        return false;
+    }
+
+    std::vector<BYTE> buffer;
+    if (!FileUtils::ReadFileToBuffer(EntryPath(it->key), buffer) || buffer.size() % sizeof(wchar_t) != 0) {
+        // Entry file vanished or is corrupt; drop the index record
+        Remove(it);
+        SaveIndex();
+        m_misses++;
+        return false;
+    }
+
+    response.assign(reinterpret_cast<const wchar_t*>(buffer.data()), buffer.size() / sizeof(wchar_t));
+    it->lastAccess = now;
+    m_lru.splice(m_lru.begin(), m_lru, it);
+    m_indexDirty = true;
+    if (now - m_indexSavedAt >= kIndexFlushSeconds) {
+        SaveIndex();
+    }
+    m_hits++;
+    return true;
+}
+
+void ResponseCache::Store(const Hash::Digest& key, const std::wstring& response)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    EnsureLoaded();
+
+    const uint64_t bytes = response.length() * sizeof(wchar_t);
+    if (bytes > m_maxBytes) {
+        return;
+    }
+
+    const std::wstring hex = key.ToHex();
+    auto existing = m_entries.find(hex);
+    if (existing != m_entries.end()) {
+        Remove(existing->second);
+    }
+
+    if (m_directory.empty()) {
+        return;
+    }
+
+    const BYTE* data = reinterpret_cast<const BYTE*>(response.data());
+    if (!FileUtils::WriteBufferToFile(EntryPath(hex), std::vector<BYTE>(data, data + bytes))) {
+        return;
+    }
+
+    const int64_t now = Now();
+    m_lru.push_front(Entry{ hex, now, now, bytes });
+    m_entries[hex] = m_lru.begin();
+    m_totalBytes += bytes;
+
+    EvictToLimits();
+    SaveIndex();
+}
+
+void ResponseCache::Clear()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    EnsureLoaded();
+    while (!m_lru.empty()) {
+        Remove(m_lru.begin());
+    }
+    SaveIndex();
+}
+
+std::wstring ResponseCache::Describe()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    const uint64_t lookups = m_hits + m_misses;
+    wchar_t text[256];
+    swprintf(text, sizeof(text) / sizeof(text[0]),
+             L"entries=%zu bytes=%llu hits=%llu misses=%llu hit rate=%.1f%%\r\n"
+             L"expired=%llu evictions=%llu\r\n",
+             m_lru.size(), static_cast<unsigned long long>(m_totalBytes),
+             static_cast<unsigned long long>(m_hits), static_cast<unsigned long long>(m_misses),
+             lookups ? 100.0 * m_hits / lookups : 0.0,
+             static_cast<unsigned long long>(m_expired), static_cast<unsigned long long>(m_evictions));
+    return text;
+}
+
+void ResponseCache::EnsureLoaded()
+{
+    if (m_loaded) {
+        return;
+    }
+    m_loaded = true;
+
+    m_directory = CacheDirectory();
+    if (m_directory.empty()) {
+        return;
+    }
+
+    std::wifstream file(m_directory + L"\\index.txt");
+    if (!file.is_open()) {
+        return;
+    }
+    file.imbue(std::locale::classic());
+
+    // Index is written most-recent first, so appending preserves LRU order
+    std::wstring line;
+    while (std::getline(file, line)) {
+        std::wistringstream fields(line);
+        Entry entry;
+        if (!(fields >> entry.key >> entry.created >> entry.lastAccess >> entry.bytes)) {
+            continue;
+        }
+        Hash::Digest parsed;
+        if (!Hash::Digest::FromHex(entry.key, parsed) || m_entries.count(entry.key)) {
+            continue;
+        }
+        m_lru.push_back(entry);
+        m_entries[entry.key] = std::prev(m_lru.end());
+        m_totalBytes += entry.bytes;
+    }
+}
+
+void ResponseCache::SaveIndex()
+{
+    m_indexDirty = false;
+    m_indexSavedAt = Now();
+    if (m_directory.empty()) {
+        return;
+    }
+
+    std::wofstream file(m_directory + L"\\index.txt", std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        return;
+    }
+    file.imbue(std::locale::classic());
+    for (const auto& entry : m_lru) {
+        file << entry.key << L' ' << entry.created << L' ' << entry.lastAccess << L' ' << entry.bytes << L"\n";
+    }
+}
+
+void ResponseCache::Remove(std::list<Entry>::iterator it)
+{
+    DeleteFileW(EntryPath(it->key).c_str());
+    m_totalBytes -= it->bytes;
+    m_entries.erase(it->key);
+    m_lru.erase(it);
+}
+
+void ResponseCache::EvictToLimits()
+{
+    while (!m_lru.empty() && (m_totalBytes > m_maxBytes || m_lru.size() > m_maxEntries)) {
+        Remove(std::prev(m_lru.end()));
+        m_evictions++;
+    }
+}
+
+std::wstring ResponseCache::CacheDirectory() const
+{
+    std::wstring appData = FileUtils::GetAppDataPath();
+    if (appData.empty()) {
+        return L"";
+    }
+
+    FileUtils::EnsureDirectoryExists(appData);
+    FileUtils::EnsureDirectoryExists(appData + L"\\cache");
+    std::wstring directory = appData + L"\\cache\\responses";
+    FileUtils::EnsureDirectoryExists(directory);
+    return directory;
+}
+
+std::wstring ResponseCache::EntryPath(const std::wstring& key) const
+{
+    return m_directory + L"\\" + key + L".bin";
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Hash.h"
+
+// Opt-in on-disk LRU cache of assistant responses keyed by a request digest.
+// Entries live under %APPDATA%\PilotLight\cache\responses; an index file keeps
+// creation/access times so TTL and size caps survive restarts.
+class ResponseCache {
+public:
+    ResponseCache();
+    ~ResponseCache();  // Writes access times not yet in the index
+
+    static ResponseCache& Shared();
+
+    void Configure(int64_t ttlSeconds, uint64_t maxBytes, size_t maxEntries);
+
+    bool Lookup(const Hash::Digest& key, std::wstring& response);
+    void Store(const Hash::Digest& key, const std::wstring& response);
+    void Clear();
+
+    std::wstring Describe();
+
+private:
+    struct Entry {
+        std::wstring key;  // Hex digest, also the entry file name
+        int64_t created;
+        int64_t lastAccess;
+        uint64_t bytes;
+    };
+
+    void EnsureLoaded();
+    void SaveIndex();
+    void Remove(std::list<Entry>::iterator it);
+    void EvictToLimits();
+    std::wstring CacheDirectory() const;
+    std::wstring EntryPath(const std::wstring& key) const;
+
+    std::mutex m_lock;
+    bool m_loaded;
+    std::wstring m_directory;
+    std::list<Entry> m_lru;  // Most recently used first
+    std::unordered_map<std::wstring, std::list<Entry>::iterator> m_entries;
+    uint64_t m_totalBytes;
+    bool m_indexDirty;       // Access times changed since the index was written
+    int64_t m_indexSavedAt;
+
+    int64_t m_ttlSeconds;
+    uint64_t m_maxBytes;
+    size_t m_maxEntries;
+
+    uint64_t m_hits;
+    uint64_t m_misses;
+    uint64_t m_expired;
+    uint64_t m_evictions;
+};
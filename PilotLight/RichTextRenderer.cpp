@@ -1,162 +1,62 @@
 #include "RichTextRenderer.h"
-#include <sstream>
+#include <algorithm>
+#include <cstring>
 #include <richedit.h>
 
-std::wstring RichTextRenderer::EscapeRTF(const std::wstring& str)
-{
-    std::wstring result;
-    result.reserve(str.length() + 10);
-    
-    for (wchar_t c : str) {
-        switch (c) {
-            case L'\\': result += L"\\\\"; break;
-            case L'{': result += L"\\{"; break;
-            case L'}': result += L"\\}"; break;
-            default: result += c; break;
-        }
-    }
-    
-    return result;
-}
+namespace {
+    struct StreamSource {
+        const std::string* data;
+        size_t offset;
+    };
 
-std::wstring RichTextRenderer::ProcessMarkdown(const std::wstring& markdown)
-{
-    std::wstring result = markdown;
-    std::wstring processed;
-    size_t pos = 0;
-    
-    while (pos < result.length()) {
-        // Check for code blocks (```...```)
-        if (result.substr(pos, 3) == L"```") {
-            size_t end = result.find(L"```", pos + 3);
-            if (end != std::wstring::npos) {
-                processed += L"\\f1 ";  // Monospace font
-                processed += EscapeRTF(result.substr(pos + 3, end - pos - 3));
-                processed += L"\\f0 ";  // Back to normal font
-                pos = end + 3;
-                continue;
-            }
-        }
-        
-        // Check for inline code (`...`)
-        if (result[pos] == L'`') {
-            size_t end = result.find(L'`', pos + 1);
-            if (end != std::wstring::npos) {
-                processed += L"\\f1 ";
-                processed += EscapeRTF(result.substr(pos + 1, end - pos - 1));
-                processed += L"\\f0 ";
-                pos = end + 1;
-                continue;
-            }
-        }
-        
-        // Check for bold (**...**)
-        if (result.substr(pos, 2) == L"**") {
-            size_t end = result.find(L"**", pos + 2);
-            if (end != std::wstring::npos) {
-                processed += L"\\b ";
-                processed += EscapeRTF(result.substr(pos + 2, end - pos - 2));
-                processed += L"\\b0 ";
-                pos = end + 2;
-                continue;
-            }
-        }
-        
-        // Check for italic (*...*)
-        if (result[pos] == L'*') {
-            size_t end = result.find(L'*', pos + 1);
-            if (end != std::wstring::npos) {
-                processed += L"\\i ";
-                processed += EscapeRTF(result.substr(pos + 1, end - pos - 1));
-                processed += L"\\i0 ";
-                pos = end + 1;
-                continue;
-            }
-        }
-        
-        // Regular character
-        if (result[pos] == L'\\' || result[pos] == L'{' || result[pos] == L'}') {
-            processed += L'\\';
-        }
-        processed += result[pos];
-        pos++;
+    DWORD CALLBACK ReadStream(DWORD_PTR cookie, LPBYTE buffer, LONG bytes, LONG* read)
+    {
+        StreamSource* source = reinterpret_cast<StreamSource*>(cookie);
+        const size_t count = (std::min)(source->data->size() - source->offset, static_cast<size_t>(bytes));
+        memcpy(buffer, source->data->data() + source->offset, count);
+        source->offset += count;
+        *read = static_cast<LONG>(count);
+        return 0;
     }
-    
-    return processed;
 }
 
-std::wstring RichTextRenderer::RenderToRTF(const std::wstring& markdown)
+void RichTextRenderer::AppendRtf(CRichEditCtrl& ctrl, const std::string& rtf)
 {
-    std::wostringstream rtf;
-    
-    rtf << L"{\\rtf1\\ansi\\deff0";
-    rtf << L"{\\fonttbl{\\f0\\fswiss Segoe UI;}{\\f1\\fmodern Consolas;}}";
-    rtf << L"{\\colortbl;\\red220\\green220\\blue220;}";  // Text color
-    rtf << L"\\cf1 ";
-    
-    rtf << ProcessMarkdown(markdown);
-    
-    rtf << L"}";
-    
-    return rtf.str();
+    const int endPos = TextLength(ctrl);
+    ReplaceRtf(ctrl, endPos, endPos, rtf);
 }
 
-void RichTextRenderer::AppendFormattedText(CRichEditCtrl& ctrl, const std::wstring& text, COLORREF color)
+int RichTextRenderer::ReplaceRtf(CRichEditCtrl& ctrl, int start, int end, const std::string& rtf)
 {
-    // Get current text length
-    int startPos = ctrl.GetTextLength();
-    
-    // Append new text
-    ctrl.SetSel(startPos, startPos);
-    ctrl.ReplaceSel(text.c_str());
-    
-    // Format the newly added text
-    int endPos = ctrl.GetTextLength();
-    ctrl.SetSel(startPos, endPos);
-    
-    CHARFORMAT2 cf;
-    ZeroMemory(&cf, sizeof(CHARFORMAT2));
-    cf.cbSize = sizeof(CHARFORMAT2);
-    cf.dwMask = CFM_COLOR;
-    cf.crTextColor = color;
-    ctrl.SetSelectionCharFormat(cf);
-    
-    // Deselect
-    ctrl.SetSel(endPos, endPos);
-}
-
-void RichTextRenderer::AppendBubble(CRichEditCtrl& ctrl, const std::wstring& text, COLORREF textColor,
-                                   COLORREF backgroundColor, int indent)
-{
-    int startPos = ctrl.GetTextLength();
-    ctrl.SetSel(startPos, startPos);
-
-    std::wstring bubbleText = text + L"\r\n";
-    ctrl.ReplaceSel(bubbleText.c_str());
-
-    int endPos = ctrl.GetTextLength();
-    ctrl.SetSel(startPos, endPos);
+    const int kept = TextLength(ctrl) - (end - start);
+    ctrl.SetSel(start, end);
 
-    CHARFORMAT2 cf;
-    ZeroMemory(&cf, sizeof(cf));
-    cf.cbSize = sizeof(cf);
-    cf.dwMask = CFM_COLOR | CFM_BACKCOLOR;
-    cf.crTextColor = textColor;
-    cf.crBackColor = backgroundColor;
-    ctrl.SetSelectionCharFormat(cf);
+    StreamSource source = { &rtf, 0 };
+    EDITSTREAM stream;
+    ZeroMemory(&stream, sizeof(stream));
+    stream.dwCookie = reinterpret_cast<DWORD_PTR>(&source);
+    stream.pfnCallback = ReadStream;
+    ctrl.StreamIn(SF_RTF | SFF_SELECTION, stream);
 
-    PARAFORMAT2 pf;
-    ZeroMemory(&pf, sizeof(pf));
-    pf.cbSize = sizeof(pf);
-    pf.dwMask = PFM_STARTINDENT | PFM_SPACEAFTER | PFM_SPACEBEFORE | PFM_OFFSET;
-    int twipsIndent = indent * 15;
-    pf.dxStartIndent = twipsIndent;
-    pf.dxOffset = twipsIndent / 2;
-    pf.dySpaceAfter = 60;
-    pf.dySpaceBefore = 24;
-    ctrl.SetParaFormat(pf);
+    // RichEdit can drop the fragment's final \par when streaming into a selection;
+    // make sure the next message still starts on its own paragraph
+    int inserted = TextLength(ctrl) - kept;
+    if (inserted > 0) {
+        CString last;
+        ctrl.GetTextRange(start + inserted - 1, start + inserted, last);
+        if (last != L"\r") {
+            ctrl.SetSel(start + inserted, start + inserted);
+            ctrl.ReplaceSel(L"\r");
+            ++inserted;
+        }
+    }
+    return inserted;
+}
 
-    ctrl.SetSel(endPos, endPos);
+int RichTextRenderer::TextLength(CRichEditCtrl& ctrl)
+{
+    GETTEXTLENGTHEX query = { GTL_PRECISE | GTL_NUMCHARS, 1200 };
+    return static_cast<int>(ctrl.SendMessage(EM_GETTEXTLENGTHEX, reinterpret_cast<WPARAM>(&query), 0));
 }
 
 void RichTextRenderer::ScrollToBottom(CRichEditCtrl& ctrl)
@@ -5,23 +5,18 @@
 #include <winsock2.h>
 #include <afxrich.h>
 
-// Basic formatting renderer (bold, italic, code blocks)
+// Windows side of chat rendering; RTF itself is produced by MarkdownRtfRenderer
 class RichTextRenderer {
 public:
-    // Convert basic markdown to RTF
-    static std::wstring RenderToRTF(const std::wstring& markdown);
-    
-    // Append formatted text to RichEdit control
-    static void AppendFormattedText(CRichEditCtrl& ctrl, const std::wstring& text, COLORREF color);
-    
-    // Append a bubble-style text block
-    static void AppendBubble(CRichEditCtrl& ctrl, const std::wstring& text, COLORREF textColor,
-                             COLORREF backgroundColor, int indent = 18);
+    // Insert an RTF fragment at the end of the control with a single EM_STREAMIN
+    static void AppendRtf(CRichEditCtrl& ctrl, const std::string& rtf);
+
+    // Replace characters [start, end) with an RTF fragment; returns the number of characters inserted
+    static int ReplaceRtf(CRichEditCtrl& ctrl, int start, int end, const std::string& rtf);
+
+    // Character count in selection units (paragraph ends count once)
+    static int TextLength(CRichEditCtrl& ctrl);
     
     // Scroll to bottom
     static void ScrollToBottom(CRichEditCtrl& ctrl);
-    
-private:
-    static std::wstring EscapeRTF(const std::wstring& str);
-    static std::wstring ProcessMarkdown(const std::wstring& markdown);
 };
\ No newline at end of file
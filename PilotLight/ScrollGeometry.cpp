@@ -0,0 +1,96 @@
+#include "ScrollGeometry.h"
+#include <algorithm>
+
+ScrollGeometry::ScrollGeometry()
+    : m_lineHeight(kDefaultLineHeight)
+    , m_lineCount(0)
+    , m_viewportHeight(0)
+    , m_trackHeight(0)
+    , m_pixelsAbove(0)
+    , m_pixelsBelow(0)
+{
+}
+
+bool ScrollGeometry::SetLineHeight(int pixels)
+{
+    const int lineHeight = pixels > 0 ? pixels : kDefaultLineHeight;
+    const bool changed = lineHeight != m_lineHeight;
+    m_lineHeight = lineHeight;
+    return changed;
+}
+
+bool ScrollGeometry::SetLineCount(int lines)
+{
+    const bool changed = lines != m_lineCount;
+    m_lineCount = lines;
+    return changed;
+}
+
+bool ScrollGeometry::SetViewport(int viewportHeight, int trackHeight)
+{
+    const bool changed = viewportHeight != m_viewportHeight || trackHeight != m_trackHeight;
+    m_viewportHeight = viewportHeight;
+    m_trackHeight = trackHeight;
+    return changed;
+}
+
+bool ScrollGeometry::SetVirtualExtent(int pixelsAbove, int pixelsBelow)
+{
+    const bool changed = pixelsAbove != m_pixelsAbove || pixelsBelow != m_pixelsBelow;
+    m_pixelsAbove = pixelsAbove;
+    m_pixelsBelow = pixelsBelow;
+    return changed;
+}
+
+int ScrollGeometry::VisibleLines() const
+{
+    return (std::max)(1, m_viewportHeight / m_lineHeight);
+}
+
+int ScrollGeometry::ScrollableLines() const
+{
+    return (std::max)(0, TotalLines() - VisibleLines());
+}
+
+int ScrollGeometry::LocalScrollableLines() const
+{
+    return (std::max)(0, m_lineCount - VisibleLines());
+}
+
+int ScrollGeometry::ThumbHeight() const
+{
+    const int totalLines = (std::max)(1, TotalLines());
+    const int visibleLines = VisibleLines();
+    if (totalLines <= visibleLines || m_trackHeight <= 0) {
+        return 0;  // No scrolling needed
+    }
+
+    const int thumbHeight = static_cast<int>(static_cast<float>(visibleLines) / totalLines * m_trackHeight);
+    return (std::min)(m_trackHeight, (std::max)(kMinThumbHeight, thumbHeight));
+}
+
+int ScrollGeometry::ThumbOffset(int firstVisibleLine) const
+{
+    const int scrollableLines = ScrollableLines();
+    const int scrollableTrack = m_trackHeight - ThumbHeight();
+    if (scrollableLines <= 0 || scrollableTrack <= 0) {
+        return 0;
+    }
+
+    const int line = (std::max)(0, (std::min)(scrollableLines, AboveLines() + firstVisibleLine));
+    const int offset = static_cast<int>(static_cast<float>(line) / scrollableLines * scrollableTrack);
+    return (std::max)(0, (std::min)(scrollableTrack, offset));
+}
+
+int ScrollGeometry::DragTarget(int startLine, int deltaY) const
+{
+    const int scrollableLines = ScrollableLines();
+    const int thumbHeight = ThumbHeight();
+    const int scrollableTrack = m_trackHeight - thumbHeight;
+    if (thumbHeight == 0 || scrollableLines <= 0 || scrollableTrack <= 0) {
+        return -1;
+    }
+
+    const int deltaLines = static_cast<int>(static_cast<float>(deltaY) / scrollableTrack * scrollableLines);
+    return (std::max)(0, (std::min)(scrollableLines, startLine + deltaLines));
+}
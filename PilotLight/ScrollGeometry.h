@@ -0,0 +1,46 @@
+#pragma once
+
+// Scrollbar math for CThemedRichEdit, in lines of the control font. The
+// control pushes the line height, its line count and the viewport size when
+// those change, so painting and mouse handling read cached values instead of
+// querying the window. Content outside the control (a virtualized transcript)
+// counts as whole lines above and below. Portable.
+class ScrollGeometry {
+public:
+    static constexpr int kDefaultLineHeight = 20;
+    static constexpr int kMinThumbHeight = 30;
+
+    ScrollGeometry();
+
+    // Each setter returns true if the value changed
+    bool SetLineHeight(int pixels);  // Non-positive values use kDefaultLineHeight
+    bool SetLineCount(int lines);
+    bool SetViewport(int viewportHeight, int trackHeight);
+    bool SetVirtualExtent(int pixelsAbove, int pixelsBelow);
+
+    int LineHeight() const { return m_lineHeight; }
+    int LineCount() const { return m_lineCount; }
+    int AboveLines() const { return m_pixelsAbove / m_lineHeight; }
+    int BelowLines() const { return m_pixelsBelow / m_lineHeight; }
+    int TotalLines() const { return m_lineCount + AboveLines() + BelowLines(); }
+    int VisibleLines() const;
+    int ScrollableLines() const;       // Including the virtual lines
+    int LocalScrollableLines() const;  // Within the control
+
+    // Thumb height in pixels, 0 when everything fits
+    int ThumbHeight() const;
+    // Thumb top relative to the track for the first visible line of the control
+    int ThumbOffset(int firstVisibleLine) const;
+    // Line (counting virtual lines above) the view should start at after the
+    // thumb moved deltaY pixels from where a drag began at startLine, or -1
+    // when the thumb cannot move
+    int DragTarget(int startLine, int deltaY) const;
+
+private:
+    int m_lineHeight;
+    int m_lineCount;
+    int m_viewportHeight;
+    int m_trackHeight;
+    int m_pixelsAbove;
+    int m_pixelsBelow;
+};
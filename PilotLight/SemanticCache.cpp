@@ -0,0 +1,253 @@
+#include "SemanticCache.h"
+#include "Diagnostics.h"
+#include <algorithm>
+#include <cstdio>
+#include <cwctype>
+
+namespace {
+    constexpr size_t kShingleLength = 4;
+    constexpr size_t kMaxBucketSlots = 64;  // Bounds lookup cost for very common bands
+
+    inline uint32_t Mix32(uint64_t value)
+    {
+        // Murmur3 64-bit finalizer folded to 32 bits
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdULL;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ULL;
+        value ^= value >> 33;
+        return static_cast<uint32_t>(value);
+    }
+
+    // Non-ASCII characters count as word characters unless classified as space
+    // or punctuation, so text in other scripts survives even under the C locale
+    inline bool IsWordChar(wchar_t ch)
+    {
+        if (ch < 0x80) {
+            return std::iswalnum(ch) != 0;
+        }
+        return std::iswalnum(ch) || (!std::iswspace(ch) && !std::iswpunct(ch));
+    }
+
+    // Lowercase, map punctuation to spaces and collapse runs of whitespace
+    std::wstring Normalize(const std::wstring& text)
+    {
+        std::wstring normalized;
+        normalized.reserve(text.length());
+        bool pendingSpace = false;
+        for (wchar_t ch : text) {
+            if (IsWordChar(ch)) {
+                if (pendingSpace && !normalized.empty()) {
+                    normalized += L' ';
+                }
+                pendingSpace = false;
+                normalized += static_cast<wchar_t>(std::towlower(ch));
+            } else {
+                pendingSpace = true;
+            }
+        }
+        return normalized;
+    }
+}
+
+SemanticCache::SemanticCache()
+    : m_threshold(0.9)
+    , m_maxEntries(10000)
+    , m_nextSlot(0)
+    , m_hits(0)
+    , m_misses(0)
+    , m_skipped(0)
+    , m_candidatesCompared(0)
+{
+}
+
+SemanticCache& SemanticCache::Shared()
+{
+    static SemanticCache cache;
+    static const bool registered = [] {
+        Diagnostics::RegisterSection(L"Semantic cache", [] { return cache.Describe(); });
+        return true;
+    }();
+    (void)registered;
+    return cache;
+}
+
+void SemanticCache::Configure(double similarityThreshold, size_t maxEntries)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_threshold = similarityThreshold;
+    if (maxEntries != m_maxEntries) {
+        m_maxEntries = (std::max)(static_cast<size_t>(1), maxEntries);
+        m_entries.clear();
+        m_buckets.clear();
+        m_nextSlot = 0;
+    }
+}
+
+size_t SemanticCache::ComputeSignature(const std::wstring& text, Signature& signature)
+{
+    std::fill(signature, signature + kSignatureSize, UINT32_MAX);
+
+    const std::wstring normalized = Normalize(text);
+    const size_t shingleCount = normalized.length() >= kShingleLength
+        ? normalized.length() - kShingleLength + 1
+        : (normalized.empty() ? 0 : 1);
+
+    for (size_t i = 0; i < shingleCount; ++i) {
+        const size_t length = (std::min)(kShingleLength, normalized.length() - i);
+        const uint64_t shingle = Hash::Fnv1a64(normalized.data() + i, length * sizeof(wchar_t));
+
+        // Kirsch-Mitzenmacher: derive all permutations from two base hashes
+        const uint64_t h1 = shingle;
+        const uint64_t h2 = Mix32(shingle) | 1ULL;
+        for (int k = 0; k < kSignatureSize; ++k) {
+            const uint32_t value = Mix32(h1 + static_cast<uint64_t>(k) * h2);
+            if (value < signature[k]) {
+                signature[k] = value;
+            }
+        }
+    }
+    return shingleCount;
+}
+
+double SemanticCache::EstimateSimilarity(const Signature& a, const Signature& b)
+{
+    int matches = 0;
+    for (int k = 0; k < kSignatureSize; ++k) {
+        matches += a[k] == b[k] ? 1 : 0;
+    }
+    return static_cast<double>(matches) / kSignatureSize;
+}
+
+bool SemanticCache::Lookup(const Hash::Digest& context, const std::wstring& question,
+                           std::wstring& response, double& similarity)
+{
+    Signature signature;
+    const size_t shingles = ComputeSignature(question, signature);
+    const uint64_t contextKey = context.Prefix64();
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (shingles < kMinShingles) {
+        m_skipped++;
+        return false;
+    }
+
+    // Gather candidates sharing at least one band, then score each once
+    std::vector<uint32_t> candidates;
+    for (int band = 0; band < kBands; ++band) {
+        auto bucket = m_buckets.find(BandKey(contextKey, signature, band));
+        if (bucket != m_buckets.end()) {
+            candidates.insert(candidates.end(), bucket->second.begin(), bucket->second.end());
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    const Entry* best = nullptr;
+    double bestSimilarity = 0.0;
+    for (uint32_t slot : candidates) {
+        const Entry& entry = m_entries[slot];
+        if (entry.context != contextKey) {
+            continue;
+        }
+        const double estimate = EstimateSimilarity(signature, entry.signature);
+        if (estimate > bestSimilarity) {
+            bestSimilarity = estimate;
+            best = &entry;
+        }
+    }
+    m_candidatesCompared += candidates.size();
+
+    if (!best || bestSimilarity < m_threshold) {
+        m_misses++;
+        return false;
+    }
+
+    response = best->response;
+    similarity = bestSimilarity;
+    m_hits++;
+    return true;
+}
+
+void SemanticCache::Store(const Hash::Digest& context, const std::wstring& question, const std::wstring& response)
+{
+    Entry entry;
+    entry.context = context.Prefix64();
+    if (ComputeSignature(question, entry.signature) < kMinShingles) {
+        return;
+    }
+    entry.response = response;
+
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    uint32_t slot;
+    if (m_entries.size() < m_maxEntries) {
+        slot = static_cast<uint32_t>(m_entries.size());
+        m_entries.push_back(std::move(entry));
+    } else {
+        slot = static_cast<uint32_t>(m_nextSlot);
+        m_nextSlot = (m_nextSlot + 1) % m_maxEntries;
+        Unindex(slot);
+        m_entries[slot] = std::move(entry);
+    }
+
+    const Entry& stored = m_entries[slot];
+    for (int band = 0; band < kBands; ++band) {
+        auto& slots = m_buckets[BandKey(stored.context, stored.signature, band)];
+        if (slots.size() >= kMaxBucketSlots) {
+            slots.erase(slots.begin());
+        }
+        slots.push_back(slot);
+    }
+}
+
+void SemanticCache::Clear()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_entries.clear();
+    m_buckets.clear();
+    m_nextSlot = 0;
+}
+
+std::wstring SemanticCache::Describe()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    const uint64_t lookups = m_hits + m_misses;
+    wchar_t text[256];
+    swprintf(text, sizeof(text) / sizeof(text[0]),
+             L"entries=%zu buckets=%zu threshold=%.2f\r\n"
+             L"hits=%llu misses=%llu skipped=%llu hit rate=%.1f%% avg candidates=%.1f\r\n",
+             m_entries.size(), m_buckets.size(), m_threshold,
+             static_cast<unsigned long long>(m_hits), static_cast<unsigned long long>(m_misses),
+             static_cast<unsigned long long>(m_skipped),
+             lookups ? 100.0 * m_hits / lookups : 0.0,
+             lookups ? static_cast<double>(m_candidatesCompared) / lookups : 0.0);
+    return text;
+}
+
+uint64_t SemanticCache::BandKey(uint64_t context, const Signature& signature, int band)
+{
+    uint64_t key = Hash::Fnv1a64(&context, sizeof(context));
+    key = Hash::Fnv1a64(&band, sizeof(band), key);
+    return Hash::Fnv1a64(signature + band * kRowsPerBand, kRowsPerBand * sizeof(uint32_t), key);
+}
+
+void SemanticCache::Unindex(uint32_t slot)
+{
+    const Entry& entry = m_entries[slot];
+    for (int band = 0; band < kBands; ++band) {
+        auto bucket = m_buckets.find(BandKey(entry.context, entry.signature, band));
+        if (bucket == m_buckets.end()) {
+            continue;
+        }
+        auto& slots = bucket->second;
+        auto it = std::find(slots.begin(), slots.end(), slot);
+        if (it != slots.end()) {
+            *it = slots.back();
+            slots.pop_back();
+        }
+        if (slots.empty()) {
+            m_buckets.erase(bucket);
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Hash.h"
+
+// Second-tier response cache for paraphrased repeats. The last user message is
+// shingled and summarized as a MinHash signature; signatures are indexed in LSH
+// bands so a lookup only compares against entries sharing at least one band,
+// independent of cache size. Entries only match within the same preceding
+// context (digest of every message before the question). Questions too short
+// to shingle meaningfully (fewer than kMinShingles) are neither looked up nor
+// stored, since their signatures say little about what was asked.
+class SemanticCache {
+public:
+    static constexpr int kSignatureSize = 64;
+    static constexpr int kBands = 16;
+    static constexpr int kRowsPerBand = kSignatureSize / kBands;
+    static constexpr size_t kMinShingles = 8;
+
+    typedef uint32_t Signature[kSignatureSize];
+
+    SemanticCache();
+
+    static SemanticCache& Shared();
+
+    void Configure(double similarityThreshold, size_t maxEntries);
+
+    // On a hit, similarity holds the estimated Jaccard similarity of the match
+    bool Lookup(const Hash::Digest& context, const std::wstring& question,
+                std::wstring& response, double& similarity);
+    void Store(const Hash::Digest& context, const std::wstring& question, const std::wstring& response);
+    void Clear();
+
+    // Returns the number of shingles; the signature is meaningless when 0
+    static size_t ComputeSignature(const std::wstring& text, Signature& signature);
+    static double EstimateSimilarity(const Signature& a, const Signature& b);
+
+    std::wstring Describe();
+
+private:
+    struct Entry {
+        uint64_t context;
+        Signature signature;
+        std::wstring response;
+    };
+
+    static uint64_t BandKey(uint64_t context, const Signature& signature, int band);
+    void Unindex(uint32_t slot);
+
+    std::mutex m_lock;
+    double m_threshold;
+    size_t m_maxEntries;
+    std::vector<Entry> m_entries;  // Ring; the oldest slot is recycled when full
+    size_t m_nextSlot;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> m_buckets;
+
+    uint64_t m_hits;
+    uint64_t m_misses;
+    uint64_t m_skipped;  // Too short to look up or store
+    uint64_t m_candidatesCompared;
+};
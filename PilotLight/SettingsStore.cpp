@@ -2,9 +2,22 @@
 #include "FileUtils.h"
 #include <fstream>
 #include <cwctype>
+#include <cwchar>
 #include <locale>
 
 namespace {
+#ifdef _WIN32
+    const std::wstring& NativePath(const std::wstring& path)
+    {
+        return path;
+    }
+#else
+    std::string NativePath(const std::wstring& path)
+    {
+        return std::string(path.begin(), path.end());
+    }
+#endif
+
     std::wstring TrimWhitespace(const std::wstring& value)
     {
         size_t start = 0;
@@ -31,6 +44,51 @@ namespace {
         for (wchar_t& ch : bLower) ch = std::towlower(ch);
         return aLower == bLower;
     }
+
+    bool ParseBool(const std::wstring& value)
+    {
+        return value == L"1" || StringEqualsIgnoreCase(value, L"true");
+    }
+
+    int ParseInt(const std::wstring& value, int fallback, int minValue, int maxValue)
+    {
+        wchar_t* end = nullptr;
+        const long parsed = std::wcstol(value.c_str(), &end, 10);
+        if (end == value.c_str()) {
+            return fallback;
+        }
+        if (parsed < minValue) return minValue;
+        if (parsed > maxValue) return maxValue;
+        return static_cast<int>(parsed);
+    }
+
+    std::vector<std::wstring> SplitList(const std::wstring& value)
+    {
+        std::vector<std::wstring> items;
+        size_t start = 0;
+        while (start <= value.length()) {
+            size_t end = value.find(L';', start);
+            if (end == std::wstring::npos) {
+                end = value.length();
+            }
+            std::wstring item = TrimWhitespace(value.substr(start, end - start));
+            if (!item.empty()) {
+                items.push_back(item);
+            }
+            start = end + 1;
+        }
+        return items;
+    }
+
+    std::wstring JoinList(const std::vector<std::wstring>& items)
+    {
+        std::wstring value;
+        for (const auto& item : items) {
+            if (!value.empty()) value += L';';
+            value += item;
+        }
+        return value;
+    }
 }
 
 SettingsStore::Settings SettingsStore::s_settings;
@@ -77,15 +135,39 @@ void SettingsStore::Save()
     FileUtils::EnsureDirectoryExists(appData);
     std::wstring path = appData + L"\\settings.ini";
 
-    std::wofstream file(path, std::ios::out | std::ios::trunc);
+    std::wofstream file(NativePath(path), std::ios::out | std::ios::trunc);
     if (!file.is_open()) {
         return;
     }
 
     file.imbue(std::locale::classic());
     file << L"endpoint=" << s_settings.endpoint << L"\n";
+    file << L"endpoints=" << JoinList(s_settings.endpoints) << L"\n";
     file << L"apiKey=" << s_settings.apiKey << L"\n";
     file << L"stubMode=" << (s_settings.stubModeEnabled ? 1 : 0) << L"\n";
+    file << L"hedge=" << (s_settings.hedgeEnabled ? 1 : 0) << L"\n";
+    file << L"hedgePercentile=" << s_settings.hedgePercentile << L"\n";
+    file << L"hedgeMaxRatePercent=" << s_settings.hedgeMaxRatePercent << L"\n";
+    file << L"responseCache=" << (s_settings.responseCacheEnabled ? 1 : 0) << L"\n";
+    file << L"responseCacheTtlMinutes=" << s_settings.responseCacheTtlMinutes << L"\n";
+    file << L"responseCacheMaxMB=" << s_settings.responseCacheMaxMB << L"\n";
+    file << L"semanticCache=" << (s_settings.semanticCacheEnabled ? 1 : 0) << L"\n";
+    file << L"semanticCacheThresholdPercent=" << s_settings.semanticCacheThresholdPercent << L"\n";
+    file << L"semanticCacheMaxEntries=" << s_settings.semanticCacheMaxEntries << L"\n";
+    file << L"rateLimitRequestsPerMinute=" << s_settings.rateLimitRequestsPerMinute << L"\n";
+    file << L"rateLimitTokensPerMinute=" << s_settings.rateLimitTokensPerMinute << L"\n";
+    file << L"stream=" << (s_settings.streamResponses ? 1 : 0) << L"\n";
+    file << L"renderCacheMaxMB=" << s_settings.renderCacheMaxMB << L"\n";
+    file << L"fastStartup=" << (s_settings.fastStartup ? 1 : 0) << L"\n";
+    file << L"pluginIsolation=" << (s_settings.pluginIsolation ? 1 : 0) << L"\n";
+    file << L"pluginTimeoutMs=" << s_settings.pluginTimeoutMs << L"\n";
+    file << L"pluginBudgetMs=" << s_settings.pluginBudgetMs << L"\n";
+    file << L"pluginBudgetStrikes=" << s_settings.pluginBudgetStrikes << L"\n";
+    file << L"pluginHotReload=" << (s_settings.pluginHotReload ? 1 : 0) << L"\n";
+    file << L"pluginCacheMaxKB=" << s_settings.pluginCacheMaxKB << L"\n";
+    file << L"toolsEnabled=" << (s_settings.toolsEnabled ? 1 : 0) << L"\n";
+    file << L"toolTimeoutMs=" << s_settings.toolTimeoutMs << L"\n";
+    file << L"toolMaxParallel=" << s_settings.toolMaxParallel << L"\n";
 }
 
 void SettingsStore::EnsureLoaded()
@@ -101,7 +183,7 @@ void SettingsStore::EnsureLoaded()
     }
 
     std::wstring path = appData + L"\\settings.ini";
-    std::wifstream file(path);
+    std::wifstream file(NativePath(path));
     if (!file.is_open()) {
         return;
     }
@@ -123,10 +205,58 @@ void SettingsStore::EnsureLoaded()
 
         if (key == L"endpoint") {
             s_settings.endpoint = value;
+        } else if (key == L"endpoints") {
+            s_settings.endpoints = SplitList(value);
         } else if (key == L"apiKey") {
             s_settings.apiKey = value;
         } else if (key == L"stubMode") {
-            s_settings.stubModeEnabled = (value == L"1" || StringEqualsIgnoreCase(value, L"true"));
+            s_settings.stubModeEnabled = ParseBool(value);
+        } else if (key == L"hedge") {
+            s_settings.hedgeEnabled = ParseBool(value);
+        } else if (key == L"hedgePercentile") {
+            s_settings.hedgePercentile = ParseInt(value, 95, 50, 100);
+        } else if (key == L"hedgeMaxRatePercent") {
+            s_settings.hedgeMaxRatePercent = ParseInt(value, 10, 0, 100);
+        } else if (key == L"responseCache") {
+            s_settings.responseCacheEnabled = ParseBool(value);
+        } else if (key == L"responseCacheTtlMinutes") {
+            s_settings.responseCacheTtlMinutes = ParseInt(value, 24 * 60, 0, 365 * 24 * 60);
+        } else if (key == L"responseCacheMaxMB") {
+            s_settings.responseCacheMaxMB = ParseInt(value, 32, 1, 4096);
+        } else if (key == L"semanticCache") {
+            s_settings.semanticCacheEnabled = ParseBool(value);
+        } else if (key == L"semanticCacheThresholdPercent") {
+            s_settings.semanticCacheThresholdPercent = ParseInt(value, 90, 50, 100);
+        } else if (key == L"semanticCacheMaxEntries") {
+            s_settings.semanticCacheMaxEntries = ParseInt(value, 10000, 1, 1000000);
+        } else if (key == L"rateLimitRequestsPerMinute") {
+            s_settings.rateLimitRequestsPerMinute = ParseInt(value, 0, 0, 1000000);
+        } else if (key == L"rateLimitTokensPerMinute") {
+            s_settings.rateLimitTokensPerMinute = ParseInt(value, 0, 0, 100000000);
+        } else if (key == L"stream") {
+            s_settings.streamResponses = ParseBool(value);
+        } else if (key == L"renderCacheMaxMB") {
+            s_settings.renderCacheMaxMB = ParseInt(value, 16, 0, 1024);
+        } else if (key == L"fastStartup") {
+            s_settings.fastStartup = ParseBool(value);
+        } else if (key == L"pluginIsolation") {
+            s_settings.pluginIsolation = ParseBool(value);
+        } else if (key == L"pluginTimeoutMs") {
+            s_settings.pluginTimeoutMs = ParseInt(value, 2000, 50, 60000);
+        } else if (key == L"pluginBudgetMs") {
+            s_settings.pluginBudgetMs = ParseInt(value, 500, 0, 60000);
+        } else if (key == L"pluginBudgetStrikes") {
+            s_settings.pluginBudgetStrikes = ParseInt(value, 3, 1, 1000);
+        } else if (key == L"pluginHotReload") {
+            s_settings.pluginHotReload = ParseBool(value);
+        } else if (key == L"pluginCacheMaxKB") {
+            s_settings.pluginCacheMaxKB = ParseInt(value, 4096, 0, 1024 * 1024);
+        } else if (key == L"toolsEnabled") {
+            s_settings.toolsEnabled = ParseBool(value);
+        } else if (key == L"toolTimeoutMs") {
+            s_settings.toolTimeoutMs = ParseInt(value, 10000, 100, 600000);
+        } else if (key == L"toolMaxParallel") {
+            s_settings.toolMaxParallel = ParseInt(value, 4, 1, 32);
         }
     }
 }
@@ -1,13 +1,38 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 class SettingsStore {
 public:
     struct Settings {
         std::wstring endpoint;
+        std::vector<std::wstring> endpoints;  // Additional gateways for routing/failover
         std::wstring apiKey;
         bool stubModeEnabled = false;
+        bool hedgeEnabled = false;        // Duplicate slow requests to cut tail latency
+        int hedgePercentile = 95;         // Hedge once TTFT exceeds this percentile of recent samples
+        int hedgeMaxRatePercent = 10;     // Upper bound on hedged requests
+        bool responseCacheEnabled = false;  // Serve repeated identical requests from disk
+        int responseCacheTtlMinutes = 24 * 60;
+        int responseCacheMaxMB = 32;
+        bool semanticCacheEnabled = false;  // Serve paraphrased repeats via MinHash similarity
+        int semanticCacheThresholdPercent = 90;
+        int semanticCacheMaxEntries = 10000;
+        int rateLimitRequestsPerMinute = 0;  // 0 = learn from x-ratelimit-* headers
+        int rateLimitTokensPerMinute = 0;
+        bool streamResponses = true;  // Show the reply as it is generated
+        int renderCacheMaxMB = 16;    // Rendered messages kept for redraws; 0 disables
+        bool fastStartup = true;      // Show the history tail first, load the rest in the background
+        bool pluginIsolation = false;  // Run plugins in a helper process
+        int pluginTimeoutMs = 2000;    // Per call; a helper that misses it is restarted
+        int pluginBudgetMs = 500;      // Per-call latency budget; 0 disables
+        int pluginBudgetStrikes = 3;   // Over-budget calls in a row before a plugin is bypassed
+        bool pluginHotReload = true;   // Watch the plugins folder and reload changed DLLs
+        int pluginCacheMaxKB = 4096;   // Results of deterministic plugins; 0 disables
+        bool toolsEnabled = false;     // Offer the built-in tools to the model
+        int toolTimeoutMs = 10000;     // Per call; a call that misses it is reported as timed out
+        int toolMaxParallel = 4;       // Tool calls of one reply that run at the same time
     };
 
     static const Settings& Get();
@@ -0,0 +1,456 @@
+#include "SharedChannel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PILOTLIGHT_CHANNEL_PAUSE() _mm_pause()
+#else
+#define PILOTLIGHT_CHANNEL_PAUSE() ((void)0)
+#endif
+
+// Control block of one direction; the writer owns head, the reader owns tail
+struct SharedChannel::Ring {
+    alignas(64) std::atomic<uint64_t> head;  // Bytes written so far
+    alignas(64) std::atomic<uint64_t> tail;  // Bytes read so far
+    alignas(64) std::atomic<uint32_t> readerWaiting;
+    std::atomic<uint32_t> writerWaiting;
+#ifndef _WIN32
+    sem_t bells[2];
+#endif
+};
+
+struct SharedChannel::Layout {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t ringBytes;
+    Ring rings[2];
+};
+
+namespace {
+    constexpr uint32_t kMagic = 0x4C43504Cu;
+    constexpr uint32_t kLayoutVersion = 1;
+    constexpr double kSpinMs = 0.05;  // Busy-wait before sleeping on a doorbell
+    constexpr int kPauseProbes = 64;  // Probes before the spin starts yielding
+    constexpr int kPeerCheckMs = 50;  // Longest sleep between peer checks
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring counters are shared between processes");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "wait flags are shared between processes");
+
+    double NowMs()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    size_t RoundUpToCacheLine(size_t value)
+    {
+        return (value + 63) & ~static_cast<size_t>(63);
+    }
+
+    size_t RoundUpPowerOfTwo(size_t value)
+    {
+        size_t result = 4096;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+#ifdef _WIN32
+    std::wstring ObjectName(const std::string& name, const char* suffix)
+    {
+        const std::string full = "Local\\" + name + suffix;
+        return std::wstring(full.begin(), full.end());
+    }
+
+    const char* BellSuffix(int ring, int bell)
+    {
+        static const char* const suffixes[2][2] = { { "-0d", "-0s" }, { "-1d", "-1s" } };
+        return suffixes[ring][bell];
+    }
+#endif
+}
+
+SharedChannel::SharedChannel()
+    : m_shared(nullptr)
+    , m_data{ nullptr, nullptr }
+    , m_ringBytes(0)
+    , m_mappedBytes(0)
+    , m_writeRing(0)
+    , m_readRing(1)
+    , m_owner(false)
+    , m_mapping(nullptr)
+    , m_bells{ { nullptr, nullptr }, { nullptr, nullptr } }
+    , m_sleeps(0)
+    , m_rings(0)
+{
+}
+
+SharedChannel::~SharedChannel()
+{
+    Close();
+}
+
+bool SharedChannel::Create(const std::string& name, size_t ringBytes)
+{
+    Close();
+    m_writeRing = 0;
+    m_readRing = 1;
+    return Map(name, RoundUpPowerOfTwo(ringBytes), true);
+}
+
+bool SharedChannel::Open(const std::string& name)
+{
+    Close();
+    m_writeRing = 1;
+    m_readRing = 0;
+    return Map(name, 0, false);
+}
+
+bool SharedChannel::Map(const std::string& name, size_t ringBytes, bool create)
+{
+    m_name = name;
+    m_owner = create;
+    const size_t dataOffset = RoundUpToCacheLine(sizeof(Layout));
+    void* view = nullptr;
+    size_t viewBytes = 0;
+
+#ifdef _WIN32
+    const std::wstring mappingName = ObjectName(name, "");
+    HANDLE mapping = nullptr;
+    if (create) {
+        viewBytes = dataOffset + 2 * ringBytes;
+        const unsigned long long size = viewBytes;
+        mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                     static_cast<DWORD>(size >> 32), static_cast<DWORD>(size & 0xFFFFFFFFull),
+                                     mappingName.c_str());
+        if (mapping && GetLastError() == ERROR_ALREADY_EXISTS) {
+            CloseHandle(mapping);
+            mapping = nullptr;
+        }
+    }
+    else {
+        mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, mappingName.c_str());
+    }
+    if (!mapping) {
+        return false;
+    }
+
+    view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+    if (!create) {
+        MEMORY_BASIC_INFORMATION info = {};
+        VirtualQuery(view, &info, sizeof(info));
+        viewBytes = info.RegionSize;
+    }
+    m_mapping = mapping;
+
+    for (int ring = 0; ring < 2; ++ring) {
+        for (int bell = 0; bell < 2; ++bell) {
+            const std::wstring bellName = ObjectName(name, BellSuffix(ring, bell));
+            m_bells[ring][bell] = create
+                ? CreateSemaphoreW(nullptr, 0, LONG_MAX, bellName.c_str())
+                : OpenSemaphoreW(SYNCHRONIZE | SEMAPHORE_MODIFY_STATE, FALSE, bellName.c_str());
+            if (!m_bells[ring][bell]) {
+                m_shared = static_cast<Layout*>(view);
+                Close();
+                return false;
+            }
+        }
+    }
+#else
+    const std::string shmName = "/" + name;
+    const int fd = create
+        ? shm_open(shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR)
+        : shm_open(shmName.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        m_owner = false;  // The name may belong to another channel; Close must not unlink it
+        return false;
+    }
+
+    if (create) {
+        viewBytes = dataOffset + 2 * ringBytes;
+        if (ftruncate(fd, static_cast<off_t>(viewBytes)) != 0) {
+            close(fd);
+            shm_unlink(shmName.c_str());
+            return false;
+        }
+    }
+    else {
+        struct stat info = {};
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            return false;
+        }
+        viewBytes = static_cast<size_t>(info.st_size);
+    }
+
+    view = mmap(nullptr, viewBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        if (create) {
+            shm_unlink(shmName.c_str());
+        }
+        return false;
+    }
+#endif
+
+    m_mappedBytes = viewBytes;
+    m_shared = static_cast<Layout*>(view);
+
+    if (create) {
+        Layout* layout = new (view) Layout();
+        layout->version = kLayoutVersion;
+        layout->ringBytes = ringBytes;
+        for (Ring& ring : layout->rings) {
+            ring.head.store(0);
+            ring.tail.store(0);
+            ring.readerWaiting.store(0);
+            ring.writerWaiting.store(0);
+#ifndef _WIN32
+            sem_init(&ring.bells[DataBell], 1, 0);
+            sem_init(&ring.bells[SpaceBell], 1, 0);
+#endif
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        layout->magic = kMagic;  // Last, so an opener never sees a half-built layout
+    }
+    else {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (viewBytes < dataOffset || m_shared->magic != kMagic || m_shared->version != kLayoutVersion) {
+            m_owner = false;
+            Close();
+            return false;
+        }
+        ringBytes = static_cast<size_t>(m_shared->ringBytes);
+        if (ringBytes == 0 || (ringBytes & (ringBytes - 1)) != 0 || viewBytes < dataOffset + 2 * ringBytes) {
+            Close();
+            return false;
+        }
+    }
+
+    m_ringBytes = ringBytes;
+    unsigned char* base = static_cast<unsigned char*>(view);
+    m_data[0] = base + dataOffset;
+    m_data[1] = base + dataOffset + ringBytes;
+    return true;
+}
+
+void SharedChannel::Close()
+{
+#ifdef _WIN32
+    if (m_shared) {
+        UnmapViewOfFile(m_shared);
+    }
+    for (auto& ringBells : m_bells) {
+        for (void*& bell : ringBells) {
+            if (bell) {
+                CloseHandle(bell);
+                bell = nullptr;
+            }
+        }
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+#else
+    if (m_shared) {
+        if (m_owner && m_shared->magic == kMagic) {
+            for (Ring& ring : m_shared->rings) {
+                sem_destroy(&ring.bells[DataBell]);
+                sem_destroy(&ring.bells[SpaceBell]);
+            }
+        }
+        munmap(m_shared, m_mappedBytes);
+    }
+    if (m_owner && !m_name.empty()) {
+        shm_unlink(("/" + m_name).c_str());
+    }
+#endif
+
+    m_shared = nullptr;
+    m_data[0] = m_data[1] = nullptr;
+    m_ringBytes = 0;
+    m_mappedBytes = 0;
+    m_owner = false;
+    m_name.clear();
+}
+
+bool SharedChannel::Write(const void* data, size_t size, int timeoutMs)
+{
+    if (!m_shared) {
+        return false;
+    }
+
+    const double deadline = timeoutMs < 0 ? std::numeric_limits<double>::infinity() : NowMs() + timeoutMs;
+    Ring& ring = m_shared->rings[m_writeRing];
+    unsigned char* buffer = m_data[m_writeRing];
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+
+    while (size > 0) {
+        const uint64_t tail = ring.tail.load(std::memory_order_acquire);
+        const size_t space = m_ringBytes - static_cast<size_t>(head - tail);
+        if (space == 0) {
+            if (!WaitChange(ring.tail, tail, ring.writerWaiting, m_writeRing, SpaceBell, deadline)) {
+                return false;
+            }
+            continue;
+        }
+
+        // Copy what fits, in two pieces when it wraps
+        const size_t chunk = (std::min)(size, space);
+        const size_t position = static_cast<size_t>(head) & (m_ringBytes - 1);
+        const size_t first = (std::min)(chunk, m_ringBytes - position);
+        memcpy(buffer + position, bytes, first);
+        memcpy(buffer, bytes + first, chunk - first);
+
+        head += chunk;
+        bytes += chunk;
+        size -= chunk;
+        ring.head.store(head, std::memory_order_seq_cst);
+        Notify(ring.readerWaiting, m_writeRing, DataBell);
+    }
+    return true;
+}
+
+bool SharedChannel::Read(void* data, size_t size, int timeoutMs)
+{
+    if (!m_shared) {
+        return false;
+    }
+
+    const double deadline = timeoutMs < 0 ? std::numeric_limits<double>::infinity() : NowMs() + timeoutMs;
+    Ring& ring = m_shared->rings[m_readRing];
+    const unsigned char* buffer = m_data[m_readRing];
+    unsigned char* bytes = static_cast<unsigned char*>(data);
+    uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+
+    while (size > 0) {
+        const uint64_t head = ring.head.load(std::memory_order_acquire);
+        const size_t available = static_cast<size_t>(head - tail);
+        if (available == 0) {
+            if (!WaitChange(ring.head, head, ring.readerWaiting, m_readRing, DataBell, deadline)) {
+                return false;
+            }
+            continue;
+        }
+
+        const size_t chunk = (std::min)(size, available);
+        const size_t position = static_cast<size_t>(tail) & (m_ringBytes - 1);
+        const size_t first = (std::min)(chunk, m_ringBytes - position);
+        memcpy(bytes, buffer + position, first);
+        memcpy(bytes + first, buffer, chunk - first);
+
+        tail += chunk;
+        bytes += chunk;
+        size -= chunk;
+        ring.tail.store(tail, std::memory_order_seq_cst);
+        Notify(ring.writerWaiting, m_readRing, SpaceBell);
+    }
+    return true;
+}
+
+bool SharedChannel::WaitChange(const std::atomic<uint64_t>& counter, uint64_t seen, std::atomic<uint32_t>& waiting,
+                               int ring, Bell bell, double deadline)
+{
+    // Most replies arrive within a few microseconds; catch those without
+    // sleeping. Yield between probes so a peer sharing this core can run.
+    const double spinUntil = NowMs() + kSpinMs;
+    for (int probe = 0;; ++probe) {
+        if (counter.load(std::memory_order_acquire) != seen) {
+            return true;
+        }
+        if (probe < kPauseProbes) {
+            PILOTLIGHT_CHANNEL_PAUSE();
+        }
+        else if (NowMs() < spinUntil) {
+            std::this_thread::yield();
+        }
+        else {
+            break;
+        }
+    }
+
+    for (;;) {
+        // Announce the sleep before the final check; the peer publishes its
+        // counter before it looks at the flag, so one of the two sees the other
+        waiting.store(1, std::memory_order_seq_cst);
+        if (counter.load(std::memory_order_seq_cst) != seen) {
+            waiting.store(0, std::memory_order_relaxed);
+            return true;
+        }
+
+        const double now = NowMs();
+        if (now >= deadline || (m_peerCheck && !m_peerCheck())) {
+            waiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+
+        const double remaining = std::ceil(deadline - now);
+        const int slice = remaining < kPeerCheckMs ? static_cast<int>(remaining) : kPeerCheckMs;
+        ++m_sleeps;
+        WaitDoorbell(ring, bell, slice);
+    }
+}
+
+void SharedChannel::Notify(std::atomic<uint32_t>& waiting, int ring, Bell bell)
+{
+    if (waiting.load(std::memory_order_seq_cst) != 0 && waiting.exchange(0, std::memory_order_seq_cst) != 0) {
+        ++m_rings;
+        RingDoorbell(ring, bell);
+    }
+}
+
+bool SharedChannel::WaitDoorbell(int ring, Bell bell, int milliseconds)
+{
+#ifdef _WIN32
+    return WaitForSingleObject(m_bells[ring][bell], static_cast<DWORD>(milliseconds)) == WAIT_OBJECT_0;
+#else
+    timespec until = {};
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += milliseconds / 1000;
+    until.tv_nsec += static_cast<long>(milliseconds % 1000) * 1000000L;
+    if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec += 1;
+        until.tv_nsec -= 1000000000L;
+    }
+
+    sem_t* semaphore = &m_shared->rings[ring].bells[bell];
+    int result;
+    do {
+        result = sem_timedwait(semaphore, &until);
+    } while (result != 0 && errno == EINTR);
+    return result == 0;
+#endif
+}
+
+void SharedChannel::RingDoorbell(int ring, Bell bell)
+{
+#ifdef _WIN32
+    ReleaseSemaphore(m_bells[ring][bell], 1, nullptr);
+#else
+    sem_post(&m_shared->rings[ring].bells[bell]);
+#endif
+}
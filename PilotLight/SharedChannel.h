@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Byte stream between two processes through one shared-memory region: a ring
+// per direction plus a doorbell each way. A reader spins briefly before it
+// sleeps on its doorbell, and a writer only rings when the reader is asleep,
+// so a small message usually crosses without a system call. Windows uses a
+// named file mapping and named semaphores; other systems shm_open and
+// process-shared POSIX semaphores inside the region. One thread per side at
+// a time. Portable.
+class SharedChannel {
+public:
+    static constexpr size_t kDefaultRingBytes = 1 << 20;
+
+    // Polled while a transfer waits; returning false abandons it (the peer died)
+    typedef std::function<bool()> PeerCheck;
+
+    SharedChannel();
+    ~SharedChannel();
+    SharedChannel(const SharedChannel&) = delete;
+    SharedChannel& operator=(const SharedChannel&) = delete;
+
+    // The creating side writes ring 0 and reads ring 1; the opening side the reverse.
+    // Names are plain ASCII without slashes.
+    bool Create(const std::string& name, size_t ringBytes = kDefaultRingBytes);
+    bool Open(const std::string& name);
+    void Close();
+    bool IsOpen() const { return m_shared != nullptr; }
+
+    void SetPeerCheck(PeerCheck check) { m_peerCheck = std::move(check); }
+
+    // Whole transfers within timeoutMs (negative waits indefinitely). False on
+    // timeout or a dead peer; the stream is then out of step and must be closed.
+    bool Write(const void* data, size_t size, int timeoutMs);
+    bool Read(void* data, size_t size, int timeoutMs);
+
+    uint64_t Sleeps() const { return m_sleeps; }  // Waits that outlasted the spin
+    uint64_t Rings() const { return m_rings; }    // Doorbells rung for the peer
+
+private:
+    struct Ring;
+    struct Layout;
+
+    enum Bell { DataBell = 0, SpaceBell = 1 };
+
+    bool Map(const std::string& name, size_t ringBytes, bool create);
+    bool WaitChange(const std::atomic<uint64_t>& counter, uint64_t seen, std::atomic<uint32_t>& waiting,
+                    int ring, Bell bell, double deadline);
+    void Notify(std::atomic<uint32_t>& waiting, int ring, Bell bell);
+    bool WaitDoorbell(int ring, Bell bell, int milliseconds);
+    void RingDoorbell(int ring, Bell bell);
+
+    Layout* m_shared;
+    unsigned char* m_data[2];
+    size_t m_ringBytes;
+    size_t m_mappedBytes;
+    int m_writeRing;
+    int m_readRing;
+    bool m_owner;
+    std::string m_name;
+    void* m_mapping;     // Windows: file mapping handle
+    void* m_bells[2][2];  // Windows: semaphore per ring and bell
+    PeerCheck m_peerCheck;
+
+    uint64_t m_sleeps;
+    uint64_t m_rings;
+};
@@ -0,0 +1,86 @@
+#include "StartupTrace.h"
+#include "Diagnostics.h"
+#include <cwchar>
+
+namespace {
+    const wchar_t* const kMilestoneNames[StartupTrace::MilestoneCount] = {
+        L"dialog init", L"first paint", L"input ready", L"history loaded",
+    };
+}
+
+StartupTrace::StartupTrace()
+    : m_tailMessages(0)
+    , m_totalMessages(0)
+    , m_plugins(0)
+    , m_deferredPlugins(0)
+    , m_pluginScanMs(0.0)
+    , m_deferredLoadMs(0.0)
+{
+    for (double& seconds : m_seconds) {
+        seconds = -1.0;
+    }
+}
+
+StartupTrace& StartupTrace::Shared()
+{
+    static StartupTrace trace;
+    static const bool registered = [] {
+        Diagnostics::RegisterSection(L"Startup", [] { return trace.Describe(); });
+        return true;
+    }();
+    (void)registered;
+    return trace;
+}
+
+void StartupTrace::Mark(Milestone milestone, double seconds)
+{
+    if (IsMarked(milestone)) {
+        return;
+    }
+    m_seconds[milestone] = seconds;
+    if (milestone == HistoryLoaded) {
+        Diagnostics::Log(L"startup: " + Timeline());
+    }
+}
+
+void StartupTrace::SetHistory(size_t tailMessages, size_t totalMessages)
+{
+    m_tailMessages = tailMessages;
+    m_totalMessages = totalMessages;
+}
+
+void StartupTrace::SetPlugins(size_t plugins, size_t deferred, double scanMs, double deferredLoadMs)
+{
+    m_plugins = plugins;
+    m_deferredPlugins = deferred;
+    m_pluginScanMs = scanMs;
+    m_deferredLoadMs = deferredLoadMs;
+}
+
+std::wstring StartupTrace::Describe() const
+{
+    wchar_t history[96];
+    swprintf(history, sizeof(history) / sizeof(history[0]), L"\r\nhistory: %zu messages shown first of %zu\r\n",
+             m_tailMessages, m_totalMessages);
+    wchar_t plugins[160];
+    swprintf(plugins, sizeof(plugins) / sizeof(plugins[0]),
+             L"plugins: %zu listed in %.1fms, %zu left unloaded until first use (%.1fms of DLL loading deferred)\r\n",
+             m_plugins, m_pluginScanMs, m_deferredPlugins, m_deferredLoadMs);
+    return Timeline() + history + plugins;
+}
+
+std::wstring StartupTrace::Timeline() const
+{
+    std::wstring text = L"process start";
+    for (int milestone = 0; milestone < MilestoneCount; ++milestone) {
+        wchar_t step[64];
+        if (m_seconds[milestone] >= 0.0) {
+            swprintf(step, sizeof(step) / sizeof(step[0]), L" -> %ls %.1fms",
+                     kMilestoneNames[milestone], m_seconds[milestone] * 1000.0);
+        } else {
+            swprintf(step, sizeof(step) / sizeof(step[0]), L" -> %ls pending", kMilestoneNames[milestone]);
+        }
+        text += step;
+    }
+    return text;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Startup milestones in seconds since the process was created, reported
+// under "Startup" in diagnostics and logged once history is fully loaded.
+// The caller supplies the clock so the module stays portable. UI thread only.
+class StartupTrace {
+public:
+    enum Milestone { DialogInit, FirstPaint, InputReady, HistoryLoaded, MilestoneCount };
+
+    StartupTrace();
+
+    static StartupTrace& Shared();
+
+    // The first mark of a milestone wins
+    void Mark(Milestone milestone, double seconds);
+    bool IsMarked(Milestone milestone) const { return m_seconds[milestone] >= 0.0; }
+    void SetHistory(size_t tailMessages, size_t totalMessages);
+
+    // Plugin scan: deferred plugins are listed from the manifest without
+    // loading; deferredLoadMs is what loading them took when last measured
+    void SetPlugins(size_t plugins, size_t deferred, double scanMs, double deferredLoadMs);
+
+    std::wstring Describe() const;
+
+private:
+    std::wstring Timeline() const;
+
+    double m_seconds[MilestoneCount];
+    size_t m_tailMessages;
+    size_t m_totalMessages;
+    size_t m_plugins;
+    size_t m_deferredPlugins;
+    double m_pluginScanMs;
+    double m_deferredLoadMs;
+};
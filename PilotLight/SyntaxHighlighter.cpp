@@ -0,0 +1,584 @@
+#include "SyntaxHighlighter.h"
+#include "Hash.h"
+#include <algorithm>
+#include <chrono>
+#include <cwchar>
+
+namespace {
+    constexpr size_t kMaxCachedBlocks = 128;
+    constexpr size_t kMaxWordLength = 32;
+
+    // What a leading '#', '@' or '$' means in a language
+    enum class MetaRule : uint8_t { None, Directive, Decorator, Variable };
+
+    // One row of the lexer table
+    struct LanguageRules {
+        const wchar_t* lineComment = nullptr;
+        const wchar_t* blockOpen = nullptr;
+        const wchar_t* blockClose = nullptr;
+        const wchar_t* quotes = L"";
+        const wchar_t* multilineQuotes = L"";  // Strings that may span lines
+        MetaRule meta = MetaRule::None;
+        bool tripleQuotes = false;
+        bool backslashEscapes = true;
+        bool caseInsensitive = false;    // Keyword tables are lower case
+        bool commentAfterSpace = false;  // '#' only starts a comment at a word boundary
+        bool digitSeparators = false;
+        bool identDollar = false;
+        bool keyStrings = false;  // A string followed by ':' is a key
+        std::vector<const wchar_t*> keywords;
+        std::vector<const wchar_t*> types;
+    };
+
+    enum : uint8_t { kSpace = 1, kIdentStart = 2, kDigit = 4 };
+
+    struct CharTable {
+        uint8_t classes[128];
+    };
+
+    constexpr CharTable MakeCharTable()
+    {
+        CharTable table = {};
+        for (int ch = 0; ch < 128; ++ch) {
+            if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\v' || ch == '\f') {
+                table.classes[ch] = kSpace;
+            } else if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_') {
+                table.classes[ch] = kIdentStart;
+            } else if (ch >= '0' && ch <= '9') {
+                table.classes[ch] = kDigit;
+            }
+        }
+        return table;
+    }
+
+    constexpr CharTable kChars = MakeCharTable();
+
+    // Characters outside ASCII count as identifier characters
+    bool HasClass(wchar_t ch, uint8_t classes, bool nonAscii)
+    {
+        const unsigned int unit = static_cast<unsigned int>(ch);
+        return unit < 128 ? (kChars.classes[unit] & classes) != 0 : nonAscii;
+    }
+
+    bool IsSpace(wchar_t ch) { return HasClass(ch, kSpace, false); }
+    bool IsDigit(wchar_t ch) { return HasClass(ch, kDigit, false); }
+    bool IsIdentStart(wchar_t ch) { return HasClass(ch, kIdentStart, true); }
+    bool IsIdent(wchar_t ch) { return HasClass(ch, kIdentStart | kDigit, true); }
+
+    bool Contains(const wchar_t* set, wchar_t ch)
+    {
+        for (; *set; ++set) {
+            if (*set == ch) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Matches(const wchar_t* text, size_t pos, size_t end, const wchar_t* marker)
+    {
+        for (; *marker; ++marker, ++pos) {
+            if (pos >= end || text[pos] != *marker) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t LineEnd(const wchar_t* text, size_t pos, size_t end)
+    {
+        const wchar_t* newline = pos < end ? wmemchr(text + pos, L'\n', end - pos) : nullptr;
+        return newline ? static_cast<size_t>(newline - text) : end;
+    }
+
+    bool WordLess(const wchar_t* a, const wchar_t* b)
+    {
+        return wcscmp(a, b) < 0;
+    }
+
+    const LanguageRules& Rules(SyntaxLanguage language)
+    {
+        static const std::vector<LanguageRules> table = [] {
+            std::vector<LanguageRules> rules(static_cast<size_t>(SyntaxLanguage::Sql) + 1);
+
+            LanguageRules& cpp = rules[static_cast<size_t>(SyntaxLanguage::Cpp)];
+            cpp.lineComment = L"//";
+            cpp.blockOpen = L"/*";
+            cpp.blockClose = L"*/";
+            cpp.quotes = L"\"'";
+            cpp.meta = MetaRule::Directive;
+            cpp.digitSeparators = true;
+            cpp.keywords = {
+                L"alignas", L"alignof", L"asm", L"auto", L"break", L"case", L"catch", L"class", L"co_await",
+                L"co_return", L"co_yield", L"const", L"const_cast", L"consteval", L"constexpr", L"constinit",
+                L"continue", L"decltype", L"default", L"delete", L"do", L"dynamic_cast", L"else", L"enum",
+                L"explicit", L"export", L"extern", L"false", L"final", L"for", L"friend", L"goto", L"if",
+                L"inline", L"mutable", L"namespace", L"new", L"noexcept", L"nullptr", L"operator", L"override",
+                L"private", L"protected", L"public", L"register", L"reinterpret_cast", L"requires", L"return",
+                L"sizeof", L"static", L"static_assert", L"static_cast", L"struct", L"switch", L"template",
+                L"this", L"thread_local", L"throw", L"true", L"try", L"typedef", L"typeid", L"typename",
+                L"union", L"using", L"virtual", L"volatile", L"while",
+            };
+            cpp.types = {
+                L"bool", L"char", L"char16_t", L"char32_t", L"char8_t", L"double", L"float", L"int",
+                L"int16_t", L"int32_t", L"int64_t", L"int8_t", L"long", L"ptrdiff_t", L"short", L"signed",
+                L"size_t", L"uint16_t", L"uint32_t", L"uint64_t", L"uint8_t", L"unsigned", L"void", L"wchar_t",
+            };
+
+            LanguageRules& python = rules[static_cast<size_t>(SyntaxLanguage::Python)];
+            python.lineComment = L"#";
+            python.quotes = L"\"'";
+            python.tripleQuotes = true;
+            python.meta = MetaRule::Decorator;
+            python.keywords = {
+                L"False", L"None", L"True", L"and", L"as", L"assert", L"async", L"await", L"break", L"class",
+                L"continue", L"def", L"del", L"elif", L"else", L"except", L"finally", L"for", L"from",
+                L"global", L"if", L"import", L"in", L"is", L"lambda", L"match", L"nonlocal", L"not", L"or",
+                L"pass", L"raise", L"return", L"try", L"while", L"with", L"yield",
+            };
+            python.types = {
+                L"bool", L"bytes", L"cls", L"dict", L"float", L"int", L"len", L"list", L"object", L"print",
+                L"range", L"self", L"set", L"str", L"super", L"tuple", L"type",
+            };
+
+            LanguageRules& script = rules[static_cast<size_t>(SyntaxLanguage::JavaScript)];
+            script.lineComment = L"//";
+            script.blockOpen = L"/*";
+            script.blockClose = L"*/";
+            script.quotes = L"\"'`";
+            script.multilineQuotes = L"`";
+            script.meta = MetaRule::Decorator;
+            script.identDollar = true;
+            script.keywords = {
+                L"abstract", L"as", L"async", L"await", L"break", L"case", L"catch", L"class", L"const",
+                L"continue", L"debugger", L"declare", L"default", L"delete", L"do", L"else", L"enum",
+                L"export", L"extends", L"false", L"finally", L"for", L"from", L"function", L"get", L"if",
+                L"implements", L"import", L"in", L"instanceof", L"interface", L"let", L"new", L"null", L"of",
+                L"private", L"protected", L"public", L"readonly", L"return", L"set", L"static", L"super",
+                L"switch", L"this", L"throw", L"true", L"try", L"type", L"typeof", L"undefined", L"var",
+                L"void", L"while", L"with", L"yield",
+            };
+            script.types = {
+                L"Array", L"Boolean", L"Date", L"Error", L"Map", L"Number", L"Object", L"Promise", L"Set",
+                L"String", L"any", L"bigint", L"boolean", L"never", L"number", L"object", L"string",
+                L"symbol", L"unknown",
+            };
+
+            LanguageRules& json = rules[static_cast<size_t>(SyntaxLanguage::Json)];
+            json.lineComment = L"//";  // JSONC
+            json.blockOpen = L"/*";
+            json.blockClose = L"*/";
+            json.quotes = L"\"";
+            json.keyStrings = true;
+            json.keywords = { L"false", L"null", L"true" };
+
+            LanguageRules& shell = rules[static_cast<size_t>(SyntaxLanguage::Shell)];
+            shell.lineComment = L"#";
+            shell.commentAfterSpace = true;
+            shell.quotes = L"\"'";
+            shell.multilineQuotes = L"\"'";
+            shell.meta = MetaRule::Variable;
+            shell.keywords = {
+                L"case", L"do", L"done", L"elif", L"else", L"esac", L"export", L"fi", L"for", L"function",
+                L"if", L"in", L"local", L"readonly", L"return", L"select", L"then", L"until", L"while",
+            };
+            shell.types = {
+                L"alias", L"cd", L"echo", L"eval", L"exec", L"exit", L"printf", L"read", L"set", L"shift",
+                L"source", L"test", L"trap", L"unset",
+            };
+
+            LanguageRules& sql = rules[static_cast<size_t>(SyntaxLanguage::Sql)];
+            sql.lineComment = L"--";
+            sql.blockOpen = L"/*";
+            sql.blockClose = L"*/";
+            sql.quotes = L"'\"";
+            sql.multilineQuotes = L"'";
+            sql.backslashEscapes = false;
+            sql.caseInsensitive = true;
+            sql.keywords = {
+                L"add", L"all", L"alter", L"and", L"as", L"asc", L"begin", L"between", L"by", L"case",
+                L"commit", L"constraint", L"create", L"cross", L"default", L"delete", L"desc", L"distinct",
+                L"drop", L"else", L"end", L"exists", L"foreign", L"from", L"full", L"group", L"having", L"if",
+                L"in", L"index", L"inner", L"insert", L"into", L"is", L"join", L"key", L"left", L"like",
+                L"limit", L"not", L"null", L"offset", L"on", L"or", L"order", L"outer", L"primary",
+                L"references", L"returning", L"right", L"rollback", L"select", L"set", L"table", L"then",
+                L"transaction", L"union", L"unique", L"update", L"using", L"values", L"view", L"when",
+                L"where", L"with",
+            };
+            sql.types = {
+                L"avg", L"bigint", L"blob", L"boolean", L"char", L"coalesce", L"count", L"date", L"decimal",
+                L"float", L"int", L"integer", L"max", L"min", L"numeric", L"real", L"serial", L"sum", L"text",
+                L"timestamp", L"varchar",
+            };
+
+            for (LanguageRules& row : rules) {
+                std::sort(row.keywords.begin(), row.keywords.end(), WordLess);
+                std::sort(row.types.begin(), row.types.end(), WordLess);
+            }
+            return rules;
+        }();
+        return table[static_cast<size_t>(language)];
+    }
+
+    bool InTable(const std::vector<const wchar_t*>& table, const wchar_t* word)
+    {
+        const auto found = std::lower_bound(table.begin(), table.end(), word, WordLess);
+        return found != table.end() && wcscmp(*found, word) == 0;
+    }
+
+    SyntaxToken ClassifyWord(const LanguageRules& rules, const wchar_t* text, size_t length)
+    {
+        if (length >= kMaxWordLength) {
+            return SyntaxToken::Plain;
+        }
+        wchar_t word[kMaxWordLength];
+        for (size_t i = 0; i < length; ++i) {
+            const wchar_t ch = text[i];
+            word[i] = rules.caseInsensitive && ch >= L'A' && ch <= L'Z' ? static_cast<wchar_t>(ch + 32) : ch;
+        }
+        word[length] = 0;
+        if (InTable(rules.keywords, word)) {
+            return SyntaxToken::Keyword;
+        }
+        return InTable(rules.types, word) ? SyntaxToken::Type : SyntaxToken::Plain;
+    }
+
+    // A span continuing the previous one with the same token extends it, so a
+    // comment or string that crosses a resume point still comes out as one span
+    void PushSpan(std::vector<SyntaxSpan>& spans, size_t start, size_t end, SyntaxToken token)
+    {
+        if (end <= start) {
+            return;
+        }
+        if (!spans.empty() && spans.back().token == token && spans.back().start + spans.back().length == start) {
+            spans.back().length = static_cast<uint32_t>(end - spans.back().start);
+            return;
+        }
+        spans.push_back(SyntaxSpan{ static_cast<uint32_t>(start), static_cast<uint32_t>(end - start), token });
+    }
+
+    // Scans from inside a comment; returns the position after its close, or end
+    size_t ScanBlockComment(const LanguageRules& rules, const wchar_t* text, size_t pos, size_t end,
+                            SyntaxState& state)
+    {
+        const wchar_t closeFirst = rules.blockClose[0];
+        for (; pos < end; ++pos) {
+            if (text[pos] == closeFirst && Matches(text, pos, end, rules.blockClose)) {
+                state.mode = SyntaxState::Normal;
+                return pos + wcslen(rules.blockClose);
+            }
+        }
+        return end;
+    }
+
+    // Scans from inside a string; single-line strings also stop at the line break
+    size_t ScanString(const LanguageRules& rules, const wchar_t* text, size_t pos, size_t end, SyntaxState& state)
+    {
+        const bool triple = state.mode == SyntaxState::TripleString;
+        const bool multiline = triple || Contains(rules.multilineQuotes, state.quote);
+        while (pos < end) {
+            const wchar_t ch = text[pos];
+            if (ch == L'\\' && rules.backslashEscapes) {
+                pos = (std::min)(pos + 2, end);
+                continue;
+            }
+            if (ch == state.quote) {
+                if (!triple) {
+                    state.mode = SyntaxState::Normal;
+                    return pos + 1;
+                }
+                if (pos + 2 < end && text[pos + 1] == ch && text[pos + 2] == ch) {
+                    state.mode = SyntaxState::Normal;
+                    return pos + 3;
+                }
+            }
+            if (ch == L'\n' && !multiline) {
+                state.mode = SyntaxState::Normal;
+                return pos;
+            }
+            ++pos;
+        }
+        return end;
+    }
+
+    // $name, ${...}, $1, $? and friends
+    size_t ScanVariable(const wchar_t* text, size_t pos, size_t end)
+    {
+        ++pos;
+        if (pos < end && text[pos] == L'{') {
+            while (pos < end && text[pos] != L'}' && text[pos] != L'\n') {
+                ++pos;
+            }
+            return pos < end && text[pos] == L'}' ? pos + 1 : pos;
+        }
+        if (pos < end && IsIdentStart(text[pos])) {
+            while (pos < end && IsIdent(text[pos])) {
+                ++pos;
+            }
+            return pos;
+        }
+        return pos < end && (IsDigit(text[pos]) || Contains(L"?@#*$!-", text[pos])) ? pos + 1 : pos;
+    }
+}
+
+SyntaxLanguage SyntaxLexer::LanguageFromInfo(const wchar_t* info, size_t length)
+{
+    // First word of the info string, lower case: "python title=x" -> "python"
+    wchar_t word[16];
+    size_t count = 0;
+    size_t i = 0;
+    while (i < length && IsSpace(info[i])) {
+        ++i;
+    }
+    for (; i < length && !IsSpace(info[i]) && info[i] != L',' && info[i] != L'{'; ++i) {
+        if (count + 1 >= sizeof(word) / sizeof(word[0])) {
+            return SyntaxLanguage::None;
+        }
+        const wchar_t ch = info[i];
+        word[count++] = ch >= L'A' && ch <= L'Z' ? static_cast<wchar_t>(ch + 32) : ch;
+    }
+    word[count] = 0;
+
+    static const struct {
+        const wchar_t* name;
+        SyntaxLanguage language;
+    } kAliases[] = {
+        { L"c", SyntaxLanguage::Cpp },           { L"cpp", SyntaxLanguage::Cpp },
+        { L"c++", SyntaxLanguage::Cpp },         { L"cc", SyntaxLanguage::Cpp },
+        { L"cxx", SyntaxLanguage::Cpp },         { L"h", SyntaxLanguage::Cpp },
+        { L"hpp", SyntaxLanguage::Cpp },         { L"python", SyntaxLanguage::Python },
+        { L"py", SyntaxLanguage::Python },       { L"python3", SyntaxLanguage::Python },
+        { L"javascript", SyntaxLanguage::JavaScript }, { L"js", SyntaxLanguage::JavaScript },
+        { L"jsx", SyntaxLanguage::JavaScript },  { L"mjs", SyntaxLanguage::JavaScript },
+        { L"typescript", SyntaxLanguage::JavaScript }, { L"ts", SyntaxLanguage::JavaScript },
+        { L"tsx", SyntaxLanguage::JavaScript },  { L"json", SyntaxLanguage::Json },
+        { L"jsonc", SyntaxLanguage::Json },      { L"json5", SyntaxLanguage::Json },
+        { L"sh", SyntaxLanguage::Shell },        { L"bash", SyntaxLanguage::Shell },
+        { L"shell", SyntaxLanguage::Shell },     { L"zsh", SyntaxLanguage::Shell },
+        { L"sql", SyntaxLanguage::Sql },         { L"mysql", SyntaxLanguage::Sql },
+        { L"postgresql", SyntaxLanguage::Sql },  { L"postgres", SyntaxLanguage::Sql },
+        { L"sqlite", SyntaxLanguage::Sql },      { L"tsql", SyntaxLanguage::Sql },
+    };
+    for (const auto& alias : kAliases) {
+        if (wcscmp(alias.name, word) == 0) {
+            return alias.language;
+        }
+    }
+    return SyntaxLanguage::None;
+}
+
+SyntaxState SyntaxLexer::Lex(SyntaxLanguage language, const wchar_t* text, size_t begin, size_t end,
+                             SyntaxState state, std::vector<SyntaxSpan>& spans)
+{
+    if (language == SyntaxLanguage::None) {
+        return state;
+    }
+    const LanguageRules& rules = Rules(language);
+    size_t pos = begin;
+    bool lineStart = true;
+
+    // Finish a comment or string the previous line left open
+    if (state.mode == SyntaxState::BlockComment) {
+        pos = ScanBlockComment(rules, text, pos, end, state);
+        PushSpan(spans, begin, pos, SyntaxToken::Comment);
+        lineStart = false;
+    } else if (state.mode != SyntaxState::Normal) {
+        pos = ScanString(rules, text, pos, end, state);
+        PushSpan(spans, begin, pos, SyntaxToken::String);
+        lineStart = false;
+    }
+
+    while (pos < end) {
+        const wchar_t ch = text[pos];
+        if (ch == L'\n') {
+            lineStart = true;
+            ++pos;
+            continue;
+        }
+        if (IsSpace(ch)) {
+            ++pos;
+            continue;
+        }
+        const bool firstOnLine = lineStart;
+        lineStart = false;
+        const size_t start = pos;
+
+        if (rules.lineComment && ch == rules.lineComment[0] && Matches(text, pos, end, rules.lineComment) &&
+            (!rules.commentAfterSpace || pos == begin || IsSpace(text[pos - 1]) || text[pos - 1] == L'\n')) {
+            pos = LineEnd(text, pos, end);
+            PushSpan(spans, start, pos, SyntaxToken::Comment);
+            continue;
+        }
+        if (rules.blockOpen && ch == rules.blockOpen[0] && Matches(text, pos, end, rules.blockOpen)) {
+            state.mode = SyntaxState::BlockComment;
+            pos = ScanBlockComment(rules, text, pos + wcslen(rules.blockOpen), end, state);
+            PushSpan(spans, start, pos, SyntaxToken::Comment);
+            continue;
+        }
+
+        if (rules.meta == MetaRule::Directive && ch == L'#' && firstOnLine) {
+            pos = LineEnd(text, pos, end);
+            PushSpan(spans, start, pos, SyntaxToken::Meta);
+            continue;
+        }
+        if (rules.meta == MetaRule::Decorator && ch == L'@' && pos + 1 < end && IsIdentStart(text[pos + 1])) {
+            ++pos;
+            while (pos < end && (IsIdent(text[pos]) || text[pos] == L'.')) {
+                ++pos;
+            }
+            PushSpan(spans, start, pos, SyntaxToken::Meta);
+            continue;
+        }
+        if (rules.meta == MetaRule::Variable && ch == L'$') {
+            pos = ScanVariable(text, pos, end);
+            PushSpan(spans, start, pos, SyntaxToken::Meta);
+            continue;
+        }
+
+        if (ch != 0 && Contains(rules.quotes, ch)) {
+            state.quote = ch;
+            if (rules.tripleQuotes && pos + 2 < end && text[pos + 1] == ch && text[pos + 2] == ch) {
+                state.mode = SyntaxState::TripleString;
+                pos += 3;
+            } else {
+                state.mode = SyntaxState::String;
+                ++pos;
+            }
+            pos = ScanString(rules, text, pos, end, state);
+
+            SyntaxToken token = SyntaxToken::String;
+            if (rules.keyStrings && state.mode == SyntaxState::Normal) {
+                size_t next = pos;
+                while (next < end && IsSpace(text[next])) {
+                    ++next;
+                }
+                if (next < end && text[next] == L':') {
+                    token = SyntaxToken::Type;
+                }
+            }
+            PushSpan(spans, start, pos, token);
+            continue;
+        }
+
+        if (IsDigit(ch) || (ch == L'.' && pos + 1 < end && IsDigit(text[pos + 1]))) {
+            ++pos;
+            while (pos < end && (IsIdent(text[pos]) || text[pos] == L'.' ||
+                                 (rules.digitSeparators && text[pos] == L'\''))) {
+                ++pos;
+            }
+            PushSpan(spans, start, pos, SyntaxToken::Number);
+            continue;
+        }
+
+        if (IsIdentStart(ch) || (rules.identDollar && ch == L'$')) {
+            ++pos;
+            while (pos < end && (IsIdent(text[pos]) || (rules.identDollar && text[pos] == L'$'))) {
+                ++pos;
+            }
+            const SyntaxToken token = ClassifyWord(rules, text + start, pos - start);
+            if (token != SyntaxToken::Plain) {
+                PushSpan(spans, start, pos, token);
+            }
+            continue;
+        }
+
+        ++pos;
+    }
+    return state;
+}
+
+SyntaxHighlighter::SyntaxHighlighter()
+    : m_openLanguage(SyntaxLanguage::None)
+    , m_openId(0)
+    , m_openSpanCount(0)
+    , m_blocks(0)
+    , m_cacheHits(0)
+    , m_resumes(0)
+    , m_charsLexed(0)
+    , m_lexSeconds(0.0)
+{
+}
+
+const std::vector<SyntaxSpan>& SyntaxHighlighter::Highlight(SyntaxLanguage language, const wchar_t* code,
+                                                            size_t length, uint64_t growingId)
+{
+    if (language == SyntaxLanguage::None) {
+        m_spans.clear();
+        m_openLanguage = SyntaxLanguage::None;
+        return m_spans;
+    }
+    ++m_blocks;
+
+    // A block that only grew keeps everything up to its last complete line
+    if (language == m_openLanguage && length >= m_openPrefix.length() &&
+        ((growingId != 0 && growingId == m_openId) ||
+         wmemcmp(code, m_openPrefix.data(), m_openPrefix.length()) == 0)) {
+        m_openId = growingId;
+        ++m_resumes;
+        Resume(code, length);
+        return m_spans;
+    }
+
+    const uint64_t key = Hash::Fnv1a64(code, length * sizeof(wchar_t),
+                                       Hash::kFnvOffset ^ static_cast<uint64_t>(language));
+    const auto found = m_cache.find(key);
+    if (found != m_cache.end() && found->second.language == language && found->second.length == length) {
+        ++m_cacheHits;
+        return found->second.spans;
+    }
+
+    m_openLanguage = language;
+    m_openId = growingId;
+    m_openPrefix.clear();
+    m_openState = SyntaxState();
+    m_openSpanCount = 0;
+    Resume(code, length);
+
+    if (found == m_cache.end()) {
+        if (m_cacheOrder.size() >= kMaxCachedBlocks) {
+            m_cache.erase(m_cacheOrder.front());
+            m_cacheOrder.pop_front();
+        }
+        m_cacheOrder.push_back(key);
+    }
+    m_cache[key] = CachedBlock{ language, length, m_spans };
+    return m_spans;
+}
+
+void SyntaxHighlighter::Resume(const wchar_t* code, size_t length)
+{
+    const auto started = std::chrono::steady_clock::now();
+    const size_t from = m_openPrefix.length();
+    size_t lineStart = from;
+    for (size_t i = length; i > from; --i) {
+        if (code[i - 1] == L'\n') {
+            lineStart = i;
+            break;
+        }
+    }
+
+    // Complete lines are final; the unfinished last line is lexed again next
+    // time, including any part of it merged into the last complete-line span
+    m_spans.resize(m_openSpanCount);
+    if (!m_spans.empty() && m_spans.back().start + m_spans.back().length > from) {
+        m_spans.back().length = static_cast<uint32_t>(from - m_spans.back().start);
+    }
+    m_openState = SyntaxLexer::Lex(m_openLanguage, code, from, lineStart, m_openState, m_spans);
+    m_openSpanCount = m_spans.size();
+    m_openPrefix.append(code + from, lineStart - from);
+    SyntaxLexer::Lex(m_openLanguage, code, lineStart, length, m_openState, m_spans);
+
+    m_charsLexed += length - from;
+    m_lexSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+std::wstring SyntaxHighlighter::Describe() const
+{
+    wchar_t text[200];
+    swprintf(text, sizeof(text) / sizeof(text[0]),
+             L"blocks=%llu cache hits=%llu resumed=%llu lexed=%llu chars (%.1f MB/s)\r\n",
+             static_cast<unsigned long long>(m_blocks), static_cast<unsigned long long>(m_cacheHits),
+             static_cast<unsigned long long>(m_resumes), static_cast<unsigned long long>(m_charsLexed),
+             m_lexSeconds > 0.0 ? m_charsLexed / m_lexSeconds / 1e6 : 0.0);
+    return text;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class SyntaxLanguage : uint8_t { None, Cpp, Python, JavaScript, Json, Shell, Sql };
+
+enum class SyntaxToken : uint8_t { Plain, Keyword, Type, String, Number, Comment, Meta };
+constexpr size_t kSyntaxTokenCount = 7;
+
+// Colored range of a code block; offsets are relative to the block content
+struct SyntaxSpan {
+    uint32_t start;
+    uint32_t length;
+    SyntaxToken token;
+};
+
+// Lexer state at a line boundary: what the previous line left open
+struct SyntaxState {
+    enum : uint8_t { Normal, BlockComment, String, TripleString };
+
+    uint8_t mode = Normal;
+    wchar_t quote = 0;
+};
+
+// Table-driven lexer for the languages most often seen in answers. Each
+// language is a row of rules (comment markers, quote characters, keyword and
+// type tables) run by one scanner, so adding a language is a table entry.
+// Lexing a range that starts at a line boundary only needs the state the
+// previous line ended in. Portable (no Windows headers).
+class SyntaxLexer {
+public:
+    // Maps a fence info string ("cpp", "py", "ts", "bash", ...) to a language
+    static SyntaxLanguage LanguageFromInfo(const wchar_t* info, size_t length);
+
+    // Appends non-plain spans for text[begin, end); begin must start a line.
+    // Returns the state to resume with at end.
+    static SyntaxState Lex(SyntaxLanguage language, const wchar_t* text, size_t begin, size_t end,
+                           SyntaxState state, std::vector<SyntaxSpan>& spans);
+};
+
+// Highlights fenced code blocks for one renderer. Finished blocks are cached
+// by content hash; a block that extends the previous one (a streaming reply)
+// resumes from the state saved at its last complete line, so each delta costs
+// the new lines plus the unfinished one. Not thread-safe; owned by a renderer.
+class SyntaxHighlighter {
+public:
+    SyntaxHighlighter();
+
+    // Spans for code[0, length); valid until the next call. A nonzero growingId
+    // promises the block only grew since the last call with the same id, which
+    // skips re-checking the unchanged prefix.
+    const std::vector<SyntaxSpan>& Highlight(SyntaxLanguage language, const wchar_t* code, size_t length,
+                                             uint64_t growingId = 0);
+
+    std::wstring Describe() const;
+
+private:
+    struct CachedBlock {
+        SyntaxLanguage language;
+        size_t length;
+        std::vector<SyntaxSpan> spans;
+    };
+
+    void Resume(const wchar_t* code, size_t length);
+
+    // The block most recently lexed; prefix holds its complete lines
+    SyntaxLanguage m_openLanguage;
+    uint64_t m_openId;
+    std::wstring m_openPrefix;
+    SyntaxState m_openState;
+    size_t m_openSpanCount;
+    std::vector<SyntaxSpan> m_spans;
+
+    std::unordered_map<uint64_t, CachedBlock> m_cache;
+    std::deque<uint64_t> m_cacheOrder;  // Oldest first
+
+    uint64_t m_blocks;
+    uint64_t m_cacheHits;
+    uint64_t m_resumes;
+    uint64_t m_charsLexed;
+    double m_lexSeconds;
+};
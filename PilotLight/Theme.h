@@ -30,6 +30,17 @@ namespace Theme {
     constexpr COLORREF Accent     = RGB(0,122,204);
     constexpr COLORREF Text       = RGB(220,220,220);
 
+    // Code block syntax colors
+    constexpr COLORREF SyntaxKeyword = RGB(86, 156, 214);      // #569CD6
+    constexpr COLORREF SyntaxType = RGB(78, 201, 176);         // #4EC9B0
+    constexpr COLORREF SyntaxString = RGB(206, 145, 120);      // #CE9178
+    constexpr COLORREF SyntaxNumber = RGB(181, 206, 168);      // #B5CEA8
+    constexpr COLORREF SyntaxComment = RGB(106, 153, 85);      // #6A9955
+    constexpr COLORREF SyntaxMeta = RGB(197, 134, 192);        // #C586C0
+
+    // Bump when colors or fonts change; cached message renderings are keyed by it
+    constexpr UINT Version = 2;
+
     // Button state tracking
     enum class ButtonState {
         Normal,
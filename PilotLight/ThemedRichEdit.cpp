@@ -9,6 +9,12 @@ CThemedRichEdit::CThemedRichEdit()
     , m_nDragStartY(0)
     , m_nDragStartScrollPos(0)
     , m_bInitialized(false)
+    , m_virtualAbove(0)
+    , m_virtualBelow(0)
+    , m_lineHeightValid(false)
+    , m_lineCountValid(false)
+    , m_viewportValid(false)
+    , m_stripSize(0, 0)
 {
 }
 
@@ -28,6 +34,12 @@ BEGIN_MESSAGE_MAP(CThemedRichEdit, CRichEditCtrl)
     ON_WM_SIZE()
     ON_WM_SHOWWINDOW()
     ON_MESSAGE(WM_SETTEXT, &CThemedRichEdit::OnSetText)
+    ON_MESSAGE(WM_SETFONT, &CThemedRichEdit::OnSetFontMessage)
+    ON_MESSAGE(EM_STREAMIN, &CThemedRichEdit::OnContentChanged)
+    ON_MESSAGE(EM_REPLACESEL, &CThemedRichEdit::OnContentChanged)
+    ON_MESSAGE(EM_SETTEXTEX, &CThemedRichEdit::OnContentChanged)
+    ON_MESSAGE(EM_SETRECT, &CThemedRichEdit::OnContentChanged)
+    ON_MESSAGE(EM_SETRECTNP, &CThemedRichEdit::OnContentChanged)
 END_MESSAGE_MAP()
 
 void CThemedRichEdit::PreSubclassWindow()
@@ -53,6 +65,16 @@ void CThemedRichEdit::InitThemedScrollbar()
     m_bInitialized = true;
 }
 
+void CThemedRichEdit::SetVirtualExtent(int pixelsAbove, int pixelsBelow)
+{
+    if (pixelsAbove != m_virtualAbove || pixelsBelow != m_virtualBelow) {
+        m_virtualAbove = pixelsAbove;
+        m_virtualBelow = pixelsBelow;
+        m_geometry.SetVirtualExtent(pixelsAbove, pixelsBelow);
+        RedrawScrollbar();
+    }
+}
+
 void CThemedRichEdit::OnShowWindow(BOOL bShow, UINT nStatus)
 {
     CRichEditCtrl::OnShowWindow(bShow, nStatus);
@@ -64,6 +86,15 @@ void CThemedRichEdit::OnShowWindow(BOOL bShow, UINT nStatus)
     }
 }
 
+// Right edge of the client area the scrollbar owns, margins included
+CRect CThemedRichEdit::GetScrollbarStripRect()
+{
+    CRect clientRect;
+    GetClientRect(&clientRect);
+    clientRect.left = max(clientRect.left, clientRect.right - SCROLLBAR_WIDTH);
+    return clientRect;
+}
+
 CRect CThemedRichEdit::GetScrollbarTrackRect()
 {
     CRect clientRect;
@@ -78,81 +109,51 @@ CRect CThemedRichEdit::GetScrollbarTrackRect()
     return trackRect;
 }
 
-int CThemedRichEdit::GetThumbHeight()
+// Geometry with stale parts refreshed; the font and line count are only queried after a change
+const ScrollGeometry& CThemedRichEdit::Geometry()
 {
-    // Get total line count and visible lines
-    int totalLines = GetLineCount();
-    if (totalLines <= 0) totalLines = 1;
-    
-    CRect clientRect;
-    GetClientRect(&clientRect);
-    
-    // Estimate visible lines based on font height
-    CDC* pDC = GetDC();
-    TEXTMETRIC tm;
-    pDC->GetTextMetrics(&tm);
-    ReleaseDC(pDC);
-    
-    int lineHeight = tm.tmHeight + tm.tmExternalLeading;
-    if (lineHeight <= 0) lineHeight = 20;
-    
-    int visibleLines = clientRect.Height() / lineHeight;
-    if (visibleLines <= 0) visibleLines = 1;
-    
-    if (totalLines <= visibleLines) {
-        return 0;  // No scrolling needed
+    if (!m_lineHeightValid) {
+        CDC* pDC = GetDC();
+        TEXTMETRIC tm;
+        pDC->GetTextMetrics(&tm);
+        ReleaseDC(pDC);
+        m_geometry.SetLineHeight(tm.tmHeight + tm.tmExternalLeading);
+        m_lineHeightValid = true;
     }
-    
-    CRect trackRect = GetScrollbarTrackRect();
-    int trackHeight = trackRect.Height();
-    
-    int thumbHeight = (int)((float)visibleLines / totalLines * trackHeight);
-    
-    // Minimum thumb size
-    return max(30, thumbHeight);
+    if (!m_lineCountValid) {
+        m_geometry.SetLineCount(GetLineCount());
+        m_lineCountValid = true;
+    }
+    if (!m_viewportValid) {
+        CRect clientRect;
+        GetClientRect(&clientRect);
+        m_geometry.SetViewport(clientRect.Height(), GetScrollbarTrackRect().Height());
+        m_viewportValid = true;
+    }
+    return m_geometry;
+}
+
+int CThemedRichEdit::GetThumbHeight()
+{
+    return Geometry().ThumbHeight();
 }
 
 int CThemedRichEdit::GetThumbPosition()
 {
-    int totalLines = GetLineCount();
-    if (totalLines <= 0) return 0;
-    
-    int firstVisible = GetFirstVisibleLine();
-    
-    CRect clientRect;
-    GetClientRect(&clientRect);
-    
-    CDC* pDC = GetDC();
-    TEXTMETRIC tm;
-    pDC->GetTextMetrics(&tm);
-    ReleaseDC(pDC);
-    
-    int lineHeight = tm.tmHeight + tm.tmExternalLeading;
-    if (lineHeight <= 0) lineHeight = 20;
-    
-    int visibleLines = clientRect.Height() / lineHeight;
-    if (visibleLines <= 0) visibleLines = 1;
-    
-    int scrollableLines = totalLines - visibleLines;
-    if (scrollableLines <= 0) return 0;
-    
-    CRect trackRect = GetScrollbarTrackRect();
-    int trackHeight = trackRect.Height();
-    int thumbHeight = GetThumbHeight();
-    int scrollableTrack = trackHeight - thumbHeight;
-    
-    if (scrollableTrack <= 0) return 0;
-    
-    // Clamp firstVisible to valid range
-    firstVisible = min(firstVisible, scrollableLines);
-    firstVisible = max(0, firstVisible);
-    
-    int thumbPos = (int)((float)firstVisible / scrollableLines * scrollableTrack);
-    
-    // Clamp thumb position to ensure it stays within track bounds
-    thumbPos = max(0, min(scrollableTrack, thumbPos));
-    
-    return thumbPos;
+    return Geometry().ThumbOffset(GetFirstVisibleLine());
+}
+
+int CThemedRichEdit::GetLineHeight()
+{
+    return Geometry().LineHeight();
+}
+
+void CThemedRichEdit::NotifyScrolled()
+{
+    CWnd* pParent = GetParent();
+    if (pParent) {
+        pParent->SendMessage(WM_THEMED_SCROLL, ThemedScrollMoved, 0);
+    }
 }
 
 CRect CThemedRichEdit::GetThumbRect()
@@ -185,6 +186,49 @@ CRect CThemedRichEdit::GetThumbRect()
     return thumbRect;
 }
 
+// Track and thumb are drawn into a bitmap the size of the strip, then copied,
+// so the thumb never flickers against the background the control painted
+void CThemedRichEdit::PaintScrollbarStrip(CDC* pDC)
+{
+    const CRect stripRect = GetScrollbarStripRect();
+    if (stripRect.IsRectEmpty()) {
+        return;
+    }
+
+    CDC memDC;
+    if (!memDC.CreateCompatibleDC(pDC)) {
+        DrawThemedScrollbar(pDC);
+        return;
+    }
+    if (m_stripSize != stripRect.Size() || !m_stripBitmap.GetSafeHandle()) {
+        m_stripBitmap.DeleteObject();
+        if (!m_stripBitmap.CreateCompatibleBitmap(pDC, stripRect.Width(), stripRect.Height())) {
+            m_stripSize = CSize(0, 0);
+            DrawThemedScrollbar(pDC);
+            return;
+        }
+        m_stripSize = stripRect.Size();
+    }
+
+    CBitmap* pOldBitmap = memDC.SelectObject(&m_stripBitmap);
+    memDC.SetViewportOrg(-stripRect.left, -stripRect.top);
+    memDC.FillSolidRect(&stripRect, Theme::ChatBackground);
+    DrawThemedScrollbar(&memDC);
+    memDC.SetViewportOrg(0, 0);
+    pDC->BitBlt(stripRect.left, stripRect.top, stripRect.Width(), stripRect.Height(), &memDC, 0, 0, SRCCOPY);
+    memDC.SelectObject(pOldBitmap);
+}
+
+// Thumb moved or changed state: repaint the strip alone instead of the whole control
+void CThemedRichEdit::RedrawScrollbar()
+{
+    if (!GetSafeHwnd() || !IsWindowVisible()) {
+        return;
+    }
+    CClientDC dc(this);
+    PaintScrollbarStrip(&dc);
+}
+
 void CThemedRichEdit::DrawThemedScrollbar(CDC* pDC)
 {
     // Check if scrolling is needed
@@ -241,15 +285,16 @@ void CThemedRichEdit::OnPaint()
     
     // Now draw our scrollbar overlay on top
     CClientDC dc(this);
-    DrawThemedScrollbar(&dc);
+    PaintScrollbarStrip(&dc);
 }
 
 void CThemedRichEdit::OnVScroll(UINT nSBCode, UINT nPos, CScrollBar* pScrollBar)
 {
     CRichEditCtrl::OnVScroll(nSBCode, nPos, pScrollBar);
+    NotifyScrolled();
     
-    // Redraw to update scrollbar position
-    Invalidate(FALSE);
+    // The control repaints the scrolled text itself; only the thumb moves
+    RedrawScrollbar();
 }
 
 void CThemedRichEdit::OnMouseMove(UINT nFlags, CPoint point)
@@ -259,42 +304,27 @@ void CThemedRichEdit::OnMouseMove(UINT nFlags, CPoint point)
     
     // Handle thumb dragging
     if (m_bThumbPressed) {
-        int totalLines = GetLineCount();
-        int firstVisible = GetFirstVisibleLine();
-        
-        CRect clientRect;
-        GetClientRect(&clientRect);
-        
-        CDC* pDC = GetDC();
-        TEXTMETRIC tm;
-        pDC->GetTextMetrics(&tm);
-        ReleaseDC(pDC);
-        
-        int lineHeight = tm.tmHeight + tm.tmExternalLeading;
-        if (lineHeight <= 0) lineHeight = 20;
-        
-        int visibleLines = clientRect.Height() / lineHeight;
-        int scrollableLines = totalLines - visibleLines;
-        
-        int trackHeight = trackRect.Height();
-        int thumbHeight = GetThumbHeight();
-        int scrollableTrack = trackHeight - thumbHeight;
+        const ScrollGeometry& geometry = Geometry();
+        int newFirstLine = geometry.DragTarget(m_nDragStartScrollPos, point.y - m_nDragStartY);
         
-        if (scrollableTrack > 0 && scrollableLines > 0) {
-            int deltaY = point.y - m_nDragStartY;
-            int deltaLines = (int)((float)deltaY / scrollableTrack * scrollableLines);
-            int newFirstLine = m_nDragStartScrollPos + deltaLines;
-            
-            // Clamp to valid range
-            newFirstLine = max(0, min(scrollableLines, newFirstLine));
-            
-            // Scroll to the new position
-            int linesToScroll = newFirstLine - firstVisible;
-            if (linesToScroll != 0) {
-                LineScroll(linesToScroll);
+        if (newFirstLine >= 0) {
+            // Targets outside the loaded content are fetched by the parent
+            int aboveLines = geometry.AboveLines();
+            int localFirstLine = newFirstLine - aboveLines;
+            int localScrollable = geometry.LocalScrollableLines();
+            if ((localFirstLine < 0 && aboveLines > 0) || (localFirstLine > localScrollable && geometry.BelowLines() > 0)) {
+                GetParent()->SendMessage(WM_THEMED_SCROLL, ThemedScrollSeek,
+                                         static_cast<LPARAM>(newFirstLine) * geometry.LineHeight());
+            } else {
+                // Scroll to the new position
+                int linesToScroll = max(0, min(localScrollable, localFirstLine)) - GetFirstVisibleLine();
+                if (linesToScroll != 0) {
+                    LineScroll(linesToScroll);
+                    NotifyScrolled();
+                }
             }
             
-            Invalidate(FALSE);
+            RedrawScrollbar();
         }
         
         CRichEditCtrl::OnMouseMove(nFlags, point);
@@ -313,7 +343,7 @@ void CThemedRichEdit::OnMouseMove(UINT nFlags, CPoint point)
             tme.hwndTrack = m_hWnd;
             TrackMouseEvent(&tme);
         }
-        Invalidate(FALSE);
+        RedrawScrollbar();
     }
     
     CRichEditCtrl::OnMouseMove(nFlags, point);
@@ -328,28 +358,15 @@ void CThemedRichEdit::OnLButtonDown(UINT nFlags, CPoint point)
         // Start dragging the thumb
         m_bThumbPressed = true;
         m_nDragStartY = point.y;
-        m_nDragStartScrollPos = GetFirstVisibleLine();
+        m_nDragStartScrollPos = m_virtualAbove / GetLineHeight() + GetFirstVisibleLine();
         
         SetCapture();
-        Invalidate(FALSE);
+        RedrawScrollbar();
         return;
     }
     else if (trackRect.PtInRect(point)) {
         // Click on track - page up or down
-        int totalLines = GetLineCount();
-        
-        CRect clientRect;
-        GetClientRect(&clientRect);
-        
-        CDC* pDC = GetDC();
-        TEXTMETRIC tm;
-        pDC->GetTextMetrics(&tm);
-        ReleaseDC(pDC);
-        
-        int lineHeight = tm.tmHeight + tm.tmExternalLeading;
-        if (lineHeight <= 0) lineHeight = 20;
-        
-        int visibleLines = clientRect.Height() / lineHeight;
+        int visibleLines = Geometry().VisibleLines();
         
         if (point.y < thumbRect.top) {
             // Page up
@@ -358,7 +375,8 @@ void CThemedRichEdit::OnLButtonDown(UINT nFlags, CPoint point)
             // Page down
             LineScroll(visibleLines);
         }
-        Invalidate(FALSE);
+        NotifyScrolled();
+        RedrawScrollbar();
         return;
     }
     
@@ -370,7 +388,7 @@ void CThemedRichEdit::OnLButtonUp(UINT nFlags, CPoint point)
     if (m_bThumbPressed) {
         m_bThumbPressed = false;
         ReleaseCapture();
-        Invalidate(FALSE);
+        RedrawScrollbar();
         return;
     }
     
@@ -381,7 +399,7 @@ void CThemedRichEdit::OnMouseLeave()
 {
     if (m_bThumbHover && !m_bThumbPressed) {
         m_bThumbHover = false;
-        Invalidate(FALSE);
+        RedrawScrollbar();
     }
     
     CRichEditCtrl::OnMouseLeave();
@@ -392,9 +410,10 @@ BOOL CThemedRichEdit::OnMouseWheel(UINT nFlags, short zDelta, CPoint pt)
     // Scroll 3 lines per wheel notch
     int linesToScroll = -zDelta / WHEEL_DELTA * 3;
     LineScroll(linesToScroll);
+    NotifyScrolled();
     
     // Redraw scrollbar after wheel scroll
-    Invalidate(FALSE);
+    RedrawScrollbar();
     
     return TRUE;  // Handled
 }
@@ -402,6 +421,8 @@ BOOL CThemedRichEdit::OnMouseWheel(UINT nFlags, short zDelta, CPoint pt)
 void CThemedRichEdit::OnSize(UINT nType, int cx, int cy)
 {
     CRichEditCtrl::OnSize(nType, cx, cy);
+    m_viewportValid = false;
+    m_lineCountValid = false;  // Lines rewrap at the new width
     
     // Hide scrollbars and redraw
     ShowScrollBar(SB_VERT, FALSE);
@@ -412,6 +433,7 @@ void CThemedRichEdit::OnSize(UINT nType, int cx, int cy)
 LRESULT CThemedRichEdit::OnSetText(WPARAM wParam, LPARAM lParam)
 {
     LRESULT result = Default();
+    m_lineCountValid = false;
     
     // Hide scrollbars and redraw after text changes
     ShowScrollBar(SB_VERT, FALSE);
@@ -420,3 +442,20 @@ LRESULT CThemedRichEdit::OnSetText(WPARAM wParam, LPARAM lParam)
     
     return result;
 }
+
+// Text inserted or the formatting rectangle moved: the line count is stale
+LRESULT CThemedRichEdit::OnContentChanged(WPARAM, LPARAM)
+{
+    LRESULT result = Default();
+    m_lineCountValid = false;
+    RedrawScrollbar();
+    return result;
+}
+
+LRESULT CThemedRichEdit::OnSetFontMessage(WPARAM, LPARAM)
+{
+    LRESULT result = Default();
+    m_lineHeightValid = false;
+    m_lineCountValid = false;
+    return result;
+}
@@ -3,6 +3,13 @@
 #include <afxwin.h>
 #include <afxrich.h>
 #include "Theme.h"
+#include "ScrollGeometry.h"
+
+// Sent to the parent when the user scrolls. wParam is a ThemedScrollNotify
+// code; for ThemedScrollSeek, lParam is the requested top offset in pixels of
+// the whole content, which lies outside the part loaded in the control.
+#define WM_THEMED_SCROLL (WM_APP + 2)
+enum ThemedScrollNotify { ThemedScrollMoved = 0, ThemedScrollSeek = 1 };
 
 // Custom RichEdit control with themed scrollbar overlay
 class CThemedRichEdit : public CRichEditCtrl
@@ -16,6 +23,10 @@ public:
     // Call after control is created to set up themed scrollbar
     void InitThemedScrollbar();
 
+    // Height in pixels of content above and below what is loaded in the control,
+    // so the scrollbar can represent a virtualized transcript
+    void SetVirtualExtent(int pixelsAbove, int pixelsBelow);
+
 protected:
     // Override to prevent native scrollbar from showing
     virtual void PreSubclassWindow();
@@ -23,15 +34,21 @@ protected:
     // Scrollbar dimensions
     static const int SCROLLBAR_WIDTH = 12;
     
-    // Scrollbar drawing
+    // Scrollbar drawing; the strip is composed off-screen and copied in one blit
+    void PaintScrollbarStrip(CDC* pDC);
+    void RedrawScrollbar();
     void DrawThemedScrollbar(CDC* pDC);
     void DrawScrollbarThumb(CDC* pDC, const CRect& thumbRect, bool isHover, bool isPressed);
     
     // Scrollbar calculations
+    const ScrollGeometry& Geometry();
+    CRect GetScrollbarStripRect();
     CRect GetScrollbarTrackRect();
     CRect GetThumbRect();
     int GetThumbHeight();
     int GetThumbPosition();
+    int GetLineHeight();
+    void NotifyScrolled();
     
     // State tracking
     bool m_bThumbHover;
@@ -39,6 +56,16 @@ protected:
     int m_nDragStartY;
     int m_nDragStartScrollPos;
     bool m_bInitialized;
+    int m_virtualAbove;
+    int m_virtualBelow;
+
+    // Cached scroll geometry; each part is refreshed on first use after it is invalidated
+    ScrollGeometry m_geometry;
+    bool m_lineHeightValid;  // Font changed
+    bool m_lineCountValid;   // Content or wrap width changed
+    bool m_viewportValid;    // Size changed
+    CBitmap m_stripBitmap;
+    CSize m_stripSize;
 
     DECLARE_MESSAGE_MAP()
     afx_msg void OnPaint();
@@ -50,6 +77,8 @@ protected:
     afx_msg BOOL OnMouseWheel(UINT nFlags, short zDelta, CPoint pt);
     afx_msg void OnSize(UINT nType, int cx, int cy);
     afx_msg LRESULT OnSetText(WPARAM wParam, LPARAM lParam);
+    afx_msg LRESULT OnContentChanged(WPARAM wParam, LPARAM lParam);
+    afx_msg LRESULT OnSetFontMessage(WPARAM wParam, LPARAM lParam);
     afx_msg void OnShowWindow(BOOL bShow, UINT nStatus);
     afx_msg LRESULT OnShowScrollBar(WPARAM wParam, LPARAM lParam);
 };
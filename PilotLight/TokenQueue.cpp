@@ -0,0 +1,178 @@
+#include "TokenQueue.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cwchar>
+#include <thread>
+
+namespace {
+    size_t RoundUpPowerOfTwo(size_t value)
+    {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+}
+
+SpscTextQueue::SpscTextQueue(size_t capacity)
+    : m_buffer(RoundUpPowerOfTwo((std::max)(capacity, static_cast<size_t>(2))))
+    , m_mask(m_buffer.size() - 1)
+    , m_head(0)
+    , m_tail(0)
+    , m_written(0)
+    , m_stalls(0)
+    , m_aborted(false)
+{
+}
+
+size_t SpscTextQueue::Push(const wchar_t* text, size_t length)
+{
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    const size_t tail = m_tail.load(std::memory_order_acquire);
+    const size_t count = (std::min)(length, m_buffer.size() - (head - tail));
+    if (count == 0) {
+        return 0;
+    }
+
+    // At most two copies: up to the end of the ring, then from its start
+    const size_t offset = head & m_mask;
+    const size_t first = (std::min)(count, m_buffer.size() - offset);
+    memcpy(&m_buffer[offset], text, first * sizeof(wchar_t));
+    memcpy(&m_buffer[0], text + first, (count - first) * sizeof(wchar_t));
+
+    m_head.store(head + count, std::memory_order_release);
+    m_written.fetch_add(count, std::memory_order_relaxed);
+    return count;
+}
+
+bool SpscTextQueue::Write(const wchar_t* text, size_t length)
+{
+    if (Aborted()) {
+        return false;
+    }
+    size_t written = Push(text, length);
+    if (written == length) {
+        return true;
+    }
+
+    // The UI drains once per frame; waiting a millisecond at a time is plenty
+    m_stalls.fetch_add(1, std::memory_order_relaxed);
+    while (written < length) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if (Aborted()) {
+            return false;
+        }
+        written += Push(text + written, length - written);
+    }
+    return true;
+}
+
+void SpscTextQueue::Reset()
+{
+    m_tail.store(m_head.load(std::memory_order_acquire), std::memory_order_release);
+    m_aborted.store(false, std::memory_order_release);
+}
+
+size_t SpscTextQueue::Drain(std::wstring& out)
+{
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    const size_t head = m_head.load(std::memory_order_acquire);
+    const size_t count = head - tail;
+    if (count == 0) {
+        return 0;
+    }
+
+    const size_t offset = tail & m_mask;
+    const size_t first = (std::min)(count, m_buffer.size() - offset);
+    out.append(&m_buffer[offset], first);
+    out.append(&m_buffer[0], count - first);
+
+    m_tail.store(head, std::memory_order_release);
+    return count;
+}
+
+size_t SpscTextQueue::Depth() const
+{
+    const size_t tail = m_tail.load(std::memory_order_acquire);
+    const size_t head = m_head.load(std::memory_order_acquire);
+    return head - tail;
+}
+
+std::wstring SpscTextQueue::Describe() const
+{
+    wchar_t text[160];
+    swprintf(text, sizeof(text) / sizeof(text[0]), L"queue capacity=%zu written=%llu producer stalls=%llu\r\n",
+             m_buffer.size(), static_cast<unsigned long long>(Written()), static_cast<unsigned long long>(Stalls()));
+    return text;
+}
+
+FramePacer::FramePacer(double frameSeconds)
+    : m_frameSeconds(frameSeconds)
+    , m_lastApply(0.0)
+    , m_pendingSince(0.0)
+    , m_ticks(0)
+    , m_batches(0)
+    , m_chars(0)
+    , m_droppedFrames(0)
+    , m_lastDepth(0)
+    , m_maxDepth(0)
+    , m_maxBatch(0)
+    , m_applySeconds(0.0)
+    , m_maxApplySeconds(0.0)
+{
+}
+
+void FramePacer::Start(double now)
+{
+    m_lastApply = now - m_frameSeconds;
+    m_pendingSince = now;
+}
+
+bool FramePacer::ShouldApply(double now, size_t depth)
+{
+    ++m_ticks;
+    m_lastDepth = depth;
+    m_maxDepth = (std::max)(m_maxDepth, depth);
+    if (depth == 0) {
+        m_pendingSince = now;
+        return false;
+    }
+
+    // Timers fire a little early or back to back; keep to one batch per frame
+    return now - m_lastApply >= m_frameSeconds * 0.5;
+}
+
+void FramePacer::RecordBatch(double applyStart, double applyEnd, size_t chars)
+{
+    // Every frame boundary beyond the first that passed before the text was on screen
+    const double waited = applyEnd - m_pendingSince;
+    const uint64_t frames = waited > 0.0 ? static_cast<uint64_t>(waited / m_frameSeconds) : 0;
+    if (frames > 1) {
+        m_droppedFrames += frames - 1;
+    }
+
+    const double applySeconds = applyEnd - applyStart;
+    ++m_batches;
+    m_chars += chars;
+    m_maxBatch = (std::max)(m_maxBatch, chars);
+    m_applySeconds += applySeconds;
+    m_maxApplySeconds = (std::max)(m_maxApplySeconds, applySeconds);
+    m_lastApply = applyStart;
+    m_pendingSince = applyEnd;
+}
+
+std::wstring FramePacer::Describe() const
+{
+    wchar_t text[384];
+    swprintf(text, sizeof(text) / sizeof(text[0]),
+             L"frame=%.1fms ticks=%llu batches=%llu chars=%llu (avg %.1f, max %zu per batch)\r\n"
+             L"dropped frames=%llu queue depth=%zu (max %zu) apply avg=%.2fms max=%.2fms\r\n",
+             m_frameSeconds * 1000.0, static_cast<unsigned long long>(m_ticks),
+             static_cast<unsigned long long>(m_batches), static_cast<unsigned long long>(m_chars),
+             m_batches ? static_cast<double>(m_chars) / m_batches : 0.0, m_maxBatch,
+             static_cast<unsigned long long>(m_droppedFrames), m_lastDepth, m_maxDepth,
+             m_batches ? m_applySeconds * 1000.0 / m_batches : 0.0, m_maxApplySeconds * 1000.0);
+    return text;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Lock-free single-producer/single-consumer ring of characters between the
+// network thread (streamed deltas) and the UI thread. The producer and the
+// consumer each own one index; neither side ever takes a lock. Any thread may
+// act as the producer as long as only one does at a time. A consumer that
+// stops draining (to join the producer, say) aborts the queue first, so a
+// producer waiting for room gives up instead of waiting forever. Portable.
+class SpscTextQueue {
+public:
+    explicit SpscTextQueue(size_t capacity = 1 << 16);  // Rounded up to a power of two
+
+    // Producer: copies what fits and returns the count
+    size_t Push(const wchar_t* text, size_t length);
+    // Producer: copies everything, sleeping while the consumer catches up
+    // (backpressure). Returns false, dropping the rest, once the queue is aborted.
+    bool Write(const wchar_t* text, size_t length);
+
+    // Any thread: writes fail from now on until Reset()
+    void Abort() { m_aborted.store(true, std::memory_order_release); }
+    bool Aborted() const { return m_aborted.load(std::memory_order_acquire); }
+    // Consumer, with no producer running: empties the ring and accepts writes again
+    void Reset();
+
+    // Consumer: appends everything queued to out and returns the count
+    size_t Drain(std::wstring& out);
+
+    // Characters queued; exact on the consumer side, a lower bound elsewhere
+    size_t Depth() const;
+    size_t Capacity() const { return m_buffer.size(); }
+
+    // Producer-side counters
+    uint64_t Written() const { return m_written.load(std::memory_order_relaxed); }
+    uint64_t Stalls() const { return m_stalls.load(std::memory_order_relaxed); }
+
+    std::wstring Describe() const;
+
+private:
+    std::vector<wchar_t> m_buffer;
+    size_t m_mask;
+    alignas(64) std::atomic<size_t> m_head;  // Next write; owned by the producer
+    alignas(64) std::atomic<size_t> m_tail;  // Next read; owned by the consumer
+    alignas(64) std::atomic<uint64_t> m_written;
+    std::atomic<uint64_t> m_stalls;  // Writes that had to wait for the consumer
+    std::atomic<bool> m_aborted;
+};
+
+// Paces how often the UI applies queued text: at most one batch per display
+// frame, driven by a coalescing timer. Tracks backpressure: queue depth and
+// frames missed while text was waiting (UI thread busy or a batch took longer
+// than a frame). Times are seconds on any monotonic clock, so the pacer can be
+// driven by a simulated clock. Portable.
+class FramePacer {
+public:
+    explicit FramePacer(double frameSeconds = 1.0 / 60.0);
+
+    double FrameSeconds() const { return m_frameSeconds; }
+
+    // A new stream begins; statistics keep accumulating
+    void Start(double now);
+    // Timer tick with the current queue depth; true if a batch should be applied now
+    bool ShouldApply(double now, size_t depth);
+    // A batch of chars was applied between applyStart and applyEnd
+    void RecordBatch(double applyStart, double applyEnd, size_t chars);
+
+    uint64_t DroppedFrames() const { return m_droppedFrames; }
+    size_t MaxDepth() const { return m_maxDepth; }
+
+    std::wstring Describe() const;
+
+private:
+    double m_frameSeconds;
+    double m_lastApply;
+    double m_pendingSince;  // Last time the queue was seen empty or drained
+
+    uint64_t m_ticks;
+    uint64_t m_batches;
+    uint64_t m_chars;
+    uint64_t m_droppedFrames;
+    size_t m_lastDepth;
+    size_t m_maxDepth;
+    size_t m_maxBatch;
+    double m_applySeconds;
+    double m_maxApplySeconds;
+};
@@ -7,24 +7,6 @@ BEGIN_MESSAGE_MAP(CToolConfirmationDialog, CDialogEx)
     ON_BN_CLICKED(IDC_BTN_NEVER_ALLOW, &CToolConfirmationDialog::OnNeverAllow)
 END_MESSAGE_MAP()
 
-ToolPermissionPolicy ToolPermissionStore::GetPolicy(const std::wstring& toolName) const {
-    auto it = m_policies.find(toolName);
-    if (it == m_policies.end()) {
-        return ToolPermissionPolicy::Ask;
-    }
-
-    return it->second;
-}
-
-void ToolPermissionStore::SetPolicy(const std::wstring& toolName, ToolPermissionPolicy policy) {
-    if (policy == ToolPermissionPolicy::Ask) {
-        m_policies.erase(toolName);
-        return;
-    }
-
-    m_policies[toolName] = policy;
-}
-
 CToolConfirmationDialog::CToolConfirmationDialog(
     const CString& toolName,
     const CString& actionSummary,
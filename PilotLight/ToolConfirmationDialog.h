@@ -2,30 +2,7 @@
 
 #include <afxwin.h>
 #include <afxdialogex.h>
-#include <map>
-#include <string>
-
-enum class ToolConfirmationDecision {
-    Cancel = 0,
-    AllowOnce,
-    AlwaysAllow,
-    NeverAllow
-};
-
-enum class ToolPermissionPolicy {
-    Ask = 0,
-    AlwaysAllow,
-    NeverAllow
-};
-
-class ToolPermissionStore {
-public:
-    ToolPermissionPolicy GetPolicy(const std::wstring& toolName) const;
-    void SetPolicy(const std::wstring& toolName, ToolPermissionPolicy policy);
-
-private:
-    std::map<std::wstring, ToolPermissionPolicy> m_policies;
-};
+#include "ToolPermissionStore.h"
 
 class CToolConfirmationDialog : public CDialogEx {
 public:
@@ -0,0 +1,526 @@
+#include "ToolEngine.h"
+#include "Diagnostics.h"
+#include "JsonBuilder.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cwchar>
+#include <thread>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    constexpr size_t kMaxParallelLimit = 32;
+
+    double MillisecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    const wchar_t* PolicyName(ToolPermissionPolicy policy)
+    {
+        switch (policy) {
+        case ToolPermissionPolicy::AlwaysAllow: return L"always allow";
+        case ToolPermissionPolicy::NeverAllow: return L"never allow";
+        default: return L"ask";
+        }
+    }
+
+    bool ReadHex4(const std::wstring& json, size_t pos, wchar_t& value)
+    {
+        if (pos + 4 > json.size()) {
+            return false;
+        }
+        unsigned code = 0;
+        for (size_t i = pos; i < pos + 4; ++i) {
+            const wchar_t c = json[i];
+            code <<= 4;
+            if (c >= L'0' && c <= L'9') code |= c - L'0';
+            else if (c >= L'a' && c <= L'f') code |= c - L'a' + 10;
+            else if (c >= L'A' && c <= L'F') code |= c - L'A' + 10;
+            else return false;
+        }
+        value = static_cast<wchar_t>(code);
+        return true;
+    }
+
+    // Reads the string literal whose opening quote is at pos
+    bool ReadJsonString(const std::wstring& json, size_t pos, std::wstring& value)
+    {
+        value.clear();
+        for (size_t i = pos + 1; i < json.size(); ++i) {
+            const wchar_t c = json[i];
+            if (c == L'"') {
+                return true;
+            }
+            if (c != L'\\') {
+                value += c;
+                continue;
+            }
+            if (++i >= json.size()) {
+                return false;
+            }
+            switch (json[i]) {
+            case L'n': value += L'\n'; break;
+            case L'r': value += L'\r'; break;
+            case L't': value += L'\t'; break;
+            case L'b': value += L'\b'; break;
+            case L'f': value += L'\f'; break;
+            case L'u': {
+                wchar_t code;
+                if (!ReadHex4(json, i + 1, code)) {
+                    return false;
+                }
+                value += code;
+                i += 4;
+                break;
+            }
+            default: value += json[i]; break;  // \" \\ \/
+            }
+        }
+        return false;
+    }
+}
+
+// Calls of one round that run on threads. Shared with the threads, so that
+// the threads of timed-out calls can outlive the round.
+struct ToolEngine::Round {
+    struct Task {
+        std::shared_ptr<const Tool> tool;
+        ToolCall call;
+        std::chrono::milliseconds timeout;
+        std::atomic<bool> cancelled{ false };
+        size_t worker = 0;
+        bool started = false;
+        bool finished = false;
+        bool abandoned = false;
+        Clock::time_point start;
+        bool ok = false;
+        std::wstring output;
+        double ms = 0;
+    };
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<std::unique_ptr<Task>> tasks;
+    size_t next = 0;
+    std::shared_ptr<std::atomic<size_t>> stragglers;
+
+    // Takes tasks until none is left. Leaves as soon as its task timed
+    // out: the round has moved on and started a replacement.
+    static void Work(std::shared_ptr<Round> round, size_t worker)
+    {
+        std::unique_lock<std::mutex> guard(round->lock);
+        while (round->next < round->tasks.size()) {
+            Task& task = *round->tasks[round->next++];
+            task.worker = worker;
+            task.started = true;
+            task.start = Clock::now();
+            round->changed.notify_all();  // The round waits for the new deadline
+            guard.unlock();
+
+            std::wstring output;
+            bool ok = false;
+            try {
+                ok = task.tool->run(task.call.arguments, output, task.cancelled);
+            } catch (...) {
+                ok = false;
+                output = L"The tool failed unexpectedly.";
+            }
+
+            guard.lock();
+            if (task.abandoned) {
+                --*round->stragglers;
+                return;
+            }
+            task.ok = ok;
+            task.output = std::move(output);
+            task.ms = MillisecondsSince(task.start);
+            task.finished = true;
+            round->changed.notify_all();
+        }
+    }
+};
+
+ToolEngine::ToolEngine(ToolPermissionStore& permissions)
+    : m_permissions(permissions)
+    , m_maxParallel(4)
+    , m_defaultTimeoutMs(10000)
+    , m_maxRounds(4)
+    , m_stragglers(std::make_shared<std::atomic<size_t>>(0))
+    , m_rounds(0)
+    , m_calls(0)
+    , m_succeeded(0)
+    , m_failed(0)
+    , m_denied(0)
+    , m_timedOut(0)
+    , m_unknown(0)
+    , m_confirmations(0)
+    , m_widestRound(0)
+{
+}
+
+void ToolEngine::Configure(size_t maxParallel, int defaultTimeoutMs, int maxRounds)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_maxParallel = (std::max)(size_t(1), (std::min)(maxParallel, kMaxParallelLimit));
+    m_defaultTimeoutMs = (std::max)(1, defaultTimeoutMs);
+    m_maxRounds = (std::max)(0, maxRounds);
+}
+
+void ToolEngine::Register(const Tool& tool)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_tools[tool.name] = std::make_shared<const Tool>(tool);
+}
+
+bool ToolEngine::Empty() const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return m_tools.empty();
+}
+
+std::wstring ToolEngine::ToolsJson() const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    JsonBuilder json;
+    json.BeginArray();
+    for (const auto& entry : m_tools) {
+        const Tool& tool = *entry.second;
+        JsonBuilder function;
+        function.BeginObject();
+        function.AddString(L"name", tool.name);
+        function.AddString(L"description", tool.description);
+        function.AddRawValue(L"\"parameters\":" +
+                             (tool.parameters.empty() ? std::wstring(L"{\"type\":\"object\"}") : tool.parameters));
+        function.EndObject();
+
+        json.BeginObject();
+        json.AddString(L"type", L"function");
+        json.AddRawValue(L"\"function\":" + function.ToString());
+        json.EndObject();
+    }
+    json.EndArray();
+    return json.ToString();
+}
+
+std::wstring ToolEngine::Run(const Transport& transport, const ConfirmFn& confirm)
+{
+    int maxRounds;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        maxRounds = m_maxRounds;
+    }
+
+    ToolExchange exchange;
+    std::wstring text;
+    for (int round = 0;; ++round) {
+        exchange.tools = round < maxRounds ? ToolsJson() : std::wstring();
+        std::vector<ToolCall> calls;
+        const std::wstring reply = transport(exchange, calls);
+        if (!reply.empty()) {
+            text += text.empty() ? reply : L"\n\n" + reply;
+        }
+        if (calls.empty() || exchange.tools.empty()) {
+            return text;
+        }
+
+        const std::vector<ToolResult> results = Execute(calls, confirm);
+        exchange.messages.push_back(AssistantMessageJson(reply, calls));
+        for (const ToolResult& result : results) {
+            exchange.messages.push_back(ResultMessageJson(result));
+        }
+    }
+}
+
+std::vector<ToolResult> ToolEngine::Execute(const std::vector<ToolCall>& calls, const ConfirmFn& confirm)
+{
+    const Clock::time_point start = Clock::now();
+    std::vector<ToolResult> results(calls.size());
+    std::vector<std::shared_ptr<const Tool>> tools(calls.size());
+    std::vector<size_t> allowed;
+    std::vector<size_t> asked;
+
+    for (size_t i = 0; i < calls.size(); ++i) {
+        results[i] = ToolResult{ calls[i].id, calls[i].name, ToolResult::Status::Ok, std::wstring(), 0 };
+        tools[i] = Find(calls[i].name);
+        if (!tools[i]) {
+            results[i].status = ToolResult::Status::Unknown;
+            results[i].content = L"There is no tool named '" + calls[i].name + L"'.";
+            continue;
+        }
+        switch (m_permissions.GetPolicy(calls[i].name)) {
+        case ToolPermissionPolicy::AlwaysAllow:
+            allowed.push_back(i);
+            break;
+        case ToolPermissionPolicy::NeverAllow:
+            results[i].status = ToolResult::Status::Denied;
+            results[i].content = L"The user does not allow this tool.";
+            break;
+        default:
+            asked.push_back(i);
+            break;
+        }
+    }
+
+    // Every call that needs a decision is put to the user at once
+    if (!asked.empty()) {
+        std::vector<ToolCall> pending;
+        for (size_t i : asked) {
+            pending.push_back(calls[i]);
+        }
+        const std::vector<ToolConfirmationDecision> decisions =
+            confirm ? confirm(pending) : std::vector<ToolConfirmationDecision>();
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            ++m_confirmations;
+        }
+
+        for (size_t k = 0; k < asked.size(); ++k) {
+            const size_t i = asked[k];
+            const ToolConfirmationDecision decision =
+                k < decisions.size() ? decisions[k] : ToolConfirmationDecision::Cancel;
+            switch (decision) {
+            case ToolConfirmationDecision::AlwaysAllow:
+                m_permissions.SetPolicy(calls[i].name, ToolPermissionPolicy::AlwaysAllow);
+                allowed.push_back(i);
+                break;
+            case ToolConfirmationDecision::AllowOnce:
+                allowed.push_back(i);
+                break;
+            case ToolConfirmationDecision::NeverAllow:
+                m_permissions.SetPolicy(calls[i].name, ToolPermissionPolicy::NeverAllow);
+                results[i].status = ToolResult::Status::Denied;
+                results[i].content = L"The user does not allow this tool.";
+                break;
+            default:
+                results[i].status = ToolResult::Status::Denied;
+                results[i].content = L"The user declined this call.";
+                break;
+            }
+        }
+        std::sort(allowed.begin(), allowed.end());
+    }
+
+    if (!allowed.empty()) {
+        RunAllowed(tools, calls, results, allowed);
+    }
+
+    size_t ok = 0;
+    for (const ToolResult& result : results) {
+        Count(result);
+        ok += result.status == ToolResult::Status::Ok ? 1 : 0;
+    }
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        ++m_rounds;
+        m_widestRound = (std::max)(m_widestRound, allowed.size());
+    }
+
+    wchar_t line[160];
+    swprintf(line, sizeof(line) / sizeof(line[0]), L"tools: %zu call(s), %zu run, %zu ok in %.1f ms",
+             calls.size(), allowed.size(), ok, MillisecondsSince(start));
+    Diagnostics::Log(line);
+    return results;
+}
+
+std::wstring ToolEngine::AssistantMessageJson(const std::wstring& content, const std::vector<ToolCall>& calls)
+{
+    JsonBuilder json;
+    json.BeginObject();
+    json.AddString(L"role", L"assistant");
+    if (content.empty()) {
+        json.AddNull(L"content");
+    } else {
+        json.AddString(L"content", content);
+    }
+    json.BeginArray(L"tool_calls");
+    for (const ToolCall& call : calls) {
+        JsonBuilder function;
+        function.BeginObject();
+        function.AddString(L"name", call.name);
+        function.AddString(L"arguments", call.arguments);
+        function.EndObject();
+
+        json.BeginObject();
+        json.AddString(L"id", call.id);
+        json.AddString(L"type", L"function");
+        json.AddRawValue(L"\"function\":" + function.ToString());
+        json.EndObject();
+    }
+    json.EndArray();
+    json.EndObject();
+    return json.ToString();
+}
+
+std::wstring ToolEngine::ResultMessageJson(const ToolResult& result)
+{
+    JsonBuilder json;
+    json.BeginObject();
+    json.AddString(L"role", L"tool");
+    json.AddString(L"tool_call_id", result.id);
+    json.AddString(L"content", result.content);
+    json.EndObject();
+    return json.ToString();
+}
+
+bool ToolEngine::StringArgument(const std::wstring& arguments, const wchar_t* key, std::wstring& value)
+{
+    const std::wstring quotedKey = L"\"" + std::wstring(key) + L"\"";
+    size_t pos = arguments.find(quotedKey);
+    if (pos == std::wstring::npos) {
+        return false;
+    }
+    pos = arguments.find_first_not_of(L" \t\r\n", pos + quotedKey.size());
+    if (pos == std::wstring::npos || arguments[pos] != L':') {
+        return false;
+    }
+    pos = arguments.find_first_not_of(L" \t\r\n", pos + 1);
+    if (pos == std::wstring::npos || arguments[pos] != L'"') {
+        return false;
+    }
+    return ReadJsonString(arguments, pos, value);
+}
+
+std::wstring ToolEngine::Describe() const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    wchar_t text[512];
+    swprintf(text, sizeof(text) / sizeof(text[0]),
+             L"tools=%zu parallel=%zu timeout=%d ms rounds=%llu widest=%zu confirmations=%llu\r\n"
+             L"calls=%llu ok=%llu failed=%llu denied=%llu timed out=%llu unknown=%llu still running=%zu\r\n",
+             m_tools.size(), m_maxParallel, m_defaultTimeoutMs, static_cast<unsigned long long>(m_rounds),
+             m_widestRound, static_cast<unsigned long long>(m_confirmations),
+             static_cast<unsigned long long>(m_calls), static_cast<unsigned long long>(m_succeeded),
+             static_cast<unsigned long long>(m_failed), static_cast<unsigned long long>(m_denied),
+             static_cast<unsigned long long>(m_timedOut), static_cast<unsigned long long>(m_unknown),
+             m_stragglers->load());
+    std::wstring report = text;
+    for (const auto& entry : m_tools) {
+        const Tool& tool = *entry.second;
+        swprintf(text, sizeof(text) / sizeof(text[0]), L"  %ls: %ls, timeout=%d ms\r\n", tool.name.c_str(),
+                 PolicyName(m_permissions.GetPolicy(tool.name)),
+                 tool.timeoutMs > 0 ? tool.timeoutMs : m_defaultTimeoutMs);
+        report += text;
+    }
+    return report;
+}
+
+std::shared_ptr<const ToolEngine::Tool> ToolEngine::Find(const std::wstring& name) const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    const auto found = m_tools.find(name);
+    return found == m_tools.end() ? nullptr : found->second;
+}
+
+void ToolEngine::RunAllowed(const std::vector<std::shared_ptr<const Tool>>& tools, const std::vector<ToolCall>& calls,
+                            std::vector<ToolResult>& results, const std::vector<size_t>& allowed)
+{
+    size_t maxParallel;
+    int defaultTimeoutMs;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        maxParallel = m_maxParallel;
+        defaultTimeoutMs = m_defaultTimeoutMs;
+    }
+
+    auto round = std::make_shared<Round>();
+    round->stragglers = m_stragglers;
+    for (size_t i : allowed) {
+        std::unique_ptr<Round::Task> task(new Round::Task);
+        task->tool = tools[i];
+        task->call = calls[i];
+        task->timeout = std::chrono::milliseconds(tools[i]->timeoutMs > 0 ? tools[i]->timeoutMs : defaultTimeoutMs);
+        round->tasks.push_back(std::move(task));
+    }
+
+    std::vector<std::thread> workers;
+    std::vector<bool> abandoned;
+    std::unique_lock<std::mutex> guard(round->lock);
+    const size_t width = (std::min)(maxParallel, round->tasks.size());
+    for (size_t w = 0; w < width; ++w) {
+        workers.emplace_back(&Round::Work, round, w);
+        abandoned.push_back(false);
+    }
+
+    // Wait for every call to finish or time out; a timed-out call's thread
+    // is given up on and replaced while calls are still waiting to start
+    for (;;) {
+        bool pending = false;
+        bool haveDeadline = false;
+        Clock::time_point deadline;
+        const Clock::time_point now = Clock::now();
+        for (const auto& task : round->tasks) {
+            if (task->finished || task->abandoned) {
+                continue;
+            }
+            pending = true;
+            if (!task->started) {
+                continue;
+            }
+            if (now - task->start >= task->timeout) {
+                task->abandoned = true;
+                task->cancelled = true;
+                task->ms = MillisecondsSince(task->start);
+                ++*round->stragglers;
+                abandoned[task->worker] = true;
+                if (round->next < round->tasks.size()) {
+                    workers.emplace_back(&Round::Work, round, workers.size());
+                    abandoned.push_back(false);
+                }
+                continue;
+            }
+            const Clock::time_point expires = task->start + task->timeout;
+            if (!haveDeadline || expires < deadline) {
+                deadline = expires;
+                haveDeadline = true;
+            }
+        }
+        if (!pending) {
+            break;
+        }
+        if (haveDeadline) {
+            round->changed.wait_until(guard, deadline);
+        } else {
+            round->changed.wait(guard);
+        }
+    }
+
+    for (size_t k = 0; k < allowed.size(); ++k) {
+        const Round::Task& task = *round->tasks[k];
+        ToolResult& result = results[allowed[k]];
+        result.ms = task.ms;
+        if (task.abandoned) {
+            wchar_t text[96];
+            swprintf(text, sizeof(text) / sizeof(text[0]), L"The tool did not finish within %lld ms.",
+                     static_cast<long long>(task.timeout.count()));
+            result.status = ToolResult::Status::TimedOut;
+            result.content = text;
+        } else {
+            result.status = task.ok ? ToolResult::Status::Ok : ToolResult::Status::Failed;
+            result.content = task.output;
+        }
+    }
+    guard.unlock();
+
+    for (size_t w = 0; w < workers.size(); ++w) {
+        if (abandoned[w]) {
+            workers[w].detach();
+        } else {
+            workers[w].join();
+        }
+    }
+}
+
+void ToolEngine::Count(const ToolResult& result)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    ++m_calls;
+    switch (result.status) {
+    case ToolResult::Status::Ok: ++m_succeeded; break;
+    case ToolResult::Status::Failed: ++m_failed; break;
+    case ToolResult::Status::Denied: ++m_denied; break;
+    case ToolResult::Status::TimedOut: ++m_timedOut; break;
+    default: ++m_unknown; break;
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ToolPermissionStore.h"
+
+// A function call requested by the model (one entry of "tool_calls")
+struct ToolCall {
+    std::wstring id;
+    std::wstring name;
+    std::wstring arguments;  // JSON object text, as the model sent it
+};
+
+struct ToolResult {
+    enum class Status { Ok, Failed, Denied, TimedOut, Unknown };
+
+    std::wstring id;  // Of the call
+    std::wstring name;
+    Status status;
+    std::wstring content;  // Sent back to the model; describes the problem unless Ok
+    double ms;
+};
+
+// Tool part of one request: the "tools" array to offer (empty on the last
+// round, so the model has to answer) and the messages of earlier rounds of
+// this turn, which follow the history in the request
+struct ToolExchange {
+    std::wstring tools;
+    std::vector<std::wstring> messages;  // JSON objects
+};
+
+// Runs the tools a reply asks for and feeds the results back until the
+// model answers in text. Each round:
+//   - calls of unknown tools and of tools set to NeverAllow fail at once;
+//   - the calls of tools set to Ask are confirmed together, with one
+//     question per round however many there are;
+//   - the allowed calls run at the same time on at most maxParallel threads.
+// A call that outlives its tool's timeout is reported as timed out and its
+// thread is left to finish on its own, with a replacement taking its place,
+// so a hung tool never holds up the reply. Portable; the transport and the
+// confirmation are supplied by the caller.
+class ToolEngine {
+public:
+    // Runs one call on a worker thread. Returns false if it failed, with
+    // output saying why. cancelled turns true once the call timed out; the
+    // result is discarded then and the tool should return soon.
+    typedef std::function<bool(const std::wstring& arguments, std::wstring& output,
+                               const std::atomic<bool>& cancelled)> ToolFn;
+
+    struct Tool {
+        std::wstring name;
+        std::wstring description;
+        std::wstring parameters;  // JSON schema object
+        int timeoutMs;            // 0: the engine default
+        ToolFn run;
+    };
+
+    // One request to the model; fills calls with the tool calls of the reply
+    typedef std::function<std::wstring(const ToolExchange& exchange, std::vector<ToolCall>& calls)> Transport;
+
+    // One decision per call, for the calls of tools set to Ask
+    typedef std::function<std::vector<ToolConfirmationDecision>(const std::vector<ToolCall>& calls)> ConfirmFn;
+
+    explicit ToolEngine(ToolPermissionStore& permissions);
+    ToolEngine(const ToolEngine&) = delete;
+    ToolEngine& operator=(const ToolEngine&) = delete;
+
+    void Configure(size_t maxParallel, int defaultTimeoutMs, int maxRounds);
+    void Register(const Tool& tool);
+    bool Empty() const;
+
+    // The "tools" array of a request
+    std::wstring ToolsJson() const;
+
+    // Requests until a reply has no tool calls, or maxRounds rounds of tools
+    // ran; returns the text of every reply, joined by blank lines. Without
+    // confirm, calls that need one are denied.
+    std::wstring Run(const Transport& transport, const ConfirmFn& confirm);
+
+    // One round; the results are in call order
+    std::vector<ToolResult> Execute(const std::vector<ToolCall>& calls, const ConfirmFn& confirm);
+
+    // Request messages for a round: the assistant turn that asked for the
+    // calls, and one "tool" message per result
+    static std::wstring AssistantMessageJson(const std::wstring& content, const std::vector<ToolCall>& calls);
+    static std::wstring ResultMessageJson(const ToolResult& result);
+
+    // A string field of a call's arguments, for tools
+    static bool StringArgument(const std::wstring& arguments, const wchar_t* key, std::wstring& value);
+
+    std::wstring Describe() const;
+
+private:
+    struct Round;
+
+    std::shared_ptr<const Tool> Find(const std::wstring& name) const;
+    void RunAllowed(const std::vector<std::shared_ptr<const Tool>>& tools, const std::vector<ToolCall>& calls,
+                    std::vector<ToolResult>& results, const std::vector<size_t>& allowed);
+    void Count(const ToolResult& result);
+
+    ToolPermissionStore& m_permissions;
+    mutable std::mutex m_lock;
+    std::map<std::wstring, std::shared_ptr<const Tool>> m_tools;
+    size_t m_maxParallel;
+    int m_defaultTimeoutMs;
+    int m_maxRounds;
+
+    // Timed-out calls whose threads are still running; shared with those threads
+    std::shared_ptr<std::atomic<size_t>> m_stragglers;
+
+    uint64_t m_rounds;
+    uint64_t m_calls;
+    uint64_t m_succeeded;
+    uint64_t m_failed;
+    uint64_t m_denied;
+    uint64_t m_timedOut;
+    uint64_t m_unknown;
+    uint64_t m_confirmations;
+    size_t m_widestRound;
+};
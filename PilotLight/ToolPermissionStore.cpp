@@ -0,0 +1,21 @@
+#include "ToolPermissionStore.h"
+
+ToolPermissionPolicy ToolPermissionStore::GetPolicy(const std::wstring& toolName) const {
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto it = m_policies.find(toolName);
+    if (it == m_policies.end()) {
+        return ToolPermissionPolicy::Ask;
+    }
+
+    return it->second;
+}
+
+void ToolPermissionStore::SetPolicy(const std::wstring& toolName, ToolPermissionPolicy policy) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (policy == ToolPermissionPolicy::Ask) {
+        m_policies.erase(toolName);
+        return;
+    }
+
+    m_policies[toolName] = policy;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+
+enum class ToolConfirmationDecision {
+    Cancel = 0,
+    AllowOnce,
+    AlwaysAllow,
+    NeverAllow
+};
+
+enum class ToolPermissionPolicy {
+    Ask = 0,
+    AlwaysAllow,
+    NeverAllow
+};
+
+// Per-tool policy for the current session; tools not set are Ask. Read by
+// the tool engine on the response thread while the confirmation dialog may
+// set policies on the UI thread, so access is locked. Portable.
+class ToolPermissionStore {
+public:
+    ToolPermissionPolicy GetPolicy(const std::wstring& toolName) const;
+    void SetPolicy(const std::wstring& toolName, ToolPermissionPolicy policy);
+
+private:
+    mutable std::mutex m_lock;
+    std::map<std::wstring, ToolPermissionPolicy> m_policies;
+};
@@ -0,0 +1,140 @@
+#include "TranscriptLayout.h"
+#include <algorithm>
+#include <cwchar>
+
+namespace {
+    size_t LowBit(size_t value)
+    {
+        return value & (~value + 1);
+    }
+}
+
+void TranscriptLayout::Clear()
+{
+    m_heights.clear();
+    m_measured.clear();
+    m_tree.assign(1, 0);
+    m_measuredCount = 0;
+}
+
+void TranscriptLayout::Assign(const std::vector<int>& heights)
+{
+    m_heights = heights;
+    m_measured.assign(heights.size(), 0);
+    m_measuredCount = 0;
+
+    // Linear build: each node pushes its sum to its parent once
+    m_tree.assign(heights.size() + 1, 0);
+    for (size_t i = 1; i <= heights.size(); ++i) {
+        m_tree[i] += heights[i - 1];
+        const size_t parent = i + LowBit(i);
+        if (parent <= heights.size()) {
+            m_tree[parent] += m_tree[i];
+        }
+    }
+}
+
+void TranscriptLayout::Append(int height, bool measured)
+{
+    if (m_tree.empty()) {
+        m_tree.assign(1, 0);
+    }
+    m_heights.push_back(height);
+    m_measured.push_back(measured ? 1 : 0);
+    m_measuredCount += measured ? 1 : 0;
+
+    // New node i covers (i - lowbit(i), i]: its own height plus the tail of the prefix
+    const size_t i = m_heights.size();
+    m_tree.push_back(height + Offset(i - 1) - Offset(i - LowBit(i)));
+}
+
+void TranscriptLayout::SetHeight(size_t index, int height)
+{
+    if (index >= m_heights.size()) {
+        return;
+    }
+    if (!m_measured[index]) {
+        m_measured[index] = 1;
+        ++m_measuredCount;
+    }
+    if (m_heights[index] != height) {
+        Add(index, static_cast<int64_t>(height) - m_heights[index]);
+        m_heights[index] = height;
+    }
+}
+
+int64_t TranscriptLayout::Offset(size_t index) const
+{
+    int64_t sum = 0;
+    for (size_t i = (std::min)(index, m_heights.size()); i > 0; i -= LowBit(i)) {
+        sum += m_tree[i];
+    }
+    return sum;
+}
+
+size_t TranscriptLayout::IndexAt(int64_t offset) const
+{
+    if (m_heights.empty() || offset <= 0) {
+        return 0;
+    }
+
+    // Descend the tree for the longest prefix whose height is <= offset
+    size_t step = 1;
+    while (step * 2 <= m_heights.size()) {
+        step *= 2;
+    }
+    size_t position = 0;
+    for (; step > 0; step /= 2) {
+        const size_t next = position + step;
+        if (next <= m_heights.size() && m_tree[next] <= offset) {
+            position = next;
+            offset -= m_tree[next];
+        }
+    }
+    return (std::min)(position, m_heights.size() - 1);
+}
+
+TranscriptLayout::Range TranscriptLayout::VisibleRange(int64_t top, int64_t viewportHeight, size_t overscan) const
+{
+    Range range = { 0, 0 };
+    if (m_heights.empty()) {
+        return range;
+    }
+    const size_t first = IndexAt(top);
+    const size_t last = IndexAt(top + (std::max)(viewportHeight, static_cast<int64_t>(1)) - 1) + 1;
+    range.first = first > overscan ? first - overscan : 0;
+    range.last = (std::min)(last + overscan, m_heights.size());
+    return range;
+}
+
+int TranscriptLayout::EstimateHeight(const std::wstring& text, int charsPerLine, int lineHeight, int chromeHeight)
+{
+    charsPerLine = (std::max)(charsPerLine, 1);
+    size_t lines = 0;
+    size_t lineStart = 0;
+    while (true) {
+        size_t lineEnd = text.find(L'\n', lineStart);
+        const size_t length = (lineEnd == std::wstring::npos ? text.length() : lineEnd) - lineStart;
+        lines += length == 0 ? 1 : (length + charsPerLine - 1) / charsPerLine;
+        if (lineEnd == std::wstring::npos) {
+            break;
+        }
+        lineStart = lineEnd + 1;
+    }
+    return static_cast<int>(lines) * lineHeight + chromeHeight;
+}
+
+std::wstring TranscriptLayout::Describe() const
+{
+    wchar_t text[160];
+    swprintf(text, sizeof(text) / sizeof(text[0]), L"messages=%zu measured=%zu height=%lldpx\r\n",
+             m_heights.size(), m_measuredCount, static_cast<long long>(TotalHeight()));
+    return text;
+}
+
+void TranscriptLayout::Add(size_t index, int64_t delta)
+{
+    for (size_t i = index + 1; i < m_tree.size(); i += LowBit(i)) {
+        m_tree[i] += delta;
+    }
+}
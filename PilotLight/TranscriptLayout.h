@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Vertical layout of the chat transcript for virtualized display. Every
+// message has a height in pixels: an estimate until it has been laid out in
+// the control, then the measured value. A Fenwick tree over the heights keeps
+// offset <-> message lookups and height updates at O(log n), so a scroll
+// position maps straight to the few messages worth materializing. Portable.
+class TranscriptLayout {
+public:
+    struct Range {
+        size_t first;
+        size_t last;  // One past the final message
+    };
+
+    void Clear();
+    // Replaces all heights (estimates) in O(n)
+    void Assign(const std::vector<int>& heights);
+    void Append(int height, bool measured);
+    // Records a measured height
+    void SetHeight(size_t index, int height);
+
+    size_t Count() const { return m_heights.size(); }
+    int Height(size_t index) const { return m_heights[index]; }
+    bool IsMeasured(size_t index) const { return m_measured[index] != 0; }
+
+    // Top of message index; Offset(Count()) is the total height
+    int64_t Offset(size_t index) const;
+    int64_t TotalHeight() const { return Offset(m_heights.size()); }
+    // Message covering offset, clamped to the transcript
+    size_t IndexAt(int64_t offset) const;
+
+    // Messages intersecting [top, top + viewportHeight) plus overscan on either side
+    Range VisibleRange(int64_t top, int64_t viewportHeight, size_t overscan) const;
+
+    // Height guess from wrapped line count; chrome covers label line and spacing
+    static int EstimateHeight(const std::wstring& text, int charsPerLine, int lineHeight, int chromeHeight);
+
+    std::wstring Describe() const;
+
+private:
+    void Add(size_t index, int64_t delta);
+
+    std::vector<int> m_heights;
+    std::vector<uint8_t> m_measured;
+    std::vector<int64_t> m_tree;  // 1-based Fenwick tree; m_tree[0] unused
+    size_t m_measuredCount = 0;
+};
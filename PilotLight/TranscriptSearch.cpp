@@ -0,0 +1,239 @@
+#include "TranscriptSearch.h"
+#include <chrono>
+#include <cwchar>
+#include <cwctype>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PILOTLIGHT_SEARCH_SSE2 1
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+    wchar_t Fold(wchar_t ch)
+    {
+        if (static_cast<unsigned int>(ch) < 128) {
+            return ch >= L'A' && ch <= L'Z' ? static_cast<wchar_t>(ch + (L'a' - L'A')) : ch;
+        }
+        return static_cast<wchar_t>(towlower(ch));
+    }
+
+    std::wstring FoldString(const std::wstring& text)
+    {
+        std::wstring folded(text);
+        for (wchar_t& ch : folded) {
+            ch = Fold(ch);
+        }
+        return folded;
+    }
+
+    // A folded query plus both cases of its end characters, which are what
+    // the vector loop compares against
+    struct Needle {
+        const wchar_t* folded;
+        size_t length;
+        wchar_t firstLower;
+        wchar_t firstUpper;
+        wchar_t lastLower;
+        wchar_t lastUpper;
+    };
+
+    Needle MakeNeedle(const std::wstring& folded)
+    {
+        Needle needle = { folded.c_str(), folded.length(), 0, 0, 0, 0 };
+        if (!folded.empty()) {
+            needle.firstLower = folded.front();
+            needle.firstUpper = static_cast<wchar_t>(towupper(folded.front()));
+            needle.lastLower = folded.back();
+            needle.lastUpper = static_cast<wchar_t>(towupper(folded.back()));
+        }
+        return needle;
+    }
+
+    bool EqualsFolded(const wchar_t* text, const Needle& needle)
+    {
+        for (size_t i = 0; i < needle.length; ++i) {
+            if (Fold(text[i]) != needle.folded[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+#ifdef PILOTLIGHT_SEARCH_SSE2
+    // wchar_t is 16 bits on Windows and 32 elsewhere
+    __m128i Splat(wchar_t ch)
+    {
+        if constexpr (sizeof(wchar_t) == 2) {
+            return _mm_set1_epi16(static_cast<short>(ch));
+        } else {
+            return _mm_set1_epi32(static_cast<int>(ch));
+        }
+    }
+
+    __m128i Equal(__m128i a, __m128i b)
+    {
+        if constexpr (sizeof(wchar_t) == 2) {
+            return _mm_cmpeq_epi16(a, b);
+        } else {
+            return _mm_cmpeq_epi32(a, b);
+        }
+    }
+
+    unsigned LowestBit(unsigned mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+    }
+#endif
+
+    size_t FindNeedle(const wchar_t* text, size_t length, size_t from, const Needle& needle)
+    {
+        if (needle.length == 0 || length < needle.length) {
+            return std::wstring::npos;
+        }
+        const size_t last = length - needle.length;  // Final candidate position
+        size_t pos = from;
+#ifdef PILOTLIGHT_SEARCH_SSE2
+        // Test a register of candidate positions at once: a candidate needs a
+        // matching first character and a matching last character, which rules
+        // out almost everything before the scalar compare.
+        constexpr size_t kLanes = 16 / sizeof(wchar_t);
+        constexpr unsigned kLaneBits = (1u << sizeof(wchar_t)) - 1;
+        const __m128i firstLower = Splat(needle.firstLower);
+        const __m128i firstUpper = Splat(needle.firstUpper);
+        const __m128i lastLower = Splat(needle.lastLower);
+        const __m128i lastUpper = Splat(needle.lastUpper);
+        while (pos + kLanes - 1 <= last) {
+            const __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos));
+            const __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos + needle.length - 1));
+            const __m128i hits = _mm_and_si128(_mm_or_si128(Equal(head, firstLower), Equal(head, firstUpper)),
+                                               _mm_or_si128(Equal(tail, lastLower), Equal(tail, lastUpper)));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+            while (mask != 0) {
+                const unsigned bit = LowestBit(mask);
+                const size_t candidate = pos + bit / sizeof(wchar_t);
+                if (EqualsFolded(text + candidate, needle)) {
+                    return candidate;
+                }
+                mask &= ~(kLaneBits << bit);
+            }
+            pos += kLanes;
+        }
+#endif
+        for (; pos <= last; ++pos) {
+            const wchar_t ch = text[pos];
+            if ((ch == needle.firstLower || ch == needle.firstUpper) && EqualsFolded(text + pos, needle)) {
+                return pos;
+            }
+        }
+        return std::wstring::npos;
+    }
+}
+
+TranscriptSearch::TranscriptSearch()
+    : m_count(0)
+    , m_searches(0)
+    , m_scans(0)
+    , m_filters(0)
+    , m_charsScanned(0)
+    , m_scanSeconds(0.0)
+{
+}
+
+void TranscriptSearch::Invalidate()
+{
+    m_levels.clear();
+}
+
+const std::vector<TranscriptSearch::Match>& TranscriptSearch::Find(const std::wstring& query, size_t count,
+                                                                   const TextAt& textAt)
+{
+    ++m_searches;
+    if (count != m_count) {
+        m_levels.clear();
+        m_count = count;
+    }
+
+    // Keep the results of queries the new one extends
+    const std::wstring folded = FoldString(query);
+    while (!m_levels.empty() && folded.compare(0, m_levels.back().query.length(), m_levels.back().query) != 0) {
+        m_levels.pop_back();
+    }
+    if (folded.empty()) {
+        m_levels.clear();
+        return m_empty;
+    }
+    if (!m_levels.empty() && m_levels.back().query == folded) {
+        return m_levels.back().matches;
+    }
+
+    Level level;
+    level.query = folded;
+    level.truncated = false;
+    if (!m_levels.empty() && !m_levels.back().truncated) {
+        Filter(m_levels.back(), level, textAt);
+        ++m_filters;
+    } else {
+        Scan(level, count, textAt);
+        ++m_scans;
+    }
+    m_levels.push_back(std::move(level));
+    return m_levels.back().matches;
+}
+
+size_t TranscriptSearch::FindIn(const wchar_t* text, size_t length, size_t from, const std::wstring& query)
+{
+    const std::wstring folded = FoldString(query);
+    return FindNeedle(text, length, from, MakeNeedle(folded));
+}
+
+std::wstring TranscriptSearch::Describe() const
+{
+    wchar_t text[200];
+    swprintf(text, sizeof(text) / sizeof(text[0]),
+             L"searches=%llu full scans=%llu narrowed=%llu scanned=%llu chars (%.1f MB/s)\r\n",
+             static_cast<unsigned long long>(m_searches), static_cast<unsigned long long>(m_scans),
+             static_cast<unsigned long long>(m_filters), static_cast<unsigned long long>(m_charsScanned),
+             m_scanSeconds > 0.0 ? m_charsScanned / m_scanSeconds / 1e6 : 0.0);
+    return text;
+}
+
+void TranscriptSearch::Scan(Level& level, size_t count, const TextAt& textAt)
+{
+    const auto started = std::chrono::steady_clock::now();
+    const Needle needle = MakeNeedle(level.query);
+    for (size_t index = 0; index < count && !level.truncated; ++index) {
+        const std::wstring& text = textAt(index);
+        size_t pos = 0;
+        while ((pos = FindNeedle(text.data(), text.length(), pos, needle)) != std::wstring::npos) {
+            if (level.matches.size() == kMaxMatches) {
+                level.truncated = true;
+                break;
+            }
+            level.matches.push_back(Match{ static_cast<uint32_t>(index), static_cast<uint32_t>(pos) });
+            ++pos;
+        }
+        m_charsScanned += text.length();
+    }
+    m_scanSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+void TranscriptSearch::Filter(const Level& previous, Level& level, const TextAt& textAt)
+{
+    // Every match of the longer query starts where the shorter one matched
+    const Needle needle = MakeNeedle(level.query);
+    for (const Match& match : previous.matches) {
+        const std::wstring& text = textAt(match.message);
+        if (match.offset + needle.length <= text.length() && EqualsFolded(text.data() + match.offset, needle)) {
+            level.matches.push_back(match);
+        }
+    }
+}
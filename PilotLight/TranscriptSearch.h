@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Find-in-transcript over the in-memory message texts, so searching never
+// goes through the chat control. Matching is case-insensitive (simple
+// lower/upper pairs) and uses SSE2 to test many positions per instruction
+// where available. Results are kept per query prefix: typing another
+// character filters the previous matches instead of rescanning, and
+// deleting one returns the stored result. Portable.
+class TranscriptSearch {
+public:
+    struct Match {
+        uint32_t message;
+        uint32_t offset;  // In the message content; the length is the query length
+    };
+
+    typedef std::function<const std::wstring&(size_t index)> TextAt;
+
+    static constexpr size_t kMaxMatches = 65536;  // Beyond this the count is shown as "N+"
+
+    TranscriptSearch();
+
+    // Drops stored results; call when messages change in place
+    void Invalidate();
+
+    // Matches of query in messages [0, count), in transcript order
+    const std::vector<Match>& Find(const std::wstring& query, size_t count, const TextAt& textAt);
+    bool Truncated() const { return !m_levels.empty() && m_levels.back().truncated; }
+
+    // First case-insensitive occurrence of query in text[from, length), or npos
+    static size_t FindIn(const wchar_t* text, size_t length, size_t from, const std::wstring& query);
+
+    std::wstring Describe() const;
+
+private:
+    struct Level {
+        std::wstring query;  // Folded
+        std::vector<Match> matches;
+        bool truncated;
+    };
+
+    void Scan(Level& level, size_t count, const TextAt& textAt);
+    void Filter(const Level& previous, Level& level, const TextAt& textAt);
+
+    std::vector<Level> m_levels;  // Each query is an extension of the one before it
+    size_t m_count;
+    std::vector<Match> m_empty;
+
+    uint64_t m_searches;
+    uint64_t m_scans;
+    uint64_t m_filters;
+    uint64_t m_charsScanned;
+    double m_scanSeconds;
+};
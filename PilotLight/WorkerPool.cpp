@@ -0,0 +1,71 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(size_t threads)
+    : m_batch(nullptr)
+    , m_next(0)
+    , m_pending(0)
+    , m_stopping(false)
+{
+    for (size_t i = 0; i < threads; ++i) {
+        m_threads.emplace_back(&WorkerPool::WorkerMain, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::Run(const std::vector<std::function<void()>>& tasks)
+{
+    std::unique_lock<std::mutex> batch(m_runLock, std::try_to_lock);
+    if (!batch.owns_lock() || m_threads.empty() || tasks.size() < 2) {
+        for (const auto& task : tasks) {
+            task();
+        }
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_batch = &tasks;
+    m_next = 0;
+    m_pending = tasks.size();
+    m_wake.notify_all();
+
+    while (m_next < tasks.size()) {
+        RunNext(lock);
+    }
+    m_done.wait(lock, [this] { return m_pending == 0; });
+    m_batch = nullptr;
+}
+
+void WorkerPool::WorkerMain()
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    for (;;) {
+        m_wake.wait(lock, [this] { return m_stopping || (m_batch && m_next < m_batch->size()); });
+        if (m_stopping) {
+            return;
+        }
+        RunNext(lock);
+    }
+}
+
+// Takes the next task of the batch and runs it with the lock released
+void WorkerPool::RunNext(std::unique_lock<std::mutex>& lock)
+{
+    const std::function<void()>& task = (*m_batch)[m_next++];
+    lock.unlock();
+    task();
+    lock.lock();
+    if (--m_pending == 0) {
+        m_done.notify_all();
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A few threads that run a batch of independent tasks. The calling thread
+// works on the batch too, and Run returns once every task has finished. One
+// batch runs at a time; a Run that finds the pool busy runs its tasks on the
+// calling thread instead of waiting. Tasks must not throw. Portable.
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t threads);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void Run(const std::vector<std::function<void()>>& tasks);
+    size_t ThreadCount() const { return m_threads.size(); }
+
+private:
+    void WorkerMain();
+    void RunNext(std::unique_lock<std::mutex>& lock);
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_runLock;  // Held for a whole batch
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    const std::vector<std::function<void()>>* m_batch;
+    size_t m_next;     // First task not yet taken
+    size_t m_pending;  // Tasks not yet finished
+    bool m_stopping;
+};
@@ -27,6 +27,7 @@
 #define IDC_BTN_ALWAYS_ALLOW            1017
 #define IDC_BTN_NEVER_ALLOW             1018
 #define IDC_SETTINGS_ENDPOINT           1019
+#define IDC_FIND_EDIT                   1020
 #define ID_TOOL_ALLOW_ONCE              1101
 #define ID_TOOL_ALWAYS_ALLOW            1102
 #define ID_TOOL_NEVER_ALLOW             1103
@@ -37,7 +38,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        104
 #define _APS_NEXT_COMMAND_VALUE         40001
-#define _APS_NEXT_CONTROL_VALUE         1020
+#define _APS_NEXT_CONTROL_VALUE         1021
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif
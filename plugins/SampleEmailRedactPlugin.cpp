@@ -0,0 +1,100 @@
+#include <windows.h>
+#include <cwchar>
+#include <cwctype>
+#include <string>
+#include "../PilotLight/PluginAbi.h"
+
+// Pipeline sample, built twice from this file:
+//
+//   cl /LD /EHsc /I..\PilotLight SampleEmailRedactPlugin.cpp /link /OUT:EmailFinder.dll
+//   cl /LD /EHsc /DREDACT /I..\PilotLight SampleEmailRedactPlugin.cpp /link /OUT:EmailRedact.dll
+//
+// EmailFinder.dll is an analyzer that tags e-mail addresses in the prompt.
+// EmailRedact.dll declares that it runs after it and replaces the tagged
+// spans, so the addresses never leave the machine. Its output depends only
+// on the prompt and the spans, so it also declares itself deterministic.
+
+namespace {
+    const wchar_t kTag[] = L"pii.email";
+    const size_t kTagLength = sizeof(kTag) / sizeof(kTag[0]) - 1;
+}
+
+#ifndef REDACT
+
+extern "C" __declspec(dllexport)
+BOOL WINAPI PilotLight_AnalyzeUserPrompt(const PilotLightText* input, const PilotLightAnnotations* annotations)
+{
+    if (!input || !annotations) {
+        return FALSE;
+    }
+
+    // A word containing '@' with a '.' after it
+    size_t start = 0;
+    while (start < input->length) {
+        while (start < input->length && iswspace(input->data[start])) {
+            ++start;
+        }
+        size_t end = start;
+        size_t at = input->length;
+        while (end < input->length && !iswspace(input->data[end])) {
+            if (input->data[end] == L'@' && at == input->length) {
+                at = end;
+            }
+            ++end;
+        }
+        if (at > start && at < end && wmemchr(input->data + at, L'.', end - at)) {
+            const PilotLightAnnotation annotation = { start, end - start, { kTag, kTagLength }, { nullptr, 0 } };
+            annotations->add(annotations->context, &annotation);
+        }
+        start = end;
+    }
+    return TRUE;
+}
+
+#else
+
+extern "C" __declspec(dllexport)
+const PilotLightPluginInfo* WINAPI PilotLight_GetPluginInfo(void)
+{
+    static const PilotLightPluginInfo info = { sizeof(PilotLightPluginInfo), L"EmailFinder.dll", nullptr,
+                                               PILOTLIGHT_PLUGIN_DETERMINISTIC };
+    return &info;
+}
+
+extern "C" __declspec(dllexport)
+BOOL WINAPI PilotLight_TransformUserPromptAnnotated(const PilotLightText* input,
+                                                   const PilotLightAnnotation* annotations, size_t count,
+                                                   const PilotLightOutput* output)
+{
+    if (!input || !output || count == 0) {
+        return FALSE;
+    }
+
+    // Annotations arrive sorted by start; overlapping spans are skipped
+    static const wchar_t replacement[] = L"[email]";
+    std::wstring text;
+    size_t copied = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const PilotLightAnnotation& annotation = annotations[i];
+        if (annotation.start < copied || annotation.tag.length != kTagLength ||
+            wmemcmp(annotation.tag.data, kTag, kTagLength) != 0) {
+            continue;
+        }
+        text.append(input->data + copied, annotation.start - copied);
+        text += replacement;
+        copied = annotation.start + annotation.length;
+    }
+    if (copied == 0) {
+        return FALSE;
+    }
+    text.append(input->data + copied, input->length - copied);
+
+    wchar_t* buffer = output->allocate(output->context, text.length());
+    if (!buffer) {
+        return FALSE;
+    }
+    wmemcpy(buffer, text.data(), text.length());
+    return TRUE;
+}
+
+#endif
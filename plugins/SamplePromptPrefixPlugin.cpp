@@ -1,33 +1,97 @@
 #include <windows.h>
+#include <cwchar>
 #include <string>
+#include "../PilotLight/PluginAbi.h"
 
+// Version 2 hooks: the input carries its length and output of any size comes
+// from the host allocator
 extern "C" __declspec(dllexport)
-BOOL WINAPI PilotLight_TransformUserPrompt(LPCWSTR input, LPWSTR output, DWORD outputChars)
+BOOL WINAPI PilotLight_TransformUserPromptV2(const PilotLightText* input, const PilotLightOutput* output)
 {
-    if (!input || !output || outputChars == 0) {
+    if (!input || !output) {
         return FALSE;
     }
 
-    const std::wstring prefix = L"[sample-plugin] ";
-    const std::wstring transformed = prefix + input;
+    static const wchar_t prefix[] = L"[sample-plugin] ";
+    const size_t prefixLength = wcslen(prefix);
 
-    if (transformed.size() + 1 > outputChars) {
+    wchar_t* buffer = output->allocate(output->context, prefixLength + input->length);
+    if (!buffer) {
         return FALSE;
     }
 
-    wcscpy_s(output, outputChars, transformed.c_str());
+    wmemcpy(buffer, prefix, prefixLength);
+    wmemcpy(buffer + prefixLength, input->data, input->length);
+    return TRUE;
+}
+
+extern "C" __declspec(dllexport)
+BOOL WINAPI PilotLight_TransformAssistantResponseV2(const PilotLightText* input, const PilotLightOutput* output)
+{
+    if (!input || !output) {
+        return FALSE;
+    }
+
+    static const wchar_t suffix[] = L"\n\n[sample-plugin: response post-processed]";
+    const size_t suffixLength = wcslen(suffix);
+
+    wchar_t* buffer = output->allocate(output->context, input->length + suffixLength);
+    if (!buffer) {
+        return FALSE;
+    }
+
+    wmemcpy(buffer, input->data, input->length);
+    wmemcpy(buffer + input->length, suffix, suffixLength);
+    return TRUE;
+}
+
+// Batch form of the two hooks above for bulk operations such as importing a
+// conversation: the prefix and suffix are measured once for every message
+extern "C" __declspec(dllexport)
+BOOL WINAPI PilotLight_TransformBatch(const PilotLightMessage* messages, size_t count, const PilotLightOutput* outputs)
+{
+    if (!messages || !outputs) {
+        return FALSE;
+    }
+
+    static const wchar_t prefix[] = L"[sample-plugin] ";
+    static const wchar_t suffix[] = L"\n\n[sample-plugin: response post-processed]";
+    const size_t prefixLength = wcslen(prefix);
+    const size_t suffixLength = wcslen(suffix);
+
+    for (size_t i = 0; i < count; ++i) {
+        const PilotLightText& input = messages[i].text;
+        const bool user = messages[i].role == PILOTLIGHT_ROLE_USER;
+        if (!user && messages[i].role != PILOTLIGHT_ROLE_ASSISTANT) {
+            continue;
+        }
+
+        wchar_t* buffer = outputs[i].allocate(outputs[i].context, input.length + (user ? prefixLength : suffixLength));
+        if (!buffer) {
+            continue;
+        }
+        if (user) {
+            wmemcpy(buffer, prefix, prefixLength);
+            wmemcpy(buffer + prefixLength, input.data, input.length);
+        } else {
+            wmemcpy(buffer, input.data, input.length);
+            wmemcpy(buffer + input.length, suffix, suffixLength);
+        }
+    }
     return TRUE;
 }
 
+// Version 1 hook, kept to show the older interface; the host calls the
+// version 2 export instead when a plugin has both
 extern "C" __declspec(dllexport)
-BOOL WINAPI PilotLight_TransformAssistantResponse(LPCWSTR input, LPWSTR output, DWORD outputChars)
+BOOL WINAPI PilotLight_TransformUserPrompt(LPCWSTR input, LPWSTR output, DWORD outputChars)
 {
     if (!input || !output || outputChars == 0) {
         return FALSE;
     }
 
-    const std::wstring suffix = L"\n\n[sample-plugin: response post-processed]";
-    const std::wstring transformed = std::wstring(input) + suffix;
+    const std::wstring prefix = L"[sample-plugin] ";
+    const std::wstring transformed = prefix + input;
 
     if (transformed.size() + 1 > outputChars) {
         return FALSE;
@@ -0,0 +1,56 @@
+#include <windows.h>
+#include <cwchar>
+#include <cwctype>
+#include "../PilotLight/PluginAbi.h"
+
+// Streaming sample: deltas pass through untouched while the plugin counts
+// words, and a note with the count is appended when the reply ends
+
+namespace {
+    struct ReplyState {
+        size_t words;
+        bool inWord;  // The previous delta ended inside a word
+    };
+}
+
+extern "C" __declspec(dllexport)
+void* WINAPI PilotLight_BeginResponse(void)
+{
+    ReplyState* state = new ReplyState;
+    state->words = 0;
+    state->inWord = false;
+    return state;
+}
+
+extern "C" __declspec(dllexport)
+BOOL WINAPI PilotLight_OnDelta(void* context, const PilotLightText* delta, const PilotLightOutput* /*output*/)
+{
+    ReplyState* state = static_cast<ReplyState*>(context);
+    for (size_t i = 0; i < delta->length; ++i) {
+        const bool space = iswspace(delta->data[i]) != 0;
+        if (!space && !state->inWord) {
+            ++state->words;
+        }
+        state->inWord = !space;
+    }
+    return FALSE;  // Show the delta unchanged
+}
+
+extern "C" __declspec(dllexport)
+BOOL WINAPI PilotLight_EndResponse(void* context, const PilotLightOutput* output)
+{
+    ReplyState* state = static_cast<ReplyState*>(context);
+    wchar_t note[64];
+    const int length = swprintf(note, sizeof(note) / sizeof(note[0]), L"\n\n[%zu words]", state->words);
+    delete state;
+
+    if (length <= 0) {
+        return FALSE;
+    }
+    wchar_t* buffer = output->allocate(output->context, static_cast<size_t>(length));
+    if (!buffer) {
+        return FALSE;
+    }
+    wmemcpy(buffer, note, static_cast<size_t>(length));
+    return TRUE;
+}
@@ -0,0 +1,37 @@
+#include "ChatMessage.h"
+#include "TestSupport.h"
+
+namespace {
+    void SameLengthEditChangesDigest()
+    {
+        ChatMessage msg(ChatMessage::Role::User, L"my password is hunter2");
+        const Hash::Digest before = msg.ContentDigest();
+        msg.SetContent(L"my password is *******");
+        CHECK(!(msg.ContentDigest() == before));
+        CHECK(msg.ContentDigest() == ChatMessage(ChatMessage::Role::User, L"my password is *******").ContentDigest());
+    }
+
+    void RoleChangesDigest()
+    {
+        ChatMessage msg(ChatMessage::Role::User, L"hello");
+        const Hash::Digest before = msg.ContentDigest();
+        msg.role = ChatMessage::Role::Assistant;
+        CHECK(!(msg.ContentDigest() == before));
+    }
+
+    void JsonRoundTripKeepsDigest()
+    {
+        const ChatMessage msg(ChatMessage::Role::Assistant, L"line one\nline \"two\"\t\\");
+        const ChatMessage copy = ChatMessage::FromJson(msg.ToJson());
+        CHECK(copy.Content() == msg.Content());
+        CHECK(copy.ContentDigest() == msg.ContentDigest());
+    }
+}
+
+int main()
+{
+    SameLengthEditChangesDigest();
+    RoleChangesDigest();
+    JsonRoundTripKeepsDigest();
+    return TestSupport::Result("ChatMessageTests");
+}
@@ -0,0 +1,89 @@
+#include "EndpointRouter.h"
+#include "TestSupport.h"
+
+namespace {
+    typedef EndpointRouter::Clock Clock;
+
+    const std::wstring kFast = L"https://fast.example/v1/chat/completions";
+    const std::wstring kSlow = L"https://slow.example/v1/chat/completions";
+
+    Clock::time_point At(Clock::time_point start, double seconds)
+    {
+        return start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    }
+
+    void PrefersFastestHealthy()
+    {
+        EndpointRouter router;
+        const Clock::time_point t0 = Clock::now();
+        router.Configure({ kSlow, kFast });
+        router.RecordSuccess(kSlow, 900, t0);
+        router.RecordSuccess(kFast, 200, t0);
+        CHECK(router.Rank(t0).front() == kFast);
+    }
+
+    // One failure makes the endpoint unhealthy, but only until it is old
+    void SingleFailureRecovers()
+    {
+        EndpointRouter router;
+        const Clock::time_point t0 = Clock::now();
+        router.Configure({ kFast, kSlow });
+        router.RecordSuccess(kSlow, 900, t0);
+        router.RecordFailure(kFast, L"connect failed", t0);
+        CHECK(router.Rank(At(t0, 1)).front() == kSlow);
+        CHECK(!router.Snapshot(At(t0, 1))[0].healthy);
+
+        const std::vector<std::wstring> later = router.Rank(At(t0, 120));
+        CHECK(router.Snapshot(At(t0, 120))[0].healthy);
+        CHECK(later.size() == 2);
+
+        // Its next request decides: a success keeps it in the rotation
+        router.RecordSuccess(kFast, 100, At(t0, 120));
+        CHECK(router.Rank(At(t0, 121)).front() == kFast);
+    }
+
+    // After the cool-down one request probes the endpoint; failing again doubles the wait
+    void CoolDownProbes()
+    {
+        EndpointRouter router;
+        const Clock::time_point t0 = Clock::now();
+        router.Configure({ kFast, kSlow });
+        router.RecordSuccess(kSlow, 900, t0);
+        for (int i = 0; i < 3; ++i) {
+            router.RecordFailure(kFast, L"connect failed", t0);
+        }
+        CHECK(router.Rank(At(t0, 4)).front() == kSlow);
+
+        CHECK(router.Rank(At(t0, 5)).front() == kFast);   // Probe
+        CHECK(router.Rank(At(t0, 5.1)).front() == kSlow); // Only one probe per window
+        router.RecordFailure(kFast, L"connect failed", At(t0, 5.2));
+        CHECK(router.Rank(At(t0, 14)).front() == kSlow);  // Ten seconds now
+        CHECK(router.Rank(At(t0, 15.3)).front() == kFast);
+
+        router.RecordSuccess(kFast, 100, At(t0, 15.4));
+        CHECK(router.Snapshot(At(t0, 15.5))[0].healthy);
+        CHECK(router.Rank(At(t0, 16)).front() == kFast);
+    }
+
+    // With every endpoint down the soonest to recover is still offered
+    void LastResort()
+    {
+        EndpointRouter router;
+        const Clock::time_point t0 = Clock::now();
+        router.Configure({ kFast });
+        for (int i = 0; i < 3; ++i) {
+            router.RecordFailure(kFast, L"HTTP 503", t0);
+        }
+        const std::vector<std::wstring> ranked = router.Rank(At(t0, 1));
+        CHECK(ranked.size() == 1 && ranked[0] == kFast);
+    }
+}
+
+int main()
+{
+    PrefersFastestHealthy();
+    SingleFailureRecovers();
+    CoolDownProbes();
+    LastResort();
+    return TestSupport::Result("EndpointRouterTests");
+}
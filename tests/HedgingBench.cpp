@@ -0,0 +1,145 @@
+#include "HedgePolicy.h"
+#include "TestSupport.h"
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Hedged requests against an in-process stand-in server whose first-byte
+// latency is heavy-tailed: most replies take a few milliseconds, 5% take
+// 50-500 ms. Each request races a primary and, once HedgePolicy's delay
+// passes without a reply, a duplicate, the same way OpenAIClient::SendHedged
+// does; the loser is cancelled. Prints latency percentiles with and without
+// hedging and checks the hedge rate stays under the cap.
+
+namespace {
+    class StandInServer {
+    public:
+        explicit StandInServer(unsigned seed) : m_random(seed) {}
+
+        double SampleMs()
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            std::lognormal_distribution<double> body(std::log(5.0), 0.35);
+            std::uniform_real_distribution<double> unit(0.0, 1.0);
+            if (unit(m_random) < 0.05) {
+                // Pareto tail (alpha 1.2) from 50 ms, capped at 500 ms
+                return (std::min)(500.0, 50.0 / std::pow(1.0 - unit(m_random), 1.0 / 1.2));
+            }
+            return body(m_random);
+        }
+
+    private:
+        std::mutex m_lock;
+        std::mt19937 m_random;
+    };
+
+    struct Race {
+        std::mutex lock;
+        std::condition_variable changed;
+        int winner = -1;
+        bool finished[2] = { false, false };
+
+        // Waits out the attempt's latency unless the other attempt wins first
+        void Attempt(int slot, double latencyMs)
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            const bool cancelled = changed.wait_for(guard, std::chrono::duration<double, std::milli>(latencyMs),
+                                                    [&] { return winner != -1; });
+            if (!cancelled) {
+                winner = slot;
+            }
+            finished[slot] = true;
+            changed.notify_all();
+        }
+    };
+
+    struct RunResult {
+        std::vector<double> latencies;
+        size_t hedges = 0;
+        size_t hedgeWins = 0;
+    };
+
+    RunResult Run(size_t requests, bool hedge, unsigned seed)
+    {
+        StandInServer server(seed);
+        HedgePolicy policy;
+        policy.Configure(90.0, 0.1);
+
+        RunResult result;
+        for (size_t i = 0; i < requests; ++i) {
+            policy.RecordRequest();
+            const auto start = std::chrono::steady_clock::now();
+            Race race;
+            std::thread workers[2];
+            const double primaryMs = server.SampleMs();
+            workers[0] = std::thread([&] { race.Attempt(0, primaryMs); });
+
+            double delayMs = 0.0;
+            bool hedged = false;
+            if (hedge && policy.HedgeDelay(delayMs)) {
+                std::unique_lock<std::mutex> guard(race.lock);
+                const bool settled = race.changed.wait_for(guard, std::chrono::duration<double, std::milli>(delayMs),
+                                                           [&] { return race.winner != -1; });
+                guard.unlock();
+                hedged = !settled && policy.TryAcquireHedge();
+            }
+            if (hedged) {
+                const double hedgeMs = server.SampleMs();
+                workers[1] = std::thread([&] { race.Attempt(1, hedgeMs); });
+            }
+            {
+                std::unique_lock<std::mutex> guard(race.lock);
+                race.changed.wait(guard, [&] { return race.winner != -1; });
+            }
+            const double elapsedMs = TestSupport::MillisecondsSince(start);
+            for (auto& worker : workers) {
+                if (worker.joinable()) {
+                    worker.join();
+                }
+            }
+
+            policy.RecordTtft(elapsedMs);
+            if (hedged) {
+                policy.RecordHedgeOutcome(race.winner == 1);
+                ++result.hedges;
+                result.hedgeWins += race.winner == 1 ? 1 : 0;
+            }
+            result.latencies.push_back(elapsedMs);
+        }
+        std::sort(result.latencies.begin(), result.latencies.end());
+        return result;
+    }
+
+    double Percentile(const std::vector<double>& sorted, double percentile)
+    {
+        return sorted[static_cast<size_t>(percentile / 100.0 * (sorted.size() - 1) + 0.5)];
+    }
+
+    void Print(const char* label, const RunResult& result)
+    {
+        const auto& l = result.latencies;
+        std::printf("%-10s p50=%6.1f ms  p90=%6.1f ms  p99=%6.1f ms  max=%6.1f ms  hedges=%zu (%.1f%%, %zu won)\n",
+                    label, Percentile(l, 50), Percentile(l, 90), Percentile(l, 99), l.back(), result.hedges,
+                    100.0 * result.hedges / l.size(), result.hedgeWins);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const size_t requests = TestSupport::Quick(argc, argv) ? 150 : 1500;
+    const RunResult plain = Run(requests, false, 7);
+    const RunResult hedged = Run(requests, true, 7);
+    Print("no hedge", plain);
+    Print("hedged", hedged);
+
+    CHECK(plain.latencies.size() == requests && hedged.latencies.size() == requests);
+    CHECK(plain.hedges == 0);
+    // Budget: 10% of requests plus the burst allowance of two
+    CHECK(hedged.hedges <= requests / 10 + 2);
+    CHECK(hedged.hedges > 0);
+    return TestSupport::Result("HedgingBench");
+}
@@ -0,0 +1,102 @@
+#include "IncrementalMarkdown.h"
+#include "TestSupport.h"
+#include <random>
+#include <string>
+#include <vector>
+
+// Replays a 20k-token streamed reply through the incremental renderer and
+// counts the RTF bytes re-rendered per delta, against re-rendering the whole
+// message on every delta. The stream is synthetic but shaped like a real
+// one: word-sized deltas with a few larger ones, over prose, lists, headings
+// and code blocks.
+
+namespace {
+    std::wstring Reply(size_t characters)
+    {
+        static const wchar_t* kSections[] = {
+            L"## Step %d\n\nFirst, make sure the **build directory** is clean. Then run the configure step and "
+            L"check the output for *warnings* about missing packages; `cmake --version` should print 3.16 or "
+            L"newer. See [the guide](https://example.com/build) for details.\n\n",
+            L"- install the compiler\n- install `ninja`\n  - or use make\n- clone the repository\n\n",
+            L"```cpp\n#include <vector>\n\nint Sum(const std::vector<int>& values)\n{\n    int total = 0;\n"
+            L"    for (int value : values) {\n        total += value;  // no overflow check\n    }\n"
+            L"    return total;\n}\n```\n\n",
+            L"1. open the project\n2. select a target\n3. press build\n\n---\n\n",
+        };
+        std::wstring text;
+        for (int i = 0; text.length() < characters; ++i) {
+            wchar_t section[1024];
+            swprintf(section, sizeof(section) / sizeof(section[0]), kSections[i % 4], i);
+            text += section;
+        }
+        return text;
+    }
+
+    // Token-sized pieces: mostly a word with its leading space, sometimes a few
+    std::vector<size_t> Deltas(const std::wstring& text, size_t tokens, std::mt19937& random)
+    {
+        std::vector<size_t> lengths;
+        for (size_t pos = 0; pos < text.length() && lengths.size() < tokens;) {
+            size_t end = pos + 1;
+            while (end < text.length() && end - pos < 12 && text[end] != L' ' && text[end] != L'\n') {
+                ++end;
+            }
+            if (random() % 16 == 0) {
+                end = (std::min)(text.length(), end + 20);
+            }
+            lengths.push_back(end - pos);
+            pos = end;
+        }
+        return lengths;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const size_t tokens = TestSupport::Quick(argc, argv) ? 4000 : 20000;
+    const std::wstring reply = Reply(tokens * 8);
+    std::mt19937 random(17);
+    const std::vector<size_t> deltas = Deltas(reply, tokens, random);
+
+    RtfMessageStyle style;
+    style.syntaxHighlight = true;
+    IncrementalMarkdownRenderer incremental;
+    incremental.Begin(L"Assistant:", style);
+
+    MarkdownRtfRenderer full;
+    RtfMessageStyle fullStyle = style;
+    fullStyle.markdown = true;
+    const size_t kSampleEvery = 50;
+    double fullBytes = 0.0;  // Estimated from every kSampleEvery-th delta
+
+    size_t bytes = 0;
+    size_t maxBytes = 0;
+    size_t pos = 0;
+    double ms = 0.0;
+    for (size_t i = 0; i < deltas.size(); ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        const IncrementalMarkdownRenderer::Update& update = incremental.Append(reply.c_str() + pos, deltas[i]);
+        ms += TestSupport::MillisecondsSince(start);
+        pos += deltas[i];
+        const size_t deltaBytes = update.stableRtf.size() + update.tailRtf.size();
+        bytes += deltaBytes;
+        maxBytes = (std::max)(maxBytes, deltaBytes);
+        if (i % kSampleEvery == 0) {
+            fullBytes += kSampleEvery * full.Render(L"Assistant:", incremental.Text(), fullStyle).size();
+        }
+    }
+
+    const double average = static_cast<double>(bytes) / deltas.size();
+    const double fullAverage = fullBytes / deltas.size();
+    std::printf("%zu deltas, %zu chars: %.1f ms total, %.2f us per delta\n", deltas.size(), pos, ms,
+                1000.0 * ms / deltas.size());
+    std::printf("RTF bytes per delta: incremental avg %.0f max %zu, full re-render avg %.0f (x%.0f)\n", average,
+                maxBytes, fullAverage, fullAverage / average);
+    std::printf("%ls\n", incremental.Describe().c_str());
+
+    CHECK(deltas.size() == tokens);
+    CHECK(incremental.Text() == reply.substr(0, pos));
+    CHECK(average * 20 < fullAverage);
+    CHECK(maxBytes < 8192);  // Bounded by the largest open block, not the message
+    return TestSupport::Result("IncrementalMarkdownBench");
+}
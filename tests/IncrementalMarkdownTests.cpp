@@ -0,0 +1,76 @@
+#include "IncrementalMarkdown.h"
+#include "TestSupport.h"
+#include <random>
+#include <string>
+
+// Streams a document in many chunkings and checks that the stable fragments
+// plus the last tail render exactly what a one-shot render of the whole text
+// does, plain and with code blocks highlighted.
+
+namespace {
+    // A fragment without its RTF header line and closing brace
+    std::string Body(const std::string& fragment)
+    {
+        const size_t header = fragment.find("}\n");
+        return fragment.substr(header + 2, fragment.length() - header - 3);
+    }
+
+    std::wstring Document()
+    {
+        std::wstring doc;
+        for (int i = 0; i < 20; ++i) {
+            doc += L"## Section " + std::to_wstring(i) + L"\n"
+                   L"Some **bold** text\nwith *italic* #tag, `code` and [a link](https://example.com/" +
+                   std::to_wstring(i) + L").\n\n"
+                   L"- item one\n  continued\n- item two\n  - nested\n1. first\n2. second\n---\n"
+                   L"```cpp\nint main() {\n    /* comment\n       spans lines */\n    return \"}\";\n}\n```\n"
+                   L"#notheading\n\n> not a quote block, just text é中\n\n";
+        }
+        return doc + L"```python\ndef unterminated():\n    pass";
+    }
+
+    bool StreamMatches(const std::wstring& doc, const RtfMessageStyle& style, std::mt19937& random, size_t maxChunk)
+    {
+        IncrementalMarkdownRenderer incremental;
+        incremental.Begin(L"", style);
+        std::string stable;
+        std::string tail;
+        for (size_t pos = 0; pos < doc.length();) {
+            const size_t length = (std::min)(doc.length() - pos, 1 + random() % maxChunk);
+            const IncrementalMarkdownRenderer::Update& update = incremental.Append(doc.c_str() + pos, length);
+            pos += length;
+            if (!update.stableRtf.empty()) {
+                stable += Body(update.stableRtf);
+            }
+            tail = Body(update.tailRtf);
+        }
+
+        RtfMessageStyle full = style;
+        full.markdown = true;
+        MarkdownTokenizer tokenizer;
+        std::vector<MarkdownSpan> spans;
+        tokenizer.Tokenize(doc, spans);
+        MarkdownRtfRenderer renderer;
+        const std::string expected = Body(renderer.RenderSpans(L"", doc.c_str(), spans, 0, spans.size(), full));
+        return incremental.Text() == doc && stable + tail == expected;
+    }
+}
+
+int main()
+{
+    const std::wstring doc = Document();
+    std::mt19937 random(3);
+    for (bool highlight : { false, true }) {
+        RtfMessageStyle style;
+        style.syntaxHighlight = highlight;
+        for (size_t maxChunk : { 1, 2, 5, 16, 200 }) {
+            for (int seed = 0; seed < 4; ++seed) {
+                CHECK(StreamMatches(doc, style, random, maxChunk));
+            }
+        }
+
+        // Everything in one delta
+        CHECK(StreamMatches(doc, style, random, doc.length()));
+    }
+    return TestSupport::Result("IncrementalMarkdownTests");
+}
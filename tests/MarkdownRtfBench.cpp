@@ -0,0 +1,104 @@
+#include "MarkdownRtf.h"
+#include "TestSupport.h"
+#include <string>
+#include <vector>
+
+// RTF rendering throughput on MB-sized transcripts, English and CJK: once as
+// the individual messages a chat view renders, once as a single message at
+// two sizes, where the time ratio shows rendering stays linear.
+
+namespace {
+    const wchar_t* kEnglish =
+        L"## Reversing a list\n\n"
+        L"You can reverse a list **in place** with `list.reverse()`, or build a *new* one with slicing. "
+        L"See [the tutorial](https://docs.python.org/3/tutorial/datastructures.html) for more.\n\n"
+        L"- `reverse()` returns `None`\n"
+        L"- slicing copies: `items[::-1]`\n"
+        L"1. read the list\n2. reverse it\n\n"
+        L"```python\nitems = [1, 2, 3]\nitems.reverse()\nprint(items)  # [3, 2, 1]\n```\n\n"
+        L"Braces {like these} and back\\slashes are escaped.\n\n";
+
+    const wchar_t* kCjk =
+        L"## 反转列表\n\n"
+        L"可以用 `list.reverse()` **原地**反转列表，也可以用切片*新建*一个。"
+        L"更多内容见[教程](https://docs.python.org/zh-cn/3/tutorial/datastructures.html)。\n\n"
+        L"- `reverse()` 返回 `None`\n"
+        L"- 切片会复制：`items[::-1]`\n"
+        L"1. 读取列表\n2. 反转它\n\n"
+        L"```python\nitems = [1, 2, 3]\nitems.reverse()  # 原地\n```\n\n"
+        L"表情符号 \U0001F600 在基本多文种平面之外。\n\n";
+
+    std::wstring Repeat(const wchar_t* piece, size_t characters)
+    {
+        std::wstring text;
+        text.reserve(characters + 1024);
+        while (text.length() < characters) {
+            text += piece;
+        }
+        return text;
+    }
+
+    RtfMessageStyle AssistantStyle()
+    {
+        RtfMessageStyle style;
+        style.markdown = true;
+        style.labelOnOwnLine = true;
+        style.trailingBlankLine = true;
+        return style;
+    }
+
+    // Best of three, in milliseconds; output is the total RTF size of one run
+    double Time(MarkdownRtfRenderer& renderer, const std::vector<std::wstring>& messages, size_t& output)
+    {
+        const RtfMessageStyle style = AssistantStyle();
+        double best = 1e300;
+        for (int run = 0; run < 3; ++run) {
+            output = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (const std::wstring& message : messages) {
+                output += renderer.Render(L"Assistant:", message, style).length();
+            }
+            best = (std::min)(best, TestSupport::MillisecondsSince(start));
+        }
+        return best;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const size_t size = TestSupport::Quick(argc, argv) ? (1u << 20) : (4u << 20);
+    MarkdownRtfRenderer renderer;
+
+    const struct {
+        const char* name;
+        const wchar_t* piece;
+    } kTranscripts[] = {
+        { "english", kEnglish },
+        { "cjk", kCjk },
+    };
+    for (const auto& test : kTranscripts) {
+        // A transcript as the chat view renders it, one message at a time
+        const std::wstring message = Repeat(test.piece, 2048);
+        const std::vector<std::wstring> messages(size / message.length() + 1, message);
+        size_t output = 0;
+        const double ms = Time(renderer, messages, output);
+        std::printf("%-8s %zu messages, %zu chars: %.2f ms, %.0f M chars/s, %.0f MB/s of RTF\n", test.name,
+                    messages.size(), messages.size() * message.length(), ms,
+                    messages.size() * message.length() / ms / 1000.0, output / ms / 1000.0);
+        CHECK(output > messages.size() * message.length());
+
+        // The same text as one message, at a quarter and the full size
+        const std::vector<std::wstring> small(1, Repeat(test.piece, size / 4));
+        const std::vector<std::wstring> large(1, Repeat(test.piece, size));
+        size_t smallOutput = 0;
+        size_t largeOutput = 0;
+        const double smallMs = (std::max)(Time(renderer, small, smallOutput), 0.01);
+        const double largeMs = Time(renderer, large, largeOutput);
+        std::printf("%-8s one message, %zu chars: %.2f ms, %zu chars: %.2f ms (x%.1f)\n", test.name,
+                    small[0].length(), smallMs, large[0].length(), largeMs, largeMs / smallMs);
+        // Four times the input; quadratic would be x16, the slack is for cache effects and noise
+        CHECK(largeMs / smallMs < 10.0);
+        CHECK(largeOutput > 3 * smallOutput);
+    }
+    return TestSupport::Result("MarkdownRtfBench");
+}
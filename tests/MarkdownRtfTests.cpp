@@ -0,0 +1,252 @@
+#include "MarkdownRtf.h"
+#include "TestSupport.h"
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <vector>
+
+// Checks the RTF a message renders to: output stays 7-bit ASCII, non-ASCII
+// text becomes signed 16-bit \uN escapes with a '?' fallback (surrogate pairs
+// outside the BMP), and braces and backslashes are escaped in the label and
+// in both plain and markdown bodies. Then checks the text map against the text
+// a rich edit control shows for the same RTF: every mapped body character must
+// be where the map says, and a search hit in the raw text must select that
+// text, or the link text when it is a hidden link target.
+
+namespace {
+    // Text of an RTF fragment as the control counts it: \par is one character,
+    // \line and \tab one each, \uN one unit, header groups and markup none
+    std::wstring ShownText(const std::string& rtf)
+    {
+        std::wstring text;
+        int skipDepth = 0;
+        int depth = 0;
+        for (size_t i = 0; i < rtf.length(); ++i) {
+            const char ch = rtf[i];
+            if (ch == '{') {
+                ++depth;
+                if (rtf.compare(i, 9, "{\\fonttbl") == 0 || rtf.compare(i, 10, "{\\colortbl") == 0) {
+                    skipDepth = skipDepth ? skipDepth : depth;
+                }
+            } else if (ch == '}') {
+                if (depth == skipDepth) {
+                    skipDepth = 0;
+                }
+                --depth;
+            } else if (ch == '\\') {
+                const char next = rtf[i + 1];
+                if (next == '\\' || next == '{' || next == '}') {
+                    if (!skipDepth) {
+                        text += static_cast<wchar_t>(next);
+                    }
+                    ++i;
+                    continue;
+                }
+                size_t end = i + 1;
+                while (end < rtf.length() && std::isalpha(static_cast<unsigned char>(rtf[end]))) {
+                    ++end;
+                }
+                const std::string word = rtf.substr(i + 1, end - i - 1);
+                size_t numberEnd = end;
+                while (numberEnd < rtf.length() && (rtf[numberEnd] == '-' || std::isdigit(rtf[numberEnd]))) {
+                    ++numberEnd;
+                }
+                const std::string number = rtf.substr(end, numberEnd - end);
+                i = numberEnd < rtf.length() && rtf[numberEnd] == ' ' ? numberEnd : numberEnd - 1;
+                if (skipDepth) {
+                    continue;
+                }
+                if (word == "par") {
+                    text += L'\r';
+                } else if (word == "line") {
+                    text += L'\v';
+                } else if (word == "tab") {
+                    text += L'\t';
+                } else if (word == "u") {
+                    text += static_cast<wchar_t>(static_cast<uint16_t>(std::stoi(number)));
+                    i = numberEnd;  // Skip the '?' fallback
+                }
+            } else if (ch != '\n' && !skipDepth) {
+                text += static_cast<wchar_t>(ch);
+            }
+        }
+        return text;
+    }
+
+    RtfMessageStyle AssistantStyle()
+    {
+        RtfMessageStyle style;
+        style.markdown = true;
+        style.labelOnOwnLine = true;
+        style.trailingBlankLine = true;
+        style.syntaxHighlight = true;
+        return style;
+    }
+
+    RtfMessageStyle UserStyle()
+    {
+        RtfMessageStyle style;
+        style.highlight = true;
+        return style;
+    }
+
+    std::string Escaped(const std::wstring& text)
+    {
+        std::string out;
+        MarkdownRtfRenderer::AppendEscaped(out, text.c_str(), text.length(), true);
+        return out;
+    }
+
+    bool AllAscii(const std::string& rtf)
+    {
+        for (const char ch : rtf) {
+            if (static_cast<unsigned char>(ch) >= 0x80) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void EscapesCharacters()
+    {
+        // Latin-1 and CJK stay positive
+        CHECK(Escaped(L"café") == "caf\\u233?");
+        CHECK(Escaped(L"中文") == "\\u20013?\\u25991?");
+        // From U+8000 on the value wraps to a negative signed 16-bit number
+        CHECK(Escaped(L"耀") == "\\u-32768?");
+        CHECK(Escaped(L"！") == "\\u-255?");
+        // Outside the BMP: one unit where wchar_t is 32 bits, already a pair
+        // where it is 16 bits; both are written as the UTF-16 surrogate pair
+        CHECK(Escaped(L"\U0001F600") == "\\u-10179?\\u-8704?");
+        const wchar_t pair[] = { 0xd83d, 0xde00 };
+        std::string out;
+        MarkdownRtfRenderer::AppendEscaped(out, pair, 2, true);
+        CHECK(out == "\\u-10179?\\u-8704?");
+        // RTF syntax and control characters
+        CHECK(Escaped(L"{a}\\b") == "\\{a\\}\\\\b");
+        CHECK(Escaped(L"x\ty\r\nz\x01") == "x\\tab y\\line z");
+    }
+
+    // A rendered message escapes the same way, and the control shows the
+    // original text back
+    void RenderEscapesBody()
+    {
+        const std::wstring body = L"café 中 ！ \U0001F600 {x} \\ end";
+        MarkdownRtfRenderer renderer;
+
+        const std::string plain = renderer.Render(L"You: ", body, UserStyle());
+        CHECK(AllAscii(plain));
+        CHECK(plain.find("caf\\u233? \\u20013? \\u-255? \\u-10179?\\u-8704? \\{x\\} \\\\ end\\par") !=
+              std::string::npos);
+        std::wstring shown = ShownText(plain);
+        CHECK(shown.find(L"You: café 中 ！ ") != std::wstring::npos);
+        CHECK(shown.find(L"{x} \\ end\r") != std::wstring::npos);
+
+        const std::string markdown = renderer.Render(L"Assistant:", body, AssistantStyle());
+        CHECK(AllAscii(markdown));
+        CHECK(markdown.find("caf\\u233? \\u20013? \\u-255? \\u-10179?\\u-8704? \\{x\\} \\\\ end") !=
+              std::string::npos);
+        shown = ShownText(markdown);
+        CHECK(shown.find(L"Assistant:\r") == 0);
+        CHECK(shown.find(L"{x} \\ end") != std::wstring::npos);
+    }
+
+    void RenderEscapesLabel()
+    {
+        MarkdownRtfRenderer renderer;
+        const std::string rtf = renderer.Render(L"{É}\\: ", L"hi", UserStyle());
+        CHECK(AllAscii(rtf));
+        CHECK(rtf.find("\\{\\u201?\\}\\\\: ") != std::string::npos);
+        CHECK(ShownText(rtf).find(L"{É}\\: hi") != std::wstring::npos);
+    }
+
+    const wchar_t* kBody =
+        L"# Title with *docs*\n\n"
+        L"See [the docs](https://docs.example.com/find) or **bold docs**, `docs()` and _docs_.\n"
+        L"- item with docs\n  - nested docs\n1. first docs\n---\n"
+        L"```python\n# docs here\nprint('docs')\n```\n"
+        L"Tab\there, docs\tagain.\n";
+
+    // Each run's characters appear where the map says
+    void RunsMatchShownText(const std::wstring& label, const std::wstring& body, const RtfMessageStyle& style)
+    {
+        MarkdownRtfRenderer renderer;
+        const std::wstring shown = ShownText(renderer.Render(label, body, style));
+        const std::vector<RtfTextRun> runs = renderer.MapText(label, body, style);
+        CHECK(!runs.empty());
+        bool same = true;
+        for (const RtfTextRun& run : runs) {
+            if (run.hidden) {
+                continue;
+            }
+            for (uint32_t i = 0; i < run.length; ++i) {
+                const wchar_t expected = body[run.source + i] == L'\n' ? L'\v' : body[run.source + i];
+                same = same && run.rendered + i < shown.length() && shown[run.rendered + i] == expected;
+            }
+        }
+        CHECK(same);
+    }
+
+    // Every raw hit of "docs" lands on a shown "docs", in order; the one in the
+    // link target selects the link text
+    void HitsSelectShownText()
+    {
+        const std::wstring body = kBody;
+        const RtfMessageStyle style = AssistantStyle();
+        MarkdownRtfRenderer renderer;
+        const std::wstring shown = ShownText(renderer.Render(L"Assistant:", body, style));
+        const std::vector<RtfTextRun> runs = renderer.MapText(L"Assistant:", body, style);
+
+        const std::wstring link = L"the docs";
+        size_t hits = 0;
+        size_t lastStart = 0;
+        for (size_t pos = 0; (pos = body.find(L"docs", pos)) != std::wstring::npos; ++pos, ++hits) {
+            size_t start = 0;
+            size_t length = 0;
+            CHECK(MarkdownRtfRenderer::MapRange(runs, pos, 4, start, length));
+            const std::wstring selected = shown.substr(start, length);
+            const bool inTarget = body.compare(pos - 9, 9, L"(https://") == 0;
+            CHECK(selected == (inTarget ? link : L"docs"));
+            CHECK(start >= lastStart || inTarget);
+            lastStart = (std::max)(lastStart, start);
+        }
+        CHECK(hits == 12);
+
+        // Markup the raw text has and the control does not
+        size_t start = 0;
+        size_t length = 0;
+        CHECK(!MarkdownRtfRenderer::MapRange(runs, body.find(L"**"), 2, start, length));
+        CHECK(MarkdownRtfRenderer::MapRange(runs, body.find(L"**bold"), 6, start, length));
+        CHECK(shown.substr(start, length) == L"bold");
+        CHECK(!MarkdownRtfRenderer::MapRange(runs, body.find(L"```"), 3, start, length));
+    }
+
+    // Plain bodies keep the inline label ahead of the text
+    void PlainBodyAfterInlineLabel()
+    {
+        const std::wstring body = L"two\nlines, \x01 control {braces} \\ and é";
+        MarkdownRtfRenderer renderer;
+        const std::vector<RtfTextRun> runs = renderer.MapText(L"You: ", body, UserStyle());
+        size_t start = 0;
+        size_t length = 0;
+        CHECK(MarkdownRtfRenderer::MapRange(runs, 0, 3, start, length));
+        CHECK(start == 5 && length == 3);
+        CHECK(MarkdownRtfRenderer::MapRange(runs, body.find(L"control"), 7, start, length));
+        CHECK(start == 5 + body.find(L"control") - 1);  // The control character is dropped
+    }
+}
+
+int main()
+{
+    EscapesCharacters();
+    RenderEscapesBody();
+    RenderEscapesLabel();
+    RunsMatchShownText(L"Assistant:", kBody, AssistantStyle());
+    RunsMatchShownText(L"You: ", kBody, UserStyle());
+    RtfMessageStyle inlineMarkdown = AssistantStyle();
+    inlineMarkdown.labelOnOwnLine = false;
+    RunsMatchShownText(L"System: ", kBody, inlineMarkdown);
+    HitsSelectShownText();
+    PlainBodyAfterInlineLabel();
+    return TestSupport::Result("MarkdownRtfTests");
+}
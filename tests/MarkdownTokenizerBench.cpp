@@ -0,0 +1,87 @@
+#include "MarkdownTokenizer.h"
+#include "TestSupport.h"
+#include <string>
+#include <vector>
+
+// Tokenizer throughput on a synthetic transcript of typical answers, then
+// pathological inputs that were quadratic before (unmatched '*', stray
+// backticks, broken links) at two sizes; the time ratio shows they stay linear.
+
+namespace {
+    std::wstring Transcript(size_t characters)
+    {
+        static const wchar_t* kAnswer =
+            L"## Reversing a list\n\n"
+            L"You can reverse a list **in place** with `list.reverse()`, or build a *new* one with slicing. "
+            L"See [the tutorial](https://docs.python.org/3/tutorial/datastructures.html) for more.\n\n"
+            L"- `reverse()` returns `None`\n"
+            L"- slicing copies: `items[::-1]`\n"
+            L"  - memory grows with *n*\n"
+            L"1. read the list\n2. reverse it\n\n"
+            L"```python\nitems = [1, 2, 3]\nitems.reverse()\nprint(items)  # [3, 2, 1]\n```\n\n"
+            L"Note that 2 * 3 * 4 is arithmetic, not emphasis, and snake_case_names stay as they are.\n\n";
+        std::wstring text;
+        text.reserve(characters + 1024);
+        while (text.length() < characters) {
+            text += kAnswer;
+        }
+        return text;
+    }
+
+    std::wstring Repeat(const wchar_t* piece, size_t characters)
+    {
+        std::wstring text;
+        while (text.length() < characters) {
+            text += piece;
+        }
+        return text;
+    }
+
+    // Best of three, in milliseconds
+    double Time(MarkdownTokenizer& tokenizer, const std::wstring& text, std::vector<MarkdownSpan>& spans)
+    {
+        double best = 1e300;
+        for (int run = 0; run < 3; ++run) {
+            const auto start = std::chrono::steady_clock::now();
+            tokenizer.Tokenize(text, spans);
+            best = (std::min)(best, TestSupport::MillisecondsSince(start));
+        }
+        return best;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const size_t size = TestSupport::Quick(argc, argv) ? (1u << 20) : (4u << 20);
+    MarkdownTokenizer tokenizer;
+    std::vector<MarkdownSpan> spans;
+
+    const std::wstring transcript = Transcript(size);
+    const double ms = Time(tokenizer, transcript, spans);
+    std::printf("transcript: %zu chars, %zu spans, %.2f ms, %.0f M chars/s\n", transcript.length(), spans.size(), ms,
+                transcript.length() / ms / 1000.0);
+    CHECK(!spans.empty());
+
+    const struct {
+        const char* name;
+        const wchar_t* piece;
+    } kPathological[] = {
+        { "unmatched *", L"a * b *c " },
+        { "open **", L"**word " },
+        { "stray `", L"x ` y " },
+        { "broken link", L"[a](b [c] " },
+        { "open [", L"[[x " },
+        { "mixed _*", L"_a*b_c* " },
+    };
+    for (const auto& test : kPathological) {
+        const std::wstring small = Repeat(test.piece, size / 4);
+        const std::wstring large = Repeat(test.piece, size);
+        const double smallMs = (std::max)(Time(tokenizer, small, spans), 0.01);
+        const double largeMs = Time(tokenizer, large, spans);
+        std::printf("%-12s %zu chars: %.2f ms, %zu chars: %.2f ms (x%.1f)\n", test.name, small.length(), smallMs,
+                    large.length(), largeMs, largeMs / smallMs);
+        // Four times the input; quadratic would be x16, the slack is for cache effects and noise
+        CHECK(largeMs / smallMs < 10.0);
+    }
+    return TestSupport::Result("MarkdownTokenizerBench");
+}
@@ -0,0 +1,99 @@
+#include "MarkdownTokenizer.h"
+#include "TestSupport.h"
+#include <string>
+#include <vector>
+
+namespace {
+    // Compact rendering of the span stream: blocks as <p>, <h2>, <li1>, <pre>,
+    // <hr>; styled text as {b:...} {i:...} {bi:...}; inline code as `...`;
+    // links as [text](target); line breaks as |
+    std::wstring Render(const std::wstring& text)
+    {
+        static const wchar_t* kBlocks[] = { L"p", L"h", L"li", L"pre", L"hr" };
+        MarkdownTokenizer tokenizer;
+        std::vector<MarkdownSpan> spans;
+        tokenizer.Tokenize(text, spans);
+
+        std::wstring out;
+        std::wstring target;
+        for (const MarkdownSpan& span : spans) {
+            CHECK(span.start + span.length <= text.length());
+            const std::wstring range = text.substr(span.start, span.length);
+            switch (span.kind) {
+                case MarkdownSpanKind::BlockStart:
+                    out += L"<" + std::wstring(kBlocks[static_cast<int>(span.block)]);
+                    if (span.block == MarkdownBlock::Heading || span.block == MarkdownBlock::ListItem) {
+                        out += std::to_wstring(span.level);
+                    }
+                    out += L">";
+                    break;
+                case MarkdownSpanKind::BlockEnd:
+                    out += L"</>";
+                    break;
+                case MarkdownSpanKind::Text:
+                    if (span.style == MarkdownSpan::Bold) {
+                        out += L"{b:" + range + L"}";
+                    } else if (span.style == MarkdownSpan::Italic) {
+                        out += L"{i:" + range + L"}";
+                    } else if (span.style) {
+                        out += L"{bi:" + range + L"}";
+                    } else {
+                        out += range;
+                    }
+                    break;
+                case MarkdownSpanKind::LineBreak:
+                    out += L"|";
+                    break;
+                case MarkdownSpanKind::Code:
+                    out += L"`" + range + L"`";
+                    break;
+                case MarkdownSpanKind::CodeBlock:
+                    out += text.substr(span.auxStart, span.auxLength) + L":" + range;
+                    out += span.flags & MarkdownSpan::Unterminated ? L"..." : L"";
+                    break;
+                case MarkdownSpanKind::LinkStart:
+                    out += L"[";
+                    target = text.substr(span.auxStart, span.auxLength);
+                    break;
+                case MarkdownSpanKind::LinkEnd:
+                    out += L"](" + target + L")";
+                    break;
+            }
+        }
+        return out;
+    }
+
+    void Expect(const std::wstring& markdown, const std::wstring& expected)
+    {
+        const std::wstring actual = Render(markdown);
+        if (actual != expected) {
+            std::printf("  input:    %ls\n  expected: %ls\n  actual:   %ls\n", markdown.c_str(), expected.c_str(),
+                        actual.c_str());
+            CHECK(actual == expected);
+        }
+    }
+}
+
+int main()
+{
+    Expect(L"plain text", L"<p>plain text</>");
+    Expect(L"# Title\nbody", L"<h1>Title</><p>body</>");
+    Expect(L"*an **important** word*", L"<p>{i:an }{bi:important}{i: word}</>");
+    Expect(L"**bold *and italic* text**", L"<p>{b:bold }{bi:and italic}{b: text}</>");
+    Expect(L"2 * 3 * 4 = 24", L"<p>2 * 3 * 4 = 24</>");
+    Expect(L"snake_case_name", L"<p>snake_case_name</>");
+    Expect(L"use `a*b*c` here", L"<p>use `a*b*c` here</>");
+    Expect(L"see [the docs](https://example.com) now", L"<p>see [the docs](https://example.com) now</>");
+    Expect(L"- one\n- two\n  - nested", L"<li0>one</><li0>two</><li1>nested</>");
+    Expect(L"```cpp\nint x;\n```\nafter", L"<pre>cpp:int x;</><p>after</>");
+    Expect(L"```\nstill open", L"<pre>:still open...</>");
+    Expect(L"line one\nline two", L"<p>line one|line two</>");
+    Expect(L"---", L"<hr></>");
+
+    // Pathological inputs still produce one bounded span stream
+    const std::wstring stars = L"a" + std::wstring(64, L'*') + L"b";
+    Expect(stars, L"<p>" + stars + L"</>");
+    const std::wstring ticks = L"a" + std::wstring(20, L'`') + L"b";
+    Expect(ticks, L"<p>" + ticks + L"</>");
+    return TestSupport::Result("MarkdownTokenizerTests");
+}
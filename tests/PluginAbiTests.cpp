@@ -0,0 +1,159 @@
+#include "PluginHost.h"
+#include "TestSupport.h"
+#include "FakeWin32.h"
+#include <cwchar>
+#include <string>
+#include <vector>
+
+// The transform hooks through the real PluginHost, with fake plugin DLLs:
+// version 2 and version 1 hooks chained in discovery order, version 2
+// preferred when a plugin exports both, and the version 1 output rules
+// (text past the old 8192 character cap fits, unterminated output is
+// ignored).
+
+namespace {
+    BOOL WINAPI Write(const PilotLightOutput* output, const std::wstring& text)
+    {
+        wchar_t* buffer = output->allocate(output->context, text.length());
+        if (!buffer) {
+            return FALSE;
+        }
+        wmemcpy(buffer, text.data(), text.length());
+        return TRUE;
+    }
+
+    BOOL WINAPI PrefixV2(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        return Write(output, L"[v2]" + std::wstring(input->data, input->length));
+    }
+
+    BOOL WINAPI SuffixV1(LPCWSTR input, LPWSTR output, DWORD outputChars)
+    {
+        const size_t length = wcslen(input);
+        if (length + 5 > outputChars) {
+            return FALSE;
+        }
+        wcscpy(output, input);
+        wcscat(output, L"[v1]");
+        return TRUE;
+    }
+
+    BOOL WINAPI Unterminated(LPCWSTR, LPWSTR output, DWORD outputChars)
+    {
+        wmemset(output, L'x', outputChars);
+        return TRUE;
+    }
+
+    // Returns TRUE without allocating: leaves the text unchanged
+    BOOL WINAPI Declines(const PilotLightText*, const PilotLightOutput*)
+    {
+        return TRUE;
+    }
+
+    DWORD g_lastV1Capacity = 0;
+
+    BOOL WINAPI RecordsCapacity(LPCWSTR input, LPWSTR output, DWORD outputChars)
+    {
+        g_lastV1Capacity = outputChars;
+        return SuffixV1(input, output, outputChars);
+    }
+
+    BOOL WINAPI ResponseV2(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        return Write(output, std::wstring(input->data, input->length) + L" (checked)");
+    }
+
+    FakeWin32::Module Plugin(const wchar_t* name, std::map<std::string, FARPROC> exports)
+    {
+        FakeWin32::Module module;
+        module.name = name;
+        module.exports = exports;
+        return module;
+    }
+
+    void ChainsVersionsInDiscoveryOrder()
+    {
+        FakeWin32::SetPlugins({
+            Plugin(L"a-prefix.dll", { { PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2, FakeWin32::Export(&PrefixV2) } }),
+            Plugin(L"b-suffix.dll", { { PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT, FakeWin32::Export(&SuffixV1) } }),
+            Plugin(L"c-prefix.dll", { { PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2, FakeWin32::Export(&PrefixV2) } }),
+        });
+        PluginHost host(false);
+        CHECK(host.LoadedPluginCount() == 3);
+        CHECK(host.ApplyUserMessageTransforms(L"hi") == L"[v2][v2]hi[v1]");
+        // No response hooks: replies pass through
+        CHECK(host.ApplyAssistantResponseTransforms(L"reply") == L"reply");
+    }
+
+    void PrefersVersion2()
+    {
+        FakeWin32::SetPlugins({
+            Plugin(L"both.dll", { { PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT, FakeWin32::Export(&SuffixV1) },
+                                  { PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2, FakeWin32::Export(&PrefixV2) },
+                                  { PILOTLIGHT_EXPORT_TRANSFORM_ASSISTANT_RESPONSE_V2,
+                                    FakeWin32::Export(&ResponseV2) } }),
+        });
+        PluginHost host(false);
+        CHECK(host.ApplyUserMessageTransforms(L"hi") == L"[v2]hi");
+        CHECK(host.ApplyAssistantResponseTransforms(L"reply") == L"reply (checked)");
+    }
+
+    void IgnoresUnusableOutput()
+    {
+        FakeWin32::SetPlugins({
+            Plugin(L"a-unterminated.dll",
+                   { { PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT, FakeWin32::Export(&Unterminated) } }),
+            Plugin(L"b-declines.dll", { { PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2, FakeWin32::Export(&Declines) } }),
+            Plugin(L"c-suffix.dll", { { PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT, FakeWin32::Export(&SuffixV1) } }),
+        });
+        PluginHost host(false);
+        CHECK(host.ApplyUserMessageTransforms(L"hi") == L"hi[v1]");
+    }
+
+    // Version 1 output used to be capped at 8192 characters, and plugins
+    // were skipped for longer prompts
+    void LongPromptsFit()
+    {
+        FakeWin32::SetPlugins({
+            Plugin(L"a-prefix.dll", { { PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2, FakeWin32::Export(&PrefixV2) } }),
+            Plugin(L"b-suffix.dll",
+                   { { PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT, FakeWin32::Export(&RecordsCapacity) } }),
+        });
+        PluginHost host(false);
+        for (size_t length : { size_t(10), size_t(8191), size_t(8192), size_t(20000), size_t(1) << 20 }) {
+            const std::wstring prompt(length, L'p');
+            const std::wstring result = host.ApplyUserMessageTransforms(prompt);
+            CHECK(result == L"[v2]" + prompt + L"[v1]");
+            CHECK(g_lastV1Capacity >= 8192);
+            CHECK(g_lastV1Capacity > 2 * (length + 4));
+        }
+    }
+
+    void UnloadsWhatItLoads()
+    {
+        const size_t loads = FakeWin32::LoadCount();
+        const size_t frees = FakeWin32::FreeCount();
+        FakeWin32::SetPlugins({
+            Plugin(L"a-prefix.dll", { { PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2, FakeWin32::Export(&PrefixV2) } }),
+            Plugin(L"b-nothing.dll", {}),
+        });
+        {
+            PluginHost host(false);
+            CHECK(host.LoadedPluginCount() == 1);
+            CHECK(host.ApplyUserMessageTransforms(L"x") == L"[v2]x");
+        }
+        CHECK(FakeWin32::LoadCount() - loads == 2);
+        CHECK(FakeWin32::FreeCount() - frees == 2);
+    }
+}
+
+int main()
+{
+    FakeWin32::WriteSettings(L"pluginHotReload=0\npluginBudgetMs=0\npluginCacheMaxKB=0\n");
+    ChainsVersionsInDiscoveryOrder();
+    PrefersVersion2();
+    IgnoresUnusableOutput();
+    LongPromptsFit();
+    UnloadsWhatItLoads();
+    return TestSupport::Result("PluginAbiTests");
+}
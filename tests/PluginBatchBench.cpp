@@ -0,0 +1,121 @@
+#include "PluginHost.h"
+#include "TestSupport.h"
+#include "FakeWin32.h"
+#include <cwchar>
+#include <string>
+#include <vector>
+
+// A 1000-message conversation through one tagging plugin, as one
+// PilotLight_TransformBatch per role against a call per message. Each call
+// optionally pays a fixed setup cost first (a plugin preparing a model or
+// a dictionary), which the batch pays twice instead of a thousand times.
+
+namespace {
+    double g_setupUs = 0;
+
+    void Setup()
+    {
+        if (g_setupUs > 0) {
+            const auto start = std::chrono::steady_clock::now();
+            while (TestSupport::MillisecondsSince(start) * 1000.0 < g_setupUs) {
+            }
+        }
+    }
+
+    BOOL Tag(DWORD role, const PilotLightText& text, const PilotLightOutput* output)
+    {
+        wchar_t* buffer = output->allocate(output->context, text.length + 2);
+        if (!buffer) {
+            return FALSE;
+        }
+        buffer[0] = role == PILOTLIGHT_ROLE_USER ? L'U' : L'A';
+        buffer[1] = L':';
+        wmemcpy(buffer + 2, text.data, text.length);
+        return TRUE;
+    }
+
+    BOOL WINAPI TagPrompt(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        Setup();
+        return Tag(PILOTLIGHT_ROLE_USER, *input, output);
+    }
+
+    BOOL WINAPI TagResponse(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        Setup();
+        return Tag(PILOTLIGHT_ROLE_ASSISTANT, *input, output);
+    }
+
+    BOOL WINAPI TagBatch(const PilotLightMessage* messages, size_t count, const PilotLightOutput* outputs)
+    {
+        Setup();
+        for (size_t i = 0; i < count; ++i) {
+            if (!Tag(messages[i].role, messages[i].text, &outputs[i])) {
+                return FALSE;
+            }
+        }
+        return TRUE;
+    }
+
+    std::vector<PluginHost::BatchMessage> Conversation()
+    {
+        std::vector<PluginHost::BatchMessage> messages;
+        for (size_t i = 0; i < 1000; ++i) {
+            messages.push_back({ i % 2 == 0 ? DWORD(PILOTLIGHT_ROLE_USER) : DWORD(PILOTLIGHT_ROLE_ASSISTANT),
+                                 L"message " + std::to_wstring(i) + std::wstring(200, L'x') });
+        }
+        return messages;
+    }
+
+    // Milliseconds per conversation
+    double Measure(const PluginHost& host, bool batch, size_t rounds)
+    {
+        double total = 0;
+        for (size_t round = 0; round < rounds; ++round) {
+            std::vector<PluginHost::BatchMessage> messages = Conversation();
+            const auto start = std::chrono::steady_clock::now();
+            if (batch) {
+                host.ApplyTransformsBatch(messages);
+            } else {
+                for (PluginHost::BatchMessage& message : messages) {
+                    message.text = message.role == PILOTLIGHT_ROLE_USER
+                        ? host.ApplyUserMessageTransforms(message.text)
+                        : host.ApplyAssistantResponseTransforms(message.text);
+                }
+            }
+            total += TestSupport::MillisecondsSince(start);
+            CHECK(messages[0].text.compare(0, 10, L"U:message ") == 0);
+            CHECK(messages[999].text.compare(0, 12, L"A:message 99") == 0);
+        }
+        return total / rounds;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    FakeWin32::WriteSettings(L"pluginHotReload=0\npluginBudgetMs=0\npluginCacheMaxKB=0\n");
+    const bool quick = TestSupport::Quick(argc, argv);
+    FakeWin32::Module tag;
+    tag.name = L"tag.dll";
+    tag.exports[PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2] = FakeWin32::Export(&TagPrompt);
+    tag.exports[PILOTLIGHT_EXPORT_TRANSFORM_ASSISTANT_RESPONSE_V2] = FakeWin32::Export(&TagResponse);
+    tag.exports[PILOTLIGHT_EXPORT_TRANSFORM_BATCH] = FakeWin32::Export(&TagBatch);
+    FakeWin32::SetPlugins({ tag });
+    PluginHost host(false);
+
+    const size_t rounds = quick ? 3 : 20;
+    double batched[2] = {};
+    double single[2] = {};
+    const double setups[] = { 0, 20 };
+    for (size_t i = 0; i < 2; ++i) {
+        g_setupUs = setups[i];
+        batched[i] = Measure(host, true, rounds);
+        single[i] = Measure(host, false, rounds);
+        std::printf("1000 messages, %2.0f us setup per call: %7.2f ms batched, %7.2f ms one by one\n", setups[i],
+                    batched[i], single[i]);
+    }
+
+    CHECK(batched[0] < single[0]);
+    CHECK(batched[1] * 4 < single[1]);
+    return TestSupport::Result("PluginBatchBench");
+}
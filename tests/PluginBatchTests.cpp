@@ -0,0 +1,279 @@
+#include "PluginHost.h"
+#include "TestSupport.h"
+#include "FakeWin32.h"
+#include <atomic>
+#include <cwchar>
+#include <cwctype>
+#include <random>
+#include <string>
+#include <vector>
+
+// PilotLight_TransformBatch through the real PluginHost: a conversation
+// transformed as one batch comes out exactly as it does message by message,
+// through streaming, batch-capable, analyzer, annotated and version 1
+// plugins; the batch export is called once per step; and the wire form used
+// with the isolation helper round-trips.
+
+namespace {
+    BOOL Write(const PilotLightOutput* output, const std::wstring& text)
+    {
+        wchar_t* buffer = output->allocate(output->context, text.length());
+        if (!buffer) {
+            return FALSE;
+        }
+        wmemcpy(buffer, text.data(), text.length());
+        return TRUE;
+    }
+
+    // a-stream.dll: upper-cases replies as they stream and appends a mark at the end
+    void* WINAPI BeginResponse()
+    {
+        return new int(0);
+    }
+
+    BOOL WINAPI OnDelta(void* state, const PilotLightText* delta, const PilotLightOutput* output)
+    {
+        ++*static_cast<int*>(state);
+        std::wstring text(delta->data, delta->length);
+        for (wchar_t& c : text) {
+            c = towupper(c);
+        }
+        return Write(output, text);
+    }
+
+    BOOL WINAPI EndResponse(void* state, const PilotLightOutput* output)
+    {
+        delete static_cast<int*>(state);
+        return Write(output, L"~");
+    }
+
+    // b-batch.dll: tags prompts and replies, one message or many at a time
+    std::atomic<int> g_singleCalls(0);
+    std::atomic<int> g_batchCalls(0);
+    std::atomic<bool> g_batchFails(false);
+
+    std::wstring Tag(DWORD role, const PilotLightText& text)
+    {
+        return (role == PILOTLIGHT_ROLE_USER ? L"U:" : L"A:") + std::wstring(text.data, text.length);
+    }
+
+    BOOL WINAPI TagPrompt(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        ++g_singleCalls;
+        return Write(output, Tag(PILOTLIGHT_ROLE_USER, *input));
+    }
+
+    BOOL WINAPI TagResponse(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        ++g_singleCalls;
+        return Write(output, Tag(PILOTLIGHT_ROLE_ASSISTANT, *input));
+    }
+
+    BOOL WINAPI TagBatch(const PilotLightMessage* messages, size_t count, const PilotLightOutput* outputs)
+    {
+        ++g_batchCalls;
+        if (g_batchFails) {
+            return FALSE;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            // Empty texts are left without output, which leaves them unchanged
+            if (messages[i].text.length > 0 && !Write(&outputs[i], Tag(messages[i].role, messages[i].text))) {
+                return FALSE;
+            }
+        }
+        return TRUE;
+    }
+
+    // c-digits.dll: reports runs of digits
+    BOOL WINAPI FindDigits(const PilotLightText* input, const PilotLightAnnotations* annotations)
+    {
+        for (size_t i = 0; i < input->length;) {
+            if (!iswdigit(input->data[i])) {
+                ++i;
+                continue;
+            }
+            size_t end = i;
+            while (end < input->length && iswdigit(input->data[end])) {
+                ++end;
+            }
+            const PilotLightAnnotation annotation = { i, end - i, { L"digits", 6 }, { nullptr, 0 } };
+            annotations->add(annotations->context, &annotation);
+            i = end;
+        }
+        return TRUE;
+    }
+
+    // d-mask.dll: masks what was reported; deterministic, so it is cached
+    BOOL WINAPI Mask(const PilotLightText* input, const PilotLightAnnotation* annotations, size_t count,
+                     const PilotLightOutput* output)
+    {
+        if (count == 0) {
+            return FALSE;
+        }
+        std::wstring text(input->data, input->length);
+        for (size_t i = 0; i < count; ++i) {
+            text.replace(annotations[i].start, annotations[i].length, annotations[i].length, L'#');
+        }
+        return Write(output, text);
+    }
+
+    const PilotLightPluginInfo* WINAPI Deterministic()
+    {
+        static const PilotLightPluginInfo info = { sizeof(PilotLightPluginInfo), nullptr, nullptr,
+                                                   PILOTLIGHT_PLUGIN_DETERMINISTIC };
+        return &info;
+    }
+
+    // e-dot.dll: version 1, ends prompts with a dot
+    BOOL WINAPI Dot(LPCWSTR input, LPWSTR output, DWORD outputChars)
+    {
+        const size_t length = wcslen(input);
+        if (length + 2 > outputChars) {
+            return FALSE;
+        }
+        wmemcpy(output, input, length);
+        output[length] = L'.';
+        output[length + 1] = L'\0';
+        return TRUE;
+    }
+
+    std::vector<FakeWin32::Module> Plugins()
+    {
+        std::vector<FakeWin32::Module> modules(5);
+        modules[0].name = L"a-stream.dll";
+        modules[0].exports[PILOTLIGHT_EXPORT_BEGIN_RESPONSE] = FakeWin32::Export(&BeginResponse);
+        modules[0].exports[PILOTLIGHT_EXPORT_ON_DELTA] = FakeWin32::Export(&OnDelta);
+        modules[0].exports[PILOTLIGHT_EXPORT_END_RESPONSE] = FakeWin32::Export(&EndResponse);
+        modules[1].name = L"b-batch.dll";
+        modules[1].exports[PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2] = FakeWin32::Export(&TagPrompt);
+        modules[1].exports[PILOTLIGHT_EXPORT_TRANSFORM_ASSISTANT_RESPONSE_V2] = FakeWin32::Export(&TagResponse);
+        modules[1].exports[PILOTLIGHT_EXPORT_TRANSFORM_BATCH] = FakeWin32::Export(&TagBatch);
+        modules[2].name = L"c-digits.dll";
+        modules[2].exports[PILOTLIGHT_EXPORT_ANALYZE_USER_PROMPT] = FakeWin32::Export(&FindDigits);
+        modules[2].exports[PILOTLIGHT_EXPORT_ANALYZE_ASSISTANT_RESPONSE] = FakeWin32::Export(&FindDigits);
+        modules[3].name = L"d-mask.dll";
+        modules[3].exports[PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_ANNOTATED] = FakeWin32::Export(&Mask);
+        modules[3].exports[PILOTLIGHT_EXPORT_TRANSFORM_ASSISTANT_RESPONSE_ANNOTATED] = FakeWin32::Export(&Mask);
+        modules[3].exports[PILOTLIGHT_EXPORT_GET_PLUGIN_INFO] = FakeWin32::Export(&Deterministic);
+        modules[4].name = L"e-dot.dll";
+        modules[4].exports[PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT] = FakeWin32::Export(&Dot);
+        return modules;
+    }
+
+    std::vector<PluginHost::BatchMessage> Conversation(size_t count, unsigned seed)
+    {
+        static const wchar_t* const texts[] = { L"hello", L"call 555 0100", L"", L"order 42 of 7", L"no digits",
+                                                L"x", L"2024-01-02" };
+        std::mt19937 random(seed);
+        std::vector<PluginHost::BatchMessage> messages;
+        for (size_t i = 0; i < count; ++i) {
+            const DWORD role = random() % 8 == 0 ? 3 : (i % 2 == 0 ? PILOTLIGHT_ROLE_USER : PILOTLIGHT_ROLE_ASSISTANT);
+            messages.push_back({ role, texts[random() % 7] + std::to_wstring(random() % 3 == 0 ? i : 0) });
+        }
+        return messages;
+    }
+
+    std::vector<PluginHost::BatchMessage> OneByOne(const PluginHost& host,
+                                                   std::vector<PluginHost::BatchMessage> messages)
+    {
+        for (PluginHost::BatchMessage& message : messages) {
+            if (message.role == PILOTLIGHT_ROLE_USER) {
+                message.text = host.ApplyUserMessageTransforms(message.text);
+            } else if (message.role == PILOTLIGHT_ROLE_ASSISTANT) {
+                message.text = host.ApplyAssistantResponseTransforms(message.text);
+            }
+        }
+        return messages;
+    }
+
+    bool Same(const std::vector<PluginHost::BatchMessage>& a, const std::vector<PluginHost::BatchMessage>& b)
+    {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (a[i].role != b[i].role || a[i].text != b[i].text) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void MatchesOneByOne()
+    {
+        FakeWin32::SetPlugins(Plugins());
+        PluginHost host(false);
+        CHECK(host.LoadedPluginCount() == 5);
+
+        std::vector<PluginHost::BatchMessage> messages = { { PILOTLIGHT_ROLE_USER, L"call 555" },
+                                                           { PILOTLIGHT_ROLE_ASSISTANT, L"ok 12" },
+                                                           { 3, L"tool 9" } };
+        host.ApplyTransformsBatch(messages);
+        CHECK(messages[0].text == L"U:call ###.");
+        CHECK(messages[1].text == L"A:OK ##~");
+        CHECK(messages[2].text == L"tool 9");
+
+        for (unsigned seed = 1; seed <= 20; ++seed) {
+            std::vector<PluginHost::BatchMessage> batch = Conversation(1 + seed * 7, seed);
+            const std::vector<PluginHost::BatchMessage> expected = OneByOne(host, batch);
+            const int batchCalls = g_batchCalls;
+            const int singleCalls = g_singleCalls;
+            host.ApplyTransformsBatch(batch);
+            CHECK(Same(batch, expected));
+            // One call for the prompts and one for the replies, unless a role has a single message
+            CHECK(g_batchCalls - batchCalls <= 2);
+            CHECK(g_singleCalls - singleCalls <= 2);
+        }
+        CHECK(g_batchCalls >= 20);
+    }
+
+    // FALSE from the batch export leaves that plugin's step undone; the others still run
+    void FailedBatchChangesNothing()
+    {
+        FakeWin32::SetPlugins(Plugins());
+        PluginHost host(false);
+        std::vector<PluginHost::BatchMessage> messages = { { PILOTLIGHT_ROLE_USER, L"a 1" },
+                                                           { PILOTLIGHT_ROLE_USER, L"b 2" } };
+        const int batchCalls = g_batchCalls;
+        const int singleCalls = g_singleCalls;
+        g_batchFails = true;
+        host.ApplyTransformsBatch(messages);
+        g_batchFails = false;
+        CHECK(g_batchCalls == batchCalls + 1);
+        CHECK(g_singleCalls == singleCalls);  // No retry one message at a time
+        CHECK(messages[0].text == L"a #.");
+        CHECK(messages[1].text == L"b #.");
+    }
+
+    void WireFormRoundTrips()
+    {
+        const std::vector<PluginHost::BatchMessage> messages = { { PILOTLIGHT_ROLE_USER, L"" },
+                                                                 { PILOTLIGHT_ROLE_ASSISTANT, L"12 3:4 x" },
+                                                                 { 7, std::wstring(70000, L':') },
+                                                                 { PILOTLIGHT_ROLE_USER, L"é中" } };
+        std::vector<PluginHost::BatchMessage> decoded;
+        CHECK(PluginHost::DecodeBatch(PluginHost::EncodeBatch(messages, 0, messages.size()), decoded));
+        CHECK(Same(decoded, messages));
+
+        decoded.clear();
+        CHECK(PluginHost::DecodeBatch(PluginHost::EncodeBatch(messages, 1, 10), decoded));
+        CHECK(Same(decoded, std::vector<PluginHost::BatchMessage>(messages.begin() + 1, messages.end())));
+
+        decoded.clear();
+        CHECK(PluginHost::DecodeBatch(L"", decoded) && decoded.empty());
+        CHECK(PluginHost::EncodeBatch(messages, 4, 1).empty());
+        for (const wchar_t* malformed : { L"x", L"1:abc", L"1 5:abc", L"1 3abc", L"1 2:ab2" }) {
+            decoded.clear();
+            CHECK(!PluginHost::DecodeBatch(malformed, decoded));
+        }
+    }
+}
+
+int main()
+{
+    FakeWin32::WriteSettings(L"pluginHotReload=0\npluginBudgetMs=0\n");
+    MatchesOneByOne();
+    FailedBatchChangesNothing();
+    WireFormRoundTrips();
+    return TestSupport::Result("PluginBatchTests");
+}
@@ -0,0 +1,140 @@
+#include "PluginHost.h"
+#include "PluginCache.h"
+#include "TestSupport.h"
+#include "FakeWin32.h"
+#include <atomic>
+#include <cwchar>
+#include <string>
+
+// PluginCache on its own (hits, misses, the byte bound and LRU eviction, off
+// at 0), then through PluginHost: a deterministic plugin is called once per
+// input and not loaded at all on a warm start, a new DLL version misses, and
+// a plugin without the flag is always called.
+
+namespace {
+    PluginCache::Result Replaced(const std::wstring& output)
+    {
+        PluginCache::Result result = { true, output, Hash::Sha256Of(output) };
+        return result;
+    }
+
+    void LookupAndEvict()
+    {
+        PluginCache cache;
+        cache.Configure(3 * (128 + 100 * sizeof(wchar_t)));  // Three 100-character entries
+        CHECK(cache.Enabled());
+
+        const Hash::Digest a = Hash::Sha256Of(L"a");
+        const Hash::Digest b = Hash::Sha256Of(L"b");
+        const Hash::Digest c = Hash::Sha256Of(L"c");
+        const Hash::Digest d = Hash::Sha256Of(L"d");
+        PluginCache::Result result;
+        CHECK(!cache.Lookup(a, result));
+
+        cache.Store(a, Replaced(std::wstring(100, L'a')));
+        cache.Store(b, Replaced(std::wstring(100, L'b')));
+        const PluginCache::Result unchanged = { false, std::wstring(), c };
+        cache.Store(c, unchanged);
+        CHECK(cache.Lookup(a, result) && result.replaced && result.output == std::wstring(100, L'a'));
+        CHECK(result.outputDigest == Hash::Sha256Of(std::wstring(100, L'a')));
+        CHECK(cache.Lookup(c, result) && !result.replaced && result.output.empty());
+
+        // b is now the least recently used
+        cache.Store(d, Replaced(std::wstring(100, L'd')));
+        CHECK(!cache.Lookup(b, result));
+        CHECK(cache.Lookup(a, result));
+        CHECK(cache.Lookup(c, result));
+        CHECK(cache.Lookup(d, result));
+        CHECK(cache.Describe().find(L"entries=3 ") == 0);
+
+        // Larger than the whole cache: not stored
+        cache.Store(b, Replaced(std::wstring(1000, L'b')));
+        CHECK(!cache.Lookup(b, result));
+
+        cache.Configure(0);
+        CHECK(!cache.Enabled());
+        CHECK(!cache.Lookup(a, result));
+        cache.Store(a, Replaced(L"x"));
+        CHECK(!cache.Lookup(a, result));
+    }
+
+    std::atomic<int> g_deterministicCalls(0);
+    std::atomic<int> g_plainCalls(0);
+
+    BOOL Write(const PilotLightOutput* output, const std::wstring& text)
+    {
+        wchar_t* buffer = output->allocate(output->context, text.length());
+        if (!buffer) {
+            return FALSE;
+        }
+        wmemcpy(buffer, text.data(), text.length());
+        return TRUE;
+    }
+
+    BOOL WINAPI Deterministic(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        ++g_deterministicCalls;
+        return Write(output, L"[d]" + std::wstring(input->data, input->length));
+    }
+
+    BOOL WINAPI Plain(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        ++g_plainCalls;
+        return Write(output, std::wstring(input->data, input->length) + L"[p]");
+    }
+
+    const PilotLightPluginInfo* WINAPI DeterministicInfo()
+    {
+        static const PilotLightPluginInfo info = { sizeof(PilotLightPluginInfo), nullptr, nullptr,
+                                                   PILOTLIGHT_PLUGIN_DETERMINISTIC };
+        return &info;
+    }
+
+    void SetPlugins()
+    {
+        FakeWin32::Module deterministic;
+        deterministic.name = L"a-deterministic.dll";
+        deterministic.exports[PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2] = FakeWin32::Export(&Deterministic);
+        deterministic.exports[PILOTLIGHT_EXPORT_GET_PLUGIN_INFO] = FakeWin32::Export(&DeterministicInfo);
+        FakeWin32::Module plain;
+        plain.name = L"b-plain.dll";
+        plain.exports[PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2] = FakeWin32::Export(&Plain);
+        FakeWin32::SetPlugins({ deterministic, plain });
+    }
+
+    void HostCallsOncePerInput()
+    {
+        SetPlugins();
+        {
+            PluginHost host(false);
+            CHECK(host.ApplyUserMessageTransforms(L"hi") == L"[d]hi[p]");
+            CHECK(host.ApplyUserMessageTransforms(L"hi") == L"[d]hi[p]");
+            CHECK(host.ApplyUserMessageTransforms(L"ho") == L"[d]ho[p]");
+            CHECK(g_deterministicCalls == 2);
+            CHECK(g_plainCalls == 3);
+        }
+
+        // Warm start: the manifest knows the plugins, and a hit needs no DLL
+        const size_t loads = FakeWin32::LoadCount();
+        {
+            PluginHost host(false);
+            CHECK(host.ApplyUserMessageTransforms(L"hi") == L"[d]hi[p]");
+            CHECK(g_deterministicCalls == 2);
+            CHECK(FakeWin32::LoadCount() - loads == 1);  // Only b-plain.dll
+        }
+
+        // A new version of the DLL does not see the old results
+        SetPlugins();
+        PluginHost host(false);
+        CHECK(host.ApplyUserMessageTransforms(L"hi") == L"[d]hi[p]");
+        CHECK(g_deterministicCalls == 3);
+    }
+}
+
+int main()
+{
+    FakeWin32::WriteSettings(L"pluginHotReload=0\npluginBudgetMs=0\npluginCacheMaxKB=64\n");
+    LookupAndEvict();
+    HostCallsOncePerInput();
+    return TestSupport::Result("PluginCacheTests");
+}
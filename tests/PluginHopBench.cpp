@@ -0,0 +1,80 @@
+#include "PluginHost.h"
+#include "TestSupport.h"
+#include "FakeWin32.h"
+#include <cwchar>
+#include <string>
+#include <vector>
+
+// Cost of one plugin hop: a prompt through a chain of plugins that each
+// prepend three characters, with version 2 and with version 1 hooks, for
+// 1 KB and 1 MB prompts. The plugin's own copy of the text is included;
+// at 1 MB it is most of the hop.
+
+namespace {
+    const size_t kChain = 8;
+
+    BOOL WINAPI PrependV2(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        wchar_t* buffer = output->allocate(output->context, input->length + 3);
+        if (!buffer) {
+            return FALSE;
+        }
+        wmemcpy(buffer, L">> ", 3);
+        wmemcpy(buffer + 3, input->data, input->length);
+        return TRUE;
+    }
+
+    BOOL WINAPI PrependV1(LPCWSTR input, LPWSTR output, DWORD outputChars)
+    {
+        const size_t length = wcslen(input);
+        if (length + 4 > outputChars) {
+            return FALSE;
+        }
+        wmemcpy(output, L">> ", 3);
+        wmemcpy(output + 3, input, length + 1);
+        return TRUE;
+    }
+
+    // Microseconds per hop
+    double Measure(const char* exportName, FARPROC hook, size_t length, size_t calls)
+    {
+        std::vector<FakeWin32::Module> modules(kChain);
+        for (size_t i = 0; i < kChain; ++i) {
+            modules[i].name = L"prepend" + std::to_wstring(i) + L".dll";
+            modules[i].exports[exportName] = hook;
+        }
+        FakeWin32::SetPlugins(modules);
+        PluginHost host(false);
+
+        const std::wstring prompt(length, L'p');
+        size_t checksum = host.ApplyUserMessageTransforms(prompt).length();  // Loads and warms up
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < calls; ++i) {
+            checksum += host.ApplyUserMessageTransforms(prompt).length();
+        }
+        const double us = TestSupport::MillisecondsSince(start) * 1000.0 / (calls * kChain);
+        CHECK(checksum == (calls + 1) * (length + 3 * kChain));
+        return us;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    FakeWin32::WriteSettings(L"pluginHotReload=0\npluginBudgetMs=0\npluginCacheMaxKB=0\n");
+    const bool quick = TestSupport::Quick(argc, argv);
+
+    std::printf("per hop, %zu plugins in a chain:\n", kChain);
+    const size_t sizes[] = { 1024, 1024 * 1024 };
+    double v2[2] = {};
+    double v1[2] = {};
+    for (size_t i = 0; i < 2; ++i) {
+        const size_t calls = (sizes[i] > 1024 ? 20 : 20000) / (quick ? 10 : 1);
+        v2[i] = Measure(PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2, FakeWin32::Export(&PrependV2), sizes[i], calls);
+        v1[i] = Measure(PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT, FakeWin32::Export(&PrependV1), sizes[i], calls);
+        std::printf("%7zu chars: v2 %9.2f us, v1 %9.2f us\n", sizes[i], v2[i], v1[i]);
+    }
+
+    // Version 1 copies the output out of its buffer and rescans it; version 2 does neither
+    CHECK(v2[1] < v1[1]);
+    return TestSupport::Result("PluginHopBench");
+}
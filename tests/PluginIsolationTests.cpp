@@ -0,0 +1,135 @@
+#include "PluginHost.h"
+#include "PluginProcess.h"
+#include "TestSupport.h"
+#include "FakeWin32.h"
+#include <csignal>
+#include <cwchar>
+#include <cwctype>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// PluginHost with pluginIsolation=1: the plugins run in a forked helper
+// reached over SharedChannel. Transforms and response streams come back
+// from the helper; a hang is cut off at pluginTimeoutMs and a crash is
+// noticed at once, both leaving the text unchanged and the next call
+// starting a new helper; after four starts within a minute the plugins are
+// bypassed.
+
+namespace {
+    const int kTimeoutMs = 300;
+
+    // PilotLight.exe --plugin-host <channel> <parent pid>
+    int HelperEntry(const std::wstring& commandLine)
+    {
+        std::wistringstream arguments(commandLine.substr(commandLine.find(L"--plugin-host")));
+        std::wstring flag;
+        std::wstring channel;
+        unsigned long parent = 0;
+        arguments >> flag >> channel >> parent;
+        return PluginProcess::RunHelper(channel, parent);
+    }
+
+    BOOL WINAPI Prefix(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        const std::wstring text(input->data, input->length);
+        if (text == L"hang") {
+            std::this_thread::sleep_for(std::chrono::hours(1));
+        } else if (text == L"crash") {
+            raise(SIGSEGV);
+        }
+        const std::wstring result = L"[" + std::to_wstring(getpid()) + L"]" + text;
+        wchar_t* buffer = output->allocate(output->context, result.length());
+        wmemcpy(buffer, result.data(), result.length());
+        return TRUE;
+    }
+
+    void* WINAPI BeginResponse()
+    {
+        return nullptr;
+    }
+
+    BOOL WINAPI UpperDelta(void*, const PilotLightText* delta, const PilotLightOutput* output)
+    {
+        wchar_t* buffer = output->allocate(output->context, delta->length);
+        for (size_t i = 0; i < delta->length; ++i) {
+            buffer[i] = towupper(delta->data[i]);
+        }
+        return TRUE;
+    }
+
+    BOOL WINAPI EndResponse(void*, const PilotLightOutput*)
+    {
+        return FALSE;
+    }
+
+    // Prompts come back with the helper's pid in front
+    std::wstring Helper(const std::wstring& transformed)
+    {
+        return transformed.substr(0, transformed.find(L']') + 1);
+    }
+
+    void RunsInHelper(PluginHost& host)
+    {
+        const std::wstring first = host.ApplyUserMessageTransforms(L"hi");
+        CHECK(host.LoadedPluginCount() == 2);  // Known once the helper is ready
+        const std::wstring helper = Helper(first);
+        CHECK(first == helper + L"hi");
+        CHECK(helper != L"[" + std::to_wstring(getpid()) + L"]");
+        CHECK(host.ApplyUserMessageTransforms(L"again") == helper + L"again");
+
+        PluginHost::ResponseStream stream(host);
+        CHECK(stream.Append(L"stream") == L"STREAM");
+        CHECK(stream.Append(L"ed") == L"ED");
+        CHECK(stream.Finish(L"streamed") == L"STREAMED");
+        CHECK(host.ApplyAssistantResponseTransforms(L"whole") == L"WHOLE");
+    }
+
+    // Returns the new helper's tag
+    std::wstring Restarts(PluginHost& host, const wchar_t* failure, const std::wstring& previous, double maxMs)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        CHECK(host.ApplyUserMessageTransforms(failure) == failure);
+        const double ms = TestSupport::MillisecondsSince(start);
+        std::printf("%ls: passed through in %.0f ms\n", failure, ms);
+        CHECK(ms < maxMs);
+
+        const std::wstring next = Helper(host.ApplyUserMessageTransforms(L"after"));
+        CHECK(host.ApplyUserMessageTransforms(L"after") == next + L"after");
+        CHECK(next != previous);
+        return next;
+    }
+}
+
+int main()
+{
+    wchar_t settings[160];
+    swprintf(settings, sizeof(settings) / sizeof(settings[0]),
+             L"pluginIsolation=1\npluginTimeoutMs=%d\npluginHotReload=0\npluginBudgetMs=0\npluginCacheMaxKB=0\n",
+             kTimeoutMs);
+    FakeWin32::WriteSettings(settings);
+    FakeWin32::SetProcessEntry(&HelperEntry);
+    FakeWin32::Module prefix;
+    prefix.name = L"a-prefix.dll";
+    prefix.exports[PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2] = FakeWin32::Export(&Prefix);
+    FakeWin32::Module upper;
+    upper.name = L"b-upper.dll";
+    upper.exports[PILOTLIGHT_EXPORT_BEGIN_RESPONSE] = FakeWin32::Export(&BeginResponse);
+    upper.exports[PILOTLIGHT_EXPORT_ON_DELTA] = FakeWin32::Export(&UpperDelta);
+    upper.exports[PILOTLIGHT_EXPORT_END_RESPONSE] = FakeWin32::Export(&EndResponse);
+    FakeWin32::SetPlugins({ prefix, upper });
+
+    PluginHost host;
+    RunsInHelper(host);  // First start
+
+    std::wstring helper = Helper(host.ApplyUserMessageTransforms(L"x"));
+    helper = Restarts(host, L"hang", helper, kTimeoutMs + 700.0);  // Second start
+    helper = Restarts(host, L"crash", helper, kTimeoutMs);         // Third
+    helper = Restarts(host, L"crash", helper, kTimeoutMs);         // Fourth
+
+    // A fifth start within the minute is refused: everything passes through
+    CHECK(host.ApplyUserMessageTransforms(L"crash") == L"crash");
+    CHECK(host.ApplyUserMessageTransforms(L"hi") == L"hi");
+    CHECK(host.LoadedPluginCount() == 0);
+    return TestSupport::Result("PluginIsolationTests");
+}
@@ -0,0 +1,125 @@
+#include "PluginHost.h"
+#include "PluginManifest.h"
+#include "TestSupport.h"
+#include "FakeWin32.h"
+#include <cwchar>
+#include <string>
+
+// The manifest round trip and its staleness rules, then PluginHost counting
+// LoadLibrary calls: a cold start loads every DLL, a warm start none, and the
+// first prompt and the first reply load only the plugin they need.
+
+namespace {
+    BOOL Write(const PilotLightOutput* output, const std::wstring& text)
+    {
+        wchar_t* buffer = output->allocate(output->context, text.length());
+        if (!buffer) {
+            return FALSE;
+        }
+        wmemcpy(buffer, text.data(), text.length());
+        return TRUE;
+    }
+
+    BOOL WINAPI Prompt(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        return Write(output, L"[p]" + std::wstring(input->data, input->length));
+    }
+
+    BOOL WINAPI Response(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        return Write(output, std::wstring(input->data, input->length) + L"[r]");
+    }
+
+    void RoundTripAndStaleness()
+    {
+        const std::wstring path = FakeWin32::AppDataPath() + L"\\manifest-test.tsv";
+        PluginManifest::Entry entry;
+        entry.size = 4096;
+        entry.writeTime = 7;
+        entry.exports = PluginManifest::TransformUserPromptV2 | PluginManifest::OnDelta;
+        entry.loadMs = 1.5;
+        {
+            PluginManifest manifest;
+            CHECK(!manifest.Load(path));
+            manifest.Store(L"C:\\p\\a.dll", entry);
+            manifest.Store(L"C:\\p\\b.dll", entry);
+            CHECK(manifest.IsDirty());
+            CHECK(manifest.Save(path));
+            CHECK(!manifest.IsDirty());
+        }
+
+        PluginManifest manifest;
+        CHECK(manifest.Load(path));
+        const PluginManifest::Entry* found = manifest.Find(L"C:\\p\\a.dll", 4096, 7);
+        CHECK(found && found->exports == entry.exports && found->loadMs == 1.5);
+        CHECK(!manifest.Find(L"C:\\p\\a.dll", 4097, 7));  // Resized
+        CHECK(!manifest.Find(L"C:\\p\\a.dll", 4096, 8));  // Rewritten
+        CHECK(!manifest.Find(L"C:\\p\\c.dll", 4096, 7));
+
+        manifest.Store(L"C:\\p\\a.dll", entry);  // Unchanged
+        CHECK(!manifest.IsDirty());
+
+        // A DLL the scan did not see is dropped
+        manifest.BeginScan();
+        manifest.MarkSeen(L"C:\\p\\a.dll");
+        manifest.EndScan();
+        CHECK(manifest.IsDirty());
+        CHECK(manifest.Find(L"C:\\p\\a.dll", 4096, 7));
+        CHECK(!manifest.Find(L"C:\\p\\b.dll", 4096, 7));
+    }
+
+    void WarmStartDefersLoading()
+    {
+        FakeWin32::Module prompt;
+        prompt.name = L"a-prompt.dll";
+        prompt.exports[PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2] = FakeWin32::Export(&Prompt);
+        FakeWin32::Module response;
+        response.name = L"b-response.dll";
+        response.exports[PILOTLIGHT_EXPORT_TRANSFORM_ASSISTANT_RESPONSE_V2] = FakeWin32::Export(&Response);
+        FakeWin32::Module nothing;
+        nothing.name = L"c-nothing.dll";
+        FakeWin32::SetPlugins({ prompt, response, nothing });
+
+        size_t loads = FakeWin32::LoadCount();
+        {
+            PluginHost host(false);
+            CHECK(FakeWin32::LoadCount() - loads == 3);
+            CHECK(host.LoadedPluginCount() == 2);
+        }
+
+        loads = FakeWin32::LoadCount();
+        {
+            PluginHost host(false);
+            CHECK(FakeWin32::LoadCount() - loads == 0);
+            CHECK(host.LoadedPluginCount() == 2);
+            CHECK(host.ApplyUserMessageTransforms(L"hi") == L"[p]hi");
+            CHECK(FakeWin32::LoadCount() - loads == 1);
+            CHECK(host.ApplyUserMessageTransforms(L"again") == L"[p]again");
+            CHECK(FakeWin32::LoadCount() - loads == 1);
+            CHECK(host.ApplyAssistantResponseTransforms(L"reply") == L"reply[r]");
+            CHECK(FakeWin32::LoadCount() - loads == 2);
+        }
+
+        // Changed DLLs are loaded again once, then deferred
+        response.size = 8192;
+        FakeWin32::SetPlugins({ prompt, response, nothing });
+        loads = FakeWin32::LoadCount();
+        {
+            PluginHost host(false);
+            CHECK(FakeWin32::LoadCount() - loads == 3);
+        }
+        loads = FakeWin32::LoadCount();
+        {
+            PluginHost host(false);
+            CHECK(FakeWin32::LoadCount() - loads == 0);
+        }
+    }
+}
+
+int main()
+{
+    FakeWin32::WriteSettings(L"pluginHotReload=0\npluginBudgetMs=0\n");
+    RoundTripAndStaleness();
+    WarmStartDefersLoading();
+    return TestSupport::Result("PluginManifestTests");
+}
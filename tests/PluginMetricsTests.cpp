@@ -0,0 +1,136 @@
+#include "PluginHost.h"
+#include "PluginMetrics.h"
+#include "TestSupport.h"
+#include "FakeWin32.h"
+#include <chrono>
+#include <cwchar>
+#include <string>
+#include <thread>
+
+// Latency percentiles from the log-spaced histogram stay within a bucket of
+// the exact value; the budget bypasses a plugin only after enough over-budget
+// calls in a row, posts one notice, and Reenable undoes it; and PluginHost
+// stops calling a bypassed plugin.
+
+namespace {
+    // Percentile from a Describe line such as "  prompt: calls=100 p50=... ms"
+    double Percentile(const std::wstring& text, const wchar_t* hook, const wchar_t* name)
+    {
+        const size_t line = text.find(std::wstring(L"  ") + hook + L":");
+        const size_t at = text.find(std::wstring(L" ") + name + L"=", line);
+        if (line == std::wstring::npos || at == std::wstring::npos) {
+            return -1.0;
+        }
+        return wcstod(text.c_str() + at + wcslen(name) + 2, nullptr);
+    }
+
+    void PercentilesWithinABucket()
+    {
+        PluginMetrics metrics;
+        const size_t id = metrics.Register(L"a.dll");
+        CHECK(metrics.Register(L"b.dll") != id);
+        CHECK(metrics.Register(L"a.dll") == id);
+        for (int ms = 1; ms <= 100; ++ms) {
+            metrics.Record(id, PluginMetrics::PromptHook, ms);
+        }
+        metrics.Record(id, PluginMetrics::ResponseHook, 0.0004);  // Under a microsecond
+
+        const std::wstring text = metrics.Describe();
+        CHECK(text.find(L"budget off") == 0);
+        CHECK(text.find(L"prompt: calls=100 ") != std::wstring::npos);
+        const double p50 = Percentile(text, L"prompt", L"p50");
+        const double p95 = Percentile(text, L"prompt", L"p95");
+        const double p99 = Percentile(text, L"prompt", L"p99");
+        CHECK(p50 >= 50.0 && p50 <= 50.0 * 1.25);
+        CHECK(p95 >= 95.0 && p95 <= 95.0 * 1.25);
+        CHECK(p99 >= 99.0 && p99 <= 100.0);  // Capped at the largest sample
+        CHECK(Percentile(text, L"response", L"p50") <= 0.001);
+        CHECK(text.find(L"stream:") == std::wstring::npos);  // Hooks never called are left out
+    }
+
+    void BypassesAfterStrikesInARow()
+    {
+        PluginMetrics metrics;
+        metrics.Configure(20.0, 3);
+        const size_t slow = metrics.Register(L"slow.dll");
+        const size_t fast = metrics.Register(L"fast.dll");
+
+        metrics.Record(slow, PluginMetrics::PromptHook, 30.0);
+        metrics.Record(slow, PluginMetrics::StreamHook, 30.0);
+        metrics.Record(slow, PluginMetrics::PromptHook, 10.0);  // Starts the count over
+        metrics.Record(slow, PluginMetrics::PromptHook, 30.0);
+        metrics.Record(slow, PluginMetrics::PromptHook, 30.0);
+        CHECK(!metrics.IsBypassed(slow));
+        CHECK(metrics.TakeNotices().empty());
+
+        metrics.Record(slow, PluginMetrics::ResponseHook, 30.0);
+        metrics.Record(slow, PluginMetrics::ResponseHook, 30.0);  // Already bypassed: no second notice
+        metrics.Record(fast, PluginMetrics::PromptHook, 1.0);
+        CHECK(metrics.IsBypassed(slow));
+        CHECK(!metrics.IsBypassed(fast));
+        const std::vector<std::wstring> notices = metrics.TakeNotices();
+        CHECK(notices.size() == 1);
+        CHECK(!notices.empty() && notices[0].find(L"slow.dll") != std::wstring::npos);
+        CHECK(metrics.TakeNotices().empty());
+        CHECK(metrics.Describe().find(L"slow.dll (bypassed)") != std::wstring::npos);
+
+        CHECK(metrics.Reenable() == 1);
+        CHECK(!metrics.IsBypassed(slow));
+        metrics.Record(slow, PluginMetrics::PromptHook, 30.0);
+        CHECK(!metrics.IsBypassed(slow));  // Strikes were reset too
+        CHECK(metrics.Reenable() == 0);
+    }
+
+    void NoBudgetNoBypass()
+    {
+        PluginMetrics metrics;
+        metrics.Configure(0.0, 1);
+        const size_t id = metrics.Register(L"slow.dll");
+        for (int i = 0; i < 10; ++i) {
+            metrics.Record(id, PluginMetrics::PromptHook, 60000.0);
+        }
+        CHECK(!metrics.IsBypassed(id));
+        CHECK(metrics.TakeNotices().empty());
+    }
+
+    BOOL WINAPI Slow(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(15));
+        const std::wstring text = L"[slow]" + std::wstring(input->data, input->length);
+        wchar_t* buffer = output->allocate(output->context, text.length());
+        if (!buffer) {
+            return FALSE;
+        }
+        wmemcpy(buffer, text.data(), text.length());
+        return TRUE;
+    }
+
+    void HostSkipsBypassedPlugin()
+    {
+        FakeWin32::WriteSettings(L"pluginHotReload=0\npluginBudgetMs=5\npluginBudgetStrikes=2\n");
+        FakeWin32::Module slow;
+        slow.name = L"slow.dll";
+        slow.exports[PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2] = FakeWin32::Export(&Slow);
+        FakeWin32::SetPlugins({ slow });
+
+        PluginHost host(false);
+        CHECK(host.ApplyUserMessageTransforms(L"1") == L"[slow]1");
+        CHECK(host.TakeNotices().empty());
+        CHECK(host.ApplyUserMessageTransforms(L"2") == L"[slow]2");
+        CHECK(host.TakeNotices().size() == 1);
+        CHECK(host.ApplyUserMessageTransforms(L"3") == L"3");
+        CHECK(host.DescribePlugins().find(L"slow.dll (bypassed)") != std::wstring::npos);
+
+        CHECK(host.ReenablePlugins() == 1);
+        CHECK(host.ApplyUserMessageTransforms(L"4") == L"[slow]4");
+    }
+}
+
+int main()
+{
+    PercentilesWithinABucket();
+    BypassesAfterStrikesInARow();
+    NoBudgetNoBypass();
+    HostSkipsBypassedPlugin();
+    return TestSupport::Result("PluginMetricsTests");
+}
@@ -0,0 +1,76 @@
+#include "PluginHost.h"
+#include "TestSupport.h"
+#include "FakeWin32.h"
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+// End-to-end prompt transform latency with 1, 2, 4 and 8 independent
+// analyzers followed by one mutator. Sleeping analyzers (2 ms each, like a
+// plugin waiting on a lookup) show the overlap from the worker pool; empty
+// analyzers show what the pipeline itself costs.
+
+namespace {
+    BOOL WINAPI Sleeps(const PilotLightText*, const PilotLightAnnotations*)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        return TRUE;
+    }
+
+    BOOL WINAPI Empty(const PilotLightText*, const PilotLightAnnotations*)
+    {
+        return TRUE;
+    }
+
+    BOOL WINAPI Mark(const PilotLightText* input, const PilotLightAnnotation*, size_t count,
+                     const PilotLightOutput* output)
+    {
+        wchar_t* buffer = output->allocate(output->context, input->length + 1);
+        std::copy(input->data, input->data + input->length, buffer);
+        buffer[input->length] = static_cast<wchar_t>(L'0' + count % 10);
+        return TRUE;
+    }
+
+    // Milliseconds per prompt
+    double Measure(PilotLightAnalyzeFn analyze, size_t analyzers, size_t calls)
+    {
+        std::vector<FakeWin32::Module> modules(analyzers + 1);
+        for (size_t i = 0; i < analyzers; ++i) {
+            modules[i].name = L"analyzer" + std::to_wstring(i) + L".dll";
+            modules[i].exports[PILOTLIGHT_EXPORT_ANALYZE_USER_PROMPT] = FakeWin32::Export(analyze);
+        }
+        modules[analyzers].name = L"zz-mark.dll";
+        modules[analyzers].exports[PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_ANNOTATED] = FakeWin32::Export(&Mark);
+        FakeWin32::SetPlugins(modules);
+        PluginHost host(false);
+
+        const std::wstring prompt(512, L'p');
+        CHECK(host.ApplyUserMessageTransforms(prompt) == prompt + L"0");  // Loads and warms up
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < calls; ++i) {
+            host.ApplyUserMessageTransforms(prompt);
+        }
+        return TestSupport::MillisecondsSince(start) / calls;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    FakeWin32::WriteSettings(L"pluginHotReload=0\npluginBudgetMs=0\npluginCacheMaxKB=0\n");
+    const bool quick = TestSupport::Quick(argc, argv);
+
+    double sleeping[4] = {};
+    const size_t counts[] = { 1, 2, 4, 8 };
+    for (size_t i = 0; i < 4; ++i) {
+        sleeping[i] = Measure(&Sleeps, counts[i], quick ? 20 : 200);
+        const double empty = Measure(&Empty, counts[i], quick ? 2000 : 20000);
+        std::printf("%zu analyzers: %6.2f ms sleeping (%5.2f ms serial), %6.2f us empty\n", counts[i], sleeping[i],
+                    2.0 * counts[i], empty * 1000.0);
+    }
+
+    // Up to four analyzers at once: the caller and three pool threads
+    CHECK(sleeping[2] < sleeping[0] * 2.0);
+    CHECK(sleeping[3] < 8 * 2.0 * 0.75);
+    return TestSupport::Result("PluginPipelineBench");
+}
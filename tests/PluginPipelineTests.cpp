@@ -0,0 +1,225 @@
+#include "PluginHost.h"
+#include "TestSupport.h"
+#include "FakeWin32.h"
+#include <atomic>
+#include <cwchar>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The dependency-aware pipeline through the real PluginHost: declared order
+// from PilotLight_GetPluginInfo, analyzers of one step running at the same
+// time, their annotations merged in the same order however the threads
+// finish, annotated redaction, and annotations dropped once a mutator
+// changes the text.
+
+namespace {
+    std::atomic<int> g_running(0);
+    std::atomic<int> g_mostRunning(0);
+
+    // Reports every occurrence of word, after a pause that varies with the
+    // call so the analyzers finish in a different order each time
+    BOOL Find(const PilotLightText* input, const PilotLightAnnotations* annotations, const wchar_t* word,
+              const wchar_t* tag, int pauseMs)
+    {
+        const int running = ++g_running;
+        for (int most = g_mostRunning; running > most && !g_mostRunning.compare_exchange_weak(most, running);) {
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(pauseMs));
+        --g_running;
+
+        const std::wstring text(input->data, input->length);
+        const size_t length = wcslen(word);
+        for (size_t at = text.find(word); at != std::wstring::npos; at = text.find(word, at + 1)) {
+            const PilotLightAnnotation annotation = { at, length, { tag, wcslen(tag) }, { word, length } };
+            annotations->add(annotations->context, &annotation);
+        }
+        return TRUE;
+    }
+
+    std::atomic<int> g_calls(0);
+
+    int Pause(int slot)
+    {
+        return 5 + ((g_calls++ + slot) % 4) * 10;
+    }
+
+    BOOL WINAPI FindSecret(const PilotLightText* input, const PilotLightAnnotations* annotations)
+    {
+        return Find(input, annotations, L"secret", L"pii.secret", Pause(0));
+    }
+
+    BOOL WINAPI FindEmail(const PilotLightText* input, const PilotLightAnnotations* annotations)
+    {
+        return Find(input, annotations, L"a@b.c", L"pii.email", Pause(1));
+    }
+
+    BOOL WINAPI FindTerm(const PilotLightText* input, const PilotLightAnnotations* annotations)
+    {
+        return Find(input, annotations, L"secret", L"glossary", Pause(2));
+    }
+
+    // Reports a span, then fails: its report must be discarded
+    BOOL WINAPI FindThenFail(const PilotLightText* input, const PilotLightAnnotations* annotations)
+    {
+        Find(input, annotations, L"a@b.c", L"discarded", Pause(3));
+        return FALSE;
+    }
+
+    // Tries a span past the end of the text
+    BOOL WINAPI FindOutOfRange(const PilotLightText* input, const PilotLightAnnotations* annotations)
+    {
+        const PilotLightAnnotation annotation = { input->length, 1, { L"bad", 3 }, { nullptr, 0 } };
+        return annotations->add(annotations->context, &annotation) == FALSE;
+    }
+
+    std::mutex g_seenLock;
+    std::wstring g_seen;  // The annotations the redactor was last given
+
+    // Replaces each annotated span with its tag, and records what it was given
+    BOOL WINAPI Redact(const PilotLightText* input, const PilotLightAnnotation* annotations, size_t count,
+                       const PilotLightOutput* output)
+    {
+        std::wstring seen;
+        std::wstring result;
+        size_t copied = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const PilotLightAnnotation& annotation = annotations[i];
+            const std::wstring tag(annotation.tag.data, annotation.tag.length);
+            seen += std::to_wstring(annotation.start) + L":" + tag + L";";
+            if (annotation.start >= copied) {
+                result.append(input->data + copied, annotation.start - copied);
+                result += L"<" + tag + L">";
+                copied = annotation.start + annotation.length;
+            }
+        }
+        result.append(input->data + copied, input->length - copied);
+        {
+            std::lock_guard<std::mutex> guard(g_seenLock);
+            g_seen = seen;
+        }
+        wchar_t* buffer = output->allocate(output->context, result.length());
+        wmemcpy(buffer, result.data(), result.length());
+        return TRUE;
+    }
+
+    std::atomic<int> g_shouts(0);
+
+    BOOL WINAPI Shout(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        ++g_shouts;
+        wchar_t* buffer = output->allocate(output->context, input->length + 1);
+        wmemcpy(buffer, input->data, input->length);
+        buffer[input->length] = L'!';
+        return TRUE;
+    }
+
+    const PilotLightPluginInfo* WINAPI RedactAfterAnalyzers()
+    {
+        static const PilotLightPluginInfo info = { sizeof(PilotLightPluginInfo), L"pii.dll; email.dll; FAILS.dll",
+                                                   nullptr, 0 };
+        return &info;
+    }
+
+    // Older plugins pass a shorter structure: the flags are taken as zero, so
+    // this one is not cached although the field says deterministic
+    const PilotLightPluginInfo* WINAPI ShoutFirst()
+    {
+        static const PilotLightPluginInfo info = { offsetof(PilotLightPluginInfo, flags), nullptr, L"a-redact.dll",
+                                                   PILOTLIGHT_PLUGIN_DETERMINISTIC };
+        return &info;
+    }
+
+    FakeWin32::Module Analyzer(const wchar_t* name, PilotLightAnalyzeFn analyze)
+    {
+        FakeWin32::Module module;
+        module.name = name;
+        module.exports[PILOTLIGHT_EXPORT_ANALYZE_USER_PROMPT] = FakeWin32::Export(analyze);
+        return module;
+    }
+
+    FakeWin32::Module Redactor(const wchar_t* name)
+    {
+        FakeWin32::Module module;
+        module.name = name;
+        module.exports[PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_ANNOTATED] = FakeWin32::Export(&Redact);
+        module.exports[PILOTLIGHT_EXPORT_GET_PLUGIN_INFO] = FakeWin32::Export(&RedactAfterAnalyzers);
+        return module;
+    }
+
+    std::wstring Seen()
+    {
+        std::lock_guard<std::mutex> guard(g_seenLock);
+        return g_seen;
+    }
+
+    // The redactor is found first but declares that it runs after the analyzers
+    void RedactsAfterParallelAnalyzers()
+    {
+        FakeWin32::SetPlugins({ Redactor(L"a-redact.dll"), Analyzer(L"email.dll", &FindEmail),
+                                Analyzer(L"fails.dll", &FindThenFail), Analyzer(L"glossary.dll", &FindTerm),
+                                Analyzer(L"pii.dll", &FindSecret), Analyzer(L"range.dll", &FindOutOfRange) });
+        PluginHost host(false);
+        CHECK(host.LoadedPluginCount() == 6);
+
+        const std::wstring prompt = L"mail secret to a@b.c, secret";
+        const std::wstring redacted = L"mail <glossary> to <pii.email>, <glossary>";
+        const std::wstring seen = L"5:glossary;5:pii.secret;15:pii.email;22:glossary;22:pii.secret;";
+        g_mostRunning = 0;
+        for (int i = 0; i < 8; ++i) {
+            CHECK(host.ApplyUserMessageTransforms(prompt) == redacted);
+            CHECK(Seen() == seen);  // Sorted by span, ties in discovery order
+        }
+        std::printf("up to %d analyzers ran at once\n", g_mostRunning.load());
+        CHECK(g_mostRunning >= 2);
+    }
+
+    // A mutator in between changes the text: the redactor only sees what
+    // was found after it
+    void DropsStaleAnnotations()
+    {
+        FakeWin32::Module shout;
+        shout.name = L"shout.dll";
+        shout.exports[PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2] = FakeWin32::Export(&Shout);
+        shout.exports[PILOTLIGHT_EXPORT_GET_PLUGIN_INFO] = FakeWin32::Export(&ShoutFirst);
+        FakeWin32::SetPlugins({ Redactor(L"a-redact.dll"), Analyzer(L"email.dll", &FindEmail), shout });
+        PluginHost host(false);
+
+        // shout runs before a-redact but after email: email's spans are gone by the time a-redact runs
+        CHECK(host.ApplyUserMessageTransforms(L"to a@b.c") == L"to a@b.c!");
+        CHECK(Seen().empty());
+        const int shouts = g_shouts;
+        CHECK(host.ApplyUserMessageTransforms(L"to a@b.c") == L"to a@b.c!");
+        CHECK(g_shouts == shouts + 1);
+    }
+
+    void WallTime()
+    {
+        FakeWin32::SetPlugins({ Analyzer(L"a.dll", &FindSecret), Analyzer(L"b.dll", &FindEmail),
+                                Analyzer(L"c.dll", &FindTerm), Redactor(L"d-redact.dll") });
+        PluginHost host(false);
+        host.ApplyUserMessageTransforms(L"warm up");
+
+        // Three analyzers pausing 5-35 ms each; run one after another they take their sum
+        const int calls = 10;
+        const int before = g_calls;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; ++i) {
+            host.ApplyUserMessageTransforms(L"a secret");
+        }
+        const double ms = TestSupport::MillisecondsSince(start);
+        const double serialMs = (g_calls - before) * 20.0;  // Average pause
+        std::printf("%d prompts through 3 analyzers: %.0f ms, %.0f ms if serial\n", calls, ms, serialMs);
+        CHECK(ms < serialMs * 0.75);
+    }
+}
+
+int main()
+{
+    FakeWin32::WriteSettings(L"pluginHotReload=0\npluginBudgetMs=0\n");
+    RedactsAfterParallelAnalyzers();
+    DropsStaleAnnotations();
+    WallTime();
+    return TestSupport::Result("PluginPipelineTests");
+}
@@ -0,0 +1,121 @@
+#include "PluginHost.h"
+#include "TestSupport.h"
+#include "FakeWin32.h"
+#include <chrono>
+#include <cwchar>
+#include <string>
+#include <thread>
+
+// Hot reload through the real PluginHost: a reply that was streaming when a
+// DLL changed finishes on the old version while new prompts get the new one,
+// the old version is unloaded and its shadow copy deleted once that reply is
+// released, and a removed DLL leaves the set.
+
+namespace {
+    BOOL Write(const PilotLightOutput* output, const std::wstring& text)
+    {
+        wchar_t* buffer = output->allocate(output->context, text.length());
+        if (!buffer) {
+            return FALSE;
+        }
+        wmemcpy(buffer, text.data(), text.length());
+        return TRUE;
+    }
+
+    BOOL WINAPI TagV1(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        return Write(output, std::wstring(input->data, input->length) + L"[v1]");
+    }
+
+    BOOL WINAPI TagV2(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        return Write(output, std::wstring(input->data, input->length) + L"[v2]");
+    }
+
+    FakeWin32::Module Tagger(PilotLightTransformFn tag)
+    {
+        FakeWin32::Module module;
+        module.name = L"tag.dll";
+        module.exports[PILOTLIGHT_EXPORT_TRANSFORM_USER_PROMPT_V2] = FakeWin32::Export(tag);
+        module.exports[PILOTLIGHT_EXPORT_TRANSFORM_ASSISTANT_RESPONSE_V2] = FakeWin32::Export(tag);
+        return module;
+    }
+
+    // Polls until done returns true. The watcher waits 500 ms for the folder
+    // to settle, and may not be watching yet when a test changes it, so with
+    // touch the change is signalled again every second.
+    template <typename Done>
+    bool WaitFor(Done done, bool touch = false)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int polls = 0; !done(); ++polls) {
+            if (TestSupport::MillisecondsSince(start) > 5000.0) {
+                return false;
+            }
+            if (touch && polls % 50 == 0) {
+                FakeWin32::TouchPlugins();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return true;
+    }
+
+    size_t ShadowCopies()
+    {
+        WIN32_FIND_DATAW findData = {};
+        HANDLE find = FindFirstFileW((FakeWin32::AppDataPath() + L"\\plugin-shadow\\*.dll").c_str(), &findData);
+        if (find == INVALID_HANDLE_VALUE) {
+            return 0;
+        }
+        size_t count = 1;
+        while (FindNextFileW(find, &findData)) {
+            ++count;
+        }
+        FindClose(find);
+        return count;
+    }
+
+    void ReplyKeepsItsVersion()
+    {
+        FakeWin32::SetPlugins({ Tagger(&TagV1) });
+        PluginHost host(false);
+        CHECK(host.ApplyUserMessageTransforms(L"hi") == L"hi[v1]");
+        CHECK(ShadowCopies() == 1);
+
+        const size_t frees = FakeWin32::FreeCount();
+        {
+            PluginHost::ResponseStream stream(host);
+            stream.Append(L"rep");
+
+            FakeWin32::SetPlugins({ Tagger(&TagV2) });
+            CHECK(WaitFor([&] { return host.ApplyUserMessageTransforms(L"hi") == L"hi[v2]"; }, true));
+            CHECK(ShadowCopies() == 2);  // Both versions are loaded
+            CHECK(FakeWin32::FreeCount() == frees);
+
+            stream.Append(L"ly");
+            CHECK(stream.Finish(L"reply") == L"reply[v1]");
+        }
+        CHECK(WaitFor([&] { return FakeWin32::FreeCount() == frees + 1; }));
+        CHECK(WaitFor([] { return ShadowCopies() == 1; }));
+        CHECK(host.ApplyAssistantResponseTransforms(L"reply") == L"reply[v2]");
+    }
+
+    void RemovedPluginLeaves()
+    {
+        FakeWin32::SetPlugins({ Tagger(&TagV1) });
+        PluginHost host(false);
+        CHECK(host.LoadedPluginCount() == 1);
+
+        FakeWin32::SetPlugins({});
+        CHECK(WaitFor([&] { return host.LoadedPluginCount() == 0; }, true));
+        CHECK(host.ApplyUserMessageTransforms(L"hi") == L"hi");
+    }
+}
+
+int main()
+{
+    FakeWin32::WriteSettings(L"pluginHotReload=1\npluginBudgetMs=0\n");
+    ReplyKeepsItsVersion();
+    RemovedPluginLeaves();
+    return TestSupport::Result("PluginReloadTests");
+}
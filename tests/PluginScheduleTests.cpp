@@ -0,0 +1,204 @@
+#include "PluginSchedule.h"
+#include "TestSupport.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+// Pipeline order from the plugins' declarations: discovery order where
+// nothing is declared, analyzers that are ready together sharing a step,
+// declarations honoured case-insensitively, cycles broken at the first
+// plugin found, and every plugin run exactly once.
+
+namespace {
+    typedef PluginSchedule::Node Node;
+
+    Node Mutator(const wchar_t* name, std::vector<std::wstring> after = {}, std::vector<std::wstring> before = {})
+    {
+        return Node{ name, false, after, before };
+    }
+
+    Node Analyzer(const wchar_t* name, std::vector<std::wstring> after = {}, std::vector<std::wstring> before = {})
+    {
+        return Node{ name, true, after, before };
+    }
+
+    // The node indexes in run order
+    std::vector<size_t> Order(const std::vector<PluginSchedule::Step>& steps)
+    {
+        std::vector<size_t> order;
+        for (const auto& step : steps) {
+            order.insert(order.end(), step.nodes.begin(), step.nodes.end());
+        }
+        return order;
+    }
+
+    void KeepsDiscoveryOrder()
+    {
+        const auto steps = PluginSchedule::Build({ Mutator(L"a.dll"), Mutator(L"b.dll"), Mutator(L"c.dll") });
+        CHECK(steps.size() == 3);
+        CHECK(Order(steps) == std::vector<size_t>({ 0, 1, 2 }));
+        CHECK(PluginSchedule::Build({}).empty());
+    }
+
+    void GroupsReadyAnalyzers()
+    {
+        // The mutator found between analyzers keeps its place
+        const auto steps = PluginSchedule::Build({ Analyzer(L"pii.dll"), Analyzer(L"glossary.dll"),
+                                                   Mutator(L"redact.dll"), Analyzer(L"tone.dll"),
+                                                   Analyzer(L"length.dll") });
+        CHECK(steps.size() == 3);
+        CHECK(steps[0].analyzers && steps[0].nodes == std::vector<size_t>({ 0, 1 }));
+        CHECK(!steps[1].analyzers && steps[1].nodes == std::vector<size_t>({ 2 }));
+        CHECK(steps[2].analyzers && steps[2].nodes == std::vector<size_t>({ 3, 4 }));
+    }
+
+    void HonoursDeclarations()
+    {
+        // redact waits for both analyzers although it was found first; the
+        // analyzers still share a step
+        auto steps = PluginSchedule::Build({ Mutator(L"redact.dll", { L"PII.DLL", L" glossary.dll" }),
+                                             Analyzer(L"pii.dll"), Analyzer(L"glossary.dll") });
+        CHECK(steps.size() == 2);
+        CHECK(steps[0].analyzers && steps[0].nodes == std::vector<size_t>({ 1, 2 }));
+        CHECK(steps[1].nodes == std::vector<size_t>({ 0 }));
+
+        // runsBefore holds back the plugin it names; unknown names are ignored
+        steps = PluginSchedule::Build({ Mutator(L"a.dll"), Mutator(L"b.dll"),
+                                        Mutator(L"c.dll", {}, { L"a.dll", L"missing.dll" }) });
+        CHECK(Order(steps) == std::vector<size_t>({ 1, 2, 0 }));
+
+        // A plugin naming itself changes nothing
+        steps = PluginSchedule::Build({ Mutator(L"a.dll", { L"a.dll" }), Mutator(L"b.dll") });
+        CHECK(Order(steps) == std::vector<size_t>({ 0, 1 }));
+    }
+
+    // Among ready plugins the one found first runs first, so a declaration
+    // only moves the plugins it names
+    void BreaksTiesByDiscovery()
+    {
+        const auto steps = PluginSchedule::Build({ Mutator(L"a.dll", { L"d.dll" }), Mutator(L"b.dll"),
+                                                   Mutator(L"c.dll"), Mutator(L"d.dll") });
+        CHECK(Order(steps) == std::vector<size_t>({ 1, 2, 3, 0 }));
+    }
+
+    void BreaksCycles()
+    {
+        size_t broken = 99;
+        auto steps = PluginSchedule::Build({ Mutator(L"x.dll"), Mutator(L"a.dll", { L"b.dll" }),
+                                             Mutator(L"b.dll", { L"a.dll" }) }, &broken);
+        CHECK(broken == 1);
+        CHECK(Order(steps) == std::vector<size_t>({ 0, 1, 2 }));
+
+        steps = PluginSchedule::Build({ Mutator(L"a.dll"), Mutator(L"b.dll") }, &broken);
+        CHECK(broken == 0);
+
+        // A three-way cycle, with a plugin waiting on it
+        steps = PluginSchedule::Build({ Mutator(L"late.dll", { L"c.dll" }), Mutator(L"a.dll", { L"c.dll" }),
+                                        Mutator(L"b.dll", { L"a.dll" }), Mutator(L"c.dll", { L"b.dll" }) },
+                                      &broken);
+        CHECK(broken == 1);
+        CHECK(Order(steps) == std::vector<size_t>({ 1, 2, 3, 0 }));
+    }
+
+    // Random declarations: every node once, steps ascending, and every
+    // declaration kept when there is no cycle
+    void RandomGraphs()
+    {
+        std::mt19937 random(46);
+        for (int round = 0; round < 500; ++round) {
+            const size_t count = 1 + random() % 12;
+            std::vector<Node> nodes(count);
+            for (size_t i = 0; i < count; ++i) {
+                nodes[i].name = L"p" + std::to_wstring(i) + L".dll";
+                nodes[i].analyzer = random() % 2 == 0;
+            }
+            // Edges only from a lower to a higher rank of a random permutation, so there is no cycle
+            std::vector<size_t> rank(count);
+            for (size_t i = 0; i < count; ++i) {
+                rank[i] = i;
+            }
+            std::shuffle(rank.begin(), rank.end(), random);
+            std::vector<std::pair<size_t, size_t>> edges;
+            for (size_t e = random() % (2 * count + 1); e > 0; --e) {
+                size_t from = random() % count;
+                size_t to = random() % count;
+                if (rank[from] == rank[to]) {
+                    continue;
+                }
+                if (rank[from] > rank[to]) {
+                    std::swap(from, to);
+                }
+                edges.push_back({ from, to });
+                if (random() % 2) {
+                    nodes[to].runsAfter.push_back(nodes[from].name);
+                } else {
+                    nodes[from].runsBefore.push_back(nodes[to].name);
+                }
+            }
+
+            size_t broken = 99;
+            const auto steps = PluginSchedule::Build(nodes, &broken);
+            CHECK(broken == 0);
+            std::vector<size_t> stepOf(count, SIZE_MAX);
+            for (size_t s = 0; s < steps.size(); ++s) {
+                CHECK(!steps[s].nodes.empty());
+                CHECK(std::is_sorted(steps[s].nodes.begin(), steps[s].nodes.end()));
+                CHECK(steps[s].analyzers || steps[s].nodes.size() == 1);
+                for (size_t node : steps[s].nodes) {
+                    CHECK(stepOf[node] == SIZE_MAX);
+                    CHECK(nodes[node].analyzer == steps[s].analyzers);
+                    stepOf[node] = s;
+                }
+            }
+            CHECK(std::count(stepOf.begin(), stepOf.end(), SIZE_MAX) == 0);
+            for (const auto& edge : edges) {
+                CHECK(stepOf[edge.first] < stepOf[edge.second]);
+            }
+        }
+    }
+
+    // Any declarations, cycles included: every node still runs exactly once
+    void RandomCycles()
+    {
+        std::mt19937 random(64);
+        for (int round = 0; round < 500; ++round) {
+            const size_t count = 1 + random() % 10;
+            std::vector<Node> nodes(count);
+            for (size_t i = 0; i < count; ++i) {
+                nodes[i].name = L"p" + std::to_wstring(i) + L".dll";
+                nodes[i].analyzer = random() % 3 == 0;
+                for (size_t e = random() % 3; e > 0; --e) {
+                    nodes[i].runsAfter.push_back(L"p" + std::to_wstring(random() % count) + L".dll");
+                }
+            }
+            std::vector<size_t> order = Order(PluginSchedule::Build(nodes));
+            std::sort(order.begin(), order.end());
+            CHECK(order.size() == count);
+            for (size_t i = 0; i < order.size(); ++i) {
+                CHECK(order[i] == i);
+            }
+        }
+    }
+
+    void SplitsNames()
+    {
+        CHECK(PluginSchedule::SplitNames(L"").empty());
+        CHECK(PluginSchedule::SplitNames(L" ; ;").empty());
+        CHECK(PluginSchedule::SplitNames(L" a.dll ;b.dll;; c d.dll ") ==
+              std::vector<std::wstring>({ L"a.dll", L"b.dll", L"c d.dll" }));
+    }
+}
+
+int main()
+{
+    KeepsDiscoveryOrder();
+    GroupsReadyAnalyzers();
+    HonoursDeclarations();
+    BreaksTiesByDiscovery();
+    BreaksCycles();
+    RandomGraphs();
+    RandomCycles();
+    SplitsNames();
+    return TestSupport::Result("PluginScheduleTests");
+}
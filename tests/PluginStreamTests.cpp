@@ -0,0 +1,171 @@
+#include "PluginHost.h"
+#include "TestSupport.h"
+#include "FakeWin32.h"
+#include <cwchar>
+#include <cwctype>
+#include <string>
+
+// One reply through PluginHost::ResponseStream with a chain of a plugin that
+// holds text back until a word is complete, a streaming plugin after it and a
+// whole-response v2 plugin at the end: what is shown while streaming, the
+// final text, a final reply that differs from what was streamed, and that
+// every BeginResponse is matched by an EndResponse.
+
+namespace {
+    int g_begins = 0;
+    int g_ends = 0;
+
+    BOOL Write(const PilotLightOutput* output, const std::wstring& text)
+    {
+        wchar_t* buffer = output->allocate(output->context, text.length());
+        if (!buffer) {
+            return FALSE;
+        }
+        wmemcpy(buffer, text.data(), text.length());
+        return TRUE;
+    }
+
+    std::wstring Upper(std::wstring text)
+    {
+        for (wchar_t& ch : text) {
+            ch = static_cast<wchar_t>(std::towupper(ch));
+        }
+        return text;
+    }
+
+    // Upper-cases whole words; a word still being written is held back
+    void* WINAPI WordsBegin()
+    {
+        ++g_begins;
+        return new std::wstring();
+    }
+
+    BOOL WINAPI WordsDelta(void* state, const PilotLightText* delta, const PilotLightOutput* output)
+    {
+        std::wstring& pending = *static_cast<std::wstring*>(state);
+        pending.append(delta->data, delta->length);
+        const size_t space = pending.find_last_of(L' ');
+        if (space == std::wstring::npos) {
+            return TRUE;  // Nothing allocated: the delta is dropped for now
+        }
+        const std::wstring words = pending.substr(0, space + 1);
+        pending.erase(0, space + 1);
+        return Write(output, Upper(words));
+    }
+
+    BOOL WINAPI WordsEnd(void* state, const PilotLightOutput* output)
+    {
+        ++g_ends;
+        std::wstring* pending = static_cast<std::wstring*>(state);
+        const BOOL wrote = !pending->empty() && Write(output, Upper(*pending));
+        delete pending;
+        return wrote;
+    }
+
+    // Streams without state: every 'O' becomes '0'
+    void* WINAPI ZerosBegin()
+    {
+        ++g_begins;
+        return nullptr;
+    }
+
+    BOOL WINAPI ZerosDelta(void*, const PilotLightText* delta, const PilotLightOutput* output)
+    {
+        std::wstring text(delta->data, delta->length);
+        if (text.find(L'O') == std::wstring::npos) {
+            return FALSE;
+        }
+        for (wchar_t& ch : text) {
+            ch = ch == L'O' ? L'0' : ch;
+        }
+        return Write(output, text);
+    }
+
+    BOOL WINAPI ZerosEnd(void*, const PilotLightOutput*)
+    {
+        ++g_ends;
+        return FALSE;
+    }
+
+    BOOL WINAPI Done(const PilotLightText* input, const PilotLightOutput* output)
+    {
+        return Write(output, std::wstring(input->data, input->length) + L" [done]");
+    }
+
+    void SetChain()
+    {
+        FakeWin32::Module words;
+        words.name = L"a-words.dll";
+        words.exports[PILOTLIGHT_EXPORT_BEGIN_RESPONSE] = FakeWin32::Export(&WordsBegin);
+        words.exports[PILOTLIGHT_EXPORT_ON_DELTA] = FakeWin32::Export(&WordsDelta);
+        words.exports[PILOTLIGHT_EXPORT_END_RESPONSE] = FakeWin32::Export(&WordsEnd);
+        FakeWin32::Module zeros;
+        zeros.name = L"b-zeros.dll";
+        zeros.exports[PILOTLIGHT_EXPORT_BEGIN_RESPONSE] = FakeWin32::Export(&ZerosBegin);
+        zeros.exports[PILOTLIGHT_EXPORT_ON_DELTA] = FakeWin32::Export(&ZerosDelta);
+        zeros.exports[PILOTLIGHT_EXPORT_END_RESPONSE] = FakeWin32::Export(&ZerosEnd);
+        FakeWin32::Module done;
+        done.name = L"c-done.dll";
+        done.exports[PILOTLIGHT_EXPORT_TRANSFORM_ASSISTANT_RESPONSE_V2] = FakeWin32::Export(&Done);
+        FakeWin32::SetPlugins({ words, zeros, done });
+    }
+
+    // Held-back text reaches the final reply through the plugins after the one
+    // that released it; the whole-response plugin only sees the final text
+    void ShownAndFinal()
+    {
+        PluginHost host(false);
+        std::wstring shown;
+        {
+            PluginHost::ResponseStream stream(host);
+            shown += stream.Append(L"hel");
+            CHECK(shown.empty());
+            shown += stream.Append(L"lo wor");
+            CHECK(shown == L"HELL0 ");
+            shown += stream.Append(L"ld");
+            CHECK(shown == L"HELL0 ");
+            CHECK(stream.Finish(L"hello world") == L"HELL0 W0RLD [done]");
+        }
+        CHECK(g_begins == g_ends);
+    }
+
+    // An error or cached answer instead of the streamed text starts over
+    void MismatchedFinalReply()
+    {
+        PluginHost host(false);
+        PluginHost::ResponseStream stream(host);
+        stream.Append(L"partial ");
+        CHECK(stream.Finish(L"Error: timed out") == L"ERR0R: TIMED 0UT [done]");
+        CHECK(g_begins == g_ends);
+    }
+
+    // A reply that arrived whole counts as one delta
+    void UnstreamedReply()
+    {
+        PluginHost host(false);
+        CHECK(host.ApplyAssistantResponseTransforms(L"one two") == L"0NE TW0 [done]");
+        CHECK(g_begins == g_ends);
+    }
+
+    void DroppedStreamEnds()
+    {
+        PluginHost host(false);
+        const int begins = g_begins;
+        {
+            PluginHost::ResponseStream stream(host);
+            stream.Append(L"never finished");
+        }
+        CHECK(g_begins - begins == 2);
+        CHECK(g_begins == g_ends);
+    }
+}
+
+int main()
+{
+    SetChain();
+    ShownAndFinal();
+    MismatchedFinalReply();
+    UnstreamedReply();
+    DroppedStreamEnds();
+    return TestSupport::Result("PluginStreamTests");
+}
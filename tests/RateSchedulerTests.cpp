@@ -0,0 +1,114 @@
+#include "RateLimiter.h"
+#include "TestSupport.h"
+#include <cmath>
+#include <vector>
+
+// Every case runs on a simulated clock: times are plain seconds.
+namespace {
+    typedef RateScheduler::Priority Priority;
+
+    bool Near(double a, double b)
+    {
+        return std::fabs(a - b) < 1e-6;
+    }
+
+    void InteractiveGoesFirst()
+    {
+        RateScheduler scheduler;
+        scheduler.Configure(60.0, 0.0, 0.0);  // One request per second
+        const RateScheduler::Ticket background = scheduler.Submit(Priority::Background, 10);
+        const RateScheduler::Ticket interactive = scheduler.Submit(Priority::Interactive, 10);
+        CHECK(!scheduler.IsNext(background));
+        CHECK(scheduler.IsNext(interactive));
+        CHECK(!scheduler.TryGrant(background, 0.0));
+        CHECK(scheduler.TryGrant(interactive, 0.0));
+        CHECK(scheduler.IsNext(background));
+        CHECK(scheduler.QueueDepth(Priority::Interactive) == 0 && scheduler.QueueDepth(Priority::Background) == 1);
+    }
+
+    // Background work leaves a tenth of each bucket to interactive requests
+    void BackgroundLeavesReserve()
+    {
+        RateScheduler scheduler;
+        scheduler.Configure(0.0, 1000.0, 0.0);
+        const RateScheduler::Ticket first = scheduler.Submit(Priority::Background, 850);
+        CHECK(scheduler.TryGrant(first, 0.0));
+
+        const RateScheduler::Ticket second = scheduler.Submit(Priority::Background, 100);
+        CHECK(!scheduler.TryGrant(second, 0.0));
+        CHECK(Near(scheduler.WaitHint(0.0), (850.0 + 100.0 + 100.0 - 1000.0) * 60.0 / 1000.0));
+
+        const RateScheduler::Ticket chat = scheduler.Submit(Priority::Interactive, 100);
+        CHECK(Near(scheduler.WaitHint(0.0), 0.0));
+        CHECK(scheduler.TryGrant(chat, 0.0));
+        CHECK(!scheduler.TryGrant(second, 8.9));
+        CHECK(scheduler.TryGrant(second, 9.0));
+    }
+
+    void RetryAfterBlocksEveryone()
+    {
+        RateScheduler scheduler;
+        scheduler.Configure(600.0, 0.0, 0.0);
+        RateLimitHint hint;
+        hint.retryAfterSeconds = RateLimitHint::ParseDuration(L"2.5s");
+        scheduler.ApplyHint(hint, 10.0);
+        const RateScheduler::Ticket ticket = scheduler.Submit(Priority::Interactive, 1);
+        CHECK(Near(scheduler.WaitHint(11.0), 1.5));
+        CHECK(!scheduler.TryGrant(ticket, 12.0));
+        CHECK(scheduler.TryGrant(ticket, 12.5));
+    }
+
+    void LearnsLimitsFromHints()
+    {
+        RateScheduler scheduler;
+        scheduler.Configure(0.0, 0.0, 0.0);
+        RateLimitHint hint;
+        hint.limitRequests = 2.0;
+        hint.remainingRequests = 0.0;
+        hint.resetRequestsSeconds = RateLimitHint::ParseDuration(L"30s");
+        scheduler.ApplyHint(hint, 0.0);
+        const RateScheduler::Ticket ticket = scheduler.Submit(Priority::Interactive, 1);
+        CHECK(Near(scheduler.WaitHint(0.0), 30.0));
+        CHECK(scheduler.TryGrant(ticket, 30.0));
+    }
+
+    // A throttled request that requeues as background must not overtake chat
+    void ThrottledRetryQueuesBehindChat()
+    {
+        RateScheduler scheduler;
+        scheduler.Configure(60.0, 0.0, 0.0);
+        std::vector<RateScheduler::Ticket> order;
+        const RateScheduler::Ticket retry = scheduler.Submit(Priority::Background, 1);
+        const RateScheduler::Ticket chat1 = scheduler.Submit(Priority::Interactive, 1);
+        const RateScheduler::Ticket chat2 = scheduler.Submit(Priority::Interactive, 1);
+        for (double now = 0.0; order.size() < 3 && now < 60.0; now += 0.25) {
+            for (RateScheduler::Ticket ticket : { retry, chat1, chat2 }) {
+                if (scheduler.TryGrant(ticket, now)) {
+                    order.push_back(ticket);
+                }
+            }
+        }
+        CHECK(order.size() == 3);
+        CHECK(order.size() == 3 && order[0] == chat1 && order[1] == chat2 && order[2] == retry);
+    }
+
+    void ParsesDurations()
+    {
+        CHECK(Near(RateLimitHint::ParseDuration(L"20ms"), 0.02));
+        CHECK(Near(RateLimitHint::ParseDuration(L"6m0s"), 360.0));
+        CHECK(Near(RateLimitHint::ParseDuration(L"1h2m3.5s"), 3723.5));
+        CHECK(Near(RateLimitHint::ParseDuration(L"7"), 7.0));
+        CHECK(RateLimitHint::ParseDuration(L"soon") < 0.0);
+    }
+}
+
+int main()
+{
+    InteractiveGoesFirst();
+    BackgroundLeavesReserve();
+    RetryAfterBlocksEveryone();
+    LearnsLimitsFromHints();
+    ThrottledRetryQueuesBehindChat();
+    ParsesDurations();
+    return TestSupport::Result("RateSchedulerTests");
+}
@@ -0,0 +1,84 @@
+#include "RenderCache.h"
+#include "TestSupport.h"
+#include <string>
+
+namespace {
+    Hash::Digest Key(int n)
+    {
+        return Hash::Sha256Of(L"message " + std::to_wstring(n));
+    }
+
+    void KeyedByDigestAndTheme()
+    {
+        RenderCache cache;
+        cache.StoreRtf(Key(1), 1, "{\\rtf1 one}");
+        CHECK(cache.FindRtf(Key(1), 1) && *cache.FindRtf(Key(1), 1) == "{\\rtf1 one}");
+        CHECK(!cache.FindRtf(Key(2), 1));
+        CHECK(!cache.FindRtf(Key(1), 2));  // A theme change re-renders
+    }
+
+    // Heights are only reused at the width they were measured at
+    void HeightMatchesWidth()
+    {
+        RenderCache cache;
+        CHECK(cache.FindHeight(Key(1), 1, 600) == -1);
+        cache.StoreHeight(Key(1), 1, 600, 42);
+        CHECK(cache.FindHeight(Key(1), 1, 600) == 42);
+        CHECK(cache.FindHeight(Key(1), 1, 601) == -1);
+        cache.StoreHeight(Key(1), 1, 800, 30);
+        CHECK(cache.FindHeight(Key(1), 1, 600) == -1);
+        CHECK(cache.FindHeight(Key(1), 1, 800) == 30);
+        // The height and the fragment share one entry
+        cache.StoreRtf(Key(1), 1, "rtf");
+        CHECK(cache.Count() == 1);
+        CHECK(cache.FindHeight(Key(1), 1, 800) == 30);
+    }
+
+    // The byte bound evicts least recently used first; a lookup counts as use
+    void EvictsLeastRecentlyUsed()
+    {
+        RenderCache cache;
+        const std::string rtf(1000, 'x');
+        cache.Configure(3500);
+        cache.StoreRtf(Key(1), 1, rtf);
+        cache.StoreRtf(Key(2), 1, rtf);
+        cache.StoreRtf(Key(3), 1, rtf);
+        CHECK(cache.Count() == 3);
+        CHECK(cache.FindRtf(Key(1), 1));
+        cache.StoreRtf(Key(4), 1, rtf);
+        CHECK(cache.Count() == 3);
+        CHECK(cache.FindRtf(Key(1), 1));
+        CHECK(!cache.FindRtf(Key(2), 1));
+        CHECK(cache.FindRtf(Key(3), 1));
+        CHECK(cache.FindRtf(Key(4), 1));
+
+        // Shrinking the bound evicts at once
+        cache.Configure(1500);
+        CHECK(cache.Count() == 1);
+        CHECK(cache.FindRtf(Key(4), 1));
+    }
+
+    void ZeroDisablesAndOversizedSkipped()
+    {
+        RenderCache cache;
+        cache.Configure(0);
+        cache.StoreRtf(Key(1), 1, "rtf");
+        cache.StoreHeight(Key(1), 1, 600, 42);
+        CHECK(cache.Count() == 0);
+
+        cache.Configure(1000);
+        cache.StoreRtf(Key(1), 1, std::string(2000, 'x'));
+        CHECK(!cache.FindRtf(Key(1), 1));
+        cache.StoreRtf(Key(2), 1, "small");
+        CHECK(cache.FindRtf(Key(2), 1));
+    }
+}
+
+int main()
+{
+    KeyedByDigestAndTheme();
+    HeightMatchesWidth();
+    EvictsLeastRecentlyUsed();
+    ZeroDisablesAndOversizedSkipped();
+    return TestSupport::Result("RenderCacheTests");
+}
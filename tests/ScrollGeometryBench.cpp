@@ -0,0 +1,37 @@
+#include "ScrollGeometry.h"
+#include "TestSupport.h"
+#include <random>
+#include <vector>
+
+// Cost of the scrollbar math per paint or mouse move: thumb height and
+// position from cached inputs, with the inputs changing every call.
+
+int main(int argc, char** argv)
+{
+    const size_t count = TestSupport::Quick(argc, argv) ? 200000 : 5000000;
+    std::mt19937 random(3);
+    std::vector<int> lines(1024);
+    for (int& line : lines) {
+        line = static_cast<int>(random() % 20000);
+    }
+
+    ScrollGeometry geometry;
+    geometry.SetLineHeight(19);
+    geometry.SetViewport(820, 800);
+    geometry.SetVirtualExtent(190000, 380000);
+
+    int64_t checksum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        const int line = lines[i & 1023];
+        geometry.SetLineCount(20000 + (line & 7));
+        checksum += geometry.ThumbHeight() + geometry.ThumbOffset(line);
+    }
+    const double ns = TestSupport::MillisecondsSince(start) * 1e6 / count;
+
+    std::printf("%zu thumb updates: %.1f ns each (checksum %lld)\n", count, ns, static_cast<long long>(checksum));
+    CHECK(checksum > 0);
+    // A paint used to take a GetDC and a line count message; this is arithmetic
+    CHECK(ns < 1000.0);
+    return TestSupport::Result("ScrollGeometryBench");
+}
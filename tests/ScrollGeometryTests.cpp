@@ -0,0 +1,173 @@
+#include "ScrollGeometry.h"
+#include "TestSupport.h"
+#include <algorithm>
+#include <random>
+
+// The cached scrollbar math against the formulas the control evaluated on
+// every paint before, and the thumb position and drag mapping against each
+// other.
+
+namespace {
+    struct Case {
+        int lineHeight;
+        int lineCount;
+        int viewportHeight;
+        int trackHeight;
+        int above;
+        int below;
+        int firstVisible;
+    };
+
+    // GetThumbHeight / GetThumbPosition / GetThumbRect as they were, minus the window calls
+    int LegacyThumbHeight(const Case& c)
+    {
+        int totalLines = c.lineCount + (c.above + c.below) / c.lineHeight;
+        if (totalLines <= 0) totalLines = 1;
+        int visibleLines = c.viewportHeight / c.lineHeight;
+        if (visibleLines <= 0) visibleLines = 1;
+        if (totalLines <= visibleLines) {
+            return 0;
+        }
+        const int thumbHeight = static_cast<int>(static_cast<float>(visibleLines) / totalLines * c.trackHeight);
+        return (std::max)(30, thumbHeight);
+    }
+
+    int LegacyThumbTop(const Case& c)
+    {
+        const int aboveLines = c.above / c.lineHeight;
+        const int totalLines = c.lineCount + aboveLines + c.below / c.lineHeight;
+        int visibleLines = c.viewportHeight / c.lineHeight;
+        if (visibleLines <= 0) visibleLines = 1;
+        const int scrollableLines = totalLines - visibleLines;
+        const int scrollableTrack = c.trackHeight - LegacyThumbHeight(c);
+        if (scrollableLines <= 0 || scrollableTrack <= 0) {
+            return 0;
+        }
+        const int firstVisible = (std::max)(0, (std::min)(aboveLines + c.firstVisible, scrollableLines));
+        const int thumbPos = static_cast<int>(static_cast<float>(firstVisible) / scrollableLines * scrollableTrack);
+        return (std::max)(0, (std::min)(scrollableTrack, thumbPos));
+    }
+
+    Case RandomCase(std::mt19937& random)
+    {
+        Case c;
+        c.lineHeight = 12 + static_cast<int>(random() % 30);
+        c.lineCount = static_cast<int>(random() % 5000);
+        c.viewportHeight = static_cast<int>(random() % 2000);
+        c.trackHeight = 40 + static_cast<int>(random() % 2000);
+        c.above = random() % 4 == 0 ? 0 : static_cast<int>(random() % 500000);
+        c.below = random() % 4 == 0 ? 0 : static_cast<int>(random() % 500000);
+        c.firstVisible = static_cast<int>(random() % (c.lineCount + 1));
+        return c;
+    }
+
+    ScrollGeometry Geometry(const Case& c)
+    {
+        ScrollGeometry geometry;
+        geometry.SetLineHeight(c.lineHeight);
+        geometry.SetLineCount(c.lineCount);
+        geometry.SetViewport(c.viewportHeight, c.trackHeight);
+        geometry.SetVirtualExtent(c.above, c.below);
+        return geometry;
+    }
+
+    // Where the virtual lines round the same way as before, the result is the same
+    void MatchesLegacyFormulas()
+    {
+        std::mt19937 random(13);
+        size_t compared = 0;
+        bool same = true;
+        for (int i = 0; i < 200000; ++i) {
+            const Case c = RandomCase(random);
+            if (c.above % c.lineHeight + c.below % c.lineHeight >= c.lineHeight) {
+                continue;  // The old thumb height rounded above + below as one
+            }
+            const ScrollGeometry geometry = Geometry(c);
+            same = same && geometry.ThumbHeight() == LegacyThumbHeight(c) &&
+                   geometry.ThumbOffset(c.firstVisible) == LegacyThumbTop(c);
+            ++compared;
+        }
+        CHECK(same);
+        CHECK(compared > 100000);
+    }
+
+    void ThumbStaysOnTrack()
+    {
+        std::mt19937 random(21);
+        bool inside = true;
+        bool monotonic = true;
+        for (int i = 0; i < 20000; ++i) {
+            const Case c = RandomCase(random);
+            const ScrollGeometry geometry = Geometry(c);
+            const int height = geometry.ThumbHeight();
+            int previous = 0;
+            for (int line = 0; line <= c.lineCount; line += 1 + c.lineCount / 50) {
+                const int offset = geometry.ThumbOffset(line);
+                inside = inside && offset >= 0 && offset + height <= (std::max)(c.trackHeight, height);
+                monotonic = monotonic && offset >= previous;
+                previous = offset;
+            }
+        }
+        CHECK(inside);
+        CHECK(monotonic);
+    }
+
+    // Dragging the thumb to where a line's thumb sits lands within a line of it
+    void DragInvertsThumbOffset()
+    {
+        ScrollGeometry geometry;
+        geometry.SetLineHeight(20);
+        geometry.SetLineCount(2000);
+        geometry.SetViewport(600, 580);
+        geometry.SetVirtualExtent(10000, 20000);
+        const int scrollable = geometry.ScrollableLines();
+        CHECK(scrollable == 2000 + 500 + 1000 - 30);
+        const int perPixel = scrollable / (580 - geometry.ThumbHeight()) + 1;
+        for (int line = 0; line <= scrollable; line += 37) {
+            const int target = geometry.DragTarget(0, geometry.ThumbOffset(line - geometry.AboveLines()));
+            CHECK(target >= line - perPixel && target <= line + perPixel);
+        }
+        CHECK(geometry.DragTarget(0, 100000) == scrollable);
+        CHECK(geometry.DragTarget(100, -100000) == 0);
+
+        // Nothing to scroll
+        geometry.SetVirtualExtent(0, 0);
+        geometry.SetLineCount(10);
+        CHECK(geometry.ThumbHeight() == 0);
+        CHECK(geometry.DragTarget(0, 50) == -1);
+    }
+
+    void SettersReportChanges()
+    {
+        ScrollGeometry geometry;
+        CHECK(!geometry.SetLineHeight(0));  // Falls back to the default
+        CHECK(geometry.LineHeight() == ScrollGeometry::kDefaultLineHeight);
+        CHECK(geometry.SetLineHeight(18));
+        CHECK(!geometry.SetLineHeight(18));
+        CHECK(geometry.SetLineCount(5) && !geometry.SetLineCount(5));
+        CHECK(geometry.SetViewport(100, 90) && !geometry.SetViewport(100, 90));
+        CHECK(geometry.SetVirtualExtent(36, 0) && !geometry.SetVirtualExtent(36, 0));
+        CHECK(geometry.AboveLines() == 2 && geometry.TotalLines() == 7);
+        CHECK(geometry.LocalScrollableLines() == 0);
+    }
+
+    // A track shorter than the minimum thumb keeps the thumb inside it
+    void ShortTrackClampsThumb()
+    {
+        ScrollGeometry geometry;
+        geometry.SetLineCount(1000);
+        geometry.SetViewport(100, 20);
+        CHECK(geometry.ThumbHeight() == 20);
+        CHECK(geometry.ThumbOffset(500) == 0);
+    }
+}
+
+int main()
+{
+    MatchesLegacyFormulas();
+    ThumbStaysOnTrack();
+    DragInvertsThumbOffset();
+    SettersReportChanges();
+    ShortTrackClampsThumb();
+    return TestSupport::Result("ScrollGeometryTests");
+}
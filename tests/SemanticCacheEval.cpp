@@ -0,0 +1,246 @@
+#include "SemanticCache.h"
+#include "TestSupport.h"
+#include <cwctype>
+#include <random>
+#include <string>
+#include <vector>
+
+// Offline evaluation of the semantic cache threshold. Questions come from
+// templates with interchangeable slots; each stored question is queried once
+// as a paraphrase (same slots, reworded: case, punctuation, filler, word
+// order, typos), which should hit, and once as a near miss (one slot
+// changed), which must not. For each threshold it reports the hit rate on
+// paraphrases and the precision of all hits. Then it times lookups against a
+// large cache.
+
+namespace {
+    struct Template {
+        const wchar_t* text;  // {0} and {1} are the slots
+        std::vector<const wchar_t*> first;
+        std::vector<const wchar_t*> second;
+    };
+
+    const std::vector<Template>& Templates()
+    {
+        static const std::vector<Template> templates = {
+            { L"How do I {0} a list in {1}?",
+              { L"sort", L"reverse", L"shuffle", L"flatten", L"deduplicate" },
+              { L"Python", L"JavaScript", L"Rust", L"C++", L"Go" } },
+            { L"What is the difference between {0} and {1}?",
+              { L"TCP", L"processes", L"stack memory", L"git merge", L"mutexes" },
+              { L"UDP", L"threads", L"heap memory", L"git rebase", L"semaphores" } },
+            { L"Write a short poem about {0} in the style of {1}.",
+              { L"the ocean", L"autumn leaves", L"a lost cat", L"city lights" },
+              { L"Shakespeare", L"Emily Dickinson", L"a pirate", L"Dr. Seuss" } },
+            { L"Convert {0} degrees {1} to the other unit.",
+              { L"12", L"37", L"100", L"451", L"-40" },
+              { L"Celsius", L"Fahrenheit" } },
+            { L"Explain {0} to a {1}.",
+              { L"quantum entanglement", L"compound interest", L"photosynthesis", L"public key cryptography" },
+              { L"five year old", L"software engineer", L"historian", L"chef" } },
+            { L"Summarize the plot of {0} in {1} sentences.",
+              { L"Hamlet", L"Moby Dick", L"The Odyssey", L"Pride and Prejudice" },
+              { L"two", L"three", L"five" } },
+        };
+        return templates;
+    }
+
+    std::wstring Fill(const wchar_t* text, const std::wstring& first, const std::wstring& second)
+    {
+        std::wstring result = text;
+        result.replace(result.find(L"{0}"), 3, first);
+        result.replace(result.find(L"{1}"), 3, second);
+        return result;
+    }
+
+    std::vector<std::wstring> Words(const std::wstring& text)
+    {
+        std::vector<std::wstring> words(1);
+        for (wchar_t ch : text) {
+            if (ch == L' ') {
+                words.emplace_back();
+            } else {
+                words.back() += ch;
+            }
+        }
+        return words;
+    }
+
+    // One rewording that keeps the meaning
+    std::wstring Paraphrase(const std::wstring& question, std::mt19937& random)
+    {
+        static const wchar_t* kFiller[] = { L"please ", L"quick question: ", L"hey, ", L" thanks", L" please" };
+        std::vector<std::wstring> words = Words(question);
+        switch (random() % 5) {
+            case 0:  // Case and punctuation only
+                for (auto& word : words) {
+                    for (auto& ch : word) {
+                        ch = static_cast<wchar_t>(std::towlower(ch));
+                    }
+                }
+                words.back() += L"??";
+                break;
+            case 1:  // Typo: swap two letters of a longer word
+                for (auto& word : words) {
+                    if (word.length() > 6) {
+                        std::swap(word[2], word[3]);
+                        break;
+                    }
+                }
+                break;
+            case 2:  // Swap two neighbouring words
+            {
+                const size_t i = random() % (words.size() - 1);
+                std::swap(words[i], words[i + 1]);
+                break;
+            }
+            case 3:  // Drop a short word
+                for (size_t i = 0; i < words.size(); ++i) {
+                    if (words[i].length() <= 2) {
+                        words.erase(words.begin() + i);
+                        break;
+                    }
+                }
+                break;
+            default:  // Filler before or after
+            {
+                const wchar_t* filler = kFiller[random() % 5];
+                if (filler[0] == L' ') {
+                    words.back() += filler;
+                } else {
+                    words.front() = filler + words.front();
+                }
+                break;
+            }
+        }
+        std::wstring result;
+        for (size_t i = 0; i < words.size(); ++i) {
+            result += (i ? L" " : L"") + words[i];
+        }
+        return result;
+    }
+
+    // Each template slot appears once per conversation, so a near miss is never
+    // itself stored under the same context
+    struct Case {
+        Hash::Digest context;
+        std::wstring stored;
+        std::wstring paraphrase;
+        std::wstring nearMiss;
+    };
+
+    std::vector<Case> BuildCases(const Hash::Digest& context, std::mt19937& random)
+    {
+        std::vector<Case> cases;
+        for (const Template& t : Templates()) {
+            for (size_t a = 0; a < t.first.size(); ++a) {
+                const size_t b = random() % t.second.size();
+                const size_t otherB = (b + 1 + random() % (t.second.size() - 1)) % t.second.size();
+                Case c;
+                c.context = context;
+                c.stored = Fill(t.text, t.first[a], t.second[b]);
+                c.paraphrase = Paraphrase(c.stored, random);
+                c.nearMiss = Fill(t.text, t.first[a], t.second[otherB]);
+                cases.push_back(c);
+            }
+        }
+        return cases;
+    }
+
+    struct Score {
+        size_t hits = 0;
+        size_t correct = 0;
+        size_t paraphraseHits = 0;
+    };
+
+    Score Evaluate(const std::vector<Case>& cases, double threshold)
+    {
+        SemanticCache cache;
+        cache.Configure(threshold, cases.size());
+        for (size_t i = 0; i < cases.size(); ++i) {
+            cache.Store(cases[i].context, cases[i].stored, std::to_wstring(i));
+        }
+
+        Score score;
+        for (size_t i = 0; i < cases.size(); ++i) {
+            std::wstring response;
+            double similarity = 0.0;
+            if (cache.Lookup(cases[i].context, cases[i].paraphrase, response, similarity)) {
+                score.hits++;
+                score.correct += response == std::to_wstring(i) ? 1 : 0;
+                score.paraphraseHits += response == std::to_wstring(i) ? 1 : 0;
+            }
+            if (cache.Lookup(cases[i].context, cases[i].nearMiss, response, similarity)) {
+                score.hits++;  // Any answer to a near miss is wrong
+            }
+        }
+        return score;
+    }
+
+    std::wstring RandomQuestion(std::mt19937& random)
+    {
+        static const wchar_t* kSyllables[] = { L"ka", L"lo", L"mi", L"ne", L"ru", L"so", L"ta", L"vi", L"ze", L"po" };
+        std::wstring question;
+        for (int word = 0; word < 8; ++word) {
+            for (int syllable = 0; syllable < 3; ++syllable) {
+                question += kSyllables[random() % 10];
+            }
+            question += L' ';
+        }
+        return question + L'?';
+    }
+
+    void TimeLookups(size_t entries, size_t lookups)
+    {
+        std::mt19937 random(11);
+        const Hash::Digest context = Hash::Sha256Of(L"scale");
+        SemanticCache cache;
+        cache.Configure(0.9, entries);
+        std::vector<std::wstring> stored;
+        for (size_t i = 0; i < entries; ++i) {
+            stored.push_back(RandomQuestion(random));
+            cache.Store(context, stored.back(), L"r");
+        }
+
+        size_t hits = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < lookups; ++i) {
+            std::wstring response;
+            double similarity = 0.0;
+            const std::wstring question = i % 2 ? RandomQuestion(random) : L"Q: " + stored[random() % entries];
+            hits += cache.Lookup(context, question, response, similarity) ? 1 : 0;
+        }
+        const double ms = TestSupport::MillisecondsSince(start);
+        std::printf("%zu entries: %.1f us per lookup (signature included), %zu/%zu hits\n",
+                    entries, 1000.0 * ms / lookups, hits, lookups);
+        CHECK(hits >= lookups / 2 * 9 / 10 && hits <= lookups / 2 + lookups / 20);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const bool quick = TestSupport::Quick(argc, argv);
+    std::mt19937 random(5);
+    std::vector<Case> cases;
+    for (int round = 0; round < (quick ? 4 : 40); ++round) {
+        const std::vector<Case> more = BuildCases(Hash::Sha256Of(L"conversation " + std::to_wstring(round)), random);
+        cases.insert(cases.end(), more.begin(), more.end());
+    }
+
+    std::printf("%zu paraphrases, %zu near misses\n", cases.size(), cases.size());
+    std::printf("threshold  hit rate  precision\n");
+    for (int step = 6; step <= 19; ++step) {
+        const double threshold = step * 0.05;
+        const Score score = Evaluate(cases, threshold);
+        const double precision = score.hits ? static_cast<double>(score.correct) / score.hits : 1.0;
+        std::printf("   %.2f    %5.1f%%    %5.1f%%\n", threshold, 100.0 * score.paraphraseHits / cases.size(),
+                    100.0 * precision);
+        if (step == 18) {  // The default threshold
+            CHECK(precision >= 0.95);
+            CHECK(score.paraphraseHits * 4 >= cases.size());
+        }
+    }
+
+    TimeLookups(quick ? 20000 : 1000000, quick ? 2000 : 20000);
+    return TestSupport::Result("SemanticCacheEval");
+}
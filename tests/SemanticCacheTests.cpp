@@ -0,0 +1,50 @@
+#include "SemanticCache.h"
+#include "TestSupport.h"
+
+namespace {
+    const Hash::Digest kContext = Hash::Sha256Of(L"system: be brief");
+
+    void ParaphraseHits()
+    {
+        SemanticCache cache;
+        cache.Configure(0.6, 100);
+        cache.Store(kContext, L"How do I reverse a linked list in C++?", L"answer");
+        std::wstring response;
+        double similarity = 0.0;
+        CHECK(cache.Lookup(kContext, L"how do I reverse a linked list in C++", response, similarity));
+        CHECK(response == L"answer" && similarity >= 0.6);
+        CHECK(!cache.Lookup(Hash::Sha256Of(L"other"), L"How do I reverse a linked list in C++?", response, similarity));
+    }
+
+    // Text without word characters used to share the all-empty signature
+    void SymbolOnlyQuestionsNeverMatch()
+    {
+        SemanticCache cache;
+        cache.Configure(0.8, 100);
+        cache.Store(kContext, L"?!?!...", L"first");
+        cache.Store(kContext, L"\U0001F600\U0001F600\U0001F600", L"second");
+        std::wstring response;
+        double similarity = 0.0;
+        CHECK(!cache.Lookup(kContext, L"???", response, similarity));
+        CHECK(!cache.Lookup(kContext, L"\U0001F44D", response, similarity));
+        CHECK(!cache.Lookup(kContext, L"", response, similarity));
+        CHECK(!cache.Lookup(kContext, L"ok", response, similarity));
+    }
+
+    // Non-ASCII letters count as words even under the C locale
+    void NonAsciiQuestionsHaveShingles()
+    {
+        SemanticCache::Signature a, b;
+        CHECK(SemanticCache::ComputeSignature(L"Как дела сегодня?", a) >= SemanticCache::kMinShingles);
+        CHECK(SemanticCache::ComputeSignature(L"今天天气怎么样，会下雨吗", b) >= SemanticCache::kMinShingles);
+        CHECK(SemanticCache::EstimateSimilarity(a, b) < 0.2);
+    }
+}
+
+int main()
+{
+    ParaphraseHits();
+    SymbolOnlyQuestionsNeverMatch();
+    NonAsciiQuestionsHaveShingles();
+    return TestSupport::Result("SemanticCacheTests");
+}
@@ -0,0 +1,83 @@
+#include "SharedChannel.h"
+#include "TestSupport.h"
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Round trip through the channel to a forked echo process, as the plugin
+// host makes one per call: 64 B, 1 KB, 64 KB and 1 MB messages.
+
+namespace {
+    const size_t kSizes[] = { 64, 1024, 64 * 1024, 1024 * 1024 };
+
+    size_t Rounds(size_t size, bool quick)
+    {
+        const size_t rounds = size >= 1024 * 1024 ? 100 : size >= 64 * 1024 ? 2000 : 20000;
+        return quick ? rounds / 10 : rounds;
+    }
+
+    // The child: echoes every message back until the parent goes away
+    int Echo(const std::string& name, bool quick)
+    {
+        SharedChannel channel;
+        if (!channel.Open(name)) {
+            return 1;
+        }
+        const pid_t parent = getppid();
+        channel.SetPeerCheck([parent] { return getppid() == parent; });
+        std::vector<unsigned char> buffer;
+        for (size_t size : kSizes) {
+            buffer.resize(size);
+            for (size_t i = 0; i < Rounds(size, quick) + 1; ++i) {
+                if (!channel.Read(buffer.data(), size, -1) || !channel.Write(buffer.data(), size, -1)) {
+                    return 1;
+                }
+            }
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const bool quick = TestSupport::Quick(argc, argv);
+    const std::string name = "PilotLight-bench-" + std::to_string(getpid());
+    SharedChannel channel;
+    CHECK(channel.Create(name));
+
+    const pid_t child = fork();
+    if (child == 0) {
+        _exit(Echo(name, quick));
+    }
+
+    double smallUs = 0.0;
+    for (size_t size : kSizes) {
+        std::vector<unsigned char> sent(size, 0x5A);
+        std::vector<unsigned char> received(size);
+        const size_t rounds = Rounds(size, quick);
+        CHECK(channel.Write(sent.data(), size, 5000) && channel.Read(received.data(), size, 5000));  // Warm up
+
+        const uint64_t sleeps = channel.Sleeps();
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < rounds; ++i) {
+            sent[i % size] = static_cast<unsigned char>(i);
+            CHECK(channel.Write(sent.data(), size, 5000));
+            CHECK(channel.Read(received.data(), size, 5000));
+        }
+        const double us = TestSupport::MillisecondsSince(start) * 1000.0 / rounds;
+        CHECK(received == sent);
+        std::printf("%8zu bytes: %9.2f us per round trip, %llu sleeps in %zu rounds\n", size, us,
+                    static_cast<unsigned long long>(channel.Sleeps() - sleeps), rounds);
+        if (size == kSizes[0]) {
+            smallUs = us;
+        }
+    }
+
+    int status = 0;
+    CHECK(waitpid(child, &status, 0) == child);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    // Far below the cost of starting anything; a sleep on every call would show here
+    CHECK(smallUs < 1000.0);
+    return TestSupport::Result("SharedChannelBench");
+}
@@ -0,0 +1,153 @@
+#include "SharedChannel.h"
+#include "TestSupport.h"
+#include <random>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// The POSIX path of the channel: transfers larger than the ring arrive
+// intact in both directions, between threads and between processes; a
+// missing peer ends a wait at its timeout or when the peer check says so.
+
+namespace {
+    std::string Name(const char* what)
+    {
+        return "PilotLight-test-" + std::to_string(getpid()) + "-" + what;
+    }
+
+    std::vector<unsigned char> Bytes(size_t size, unsigned seed)
+    {
+        std::vector<unsigned char> bytes(size);
+        std::mt19937 random(seed);
+        for (unsigned char& byte : bytes) {
+            byte = static_cast<unsigned char>(random());
+        }
+        return bytes;
+    }
+
+    void StreamsBetweenThreads()
+    {
+        SharedChannel host;
+        SharedChannel guest;
+        CHECK(host.Create(Name("threads"), 4096));
+        CHECK(guest.Open(Name("threads")));
+
+        // Sizes from a byte to many times the ring, so transfers wrap and block
+        std::vector<size_t> sizes = { 1, 7, 4095, 4096, 4097, 100000 };
+        std::mt19937 random(5);
+        for (int i = 0; i < 200; ++i) {
+            sizes.push_back(1 + random() % 20000);
+        }
+
+        std::thread echo([&] {
+            std::vector<unsigned char> buffer;
+            for (size_t size : sizes) {
+                buffer.resize(size);
+                CHECK(guest.Read(buffer.data(), size, 5000));
+                for (unsigned char& byte : buffer) {
+                    byte = static_cast<unsigned char>(~byte);
+                }
+                CHECK(guest.Write(buffer.data(), size, 5000));
+            }
+        });
+        for (size_t i = 0; i < sizes.size(); ++i) {
+            const std::vector<unsigned char> sent = Bytes(sizes[i], static_cast<unsigned>(i));
+            std::vector<unsigned char> received(sizes[i]);
+            CHECK(host.Write(sent.data(), sent.size(), 5000));
+            CHECK(host.Read(received.data(), received.size(), 5000));
+            bool inverted = true;
+            for (size_t j = 0; j < sent.size(); ++j) {
+                inverted = inverted && received[j] == static_cast<unsigned char>(~sent[j]);
+            }
+            CHECK(inverted);
+        }
+        echo.join();
+    }
+
+    void StreamsBetweenProcesses()
+    {
+        SharedChannel host;
+        const std::string name = Name("fork");
+        CHECK(host.Create(name, 1 << 16));
+        const std::vector<unsigned char> sent = Bytes(3 << 20, 9);
+
+        const pid_t child = fork();
+        if (child == 0) {
+            SharedChannel guest;
+            std::vector<unsigned char> buffer(sent.size());
+            const bool ok = guest.Open(name) && guest.Read(buffer.data(), buffer.size(), 10000) &&
+                            guest.Write(buffer.data(), buffer.size(), 10000);
+            _exit(ok ? 0 : 1);
+        }
+
+        std::vector<unsigned char> received(sent.size());
+        CHECK(host.Write(sent.data(), sent.size(), 10000));
+        CHECK(host.Read(received.data(), received.size(), 10000));
+        CHECK(received == sent);
+        int status = 0;
+        CHECK(waitpid(child, &status, 0) == child);
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    void TimesOut()
+    {
+        SharedChannel host;
+        SharedChannel guest;
+        CHECK(host.Create(Name("timeout"), 4096));
+        CHECK(guest.Open(Name("timeout")));
+
+        unsigned char byte = 0;
+        auto start = std::chrono::steady_clock::now();
+        CHECK(!host.Read(&byte, 1, 100));
+        double ms = TestSupport::MillisecondsSince(start);
+        CHECK(ms >= 90.0 && ms < 1000.0);
+
+        // A full ring with nobody reading
+        const std::vector<unsigned char> large(8192);
+        start = std::chrono::steady_clock::now();
+        CHECK(!host.Write(large.data(), large.size(), 100));
+        ms = TestSupport::MillisecondsSince(start);
+        CHECK(ms >= 90.0 && ms < 1000.0);
+    }
+
+    void PeerCheckEndsWait()
+    {
+        SharedChannel host;
+        SharedChannel guest;
+        CHECK(host.Create(Name("peer"), 4096));
+        CHECK(guest.Open(Name("peer")));
+
+        const auto start = std::chrono::steady_clock::now();
+        host.SetPeerCheck([start] { return TestSupport::MillisecondsSince(start) < 100.0; });
+        unsigned char byte = 0;
+        CHECK(!host.Read(&byte, 1, -1));
+        CHECK(TestSupport::MillisecondsSince(start) < 1000.0);
+    }
+
+    void NamesAreExclusive()
+    {
+        SharedChannel first;
+        SharedChannel second;
+        SharedChannel missing;
+        CHECK(first.Create(Name("exclusive"), 4096));
+        CHECK(!second.Create(Name("exclusive"), 4096));
+        second.Close();  // Leaves the name to its owner
+        CHECK(missing.Open(Name("exclusive")));
+        missing.Close();
+        CHECK(!missing.Open(Name("missing")));
+        first.Close();
+        CHECK(second.Create(Name("exclusive"), 4096));
+    }
+}
+
+int main()
+{
+    StreamsBetweenThreads();
+    StreamsBetweenProcesses();
+    TimesOut();
+    PeerCheckEndsWait();
+    NamesAreExclusive();
+    return TestSupport::Result("SharedChannelTests");
+}
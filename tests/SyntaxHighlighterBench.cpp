@@ -0,0 +1,92 @@
+#include "SyntaxHighlighter.h"
+#include "TestSupport.h"
+#include <string>
+#include <vector>
+
+// Lexing throughput per language on a large block, then the same block
+// streamed in 16-character deltas as a reply arrives. Streaming resumes at
+// the last complete line, so its total cost must stay a small multiple of one
+// full lex rather than growing with the square of the block.
+
+namespace {
+    struct Language {
+        const char* name;
+        SyntaxLanguage language;
+        const wchar_t* snippet;
+    };
+
+    const Language kLanguages[] = {
+        { "C++", SyntaxLanguage::Cpp,
+          L"template <typename T>\nstatic int64_t Sum(const std::vector<T>& items) {\n"
+          L"    /* running total */\n    int64_t total = 0;  // signed\n"
+          L"    for (const auto& item : items) { total += item * 2.5e1; }\n    return total ? total : 0x10;\n}\n" },
+        { "Python", SyntaxLanguage::Python,
+          L"@dataclass\nclass Point:\n    \"\"\"A point.\n    Immutable.\"\"\"\n    x: int = 0\n"
+          L"    def norm(self):\n        return (self.x ** 2) ** 0.5  # length\nprint(f'{Point()}', len([1, 2]))\n" },
+        { "JS/TS", SyntaxLanguage::JavaScript,
+          L"export async function load(url: string): Promise<number> {\n  const res = await fetch(`${url}/items\n"
+          L"  ?page=1`); /* fetch */\n  return res.ok ? 1 : 0; // done\n}\n" },
+        { "JSON", SyntaxLanguage::Json,
+          L"{\n  \"name\": \"pilotlight\",\n  \"version\": 12,\n  \"tags\": [\"a\", \"b\"],\n"
+          L"  \"enabled\": true, \"ratio\": -0.25, \"none\": null\n},\n" },
+        { "shell", SyntaxLanguage::Shell,
+          L"#!/usr/bin/env bash\nset -euo pipefail\nfor f in \"$@\"; do\n  if [ -f \"$f\" ]; then\n"
+          L"    echo 'found' \"$f\" $? # report\n  fi\ndone\n" },
+        { "SQL", SyntaxLanguage::Sql,
+          L"SELECT u.id, count(*) AS n -- per user\nFROM users u\nJOIN orders o ON o.user_id = u.id\n"
+          L"WHERE u.name LIKE 'a%' /* prefix */\nGROUP BY u.id HAVING count(*) > 3;\n" },
+    };
+
+    std::wstring Block(const wchar_t* snippet, size_t characters)
+    {
+        std::wstring text;
+        text.reserve(characters + 512);
+        while (text.length() < characters) {
+            text += snippet;
+        }
+        return text;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const bool quick = TestSupport::Quick(argc, argv);
+    const size_t fullSize = quick ? (256u << 10) : (4u << 20);
+    const size_t streamSize = quick ? (64u << 10) : (256u << 10);
+    const size_t delta = 16;
+
+    for (const Language& language : kLanguages) {
+        const std::wstring block = Block(language.snippet, fullSize);
+        std::vector<SyntaxSpan> spans;
+        double fullMs = 1e300;
+        for (int run = 0; run < 3; ++run) {
+            spans.clear();
+            const auto start = std::chrono::steady_clock::now();
+            SyntaxLexer::Lex(language.language, block.c_str(), 0, block.length(), SyntaxState(), spans);
+            fullMs = (std::min)(fullMs, TestSupport::MillisecondsSince(start));
+        }
+        const double mbPerSecond = block.length() * sizeof(wchar_t) / (fullMs / 1000.0) / 1e6;
+        const size_t fullSpans = spans.size();
+
+        const std::wstring streamed = Block(language.snippet, streamSize);
+        spans.clear();
+        auto start = std::chrono::steady_clock::now();
+        SyntaxLexer::Lex(language.language, streamed.c_str(), 0, streamed.length(), SyntaxState(), spans);
+        const double onceMs = (std::max)(TestSupport::MillisecondsSince(start), 0.05);
+
+        SyntaxHighlighter highlighter;
+        start = std::chrono::steady_clock::now();
+        for (size_t length = delta; length < streamed.length() + delta; length += delta) {
+            highlighter.Highlight(language.language, streamed.c_str(), (std::min)(length, streamed.length()), 1);
+        }
+        const double streamMs = TestSupport::MillisecondsSince(start);
+
+        std::printf("%-7s full %zu chars: %.2f ms (%.0f MB/s, %zu spans); streamed %zu chars: %.2f ms (x%.1f)\n",
+                    language.name, block.length(), fullMs, mbPerSecond, fullSpans, streamed.length(), streamMs,
+                    streamMs / onceMs);
+        CHECK(fullSpans > 0);
+        // Each delta re-lexes only the unfinished line, so streaming stays linear
+        CHECK(streamMs / onceMs < 40.0);
+    }
+    return TestSupport::Result("SyntaxHighlighterBench");
+}
@@ -0,0 +1,156 @@
+#include "SyntaxHighlighter.h"
+#include "TestSupport.h"
+#include <cwchar>
+#include <string>
+#include <vector>
+
+// A block streamed into the highlighter must come out exactly as a fresh lex
+// of the same text at every length, including comments and strings that are
+// still open where a delta ends.
+
+namespace {
+    struct Sample {
+        SyntaxLanguage language;
+        const wchar_t* code;
+    };
+
+    const Sample kSamples[] = {
+        { SyntaxLanguage::Cpp,
+          L"#include <vector>\n// line comment\nint main() {\n    /* comment\n       spans lines */\n"
+          L"    const char* s = \"a \\\" b\"; char c = '\\n';\n    return 0x1F + 2.5e3; /* open" },
+        { SyntaxLanguage::Python,
+          L"import os\n@decorator\ndef f(self, x=None):\n    \"\"\"doc\n    string\"\"\"\n"
+          L"    return len('abc') + 42  # done\nclass A: pass\n'''open" },
+        { SyntaxLanguage::JavaScript,
+          L"const x = `template\nacross ${lines}`;\nfunction f(a: number): string {\n"
+          L"  /* block */ return \"s\" + 'q'; // tail\n}\nlet y = `open" },
+        { SyntaxLanguage::Json, L"{\n  \"key\": [1, 2.5, -3],\n  /* note */ \"flag\": true,\n  \"none\": null\n}" },
+        { SyntaxLanguage::Shell,
+          L"#!/bin/sh\nfor f in *.txt; do\n  echo \"$f and\n  more\" $1 $?\ndone\nexport A='x\ny'\n# end" },
+        { SyntaxLanguage::Sql,
+          L"SELECT a, count(*) FROM t -- rows\nWHERE name = 'multi\nline' AND id > 10\n/* block\n end */ ORDER BY a;" },
+    };
+
+    std::vector<SyntaxSpan> Fresh(SyntaxLanguage language, const std::wstring& code)
+    {
+        std::vector<SyntaxSpan> spans;
+        SyntaxLexer::Lex(language, code.c_str(), 0, code.length(), SyntaxState(), spans);
+        return spans;
+    }
+
+    bool Same(const std::vector<SyntaxSpan>& a, const std::vector<SyntaxSpan>& b)
+    {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (a[i].start != b[i].start || a[i].length != b[i].length || a[i].token != b[i].token) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    SyntaxToken TokenAt(const std::vector<SyntaxSpan>& spans, size_t offset)
+    {
+        for (const SyntaxSpan& span : spans) {
+            if (offset >= span.start && offset < span.start + span.length) {
+                return span.token;
+            }
+        }
+        return SyntaxToken::Plain;
+    }
+
+    // One character at a time, by growing id and by prefix comparison
+    void ResumeMatchesFreshLex()
+    {
+        for (const Sample& sample : kSamples) {
+            const std::wstring code = sample.code;
+            for (uint64_t growingId : { 1, 0 }) {
+                SyntaxHighlighter highlighter;
+                bool same = true;
+                for (size_t length = 0; length <= code.length(); ++length) {
+                    const std::vector<SyntaxSpan>& spans =
+                        highlighter.Highlight(sample.language, code.c_str(), length, growingId);
+                    same = same && Same(spans, Fresh(sample.language, code.substr(0, length)));
+                }
+                CHECK(same);
+            }
+        }
+    }
+
+    // An open comment becomes one span however it was streamed
+    void OpenCommentStaysWhole()
+    {
+        const std::wstring code = L"x = 1;\n/* one\ntwo\nthree */ y";
+        SyntaxHighlighter highlighter;
+        for (size_t length = 1; length <= code.length(); length += 3) {
+            highlighter.Highlight(SyntaxLanguage::Cpp, code.c_str(), length, 9);
+        }
+        const std::vector<SyntaxSpan>& spans = highlighter.Highlight(SyntaxLanguage::Cpp, code.c_str(),
+                                                                     code.length(), 9);
+        size_t comments = 0;
+        for (const SyntaxSpan& span : spans) {
+            comments += span.token == SyntaxToken::Comment ? 1 : 0;
+        }
+        CHECK(comments == 1);
+        CHECK(TokenAt(spans, code.find(L"three")) == SyntaxToken::Comment);
+        CHECK(TokenAt(spans, code.find(L" y") + 1) == SyntaxToken::Plain);
+    }
+
+    void ClassifiesTokens()
+    {
+        const std::wstring code = L"int n = 42; // c\nreturn \"s\";";
+        const std::vector<SyntaxSpan> spans = Fresh(SyntaxLanguage::Cpp, code);
+        CHECK(TokenAt(spans, 0) == SyntaxToken::Type);
+        CHECK(TokenAt(spans, code.find(L"n =")) == SyntaxToken::Plain);
+        CHECK(TokenAt(spans, code.find(L"42")) == SyntaxToken::Number);
+        CHECK(TokenAt(spans, code.find(L"// c") + 3) == SyntaxToken::Comment);
+        CHECK(TokenAt(spans, code.find(L"return")) == SyntaxToken::Keyword);
+        CHECK(TokenAt(spans, code.find(L"\"s\"") + 1) == SyntaxToken::String);
+
+        const std::wstring python = L"x = 'not # a comment'  # but this is";
+        const std::vector<SyntaxSpan> pySpans = Fresh(SyntaxLanguage::Python, python);
+        CHECK(TokenAt(pySpans, python.find(L"not")) == SyntaxToken::String);
+        CHECK(TokenAt(pySpans, python.find(L"but")) == SyntaxToken::Comment);
+    }
+
+    void MapsFenceInfo()
+    {
+        const struct {
+            const wchar_t* info;
+            SyntaxLanguage language;
+        } kInfos[] = {
+            { L"cpp", SyntaxLanguage::Cpp },   { L"py", SyntaxLanguage::Python },
+            { L"ts", SyntaxLanguage::JavaScript }, { L"json", SyntaxLanguage::Json },
+            { L"bash", SyntaxLanguage::Shell }, { L"sql", SyntaxLanguage::Sql },
+            { L"cobol", SyntaxLanguage::None }, { L"", SyntaxLanguage::None },
+        };
+        for (const auto& test : kInfos) {
+            CHECK(SyntaxLexer::LanguageFromInfo(test.info, std::wcslen(test.info)) == test.language);
+        }
+    }
+
+    // Finished blocks come from the cache and plain blocks have no spans
+    void CachesFinishedBlocks()
+    {
+        SyntaxHighlighter highlighter;
+        const std::wstring a = L"int a;\n";
+        const std::wstring b = L"def b(): pass\n";
+        const std::vector<SyntaxSpan> first = highlighter.Highlight(SyntaxLanguage::Cpp, a.c_str(), a.length());
+        highlighter.Highlight(SyntaxLanguage::Python, b.c_str(), b.length());
+        CHECK(Same(highlighter.Highlight(SyntaxLanguage::Cpp, a.c_str(), a.length()), first));
+        CHECK(highlighter.Describe().find(L"cache hits=1") != std::wstring::npos);
+        CHECK(highlighter.Highlight(SyntaxLanguage::None, a.c_str(), a.length()).empty());
+    }
+}
+
+int main()
+{
+    ResumeMatchesFreshLex();
+    OpenCommentStaysWhole();
+    ClassifiesTokens();
+    MapsFenceInfo();
+    CachesFinishedBlocks();
+    return TestSupport::Result("SyntaxHighlighterTests");
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// Minimal checks for the headless tests: a failed CHECK prints its location
+// and the test exits non-zero from TestSupport::Result().
+namespace TestSupport {
+    inline int& Failures()
+    {
+        static int failures = 0;
+        return failures;
+    }
+
+    inline void Fail(const char* file, int line, const char* expression)
+    {
+        std::printf("%s:%d: CHECK failed: %s\n", file, line, expression);
+        ++Failures();
+    }
+
+    inline int Result(const char* name)
+    {
+        std::printf("%s: %s\n", name, Failures() ? "FAILED" : "passed");
+        return Failures() ? 1 : 0;
+    }
+
+    // Benchmarks take --quick under ctest to keep the suite fast
+    inline bool Quick(int argc, char** argv)
+    {
+        return argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+    }
+
+    inline double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+#define CHECK(expression) \
+    do { if (!(expression)) TestSupport::Fail(__FILE__, __LINE__, #expression); } while (0)
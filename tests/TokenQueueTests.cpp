@@ -0,0 +1,103 @@
+#include "TokenQueue.h"
+#include "TestSupport.h"
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+
+namespace {
+    std::wstring Text(size_t length)
+    {
+        std::wstring text;
+        text.reserve(length);
+        for (size_t i = 0; i < length; ++i) {
+            text += static_cast<wchar_t>(L'a' + (i * 7 + i / 13) % 26);
+        }
+        return text;
+    }
+
+    // A producer writes bursty deltas while the consumer drains once per
+    // frame, as the dialog's timer does; what comes out must be what went in
+    void StreamsIntact(size_t capacity, size_t length, int frameMs)
+    {
+        SpscTextQueue queue(capacity);
+        const std::wstring input = Text(length);
+        std::atomic<bool> done(false);
+        std::thread producer([&] {
+            std::mt19937 random(static_cast<unsigned>(capacity));
+            for (size_t pos = 0; pos < input.length();) {
+                // Mostly token-sized deltas with the occasional large burst
+                const size_t size = random() % 32 == 0 ? 1 + random() % 4096 : 1 + random() % 8;
+                const size_t count = (std::min)(size, input.length() - pos);
+                CHECK(queue.Write(input.data() + pos, count));
+                pos += count;
+            }
+            done = true;
+        });
+
+        std::wstring output;
+        while (!done || queue.Depth() > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(frameMs));
+            queue.Drain(output);
+        }
+        producer.join();
+        std::printf("capacity %zu: %zu chars, %llu stalls\n", queue.Capacity(), output.length(),
+                    static_cast<unsigned long long>(queue.Stalls()));
+        CHECK(output == input);
+        CHECK(queue.Written() == input.length());
+    }
+
+    // A consumer that stops draining to join the producer aborts first
+    void AbortReleasesBlockedWriter()
+    {
+        SpscTextQueue queue(256);
+        const std::wstring input = Text(4096);
+        std::atomic<bool> returned(false);
+        bool result = true;
+        std::thread producer([&] {
+            result = queue.Write(input.data(), input.length());
+            returned = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK(!returned);  // Waiting for room that never comes
+
+        const auto start = std::chrono::steady_clock::now();
+        queue.Abort();
+        producer.join();
+        CHECK(!result);
+        CHECK(TestSupport::MillisecondsSince(start) < 1000.0);
+        CHECK(!queue.Write(L"late", 4));
+
+        queue.Reset();
+        CHECK(queue.Depth() == 0);
+        CHECK(queue.Write(L"again", 5));
+        std::wstring output;
+        queue.Drain(output);
+        CHECK(output == L"again");
+    }
+
+    // Simulated clock: a batch that arrives two frames late counts one dropped frame
+    void PacerCountsDroppedFrames()
+    {
+        FramePacer pacer(0.016);
+        pacer.Start(0.0);
+        CHECK(!pacer.ShouldApply(0.000, 0));
+        CHECK(pacer.ShouldApply(0.016, 10));
+        pacer.RecordBatch(0.016, 0.017, 10);
+        CHECK(!pacer.ShouldApply(0.018, 5));  // Within half a frame of the last batch
+        CHECK(pacer.ShouldApply(0.033, 5));
+        pacer.RecordBatch(0.050, 0.051, 5);
+        CHECK(pacer.DroppedFrames() == 1);
+        CHECK(pacer.MaxDepth() == 10);
+    }
+}
+
+int main()
+{
+    StreamsIntact(1 << 16, 1 << 20, 16);
+    StreamsIntact(4096, 1 << 16, 2);
+    StreamsIntact(256, 16384, 1);
+    AbortReleasesBlockedWriter();
+    PacerCountsDroppedFrames();
+    return TestSupport::Result("TokenQueueTests");
+}
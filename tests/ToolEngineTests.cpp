@@ -0,0 +1,255 @@
+#include "ToolEngine.h"
+#include "TestSupport.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ToolEngine with fake tools and a stub transport: allowed calls of a round
+// run side by side on at most maxParallel threads, a call past its timeout
+// is reported without holding up the round, the Ask calls of a round are
+// confirmed with one question, and Run feeds each round's results back until
+// the model answers in text or runs out of rounds.
+
+namespace {
+    typedef ToolResult::Status Status;
+
+    std::atomic<int> g_running(0);
+    std::atomic<int> g_mostRunning(0);
+
+    // Sleeps ms in small steps, stopping early once cancelled
+    ToolEngine::Tool Sleeper(const wchar_t* name, int ms, int timeoutMs = 0)
+    {
+        return ToolEngine::Tool{ name, L"Sleeps", L"{\"type\":\"object\"}", timeoutMs,
+                                 [ms](const std::wstring& arguments, std::wstring& output,
+                                      const std::atomic<bool>& cancelled) {
+                                     const int running = ++g_running;
+                                     for (int most = g_mostRunning;
+                                          running > most && !g_mostRunning.compare_exchange_weak(most, running);) {
+                                     }
+                                     for (int slept = 0; slept < ms && !cancelled; slept += 5) {
+                                         std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                                     }
+                                     --g_running;
+                                     output = L"slept " + arguments;
+                                     return true;
+                                 } };
+    }
+
+    ToolEngine::Tool Returns(const wchar_t* name, const wchar_t* output)
+    {
+        const std::wstring text = output;
+        return ToolEngine::Tool{ name, L"", L"", 0,
+                                 [text](const std::wstring&, std::wstring& result, const std::atomic<bool>&) {
+                                     result = text;
+                                     return true;
+                                 } };
+    }
+
+    std::vector<ToolCall> Calls(const wchar_t* name, int count)
+    {
+        std::vector<ToolCall> calls;
+        for (int i = 0; i < count; ++i) {
+            calls.push_back(ToolCall{ L"call" + std::to_wstring(i), name, L"{}" });
+        }
+        return calls;
+    }
+
+    // 8 calls of 100 ms on 4 threads: two waves
+    void RunsInParallel()
+    {
+        ToolPermissionStore permissions;
+        ToolEngine engine(permissions);
+        engine.Configure(4, 1000, 3);
+        engine.Register(Sleeper(L"sleep", 100));
+        permissions.SetPolicy(L"sleep", ToolPermissionPolicy::AlwaysAllow);
+
+        g_mostRunning = 0;
+        const auto start = std::chrono::steady_clock::now();
+        const std::vector<ToolResult> results = engine.Execute(Calls(L"sleep", 8), nullptr);
+        const double ms = TestSupport::MillisecondsSince(start);
+        std::printf("8 calls of 100 ms on 4 threads: %.0f ms, up to %d at once\n", ms, g_mostRunning.load());
+        CHECK(g_mostRunning == 4);
+        CHECK(ms >= 190 && ms < 350);
+        CHECK(results.size() == 8);
+        for (size_t i = 0; i < results.size(); ++i) {
+            CHECK(results[i].id == L"call" + std::to_wstring(i));
+            CHECK(results[i].status == Status::Ok && results[i].content == L"slept {}");
+        }
+    }
+
+    // A tool that honours cancellation, one that ignores it, and work queued
+    // behind both on two threads
+    void TimesOut()
+    {
+        ToolPermissionStore permissions;
+        ToolEngine engine(permissions);
+        engine.Configure(2, 1000, 3);
+        engine.Register(Sleeper(L"hang", 100000, 150));
+        engine.Register(ToolEngine::Tool{ L"deaf", L"", L"", 100,
+                                          [](const std::wstring&, std::wstring& output, const std::atomic<bool>&) {
+                                              std::this_thread::sleep_for(std::chrono::milliseconds(600));
+                                              output = L"late";
+                                              return true;
+                                          } });
+        engine.Register(Sleeper(L"sleep", 100));
+        engine.Register(ToolEngine::Tool{ L"fail", L"", L"", 0,
+                                          [](const std::wstring&, std::wstring& output, const std::atomic<bool>&) {
+                                              output = L"bad input";
+                                              return false;
+                                          } });
+        engine.Register(ToolEngine::Tool{ L"throw", L"", L"", 0,
+                                          [](const std::wstring&, std::wstring&, const std::atomic<bool>&) -> bool {
+                                              throw 1;
+                                          } });
+        for (const wchar_t* name : { L"hang", L"deaf", L"sleep", L"fail", L"throw" }) {
+            permissions.SetPolicy(name, ToolPermissionPolicy::AlwaysAllow);
+        }
+        permissions.SetPolicy(L"never", ToolPermissionPolicy::NeverAllow);
+        engine.Register(Returns(L"never", L"ran"));
+
+        const std::vector<ToolCall> calls = { { L"a", L"hang", L"{}" },  { L"b", L"deaf", L"{}" },
+                                              { L"c", L"sleep", L"{}" }, { L"d", L"sleep", L"{}" },
+                                              { L"e", L"fail", L"{}" },  { L"f", L"throw", L"{}" },
+                                              { L"g", L"missing", L"{}" }, { L"h", L"never", L"{}" } };
+        const auto start = std::chrono::steady_clock::now();
+        const std::vector<ToolResult> results = engine.Execute(calls, nullptr);
+        const double ms = TestSupport::MillisecondsSince(start);
+        std::printf("two timeouts and two 100 ms calls on 2 threads: %.0f ms\n", ms);
+        CHECK(ms < 450);
+        CHECK(results[0].status == Status::TimedOut);
+        CHECK(results[1].status == Status::TimedOut);
+        CHECK(results[2].status == Status::Ok && results[3].status == Status::Ok);
+        CHECK(results[4].status == Status::Failed && results[4].content == L"bad input");
+        CHECK(results[5].status == Status::Failed);
+        CHECK(results[6].status == Status::Unknown);
+        CHECK(results[7].status == Status::Denied);
+
+        // The ignored cancellation finishes on its own and is counted down
+        CHECK(engine.Describe().find(L"still running=1") != std::wstring::npos);
+        std::this_thread::sleep_for(std::chrono::milliseconds(700));
+        CHECK(engine.Describe().find(L"still running=0") != std::wstring::npos);
+    }
+
+    void ConfirmsOncePerRound()
+    {
+        ToolPermissionStore permissions;
+        ToolEngine engine(permissions);
+        engine.Configure(4, 1000, 3);
+        engine.Register(ToolEngine::Tool{ L"echo", L"", L"", 0,
+                                          [](const std::wstring& arguments, std::wstring& output,
+                                             const std::atomic<bool>&) {
+                                              return ToolEngine::StringArgument(arguments, L"text", output);
+                                          } });
+        engine.Register(Returns(L"x", L"x"));
+        engine.Register(Returns(L"y", L"y"));
+        engine.Register(Returns(L"z", L"z"));
+        permissions.SetPolicy(L"z", ToolPermissionPolicy::AlwaysAllow);
+
+        int questions = 0;
+        size_t asked = 0;
+        const ToolEngine::ConfirmFn confirm = [&](const std::vector<ToolCall>& calls) {
+            ++questions;
+            asked = calls.size();
+            // The fourth decision is missing: that call is cancelled
+            return std::vector<ToolConfirmationDecision>({ ToolConfirmationDecision::AllowOnce,
+                                                           ToolConfirmationDecision::NeverAllow,
+                                                           ToolConfirmationDecision::AlwaysAllow });
+        };
+        std::vector<ToolResult> results = engine.Execute({ { L"1", L"echo", L"{\"text\": \"hi \\\"you\\\"\\n\\u00e9\"}" },
+                                                           { L"2", L"x", L"{}" },
+                                                           { L"3", L"y", L"{}" },
+                                                           { L"4", L"z", L"{}" },
+                                                           { L"5", L"echo", L"{}" } },
+                                                         confirm);
+        CHECK(questions == 1 && asked == 4);
+        CHECK(results[0].status == Status::Ok && results[0].content == L"hi \"you\"\n\u00e9");
+        CHECK(results[1].status == Status::Denied);
+        CHECK(permissions.GetPolicy(L"x") == ToolPermissionPolicy::NeverAllow);
+        CHECK(results[2].status == Status::Ok);
+        CHECK(permissions.GetPolicy(L"y") == ToolPermissionPolicy::AlwaysAllow);
+        CHECK(results[3].status == Status::Ok);
+        CHECK(results[4].status == Status::Denied);
+        CHECK(permissions.GetPolicy(L"echo") == ToolPermissionPolicy::Ask);
+
+        // The decisions stick: nothing left to ask
+        questions = 0;
+        results = engine.Execute({ { L"6", L"x", L"{}" }, { L"7", L"y", L"{}" } }, confirm);
+        CHECK(questions == 0);
+        CHECK(results[0].status == Status::Denied && results[1].status == Status::Ok);
+
+        // Without a confirmation, Ask calls are denied
+        results = engine.Execute({ { L"8", L"echo", L"{\"text\":\"a\"}" } }, nullptr);
+        CHECK(results[0].status == Status::Denied);
+    }
+
+    void RunsRoundsThroughTransport()
+    {
+        ToolPermissionStore permissions;
+        ToolEngine engine(permissions);
+        engine.Configure(4, 1000, 3);
+        engine.Register(Returns(L"time", L"noon"));
+        engine.Register(Returns(L"weather", L"rain"));
+        permissions.SetPolicy(L"time", ToolPermissionPolicy::AlwaysAllow);
+        permissions.SetPolicy(L"weather", ToolPermissionPolicy::AlwaysAllow);
+        CHECK(!engine.Empty());
+
+        // Two rounds of calls, then text
+        std::vector<ToolExchange> requests;
+        const ToolEngine::Transport transport = [&](const ToolExchange& exchange, std::vector<ToolCall>& calls) {
+            requests.push_back(exchange);
+            if (requests.size() == 1) {
+                calls = { { L"k1", L"time", L"{}" }, { L"k2", L"weather", L"{\"city\":\"Oslo\"}" } };
+                return std::wstring(L"Let me check.");
+            }
+            if (requests.size() == 2) {
+                calls = { { L"k3", L"time", L"{}" } };
+                return std::wstring();
+            }
+            return std::wstring(L"Noon and rain.");
+        };
+        CHECK(engine.Run(transport, nullptr) == L"Let me check.\n\nNoon and rain.");
+        CHECK(requests.size() == 3);
+        CHECK(requests[0].messages.empty() && requests[0].tools == engine.ToolsJson());
+        CHECK(requests[0].tools.find(L"\"weather\"") != std::wstring::npos);
+        CHECK(requests[1].messages.size() == 3);
+        CHECK(requests[2].messages.size() == 5);
+        CHECK(requests[2].messages[0] == ToolEngine::AssistantMessageJson(L"Let me check.", { { L"k1", L"time", L"{}" },
+                                                                         { L"k2", L"weather",
+                                                                           L"{\"city\":\"Oslo\"}" } }));
+        CHECK(requests[2].messages[0].find(L"\"arguments\":\"{\\\"city\\\":\\\"Oslo\\\"}\"") != std::wstring::npos);
+        CHECK(requests[2].messages[2].find(L"\"tool_call_id\":\"k2\"") != std::wstring::npos);
+        CHECK(requests[2].messages[2].find(L"rain") != std::wstring::npos);
+        CHECK(requests[2].messages[3].find(L"\"content\":null") != std::wstring::npos);
+
+        // A model that always calls gets no tools on the last request, and must answer
+        requests.clear();
+        const ToolEngine::Transport greedy = [&](const ToolExchange& exchange, std::vector<ToolCall>& calls) {
+            requests.push_back(exchange);
+            calls = { { L"g" + std::to_wstring(requests.size()), L"time", L"{}" } };
+            return exchange.tools.empty() ? std::wstring(L"final") : std::wstring();
+        };
+        CHECK(engine.Run(greedy, nullptr) == L"final");
+        CHECK(requests.size() == 4 && requests.back().tools.empty());
+    }
+
+    void ReadsStringArguments()
+    {
+        std::wstring value;
+        CHECK(ToolEngine::StringArgument(L"{ \"path\" : \"C:\\\\x\\ty\" }", L"path", value));
+        CHECK(value == L"C:\\x\ty");
+        CHECK(!ToolEngine::StringArgument(L"{\"path\": 3}", L"path", value));
+        CHECK(!ToolEngine::StringArgument(L"{\"other\": \"a\"}", L"path", value));
+        CHECK(!ToolEngine::StringArgument(L"{\"path\": \"open", L"path", value));
+    }
+}
+
+int main()
+{
+    RunsInParallel();
+    TimesOut();
+    ConfirmsOncePerRound();
+    RunsRoundsThroughTransport();
+    ReadsStringArguments();
+    return TestSupport::Result("ToolEngineTests");
+}
@@ -0,0 +1,70 @@
+#include "TranscriptLayout.h"
+#include "TestSupport.h"
+#include <random>
+#include <string>
+#include <vector>
+
+// A long transcript as the dialog sees it: estimates for every message, a
+// stream of appends, re-measurements as windows load, and a VisibleRange
+// query per scroll step. Every query must stay far below a frame.
+
+int main(int argc, char** argv)
+{
+    const size_t count = TestSupport::Quick(argc, argv) ? 20000 : 100000;
+    std::mt19937 random(11);
+
+    std::vector<std::wstring> texts;
+    texts.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::wstring text(40 + random() % 2000, L'w');
+        for (size_t line = random() % 8; line > 0; --line) {
+            text[random() % text.length()] = L'\n';
+        }
+        texts.push_back(std::move(text));
+    }
+
+    TranscriptLayout layout;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int> heights;
+    heights.reserve(count);
+    for (const std::wstring& text : texts) {
+        heights.push_back(TranscriptLayout::EstimateHeight(text, 90, 17, 34));
+    }
+    layout.Assign(heights);
+    const double buildMs = TestSupport::MillisecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count / 100; ++i) {
+        layout.Append(100 + static_cast<int>(random() % 400), true);
+    }
+    const size_t remeasures = count / 5;
+    for (size_t i = 0; i < remeasures; ++i) {
+        layout.SetHeight(random() % layout.Count(), 40 + static_cast<int>(random() % 800));
+    }
+    const double updateMs = TestSupport::MillisecondsSince(start);
+
+    // Scroll through the whole transcript a wheel notch at a time
+    const int64_t total = layout.TotalHeight();
+    const int64_t step = 120;
+    size_t queries = 0;
+    size_t materialized = 0;
+    start = std::chrono::steady_clock::now();
+    for (int64_t top = 0; top < total; top += step) {
+        const TranscriptLayout::Range range = layout.VisibleRange(top, 900, 12);
+        materialized += range.last - range.first;
+        ++queries;
+    }
+    const double queryMs = TestSupport::MillisecondsSince(start);
+    const double queryUs = queryMs * 1000.0 / queries;
+
+    std::printf("%zu messages, %lld px: build %.2f ms, %zu appends + %zu measures %.2f ms\n", layout.Count(),
+                static_cast<long long>(total), buildMs, count / 100, remeasures, updateMs);
+    std::printf("%zu VisibleRange queries: %.3f us each, %.1f messages materialized on average\n", queries, queryUs,
+                static_cast<double>(materialized) / queries);
+
+    // Logarithmic: a scroll step costs microseconds, not a walk of the transcript
+    CHECK(queryUs < 50.0);
+    CHECK(materialized / queries < 64);
+    CHECK(layout.Offset(layout.IndexAt(total / 2)) <= total / 2);
+    return TestSupport::Result("TranscriptLayoutBench");
+}
@@ -0,0 +1,126 @@
+#include "TranscriptLayout.h"
+#include "TestSupport.h"
+#include <random>
+#include <vector>
+
+// The Fenwick tree against a naive prefix sum: after every kind of update,
+// Offset and IndexAt must agree with it at every position.
+
+namespace {
+    struct Naive {
+        std::vector<int> heights;
+
+        int64_t Offset(size_t index) const
+        {
+            int64_t sum = 0;
+            for (size_t i = 0; i < index && i < heights.size(); ++i) {
+                sum += heights[i];
+            }
+            return sum;
+        }
+    };
+
+    void CheckAgainst(const TranscriptLayout& layout, const Naive& naive)
+    {
+        CHECK(layout.Count() == naive.heights.size());
+        int64_t top = 0;
+        for (size_t i = 0; i < naive.heights.size(); ++i) {
+            CHECK(layout.Offset(i) == top);
+            CHECK(layout.IndexAt(top) == i);
+            if (naive.heights[i] > 1) {
+                CHECK(layout.IndexAt(top + naive.heights[i] - 1) == i);
+            }
+            top += naive.heights[i];
+        }
+        CHECK(layout.TotalHeight() == top);
+        CHECK(layout.Offset(naive.heights.size() + 5) == top);
+    }
+
+    void MatchesPrefixSum()
+    {
+        std::mt19937 random(7);
+        Naive naive;
+        for (int i = 0; i < 1000; ++i) {
+            naive.heights.push_back(20 + static_cast<int>(random() % 400));
+        }
+        TranscriptLayout layout;
+        layout.Assign(naive.heights);
+        CheckAgainst(layout, naive);
+
+        // Appends of every tree shape, then measurements anywhere
+        for (int i = 0; i < 300; ++i) {
+            naive.heights.push_back(1 + static_cast<int>(random() % 600));
+            layout.Append(naive.heights.back(), i % 2 == 0);
+        }
+        CheckAgainst(layout, naive);
+        for (int i = 0; i < 500; ++i) {
+            const size_t index = random() % naive.heights.size();
+            naive.heights[index] = 1 + static_cast<int>(random() % 900);
+            layout.SetHeight(index, naive.heights[index]);
+        }
+        CheckAgainst(layout, naive);
+        layout.SetHeight(naive.heights.size(), 50);  // Out of range; ignored
+        CheckAgainst(layout, naive);
+    }
+
+    void AppendsFromEmpty()
+    {
+        TranscriptLayout layout;
+        Naive naive;
+        CHECK(layout.TotalHeight() == 0);
+        CHECK(layout.IndexAt(100) == 0);
+        for (int i = 0; i < 70; ++i) {
+            naive.heights.push_back(10 + i);
+            layout.Append(naive.heights.back(), true);
+            CheckAgainst(layout, naive);
+        }
+        layout.Clear();
+        CHECK(layout.Count() == 0);
+        CHECK(layout.TotalHeight() == 0);
+    }
+
+    void TracksMeasured()
+    {
+        TranscriptLayout layout;
+        layout.Assign(std::vector<int>(4, 100));
+        CHECK(!layout.IsMeasured(2));
+        layout.SetHeight(2, 100);  // Same height, still counts as measured
+        CHECK(layout.IsMeasured(2));
+        CHECK(layout.TotalHeight() == 400);
+    }
+
+    void VisibleRangeAddsOverscan()
+    {
+        TranscriptLayout layout;
+        layout.Assign(std::vector<int>(100, 50));
+        TranscriptLayout::Range range = layout.VisibleRange(1000, 200, 3);
+        CHECK(range.first == 17);  // Messages 20..23 are visible
+        CHECK(range.last == 27);
+        range = layout.VisibleRange(0, 100, 5);
+        CHECK(range.first == 0 && range.last == 7);
+        range = layout.VisibleRange(4990, 500, 2);
+        CHECK(range.first == 97 && range.last == 100);
+        range = layout.VisibleRange(1e9, 100, 0);  // Beyond the end clamps to the last message
+        CHECK(range.first == 99 && range.last == 100);
+        CHECK(TranscriptLayout().VisibleRange(0, 100, 4).last == 0);
+    }
+
+    void EstimatesWrappedLines()
+    {
+        CHECK(TranscriptLayout::EstimateHeight(L"", 80, 16, 30) == 16 + 30);
+        CHECK(TranscriptLayout::EstimateHeight(std::wstring(80, L'x'), 80, 16, 30) == 16 + 30);
+        CHECK(TranscriptLayout::EstimateHeight(std::wstring(81, L'x'), 80, 16, 30) == 32 + 30);
+        CHECK(TranscriptLayout::EstimateHeight(L"a\n\nb", 80, 16, 0) == 48);
+        CHECK(TranscriptLayout::EstimateHeight(L"abc", 0, 16, 0) == 48);  // Width clamps to one character
+    }
+}
+
+int main()
+{
+    MatchesPrefixSum();
+    AppendsFromEmpty();
+    TracksMeasured();
+    VisibleRangeAddsOverscan();
+    EstimatesWrappedLines();
+    return TestSupport::Result("TranscriptLayoutTests");
+}
@@ -0,0 +1,97 @@
+#include "TranscriptSearch.h"
+#include "TestSupport.h"
+#include <random>
+#include <string>
+#include <vector>
+
+// Find-in-transcript over a long history: a cold scan for a rare word against
+// a scalar case-folding scan, then a query typed one character at a time,
+// where every keystroke after the first narrows the stored matches.
+
+namespace {
+    wchar_t Lower(wchar_t ch)
+    {
+        return ch >= L'A' && ch <= L'Z' ? static_cast<wchar_t>(ch + (L'a' - L'A')) : ch;
+    }
+
+    size_t ScalarCount(const std::vector<std::wstring>& messages, const std::wstring& query)
+    {
+        size_t count = 0;
+        for (const std::wstring& text : messages) {
+            for (size_t pos = 0; pos + query.length() <= text.length(); ++pos) {
+                size_t i = 0;
+                while (i < query.length() && Lower(text[pos + i]) == query[i]) {
+                    ++i;
+                }
+                count += i == query.length() ? 1 : 0;
+            }
+        }
+        return count;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const size_t count = TestSupport::Quick(argc, argv) ? 2000 : 20000;
+    static const wchar_t* kWords[] = { L"the", L"list", L"Function", L"returns", L"value", L"of", L"a", L"Python",
+                                       L"string", L"index", L"error", L"when", L"loop", L"memory", L"thread" };
+    std::mt19937 random(17);
+    std::vector<std::wstring> messages;
+    size_t chars = 0;
+    for (size_t i = 0; i < count; ++i) {
+        std::wstring text;
+        const size_t words = 50 + random() % 600;
+        for (size_t w = 0; w < words; ++w) {
+            text += kWords[random() % (sizeof(kWords) / sizeof(kWords[0]))];
+            text += w % 15 == 14 ? L".\n" : L" ";
+        }
+        if (i % 97 == 0) {
+            text += L"Deadlock in the renderer";
+        }
+        chars += text.length();
+        messages.push_back(std::move(text));
+    }
+    const TranscriptSearch::TextAt textAt = [&messages](size_t index) -> const std::wstring& {
+        return messages[index];
+    };
+
+    TranscriptSearch search;
+    auto start = std::chrono::steady_clock::now();
+    const size_t found = search.Find(L"deadlock", messages.size(), textAt).size();
+    const double scanMs = TestSupport::MillisecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    const size_t scalarFound = ScalarCount(messages, L"deadlock");
+    const double scalarMs = TestSupport::MillisecondsSince(start);
+
+    std::printf("%zu messages, %zu chars: scan %.2f ms (%.0f M chars/s), scalar %.2f ms (x%.1f)\n", messages.size(),
+                chars, scanMs, chars / scanMs / 1000.0, scalarMs, scalarMs / scanMs);
+    CHECK(found == scalarFound);
+    CHECK(found == (count + 96) / 97);
+
+    // Typing "memory leak" key by key. A key narrows the matches of the
+    // previous query unless there were too many to keep; then it rescans.
+    search.Invalidate();
+    const std::wstring typed = L"memory leak";
+    double narrowedMs = 0.0;
+    double rescanMs = 0.0;
+    size_t narrowed = 0;
+    bool previousTruncated = true;
+    for (size_t length = 1; length <= typed.length(); ++length) {
+        start = std::chrono::steady_clock::now();
+        const size_t matches = search.Find(typed.substr(0, length), messages.size(), textAt).size();
+        const double ms = TestSupport::MillisecondsSince(start);
+        std::printf("  \"%ls\": %zu%s matches, %.2f ms (%s)\n", typed.substr(0, length).c_str(), matches,
+                    search.Truncated() ? "+" : "", ms, previousTruncated ? "scan" : "narrowed");
+        (previousTruncated ? rescanMs : narrowedMs) += ms;
+        narrowed += previousTruncated ? 0 : 1;
+        previousTruncated = search.Truncated();
+    }
+    std::wprintf(L"%ls", search.Describe().c_str());
+
+    // Narrowing only revisits earlier matches
+    CHECK(narrowed >= 3);
+    CHECK(narrowedMs / narrowed < scanMs);
+    CHECK(search.Find(typed, messages.size(), textAt).empty());
+    return TestSupport::Result("TranscriptSearchBench");
+}
@@ -0,0 +1,140 @@
+#include "TranscriptSearch.h"
+#include "TestSupport.h"
+#include <random>
+#include <string>
+#include <vector>
+
+// The vector search against a plain scalar scan, at every alignment and
+// query length, and the per-prefix result cache against fresh searches.
+
+namespace {
+    wchar_t Lower(wchar_t ch)
+    {
+        return ch >= L'A' && ch <= L'Z' ? static_cast<wchar_t>(ch + (L'a' - L'A')) : ch;
+    }
+
+    size_t NaiveFind(const std::wstring& text, size_t from, const std::wstring& query)
+    {
+        if (query.empty()) {
+            return std::wstring::npos;
+        }
+        for (size_t pos = from; pos + query.length() <= text.length(); ++pos) {
+            size_t i = 0;
+            while (i < query.length() && Lower(text[pos + i]) == Lower(query[i])) {
+                ++i;
+            }
+            if (i == query.length()) {
+                return pos;
+            }
+        }
+        return std::wstring::npos;
+    }
+
+    std::wstring RandomText(std::mt19937& random, size_t length)
+    {
+        static const wchar_t kAlphabet[] = L"abAB c\n";
+        std::wstring text;
+        for (size_t i = 0; i < length; ++i) {
+            text += kAlphabet[random() % 7];
+        }
+        return text;
+    }
+
+    void FindInMatchesScalarScan()
+    {
+        std::mt19937 random(5);
+        bool same = true;
+        for (int round = 0; round < 2000; ++round) {
+            const std::wstring text = RandomText(random, random() % 80);
+            const std::wstring query = RandomText(random, 1 + random() % 4);
+            for (size_t from = 0; from <= text.length(); from += 1 + random() % 5) {
+                same = same && TranscriptSearch::FindIn(text.c_str(), text.length(), from, query) ==
+                                   NaiveFind(text, from, query);
+            }
+        }
+        CHECK(same);
+        CHECK(TranscriptSearch::FindIn(L"abc", 3, 0, L"") == std::wstring::npos);
+        CHECK(TranscriptSearch::FindIn(L"ab", 2, 0, L"abc") == std::wstring::npos);
+        CHECK(TranscriptSearch::FindIn(L"Straße STRASSE", 14, 0, L"strasse") == 7);
+        CHECK(TranscriptSearch::FindIn(L"ÉtÉ été", 7, 1, L"été") == 4);
+    }
+
+    std::vector<TranscriptSearch::Match> NaiveAll(const std::vector<std::wstring>& messages, const std::wstring& query)
+    {
+        std::vector<TranscriptSearch::Match> matches;
+        for (size_t index = 0; index < messages.size(); ++index) {
+            for (size_t pos = 0; (pos = NaiveFind(messages[index], pos, query)) != std::wstring::npos; ++pos) {
+                matches.push_back(TranscriptSearch::Match{ static_cast<uint32_t>(index), static_cast<uint32_t>(pos) });
+            }
+        }
+        return matches;
+    }
+
+    bool Same(const std::vector<TranscriptSearch::Match>& a, const std::vector<TranscriptSearch::Match>& b)
+    {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (a[i].message != b[i].message || a[i].offset != b[i].offset) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Typing, deleting and retyping a query narrows and restores stored results
+    void PrefixResultsMatchFreshSearch()
+    {
+        std::mt19937 random(9);
+        std::vector<std::wstring> messages;
+        for (int i = 0; i < 200; ++i) {
+            messages.push_back(RandomText(random, random() % 300));
+        }
+        const TranscriptSearch::TextAt textAt = [&messages](size_t index) -> const std::wstring& {
+            return messages[index];
+        };
+
+        TranscriptSearch search;
+        const std::vector<std::wstring> queries = { L"a", L"aB", L"aBa", L"aBa ", L"aBa b", L"aBa ", L"aB",
+                                                    L"ab", L"abb", L"a", L"" };
+        for (const std::wstring& query : queries) {
+            CHECK(Same(search.Find(query, messages.size(), textAt), NaiveAll(messages, query)));
+        }
+        CHECK(search.Describe().find(L"narrowed=") != std::wstring::npos);
+
+        // A message edited in place is only seen after Invalidate
+        search.Find(L"cc", messages.size(), textAt);
+        messages[0] = L"cc cc";
+        search.Invalidate();
+        CHECK(Same(search.Find(L"cc", messages.size(), textAt), NaiveAll(messages, L"cc")));
+
+        // A new message changes the count, which drops the stored results
+        messages.push_back(L"ccc");
+        CHECK(Same(search.Find(L"cc", messages.size(), textAt), NaiveAll(messages, L"cc")));
+    }
+
+    void StopsAtMaxMatches()
+    {
+        std::vector<std::wstring> messages(2, std::wstring(TranscriptSearch::kMaxMatches, L'a'));
+        TranscriptSearch search;
+        const TranscriptSearch::TextAt textAt = [&messages](size_t index) -> const std::wstring& {
+            return messages[index];
+        };
+        CHECK(search.Find(L"a", messages.size(), textAt).size() == TranscriptSearch::kMaxMatches);
+        CHECK(search.Truncated());
+
+        // A truncated result is scanned again rather than narrowed
+        const std::vector<TranscriptSearch::Match>& longer = search.Find(L"aa", messages.size(), textAt);
+        CHECK(longer.size() == TranscriptSearch::kMaxMatches);
+        CHECK(longer.back().message == 1);
+    }
+}
+
+int main()
+{
+    FindInMatchesScalarScan();
+    PrefixResultsMatchFreshSearch();
+    StopsAtMaxMatches();
+    return TestSupport::Result("TranscriptSearchTests");
+}
@@ -0,0 +1,502 @@
+#include "FakeWin32.h"
+#include "FileUtils.h"
+#include <Shlwapi.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cwchar>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct FakeModule {
+    std::map<std::string, FARPROC> exports;
+};
+
+namespace {
+    const wchar_t kExecutablePath[] = L"C:\\PilotLight\\PilotLight.exe";
+    const wchar_t kPluginDirectory[] = L"C:\\PilotLight\\plugins\\";
+
+    // Every kernel object is one of these; CloseHandle deletes it
+    struct Object {
+        virtual ~Object() {}
+    };
+
+    struct Event : Object {
+        bool manualReset = false;
+        bool signaled = false;
+    };
+
+    struct Process : Object {
+        pid_t pid = 0;
+        bool child = false;   // Started here, so it can be reaped
+        bool parent = false;  // Opened by a child on its parent
+        bool exited = false;
+        DWORD exitCode = STILL_ACTIVE;
+    };
+
+    struct Find : Object {
+        std::vector<WIN32_FIND_DATAW> found;
+        size_t next = 0;
+    };
+
+    struct File {
+        std::shared_ptr<const FakeModule> module;
+        uint64_t size = 0;
+        uint64_t writeTime = 0;
+    };
+
+    // Guards the files and the events; waiting on events uses the condition
+    std::mutex g_lock;
+    std::condition_variable g_changed;
+    std::map<std::wstring, File> g_files;
+    std::vector<Event*> g_notifications;
+    uint64_t g_writeTime = 1;
+    std::atomic<size_t> g_loads(0);
+    std::atomic<size_t> g_frees(0);
+    std::function<int(const std::wstring&)> g_processEntry;
+
+    // The app data folder; removed by the process that made it
+    struct AppData {
+        std::string root;
+        std::wstring path;
+        pid_t owner = 0;
+
+        AppData()
+        {
+            const char* tmp = getenv("TMPDIR");
+            std::string pattern = std::string(tmp && *tmp ? tmp : "/tmp") + "/pilotlight-tests-XXXXXX";
+            if (mkdtemp(&pattern[0])) {
+                root = pattern;
+                owner = getpid();
+                const std::string appData = root + "/appdata";
+                path.assign(appData.begin(), appData.end());
+            }
+        }
+
+        ~AppData()
+        {
+            if (!root.empty() && getpid() == owner) {
+                std::error_code ignored;
+                std::filesystem::remove_all(root, ignored);
+            }
+        }
+    };
+
+    AppData& TheAppData()
+    {
+        static AppData appData;
+        return appData;
+    }
+
+    std::string Narrow(const std::wstring& text)
+    {
+        return std::string(text.begin(), text.end());
+    }
+
+    bool EndsWith(const std::wstring& text, const std::wstring& suffix)
+    {
+        return text.length() >= suffix.length() &&
+               text.compare(text.length() - suffix.length(), suffix.length(), suffix) == 0;
+    }
+
+    void Reap(Process& process)
+    {
+        if (!process.child || process.exited) {
+            return;
+        }
+        int status = 0;
+        if (waitpid(process.pid, &status, WNOHANG) == process.pid) {
+            process.exited = true;
+            if (WIFEXITED(status)) {
+                process.exitCode = static_cast<DWORD>(WEXITSTATUS(status));
+            } else if (process.exitCode == STILL_ACTIVE) {
+                process.exitCode = 0xC0000005u;  // Killed by a signal: report it as a crash
+            }
+        }
+    }
+
+    bool HasExited(Process& process)
+    {
+        if (!process.child) {
+            // A parent that exits hands its children to another process
+            return kill(process.pid, 0) != 0 || (process.parent && getppid() != process.pid);
+        }
+        Reap(process);
+        return process.exited;
+    }
+
+    uint64_t NowMs()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+}
+
+namespace FakeWin32 {
+    void SetPlugins(const std::vector<Module>& modules)
+    {
+        std::lock_guard<std::mutex> guard(g_lock);
+        for (auto it = g_files.begin(); it != g_files.end();) {
+            it = it->first.compare(0, wcslen(kPluginDirectory), kPluginDirectory) == 0 ? g_files.erase(it)
+                                                                                        : std::next(it);
+        }
+        const uint64_t writeTime = ++g_writeTime;
+        for (const Module& module : modules) {
+            File file;
+            file.module = std::make_shared<FakeModule>(FakeModule{ module.exports });
+            file.size = module.size;
+            file.writeTime = writeTime;
+            g_files[kPluginDirectory + module.name] = file;
+        }
+    }
+
+    void TouchPlugins()
+    {
+        std::lock_guard<std::mutex> guard(g_lock);
+        for (Event* notification : g_notifications) {
+            notification->signaled = true;
+        }
+        g_changed.notify_all();
+    }
+
+    size_t LoadCount()
+    {
+        return g_loads;
+    }
+
+    size_t FreeCount()
+    {
+        return g_frees;
+    }
+
+    std::wstring AppDataPath()
+    {
+        return TheAppData().path;
+    }
+
+    void WriteSettings(const std::wstring& text)
+    {
+        FileUtils::EnsureDirectoryExists(AppDataPath());
+        std::ofstream file(Narrow(AppDataPath() + L"\\settings.ini"), std::ios::out | std::ios::trunc);
+        file << Narrow(text);
+    }
+
+    void SetProcessEntry(std::function<int(const std::wstring& commandLine)> entry)
+    {
+        g_processEntry = entry;
+    }
+}
+
+std::wstring FileUtils::GetAppDataPath()
+{
+    return FakeWin32::AppDataPath();
+}
+
+// Paths with a '\\' are virtual (the shadow folder); the app data folder is real
+bool FileUtils::EnsureDirectoryExists(const std::wstring& path)
+{
+    if (path.find(L'\\') != std::wstring::npos) {
+        return true;
+    }
+    std::error_code ignored;
+    std::filesystem::create_directories(Narrow(path), ignored);
+    return std::filesystem::is_directory(Narrow(path), ignored);
+}
+
+HANDLE FindFirstFileW(LPCWSTR pattern, WIN32_FIND_DATAW* data)
+{
+    // Only "<directory>*.dll" is asked for
+    const std::wstring text = pattern;
+    if (!EndsWith(text, L"*.dll")) {
+        return INVALID_HANDLE_VALUE;
+    }
+    const std::wstring directory = text.substr(0, text.length() - 5);
+
+    std::unique_ptr<Find> find(new Find);
+    {
+        std::lock_guard<std::mutex> guard(g_lock);
+        for (const auto& entry : g_files) {
+            const std::wstring& path = entry.first;
+            if (path.compare(0, directory.length(), directory) != 0 || !EndsWith(path, L".dll") ||
+                path.find(L'\\', directory.length()) != std::wstring::npos) {
+                continue;
+            }
+            WIN32_FIND_DATAW found = {};
+            found.dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+            found.nFileSizeHigh = static_cast<DWORD>(entry.second.size >> 32);
+            found.nFileSizeLow = static_cast<DWORD>(entry.second.size & 0xFFFFFFFFu);
+            found.ftLastWriteTime.dwHighDateTime = static_cast<DWORD>(entry.second.writeTime >> 32);
+            found.ftLastWriteTime.dwLowDateTime = static_cast<DWORD>(entry.second.writeTime & 0xFFFFFFFFu);
+            wcsncpy(found.cFileName, path.c_str() + directory.length(), MAX_PATH - 1);
+            find->found.push_back(found);
+        }
+    }
+    if (find->found.empty()) {
+        return INVALID_HANDLE_VALUE;
+    }
+    *data = find->found[0];
+    find->next = 1;
+    return find.release();
+}
+
+BOOL FindNextFileW(HANDLE handle, WIN32_FIND_DATAW* data)
+{
+    Find* find = static_cast<Find*>(static_cast<Object*>(handle));
+    if (find->next >= find->found.size()) {
+        return FALSE;
+    }
+    *data = find->found[find->next++];
+    return TRUE;
+}
+
+BOOL FindClose(HANDLE handle)
+{
+    delete static_cast<Object*>(handle);
+    return TRUE;
+}
+
+BOOL CopyFileW(LPCWSTR from, LPCWSTR to, BOOL failIfExists)
+{
+    std::lock_guard<std::mutex> guard(g_lock);
+    const auto source = g_files.find(from);
+    if (source == g_files.end() || (failIfExists && g_files.count(to) != 0)) {
+        return FALSE;
+    }
+    g_files[to] = source->second;
+    return TRUE;
+}
+
+BOOL DeleteFileW(LPCWSTR path)
+{
+    std::lock_guard<std::mutex> guard(g_lock);
+    return g_files.erase(path) != 0;
+}
+
+DWORD GetFileAttributesW(LPCWSTR path)
+{
+    std::lock_guard<std::mutex> guard(g_lock);
+    return g_files.count(path) != 0 ? FILE_ATTRIBUTE_NORMAL : INVALID_FILE_ATTRIBUTES;
+}
+
+// An auto-reset event that TouchPlugins signals
+HANDLE FindFirstChangeNotificationW(LPCWSTR, BOOL, DWORD)
+{
+    std::lock_guard<std::mutex> guard(g_lock);
+    Event* notification = new Event;
+    g_notifications.push_back(notification);
+    return static_cast<Object*>(notification);
+}
+
+BOOL FindNextChangeNotification(HANDLE)
+{
+    return TRUE;
+}
+
+BOOL FindCloseChangeNotification(HANDLE change)
+{
+    Event* notification = dynamic_cast<Event*>(static_cast<Object*>(change));
+    {
+        std::lock_guard<std::mutex> guard(g_lock);
+        g_notifications.erase(std::remove(g_notifications.begin(), g_notifications.end(), notification),
+                              g_notifications.end());
+    }
+    delete notification;
+    return TRUE;
+}
+
+HMODULE LoadLibraryW(LPCWSTR path)
+{
+    std::lock_guard<std::mutex> guard(g_lock);
+    const auto file = g_files.find(path);
+    if (file == g_files.end()) {
+        return nullptr;
+    }
+    g_loads++;
+    return new FakeModule(*file->second.module);
+}
+
+FARPROC GetProcAddress(HMODULE module, const char* name)
+{
+    const auto found = module->exports.find(name);
+    return found != module->exports.end() ? found->second : nullptr;
+}
+
+BOOL FreeLibrary(HMODULE module)
+{
+    g_frees++;
+    delete module;
+    return TRUE;
+}
+
+DWORD GetModuleFileNameW(HMODULE, LPWSTR path, DWORD size)
+{
+    const size_t length = (std::min)(wcslen(kExecutablePath), static_cast<size_t>(size) - 1);
+    wmemcpy(path, kExecutablePath, length);
+    path[length] = L'\0';
+    return static_cast<DWORD>(length);
+}
+
+BOOL PathRemoveFileSpecW(LPWSTR path)
+{
+    wchar_t* separator = wcsrchr(path, L'\\');
+    if (!separator) {
+        return FALSE;
+    }
+    *separator = L'\0';
+    return TRUE;
+}
+
+HANDLE CreateEventW(void*, BOOL manualReset, BOOL initialState, LPCWSTR)
+{
+    Event* event = new Event;
+    event->manualReset = manualReset != FALSE;
+    event->signaled = initialState != FALSE;
+    return static_cast<Object*>(event);
+}
+
+BOOL SetEvent(HANDLE handle)
+{
+    std::lock_guard<std::mutex> guard(g_lock);
+    static_cast<Event*>(static_cast<Object*>(handle))->signaled = true;
+    g_changed.notify_all();
+    return TRUE;
+}
+
+BOOL ResetEvent(HANDLE handle)
+{
+    std::lock_guard<std::mutex> guard(g_lock);
+    static_cast<Event*>(static_cast<Object*>(handle))->signaled = false;
+    return TRUE;
+}
+
+DWORD WaitForSingleObject(HANDLE handle, DWORD milliseconds)
+{
+    return WaitForMultipleObjects(1, &handle, FALSE, milliseconds);
+}
+
+// Events wake the wait at once; processes are polled every millisecond
+DWORD WaitForMultipleObjects(DWORD count, const HANDLE* handles, BOOL, DWORD milliseconds)
+{
+    const uint64_t deadline = milliseconds == INFINITE ? UINT64_MAX : NowMs() + milliseconds;
+    std::unique_lock<std::mutex> guard(g_lock);
+    for (;;) {
+        bool polling = false;
+        for (DWORD i = 0; i < count; ++i) {
+            Object* object = static_cast<Object*>(handles[i]);
+            if (Event* event = dynamic_cast<Event*>(object)) {
+                if (event->signaled) {
+                    event->signaled = event->manualReset;
+                    return WAIT_OBJECT_0 + i;
+                }
+            } else if (Process* process = dynamic_cast<Process*>(object)) {
+                if (HasExited(*process)) {
+                    return WAIT_OBJECT_0 + i;
+                }
+                polling = true;
+            } else {
+                return WAIT_FAILED;
+            }
+        }
+
+        const uint64_t now = NowMs();
+        if (now >= deadline) {
+            return WAIT_TIMEOUT;
+        }
+        const uint64_t wait = (std::min)(deadline - now, polling ? uint64_t(1) : uint64_t(1000));
+        g_changed.wait_for(guard, std::chrono::milliseconds(wait));
+    }
+}
+
+BOOL CloseHandle(HANDLE handle)
+{
+    if (!handle || handle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+    Object* object = static_cast<Object*>(handle);
+    if (Process* process = dynamic_cast<Process*>(object)) {
+        Reap(*process);
+    }
+    delete object;
+    return TRUE;
+}
+
+// Forks; the child runs the process entry and never returns here
+BOOL CreateProcessW(LPCWSTR, LPWSTR commandLine, void*, void*, BOOL, DWORD, void*, LPCWSTR, STARTUPINFOW*,
+                    PROCESS_INFORMATION* information)
+{
+    if (!g_processEntry) {
+        return FALSE;
+    }
+    const std::wstring command = commandLine;
+    const pid_t pid = fork();
+    if (pid < 0) {
+        return FALSE;
+    }
+    if (pid == 0) {
+        _exit(g_processEntry(command));
+    }
+
+    Process* process = new Process;
+    process->pid = pid;
+    process->child = true;
+    information->hProcess = static_cast<Object*>(process);
+    information->hThread = nullptr;
+    information->dwProcessId = static_cast<DWORD>(pid);
+    information->dwThreadId = 0;
+    return TRUE;
+}
+
+HANDLE OpenProcess(DWORD, BOOL, DWORD processId)
+{
+    const pid_t pid = static_cast<pid_t>(processId);
+    if (kill(pid, 0) != 0) {
+        return nullptr;
+    }
+    Process* process = new Process;
+    process->pid = pid;
+    process->parent = pid == getppid();
+    return static_cast<Object*>(process);
+}
+
+BOOL TerminateProcess(HANDLE handle, DWORD exitCode)
+{
+    Process* process = static_cast<Process*>(static_cast<Object*>(handle));
+    if (process->exited) {
+        return FALSE;
+    }
+    process->exitCode = exitCode;
+    return kill(process->pid, SIGKILL) == 0;
+}
+
+BOOL GetExitCodeProcess(HANDLE handle, DWORD* exitCode)
+{
+    Process* process = dynamic_cast<Process*>(static_cast<Object*>(handle));
+    if (!process) {
+        return FALSE;
+    }
+    Reap(*process);
+    *exitCode = process->exited ? process->exitCode : STILL_ACTIVE;
+    return TRUE;
+}
+
+DWORD GetProcessId(HANDLE handle)
+{
+    return static_cast<DWORD>(static_cast<Process*>(static_cast<Object*>(handle))->pid);
+}
+
+DWORD GetCurrentProcessId()
+{
+    return static_cast<DWORD>(getpid());
+}
+
+ULONGLONG GetTickCount64()
+{
+    return NowMs();
+}
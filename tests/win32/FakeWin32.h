@@ -0,0 +1,50 @@
+#pragma once
+
+#include <windows.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Controls of the fake Win32 layer, for tests that run PluginHost. The
+// executable lives in C:\PilotLight, and its plugins folder holds whatever
+// SetPlugins put there: DLLs whose exports are functions of the test. The app
+// data folder is real (a new temporary directory, removed at exit), so the
+// manifest, metrics and settings.ini are real files. CreateProcessW forks.
+namespace FakeWin32 {
+    // One DLL in the plugins folder
+    struct Module {
+        std::wstring name;                       // File name, e.g. L"upper.dll"
+        std::map<std::string, FARPROC> exports;  // By export name
+        uint64_t size = 4096;
+    };
+
+    template <typename Fn>
+    FARPROC Export(Fn function)
+    {
+        return reinterpret_cast<FARPROC>(function);
+    }
+
+    // Replaces the DLLs in the plugins folder. Every call gives them a new
+    // write time, so a host scanning afterwards sees them as changed.
+    void SetPlugins(const std::vector<Module>& modules);
+
+    // Signals the change notifications open on the plugins folder
+    void TouchPlugins();
+
+    // LoadLibraryW and FreeLibrary calls so far
+    size_t LoadCount();
+    size_t FreeCount();
+
+    // What FileUtils::GetAppDataPath returns
+    std::wstring AppDataPath();
+
+    // Writes settings.ini; SettingsStore reads it on first use, so call this first
+    void WriteSettings(const std::wstring& text);
+
+    // CreateProcessW forks and runs entry with the command line in the child;
+    // the child exits with its result
+    void SetProcessEntry(std::function<int(const std::wstring& commandLine)> entry);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <windows.h>
+
+// Fake in FakeWin32.cpp
+BOOL PathRemoveFileSpecW(LPWSTR path);
@@ -0,0 +1,133 @@
+#pragma once
+
+// Just enough of the Win32 API for the headless tests to build the modules
+// that include <windows.h>. Types and GetSystemTime are here; the functions
+// the plugin host calls are fakes in FakeWin32.cpp (see FakeWin32.h), so
+// only tests that link it may call them. None of it is a faithful emulation.
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+#define WINAPI
+
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef unsigned long DWORD;
+typedef unsigned long long ULONGLONG;
+typedef const wchar_t* LPCWSTR;
+typedef wchar_t* LPWSTR;
+typedef void* HANDLE;
+typedef void* HWND;
+typedef struct FakeModule* HMODULE;
+typedef intptr_t(WINAPI* FARPROC)();
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#define MAX_PATH 260
+#define MAXDWORD 0xFFFFFFFFu
+#define INFINITE 0xFFFFFFFFu
+#define INVALID_HANDLE_VALUE (reinterpret_cast<HANDLE>(static_cast<intptr_t>(-1)))
+#define INVALID_FILE_ATTRIBUTES 0xFFFFFFFFu
+#define FILE_ATTRIBUTE_DIRECTORY 0x10u
+#define FILE_ATTRIBUTE_NORMAL 0x80u
+#define FILE_NOTIFY_CHANGE_FILE_NAME 0x1u
+#define FILE_NOTIFY_CHANGE_SIZE 0x8u
+#define FILE_NOTIFY_CHANGE_LAST_WRITE 0x10u
+#define WAIT_OBJECT_0 0u
+#define WAIT_TIMEOUT 258u
+#define WAIT_FAILED 0xFFFFFFFFu
+#define STILL_ACTIVE 259u
+#define SYNCHRONIZE 0x00100000u
+#define CREATE_NO_WINDOW 0x08000000u
+
+struct SYSTEMTIME {
+    WORD wYear;
+    WORD wMonth;
+    WORD wDayOfWeek;
+    WORD wDay;
+    WORD wHour;
+    WORD wMinute;
+    WORD wSecond;
+    WORD wMilliseconds;
+};
+
+struct FILETIME {
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+};
+
+struct WIN32_FIND_DATAW {
+    DWORD dwFileAttributes;
+    FILETIME ftCreationTime;
+    FILETIME ftLastAccessTime;
+    FILETIME ftLastWriteTime;
+    DWORD nFileSizeHigh;
+    DWORD nFileSizeLow;
+    wchar_t cFileName[MAX_PATH];
+};
+
+struct STARTUPINFOW {
+    DWORD cb;
+};
+
+struct PROCESS_INFORMATION {
+    HANDLE hProcess;
+    HANDLE hThread;
+    DWORD dwProcessId;
+    DWORD dwThreadId;
+};
+
+inline void GetSystemTime(SYSTEMTIME* time)
+{
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    tm utc;
+    gmtime_r(&now.tv_sec, &utc);
+    time->wYear = static_cast<WORD>(utc.tm_year + 1900);
+    time->wMonth = static_cast<WORD>(utc.tm_mon + 1);
+    time->wDayOfWeek = static_cast<WORD>(utc.tm_wday);
+    time->wDay = static_cast<WORD>(utc.tm_mday);
+    time->wHour = static_cast<WORD>(utc.tm_hour);
+    time->wMinute = static_cast<WORD>(utc.tm_min);
+    time->wSecond = static_cast<WORD>(utc.tm_sec);
+    time->wMilliseconds = static_cast<WORD>(now.tv_nsec / 1000000);
+}
+
+// Files: the plugins folder and the shadow copies are virtual (FakeWin32::SetPlugins)
+HANDLE FindFirstFileW(LPCWSTR pattern, WIN32_FIND_DATAW* data);
+BOOL FindNextFileW(HANDLE find, WIN32_FIND_DATAW* data);
+BOOL FindClose(HANDLE find);
+BOOL CopyFileW(LPCWSTR from, LPCWSTR to, BOOL failIfExists);
+BOOL DeleteFileW(LPCWSTR path);
+DWORD GetFileAttributesW(LPCWSTR path);
+HANDLE FindFirstChangeNotificationW(LPCWSTR path, BOOL subtree, DWORD filter);
+BOOL FindNextChangeNotification(HANDLE change);
+BOOL FindCloseChangeNotification(HANDLE change);
+
+// Modules: the virtual DLLs and their exports
+HMODULE LoadLibraryW(LPCWSTR path);
+FARPROC GetProcAddress(HMODULE module, const char* name);
+BOOL FreeLibrary(HMODULE module);
+DWORD GetModuleFileNameW(HMODULE module, LPWSTR path, DWORD size);
+
+// Synchronization and processes
+HANDLE CreateEventW(void* attributes, BOOL manualReset, BOOL initialState, LPCWSTR name);
+BOOL SetEvent(HANDLE event);
+BOOL ResetEvent(HANDLE event);
+DWORD WaitForSingleObject(HANDLE handle, DWORD milliseconds);
+DWORD WaitForMultipleObjects(DWORD count, const HANDLE* handles, BOOL waitAll, DWORD milliseconds);
+BOOL CloseHandle(HANDLE handle);
+BOOL CreateProcessW(LPCWSTR application, LPWSTR commandLine, void* processAttributes, void* threadAttributes,
+                    BOOL inheritHandles, DWORD flags, void* environment, LPCWSTR directory,
+                    STARTUPINFOW* startup, PROCESS_INFORMATION* information);
+HANDLE OpenProcess(DWORD access, BOOL inheritHandle, DWORD processId);
+BOOL TerminateProcess(HANDLE process, DWORD exitCode);
+BOOL GetExitCodeProcess(HANDLE process, DWORD* exitCode);
+DWORD GetProcessId(HANDLE process);
+DWORD GetCurrentProcessId();
+ULONGLONG GetTickCount64();